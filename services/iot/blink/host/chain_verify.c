@@ -0,0 +1,508 @@
+// Verifies sample chains captured from a tag (see main/sample_chain.h) and
+// reports what verification costs on the host.
+//
+//   chain_verify --pubkey HEX FILE   FILE holds one hex-encoded payload per line,
+//                                    as read from the payload characteristic
+//   chain_verify --self-check N      signs a synthetic N-sample chain the way the
+//                                    tag does, then checks that verification
+//                                    accepts it and catches edits, drops,
+//                                    forged checkpoints and forged resumes
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/core_names.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/param_build.h>
+
+#include "payload.h"
+
+// Must match main/sample_chain.h
+#define CHAIN_CHECKPOINT_INTERVAL  720
+#define PUBKEY_LEN                 65
+
+typedef struct {
+    size_t len;             // as if sent by current firmware, see read_samples
+    size_t body_len;        // bytes the link covers
+    payload_t p;
+} sample_t;
+
+typedef struct {
+    size_t samples;
+    size_t legacy;          // pre-chain payloads, nothing to verify
+    size_t verified;        // linked to a checkpoint with a valid signature
+    size_t unverified;      // cut off from every valid checkpoint
+    size_t pending;         // chained, but no checkpoint received yet
+    size_t breaks;          // link did not match the previous sample
+    size_t checkpoints;
+    size_t bad_signatures;
+    double hash_ns;
+    double verify_ns;
+} report_t;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void chain_hash(const uint8_t prev[PAYLOAD_LINK_LEN], const payload_t *p, size_t body_len,
+                       uint8_t out[PAYLOAD_LINK_LEN])
+{
+    static EVP_MD_CTX *ctx;
+    if (!ctx) ctx = EVP_MD_CTX_new();
+
+    EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
+    EVP_DigestUpdate(ctx, prev, PAYLOAD_LINK_LEN);
+    EVP_DigestUpdate(ctx, p, body_len);
+    EVP_DigestFinal_ex(ctx, out, NULL);
+}
+
+static EVP_PKEY *pubkey_from_octets(const uint8_t *octets, size_t len)
+{
+    EVP_PKEY *pkey = NULL;
+    OSSL_PARAM_BLD *bld = OSSL_PARAM_BLD_new();
+    OSSL_PARAM *params = NULL;
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", NULL);
+
+    if (bld && ctx &&
+        OSSL_PARAM_BLD_push_utf8_string(bld, OSSL_PKEY_PARAM_GROUP_NAME, "prime256v1", 0) &&
+        OSSL_PARAM_BLD_push_octet_string(bld, OSSL_PKEY_PARAM_PUB_KEY, octets, len) &&
+        (params = OSSL_PARAM_BLD_to_param(bld)) != NULL &&
+        EVP_PKEY_fromdata_init(ctx) > 0) {
+        EVP_PKEY_fromdata(ctx, &pkey, EVP_PKEY_PUBLIC_KEY, params);
+    }
+
+    OSSL_PARAM_free(params);
+    OSSL_PARAM_BLD_free(bld);
+    EVP_PKEY_CTX_free(ctx);
+    return pkey;
+}
+
+// The tag signs the link itself as the digest, with r||s encoding.
+static bool verify_checkpoint(EVP_PKEY *pkey, const payload_t *p)
+{
+    ECDSA_SIG *sig = ECDSA_SIG_new();
+    BIGNUM *r = BN_bin2bn(p->sig, 32, NULL);
+    BIGNUM *s = BN_bin2bn(p->sig + 32, 32, NULL);
+    if (!sig || !r || !s || !ECDSA_SIG_set0(sig, r, s)) {
+        ECDSA_SIG_free(sig);
+        BN_free(r);
+        BN_free(s);
+        return false;
+    }
+
+    unsigned char der[80];
+    unsigned char *der_end = der;
+    int der_len = i2d_ECDSA_SIG(sig, &der_end);
+    ECDSA_SIG_free(sig);
+
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    bool ok = ctx && der_len > 0 && EVP_PKEY_verify_init(ctx) > 0 &&
+              EVP_PKEY_verify(ctx, der, (size_t)der_len, p->link, PAYLOAD_LINK_LEN) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    return ok;
+}
+
+static bool sign_checkpoint(EVP_PKEY *pkey, payload_t *p)
+{
+    unsigned char der[80];
+    size_t der_len = sizeof(der);
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    bool ok = ctx && EVP_PKEY_sign_init(ctx) > 0 &&
+              EVP_PKEY_sign(ctx, der, &der_len, p->link, PAYLOAD_LINK_LEN) > 0;
+    EVP_PKEY_CTX_free(ctx);
+    if (!ok) return false;
+
+    const unsigned char *der_p = der;
+    ECDSA_SIG *sig = d2i_ECDSA_SIG(NULL, &der_p, (long)der_len);
+    if (!sig) return false;
+    ok = BN_bn2binpad(ECDSA_SIG_get0_r(sig), p->sig, 32) == 32 &&
+         BN_bn2binpad(ECDSA_SIG_get0_s(sig), p->sig + 32, 32) == 32;
+    ECDSA_SIG_free(sig);
+    return ok;
+}
+
+// Walks the samples in capture order. A sample is linked when its link equals
+// H(previous link || body); the previous link is the prior sample's, or after
+// a reboot the last checkpoint's (the tag resumes from there). A valid
+// checkpoint signature vouches for every linked sample back to the last break,
+// since each link commits to all bodies before it.
+//
+// Resuming from the checkpoint is only accepted at the seq sample_chain_init
+// resumes at, or right after the checkpoint, and starts a new segment: the
+// samples linked since the checkpoint can no longer reach a later one, so a
+// sample made up and chained from the checkpoint's link cannot ride along.
+static void verify_chain(EVP_PKEY *pkey, const sample_t *samples, size_t count, report_t *rep)
+{
+    static const uint8_t zero[PAYLOAD_LINK_LEN];
+    uint8_t prev[PAYLOAD_LINK_LEN];
+    uint8_t checkpoint_link[PAYLOAD_LINK_LEN];
+    uint8_t expect[PAYLOAD_LINK_LEN];
+    uint32_t checkpoint_seq = 0;
+    bool have_prev = false;
+    bool have_checkpoint = false;
+    size_t segment_linked = 0;
+
+    memset(rep, 0, sizeof(*rep));
+    for (size_t i = 0; i < count; i++) {
+        const sample_t *s = &samples[i];
+        rep->samples++;
+        if (s->len == PAYLOAD_LEGACY_LEN) {
+            rep->legacy++;
+            continue;
+        }
+
+        double t0 = now_ns();
+        bool linked = false;
+        bool restarted = false;
+        if (have_prev) {
+            chain_hash(prev, &s->p, s->body_len, expect);
+            linked = memcmp(expect, s->p.link, sizeof(expect)) == 0;
+        }
+        if (!linked && have_checkpoint &&
+            (s->p.seq == checkpoint_seq + 1 || s->p.seq == checkpoint_seq + CHAIN_CHECKPOINT_INTERVAL + 1)) {
+            chain_hash(checkpoint_link, &s->p, s->body_len, expect);
+            linked = restarted = memcmp(expect, s->p.link, sizeof(expect)) == 0;
+        }
+        if (!linked && s->p.seq == 0) {
+            chain_hash(zero, &s->p, s->body_len, expect);
+            linked = restarted = memcmp(expect, s->p.link, sizeof(expect)) == 0;
+        }
+        rep->hash_ns += now_ns() - t0;
+
+        if (!linked) {
+            // This body cannot be tied to its link, and nothing before it can
+            // reach a later checkpoint. Its link still anchors what follows.
+            if (have_prev) rep->breaks++;
+            rep->unverified += segment_linked + 1;
+            segment_linked = 0;
+        } else {
+            if (restarted && segment_linked > 0) {
+                rep->breaks++;
+                rep->unverified += segment_linked;
+                segment_linked = 0;
+            }
+            segment_linked++;
+        }
+        memcpy(prev, s->p.link, sizeof(prev));
+        have_prev = true;
+
+        if (s->len == PAYLOAD_CHECKPOINT_LEN) {
+            rep->checkpoints++;
+            t0 = now_ns();
+            bool ok = verify_checkpoint(pkey, &s->p);
+            rep->verify_ns += now_ns() - t0;
+            if (ok) {
+                rep->verified += segment_linked;
+                segment_linked = 0;
+                memcpy(checkpoint_link, s->p.link, sizeof(checkpoint_link));
+                checkpoint_seq = s->p.seq;
+                have_checkpoint = true;
+            } else {
+                rep->bad_signatures++;
+            }
+        }
+    }
+    rep->pending = segment_linked;
+}
+
+static void print_report(const char *name, const report_t *rep)
+{
+    size_t chained = rep->samples - rep->legacy;
+    printf("{\"run\":\"%s\",\"samples\":%zu,\"legacy\":%zu,\"verified\":%zu,\"unverified\":%zu,"
+           "\"pending\":%zu,\"breaks\":%zu,\"checkpoints\":%zu,\"badSignatures\":%zu,"
+           "\"hashNsPerSample\":%.1f,\"verifyUsPerCheckpoint\":%.1f,\"verifyNsPerSample\":%.1f}\n",
+           name, rep->samples, rep->legacy, rep->verified, rep->unverified, rep->pending, rep->breaks,
+           rep->checkpoints, rep->bad_signatures,
+           chained ? rep->hash_ns / (double)chained : 0.0,
+           rep->checkpoints ? rep->verify_ns / (double)rep->checkpoints / 1e3 : 0.0,
+           chained ? (rep->hash_ns + rep->verify_ns) / (double)chained : 0.0);
+}
+
+static int hex_nibble(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decodes hex into out, skipping whitespace, ':' and a leading "0x".
+// Returns the byte count, or -1 on bad input or overflow.
+static long parse_hex(const char *str, uint8_t *out, size_t max)
+{
+    if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) str += 2;
+
+    size_t n = 0;
+    int hi = -1;
+    for (; *str; str++) {
+        if (*str == ' ' || *str == '\t' || *str == ':' || *str == '\r' || *str == '\n') continue;
+        int v = hex_nibble((unsigned char)*str);
+        if (v < 0) return -1;
+        if (hi < 0) {
+            hi = v;
+        } else {
+            if (n == max) return -1;
+            out[n++] = (uint8_t)((hi << 4) | v);
+            hi = -1;
+        }
+    }
+    return hi < 0 ? (long)n : -1;
+}
+
+// Bytes the link covers for a chained payload of len bytes, from any firmware
+// generation; 0 if len is not one.
+static size_t chained_body_len(size_t len)
+{
+    static const size_t bodies[] = {
+        PAYLOAD_CHAINED_BODY, PAYLOAD_UNTIMED_BODY, PAYLOAD_PERIOD_BODY, PAYLOAD_SEQ_BODY,
+    };
+    for (size_t i = 0; i < sizeof(bodies) / sizeof(bodies[0]); i++) {
+        if (len == bodies[i] + PAYLOAD_LINK_LEN || len == bodies[i] + PAYLOAD_LINK_LEN + PAYLOAD_SIG_LEN) {
+            return bodies[i];
+        }
+    }
+    return 0;
+}
+
+static sample_t *read_samples(const char *path, size_t *count)
+{
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+
+    size_t cap = 1024, n = 0;
+    sample_t *samples = malloc(cap * sizeof(*samples));
+    char line[512];
+    unsigned lineno = 0;
+    while (samples && fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+
+        sample_t s;
+        memset(&s, 0, sizeof(s));
+        long len = parse_hex(line, (uint8_t *)&s.p, sizeof(s.p));
+        s.len = len < 0 ? 0 : (size_t)len;
+        s.body_len = chained_body_len(s.len);
+        if (s.len != PAYLOAD_LEGACY_LEN && s.body_len == 0) {
+            fprintf(stderr, "%s:%u: not a payload (%ld bytes)\n", path, lineno, len);
+            continue;
+        }
+        if (s.body_len != 0 && s.body_len != PAYLOAD_CHAINED_BODY) {
+            // Older firmware: move link and signature into place, clear the
+            // fields it did not send, and hash the shorter body they were
+            // made over.
+            uint8_t *raw = (uint8_t *)&s.p;
+            size_t tail = s.len - s.body_len;
+            memmove(raw + offsetof(payload_t, link), raw + s.body_len, tail);
+            memset(raw + s.body_len, 0, offsetof(payload_t, link) - s.body_len);
+            s.len += offsetof(payload_t, link) - s.body_len;
+        }
+
+        if (n == cap) {
+            cap *= 2;
+            sample_t *grown = realloc(samples, cap * sizeof(*samples));
+            if (!grown) {
+                free(samples);
+                samples = NULL;
+                break;
+            }
+            samples = grown;
+        }
+        samples[n++] = s;
+    }
+
+    if (f != stdin) fclose(f);
+    *count = n;
+    return samples;
+}
+
+// Produces what the tag would send from seq 0 on: every sample chained,
+// every CHAIN_CHECKPOINT_INTERVAL-th one signed.
+static sample_t *synthesize(EVP_PKEY *pkey, size_t count)
+{
+    sample_t *samples = calloc(count, sizeof(*samples));
+    if (!samples) return NULL;
+
+    uint8_t link[PAYLOAD_LINK_LEN] = {0};
+    for (size_t i = 0; i < count; i++) {
+        payload_t *p = &samples[i].p;
+        float t = 4.0f + (float)(i % 40) * 0.05f;
+        float h = 80.0f + (float)(i % 25) * 0.2f;
+        p->temp_min = t - 0.3f;
+        p->temp_max = t + 0.3f;
+        p->humi_min = h - 1.0f;
+        p->humi_max = h + 1.0f;
+        p->flag2 = FLAG_OK;
+        p->seq = (uint32_t)i;
+        p->t_ms = (uint32_t)i * 15000;
+        p->boot = 0x5a5a;
+        samples[i].body_len = PAYLOAD_CHAINED_BODY;
+        chain_hash(link, p, PAYLOAD_CHAINED_BODY, p->link);
+        memcpy(link, p->link, sizeof(link));
+
+        samples[i].len = PAYLOAD_SAMPLE_LEN;
+        if (p->seq % CHAIN_CHECKPOINT_INTERVAL == 0) {
+            if (!sign_checkpoint(pkey, p)) {
+                free(samples);
+                return NULL;
+            }
+            samples[i].len = PAYLOAD_CHECKPOINT_LEN;
+        }
+    }
+    return samples;
+}
+
+static int expect(bool cond, const char *what)
+{
+    fprintf(stderr, "%s: %s\n", cond ? "ok  " : "FAIL", what);
+    return cond ? 0 : 1;
+}
+
+static int self_check(size_t count)
+{
+    if (count < 3 * CHAIN_CHECKPOINT_INTERVAL) count = 3 * CHAIN_CHECKPOINT_INTERVAL;
+
+    EVP_PKEY *pkey = EVP_EC_gen("P-256");
+    EVP_PKEY *other = EVP_EC_gen("P-256");
+    sample_t *samples = pkey ? synthesize(pkey, count) : NULL;
+    if (!samples || !other) {
+        fprintf(stderr, "Could not build a synthetic chain\n");
+        return 1;
+    }
+
+    size_t last_checkpoint = (count - 1) / CHAIN_CHECKPOINT_INTERVAL * CHAIN_CHECKPOINT_INTERVAL;
+    size_t covered = last_checkpoint + 1;
+    int failures = 0;
+    report_t rep;
+
+    verify_chain(pkey, samples, count, &rep);
+    print_report("clean", &rep);
+    failures += expect(rep.verified == covered && rep.pending == count - covered &&
+                       rep.breaks == 0 && rep.bad_signatures == 0,
+                       "untouched chain verifies up to the last checkpoint");
+
+    verify_chain(other, samples, count, &rep);
+    print_report("wrong-key", &rep);
+    failures += expect(rep.verified == 0 && rep.bad_signatures == rep.checkpoints,
+                       "another device's key verifies nothing");
+
+    // Edited reading in the middle of the second interval.
+    size_t victim = CHAIN_CHECKPOINT_INTERVAL + CHAIN_CHECKPOINT_INTERVAL / 2;
+    sample_t saved = samples[victim];
+    samples[victim].p.temp_max += 5.0f;
+    verify_chain(pkey, samples, count, &rep);
+    print_report("edited", &rep);
+    failures += expect(rep.breaks == 1 && rep.verified == covered - (victim - CHAIN_CHECKPOINT_INTERVAL),
+                       "edited reading is rejected with everything since the previous checkpoint");
+    samples[victim] = saved;
+
+    // Reading removed from the capture.
+    memmove(&samples[victim], &samples[victim + 1], (count - victim - 1) * sizeof(*samples));
+    verify_chain(pkey, samples, count - 1, &rep);
+    print_report("dropped", &rep);
+    failures += expect(rep.breaks == 1 && rep.unverified > 0, "dropped reading breaks the chain");
+    memmove(&samples[victim + 1], &samples[victim], (count - victim - 1) * sizeof(*samples));
+    samples[victim] = saved;
+
+    // Checkpoint re-signed with a key the verifier does not trust.
+    size_t cp = 2 * CHAIN_CHECKPOINT_INTERVAL;
+    payload_t cp_saved = samples[cp].p;
+    sign_checkpoint(other, &samples[cp].p);
+    verify_chain(pkey, samples, count, &rep);
+    print_report("forged-checkpoint", &rep);
+    failures += expect(rep.bad_signatures == 1, "forged checkpoint signature is rejected");
+    samples[cp].p = cp_saved;
+
+    // Made-up reading chained from a checkpoint's link, slipped in ahead of
+    // the genuine sample that follows the checkpoint.
+    sample_t *forged = realloc(samples, (count + 1) * sizeof(*samples));
+    if (!forged) {
+        free(samples);
+        return 1;
+    }
+    samples = forged;
+    size_t at = CHAIN_CHECKPOINT_INTERVAL + 1;
+    memmove(&samples[at + 1], &samples[at], (count - at) * sizeof(*samples));
+    samples[at].p.temp_max -= 5.0f;
+    chain_hash(samples[CHAIN_CHECKPOINT_INTERVAL].p.link, &samples[at].p, samples[at].body_len,
+               samples[at].p.link);
+    verify_chain(pkey, samples, count + 1, &rep);
+    print_report("forged-resume", &rep);
+    failures += expect(rep.breaks == 1 && rep.unverified == 1 && rep.verified == covered,
+                       "reading chained from a checkpoint's link is not vouched for");
+
+    free(samples);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_free(other);
+    return failures ? 1 : 0;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s --pubkey HEX FILE|-\n"
+            "       %s --self-check N\n"
+            "  --pubkey HEX      device key from the key characteristic (65 bytes, 04||X||Y)\n"
+            "  --self-check N    verify a synthetic N-sample chain and tampered copies of it\n",
+            argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option opts[] = {
+        {"pubkey", required_argument, NULL, 'k'},
+        {"self-check", required_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    const char *pubkey_hex = NULL;
+    long self_check_count = 0;
+    int c;
+    while ((c = getopt_long(argc, argv, "k:s:h", opts, NULL)) != -1) {
+        switch (c) {
+        case 'k': pubkey_hex = optarg; break;
+        case 's': self_check_count = strtol(optarg, NULL, 10); break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 2;
+        }
+    }
+
+    if (self_check_count > 0) return self_check((size_t)self_check_count);
+
+    if (!pubkey_hex || optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    uint8_t octets[PUBKEY_LEN];
+    EVP_PKEY *pkey = NULL;
+    if (parse_hex(pubkey_hex, octets, sizeof(octets)) != PUBKEY_LEN ||
+        !(pkey = pubkey_from_octets(octets, sizeof(octets)))) {
+        fprintf(stderr, "--pubkey must be an uncompressed P-256 point\n");
+        return 2;
+    }
+
+    size_t count = 0;
+    sample_t *samples = read_samples(argv[optind], &count);
+    if (!samples) {
+        EVP_PKEY_free(pkey);
+        return 1;
+    }
+
+    report_t rep;
+    verify_chain(pkey, samples, count, &rep);
+    print_report(argv[optind], &rep);
+
+    free(samples);
+    EVP_PKEY_free(pkey);
+    return (rep.breaks || rep.bad_signatures) ? 1 : 0;
+}
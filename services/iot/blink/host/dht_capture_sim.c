@@ -0,0 +1,246 @@
+// Simulates reading N DHT22 probes, either one after another with the old
+// busy-wait reader or all at once with dht_array's shared start pulse and
+// per-pin edge interrupts. Captures are decoded with main/dht_decode.c.
+//
+//   dht_capture_sim [--max-sensors N] [--trials N] [--isr-us US] [--isr-latency-us US]
+//
+// Each sensor gets its own response delay and bit timings within the DHT22's
+// tolerances. The edge interrupt is modelled as a single handler: edges that
+// arrive while it is busy are timestamped late, which is what could corrupt
+// a decode when lines toggle together.
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dht_decode.h"
+
+// Must match main/dht_array.c
+#define START_LOW_US   1100
+
+#define MAX_SENSORS    16
+#define FRAME_BITS     40
+
+typedef struct {
+    double t_us;
+    int sensor;
+} edge_t;
+
+typedef struct {
+    uint8_t data[5];
+    float temp;
+    float humi;
+} frame_t;
+
+static uint64_t s_rng = 0x853C49E6748FEA9Bull;
+
+static double rand_unit(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / (double)(1ull << 53);
+}
+
+static double jitter(double nominal, double spread)
+{
+    return nominal + (rand_unit() * 2.0 - 1.0) * spread;
+}
+
+static void random_frame(frame_t *f)
+{
+    int temp_dc = (int)(rand_unit() * 400.0) - 100;   // -10.0 .. 30.0 C
+    int humi_dpct = 200 + (int)(rand_unit() * 700.0);  // 20.0 .. 90.0 %
+    uint16_t rt = (uint16_t)(temp_dc < 0 ? (0x8000 | -temp_dc) : temp_dc);
+
+    f->data[0] = (uint8_t)(humi_dpct >> 8);
+    f->data[1] = (uint8_t)humi_dpct;
+    f->data[2] = (uint8_t)(rt >> 8);
+    f->data[3] = (uint8_t)rt;
+    f->data[4] = (uint8_t)(f->data[0] + f->data[1] + f->data[2] + f->data[3]);
+    f->temp = temp_dc / 10.0f;
+    f->humi = humi_dpct / 10.0f;
+}
+
+// Falling edges on the line after the host releases it at t0.
+// Returns the time the sensor lets go of the line.
+static double frame_edges(const frame_t *f, double t0, double *edges)
+{
+    double t = t0 + jitter(30.0, 10.0);         // response delay 20..40 us
+    edges[0] = t;
+    t += jitter(80.0, 5.0) + jitter(80.0, 5.0);
+    edges[1] = t;
+    for (int i = 0; i < FRAME_BITS; i++) {
+        int bit = (f->data[i / 8] >> (7 - i % 8)) & 1;
+        t += jitter(50.0, 4.0) + (bit ? jitter(70.0, 5.0) : jitter(26.0, 4.0));
+        edges[i + 2] = t;
+    }
+    return t + 50.0;
+}
+
+static int cmp_edge(const void *a, const void *b)
+{
+    double x = ((const edge_t *)a)->t_us, y = ((const edge_t *)b)->t_us;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    double wall_us;
+    double cpu_us;
+    size_t decoded;
+    size_t wrong;
+    double worst_skew_us;
+} run_t;
+
+// The old reader: per sensor, a start pulse and a busy-wait over the frame.
+static void run_sequential(const frame_t *frames, int n, run_t *r)
+{
+    double edges[DHT_FRAME_EDGES];
+    uint32_t stamps[DHT_FRAME_EDGES];
+    double t = 0.0;
+
+    for (int s = 0; s < n; s++) {
+        t += START_LOW_US + 40.0;
+        double end = frame_edges(&frames[s], t, edges);
+        for (int i = 0; i < DHT_FRAME_EDGES; i++) stamps[i] = (uint32_t)lround(edges[i]);
+
+        float temp, humi;
+        if (dht_decode_edges(stamps, DHT_FRAME_EDGES, &temp, &humi) == DHT_DECODE_OK) {
+            r->decoded++;
+            if (temp != frames[s].temp || humi != frames[s].humi) r->wrong++;
+        }
+        t = end;
+    }
+    r->wall_us = t;
+    r->cpu_us = t;     // the CPU spins for the whole read
+}
+
+static void run_concurrent(const frame_t *frames, int n, double isr_us, double isr_latency_us, run_t *r)
+{
+    static edge_t all[MAX_SENSORS * DHT_FRAME_EDGES];
+    double edges[DHT_FRAME_EDGES];
+    uint32_t stamps[MAX_SENSORS][DHT_FRAME_EDGES];
+    int filled[MAX_SENSORS] = {0};
+    size_t count = 0;
+    double release = START_LOW_US;
+    double last_end = release;
+
+    for (int s = 0; s < n; s++) {
+        double end = frame_edges(&frames[s], release + s * 1.0, edges);   // pins released one by one
+        if (end > last_end) last_end = end;
+        for (int i = 0; i < DHT_FRAME_EDGES; i++) {
+            all[count].t_us = edges[i];
+            all[count].sensor = s;
+            count++;
+        }
+    }
+    qsort(all, count, sizeof(all[0]), cmp_edge);
+
+    // One interrupt line: an edge is stamped when its handler runs.
+    double busy_until = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double enter = all[i].t_us + isr_latency_us;
+        if (enter < busy_until) enter = busy_until;
+        busy_until = enter + isr_us;
+
+        int s = all[i].sensor;
+        stamps[s][filled[s]] = (uint32_t)lround(enter);
+        double skew = enter - all[i].t_us - isr_latency_us;
+        if (skew > r->worst_skew_us) r->worst_skew_us = skew;
+        filled[s]++;
+    }
+
+    for (int s = 0; s < n; s++) {
+        float temp, humi;
+        if (dht_decode_edges(stamps[s], (size_t)filled[s], &temp, &humi) == DHT_DECODE_OK) {
+            r->decoded++;
+            if (temp != frames[s].temp || humi != frames[s].humi) r->wrong++;
+        }
+    }
+
+    if (busy_until > last_end) last_end = busy_until;
+    r->wall_us = last_end;
+    r->cpu_us = START_LOW_US + (double)count * isr_us;   // start pulse spin + handlers
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --max-sensors N      largest probe count to simulate (default 8, max %d)\n"
+            "  --trials N           reads per probe count (default 2000)\n"
+            "  --isr-us US          edge handler run time (default 3.0)\n"
+            "  --isr-latency-us US  edge to handler entry (default 1.5)\n"
+            "  --seed N\n",
+            argv0, MAX_SENSORS);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option opts[] = {
+        {"max-sensors", required_argument, NULL, 'n'},
+        {"trials", required_argument, NULL, 't'},
+        {"isr-us", required_argument, NULL, 'i'},
+        {"isr-latency-us", required_argument, NULL, 'l'},
+        {"seed", required_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int max_sensors = 8;
+    int trials = 2000;
+    double isr_us = 3.0, isr_latency_us = 1.5;
+    int c;
+    while ((c = getopt_long(argc, argv, "n:t:i:l:s:h", opts, NULL)) != -1) {
+        switch (c) {
+        case 'n': max_sensors = atoi(optarg); break;
+        case 't': trials = atoi(optarg); break;
+        case 'i': isr_us = atof(optarg); break;
+        case 'l': isr_latency_us = atof(optarg); break;
+        case 's': s_rng = strtoull(optarg, NULL, 0) | 1; break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 2;
+        }
+    }
+    if (max_sensors < 1 || max_sensors > MAX_SENSORS || trials < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("{\n  \"trials\":%d,\"isrUs\":%.1f,\"isrLatencyUs\":%.1f,\n  \"results\":[\n",
+           trials, isr_us, isr_latency_us);
+    for (int n = 1; n <= max_sensors; n++) {
+        run_t seq = {0}, conc = {0};
+        double seq_wall = 0, seq_cpu = 0, conc_wall = 0, conc_cpu = 0, worst_wall = 0;
+        frame_t frames[MAX_SENSORS];
+
+        for (int t = 0; t < trials; t++) {
+            for (int s = 0; s < n; s++) random_frame(&frames[s]);
+
+            run_t a = {0}, b = {0};
+            run_sequential(frames, n, &a);
+            run_concurrent(frames, n, isr_us, isr_latency_us, &b);
+
+            seq_wall += a.wall_us;
+            seq_cpu += a.cpu_us;
+            seq.decoded += a.decoded;
+            seq.wrong += a.wrong;
+            conc_wall += b.wall_us;
+            conc_cpu += b.cpu_us;
+            conc.decoded += b.decoded;
+            conc.wrong += b.wrong;
+            if (b.worst_skew_us > conc.worst_skew_us) conc.worst_skew_us = b.worst_skew_us;
+            if (b.wall_us > worst_wall) worst_wall = b.wall_us;
+        }
+
+        double reads = (double)trials * n;
+        printf("    {\"sensors\":%d,"
+               "\"sequential\":{\"wallMs\":%.2f,\"cpuMs\":%.2f,\"decodedPct\":%.2f,\"wrong\":%zu},"
+               "\"concurrent\":{\"wallMs\":%.2f,\"worstWallMs\":%.2f,\"cpuMs\":%.2f,\"decodedPct\":%.2f,"
+               "\"wrong\":%zu,\"worstEdgeSkewUs\":%.1f}}%s\n",
+               n, seq_wall / trials / 1000.0, seq_cpu / trials / 1000.0, 100.0 * seq.decoded / reads, seq.wrong,
+               conc_wall / trials / 1000.0, worst_wall / 1000.0, conc_cpu / trials / 1000.0,
+               100.0 * conc.decoded / reads, conc.wrong, conc.worst_skew_us, n == max_sensors ? "" : ",");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,509 @@
+// Simulates the combined NFC + DHT22 node for a stretch of time and reports
+// NFC tap latency, DHT22 sample jitter and how many captures had I2C traffic
+// on the bus. Three ways of running both workloads are compared:
+//
+//   tasks      blink.c's PN532 loop and the old sensor task as two FreeRTOS
+//              tasks: blocking 10 ms tick polls, PN532 left at infinite
+//              activation retries, vTaskDelay between samples
+//   unguarded  main.c's dispatcher (main/node_sched.c) without the sample's
+//              protected window, so an NFC step may delay a sample
+//   scheduled  main.c's dispatcher as configured in the firmware
+//
+//   node_sched_sim [--duration-s S] [--period-ms MS] [--tap-interval-ms MS]
+//                  [--stall-pct P] [--seed N]
+//
+// Cards arrive at random (exponential gaps), stay in the field 200..800 ms and
+// never overlap. Tap latency runs from a card entering the field to its tap
+// being handed to the BLE stack. I2C timings assume 100 kHz; --stall-pct of
+// transfers get stuck on the bus and run until the driver's timeout.
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "node_sched.h"
+
+// Must match main/main.c, main/pn532.c and main/dht_array.c
+#define START_LOW_US          1100
+#define NFC_POLL_INTERVAL_US  100000
+#define NFC_TAP_HOLDOFF_US    1500000
+#define READY_POLL_US         2000
+#define SAMPLE_WCET_US        22000
+#define SAMPLE_GUARD_US       1000
+#define XFER_TIMEOUT_US       20000   // PN532_XFER_TIMEOUT_MS
+#define NFC_STEP_WCET_US      60000   // PN532_STEP_WCET_US
+#define PUBLISH_WCET_US       4000
+#define CHECKPOINT_INTERVAL   720
+
+// blink.c before the merge
+#define TICK_US               10000
+#define OLD_ACK_TIMEOUT_US    1000000
+#define OLD_LIST_TIMEOUT_US   1500000
+#define OLD_TAP_DELAY_US      1500000
+#define OLD_IDLE_DELAY_US     300000
+
+#define I2C_BYTE_US           90      // 9 clocks per byte
+#define I2C_SETUP_US          60
+#define PUBLISH_US            400
+#define SEAL_US               300
+#define SIGN_US               90000
+
+typedef struct {
+    double enter_us;
+    double leave_us;
+    double published_us;        // 0 until the first tap for this card
+    int reads;
+} card_t;
+
+typedef struct {
+    double start_us;
+    double end_us;
+} span_t;
+
+typedef struct {
+    double *v;
+    size_t n, cap;
+} series_t;
+
+typedef struct {
+    card_t *cards;
+    size_t card_count;
+    double duration_us;
+    double period_us;
+
+    span_t *windows;            // DHT22 captures
+    size_t window_count, window_cap;
+    span_t *xfers;              // I2C transactions
+    size_t xfer_count, xfer_cap;
+    double stall_rate;
+    size_t stalls;
+
+    series_t interval_err;      // |start[k+1] - start[k] - period|
+    series_t lateness;          // start - release, dispatcher modes only
+    size_t repeats;             // same card reported as a new tap
+} run_t;
+
+static uint64_t s_rng = 0x853C49E6748FEA9Bull;
+
+static double rand_unit(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / (double)(1ull << 53);
+}
+
+static double uniform(double lo, double hi)
+{
+    return lo + rand_unit() * (hi - lo);
+}
+
+static void series_push(series_t *s, double v)
+{
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1024;
+        s->v = realloc(s->v, s->cap * sizeof(*s->v));
+        if (!s->v) abort();
+    }
+    s->v[s->n++] = v;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct(series_t *s, double p)
+{
+    if (s->n == 0) return 0.0;
+    qsort(s->v, s->n, sizeof(*s->v), cmp_double);
+    size_t i = (size_t)(p / 100.0 * (double)(s->n - 1) + 0.5);
+    return s->v[i];
+}
+
+static void push_span(span_t **arr, size_t *n, size_t *cap, double start, double end)
+{
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 1024;
+        *arr = realloc(*arr, *cap * sizeof(**arr));
+        if (!*arr) abort();
+    }
+    (*arr)[*n].start_us = start;
+    (*arr)[*n].end_us = end;
+    (*n)++;
+}
+
+// Runs one I2C transaction of `bytes` data bytes at t; returns its end.
+static double i2c_xfer(run_t *r, double t, int bytes)
+{
+    double end = t + I2C_SETUP_US + I2C_BYTE_US * (bytes + 1);
+    if (r->stall_rate > 0.0 && rand_unit() < r->stall_rate) {
+        end = t + XFER_TIMEOUT_US;
+        r->stalls++;
+    }
+    push_span(&r->xfers, &r->xfer_count, &r->xfer_cap, t, end);
+    return end;
+}
+
+static double dht_capture_us(void)
+{
+    return START_LOW_US + uniform(4500.0, 5200.0) + 150.0;   // pulse, frame, decode
+}
+
+static double wake_latency_us(void)
+{
+    return uniform(20.0, 80.0);
+}
+
+// First card the PN532 can activate while listening over [from, until).
+// Returns its index and sets *ready_us to when the response is ready.
+static int find_card(const run_t *r, double from, double until, double *ready_us)
+{
+    for (size_t i = 0; i < r->card_count; i++) {
+        const card_t *c = &r->cards[i];
+        if (c->leave_us <= from) continue;
+        if (c->enter_us >= until) break;
+        double at = (c->enter_us > from ? c->enter_us : from) + uniform(5000.0, 12000.0);
+        if (at <= c->leave_us) {
+            *ready_us = at;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void report_tap(run_t *r, int card, double at_us)
+{
+    card_t *c = &r->cards[card];
+    c->reads++;
+    if (c->published_us == 0.0) c->published_us = at_us;
+}
+
+static double next_tick(double t)
+{
+    return (floor(t / TICK_US) + 1.0) * TICK_US + wake_latency_us();
+}
+
+// pn532_wait_ready from blink.c: one status read, then a tick's sleep.
+static double old_wait_ready(run_t *r, double t, double ready_at, double timeout_us, int *ready)
+{
+    double deadline = floor(t / TICK_US) * TICK_US + timeout_us;
+    while (t < deadline) {
+        double end = i2c_xfer(r, t, 1);
+        if (t >= ready_at) {
+            *ready = 1;
+            return end;
+        }
+        t = next_tick(end);
+    }
+    *ready = 0;
+    return t;
+}
+
+static void run_tasks(run_t *r)
+{
+    // Sensor task: read, then vTaskDelay(period) counted from the end.
+    double t = 0.0, prev = -1.0;
+    while (t < r->duration_us) {
+        double end = t + dht_capture_us();
+        push_span(&r->windows, &r->window_count, &r->window_cap, t, end);
+        if (prev >= 0.0) series_push(&r->interval_err, fabs(t - prev - r->period_us));
+        prev = t;
+        t = (floor(end / TICK_US) + r->period_us / TICK_US) * TICK_US + wake_latency_us();
+    }
+
+    // NFC task: blink.c's app_main loop. The PN532 listens until a card shows
+    // up or the next command replaces InListPassiveTarget.
+    t = 0.0;
+    int last_card = -1;
+    while (t < r->duration_us) {
+        int ready = 0;
+        double end = i2c_xfer(r, t, 13);
+        end = old_wait_ready(r, end, end + uniform(500.0, 1000.0), OLD_ACK_TIMEOUT_US, &ready);
+        if (!ready) {
+            t = end + OLD_IDLE_DELAY_US;
+            continue;
+        }
+        double listen = i2c_xfer(r, end, 7);
+
+        double resp_at = INFINITY;
+        int card = find_card(r, listen, listen + OLD_LIST_TIMEOUT_US, &resp_at);
+        end = old_wait_ready(r, listen, resp_at, OLD_LIST_TIMEOUT_US, &ready);
+        if (!ready) {
+            t = next_tick(end + OLD_IDLE_DELAY_US - TICK_US);
+            continue;
+        }
+        end = i2c_xfer(r, end, 6);
+        end = i2c_xfer(r, end, 14);
+        if (card == last_card) r->repeats++;
+        last_card = card;
+        report_tap(r, card, end + PUBLISH_US);
+        t = next_tick(end + OLD_TAP_DELAY_US - TICK_US);
+    }
+}
+
+typedef struct {
+    int state;                  // pn532_poll_state_t
+    double ready_at;
+    int card;
+} nfc_model_t;
+
+static void run_scheduled(run_t *r, int guarded)
+{
+    node_sched_t s;
+    node_sched_init(&s);
+    const node_job_config_t sample_cfg = {
+        .name = "sample", .priority = 3, .wcet_us = SAMPLE_WCET_US,
+        .deadline_us = SAMPLE_WCET_US + SAMPLE_GUARD_US, .guard_us = SAMPLE_GUARD_US,
+        .protected_window = guarded != 0,
+    };
+    const node_job_config_t nfc_cfg = {
+        .name = "nfc", .priority = 2, .wcet_us = NFC_STEP_WCET_US,
+        .deadline_us = NFC_STEP_WCET_US + SAMPLE_WCET_US,
+    };
+    const node_job_config_t publish_cfg = {
+        .name = "publish", .priority = 1, .wcet_us = PUBLISH_WCET_US, .deadline_us = 50000,
+    };
+    int job_sample = node_sched_add(&s, &sample_cfg);
+    int job_nfc = node_sched_add(&s, &nfc_cfg);
+    int job_publish = node_sched_add(&s, &publish_cfg);
+    node_sched_release(&s, job_sample, 0);
+    node_sched_release(&s, job_nfc, 0);
+
+    nfc_model_t nfc = {0};
+    double sealed_at = INFINITY;
+    double prev_start = -1.0;
+    uint32_t samples = 0;
+    int tap_card = -1;
+    int last_card = -1;
+    double last_card_us = -1e18;
+    double now = 0.0;
+
+    while (now < r->duration_us) {
+        if (sealed_at <= now) {
+            sealed_at = INFINITY;
+            node_sched_release(&s, job_publish, (uint64_t)now);
+        }
+
+        uint64_t wake = NODE_SCHED_NEVER;
+        int job = node_sched_next(&s, (uint64_t)now, &wake);
+        if (job < 0) {
+            double next = wake == NODE_SCHED_NEVER ? INFINITY : (double)wake;
+            if (sealed_at < next) next = sealed_at;
+            if (isinf(next)) break;
+            now = next + wake_latency_us();
+            continue;
+        }
+
+        double start = now, end = now;
+        if (job == job_sample) {
+            end = start + dht_capture_us();
+            push_span(&r->windows, &r->window_count, &r->window_cap, start, end);
+            series_push(&r->lateness, start - (double)s.jobs[job].last_release_us);
+            if (prev_start >= 0.0) series_push(&r->interval_err, fabs(start - prev_start - r->period_us));
+            prev_start = start;
+            samples++;
+            sealed_at = end + (samples % CHECKPOINT_INTERVAL == 0 ? SIGN_US : SEAL_US);
+            node_sched_release(&s, job_sample, s.jobs[job].last_release_us + (uint64_t)r->period_us);
+        } else if (job == job_nfc) {
+            uint64_t next_us = READY_POLL_US;
+            if (nfc.state == 0) {
+                end = i2c_xfer(r, start, 13);
+                nfc.ready_at = end + uniform(500.0, 1000.0);
+                nfc.state = 1;
+            } else {
+                end = i2c_xfer(r, start, 1);
+                if (start >= nfc.ready_at && nfc.state == 1) {
+                    end = i2c_xfer(r, end, 7);
+                    // Two activation attempts, then NbTg = 0.
+                    double until = end + uniform(8000.0, 10000.0);
+                    nfc.card = find_card(r, end, until, &nfc.ready_at);
+                    if (nfc.card < 0) nfc.ready_at = until;
+                    nfc.state = 2;
+                } else if (start >= nfc.ready_at) {
+                    end = i2c_xfer(r, end, 6);
+                    end = i2c_xfer(r, end, nfc.card >= 0 ? 14 : 5);
+                    if (nfc.card >= 0) {
+                        int repeat = nfc.card == last_card && start - last_card_us < NFC_TAP_HOLDOFF_US;
+                        last_card = nfc.card;
+                        last_card_us = start;
+                        if (!repeat) {
+                            tap_card = nfc.card;
+                            node_sched_release(&s, job_publish, (uint64_t)end);
+                        }
+                    }
+                    nfc.state = 0;
+                    next_us = 0;
+                }
+            }
+            node_sched_release(&s, job_nfc,
+                               nfc.state == 0 ? (uint64_t)start + NFC_POLL_INTERVAL_US : (uint64_t)start + next_us);
+        } else if (job == job_publish) {
+            end = start + PUBLISH_US;
+            if (tap_card >= 0) {
+                report_tap(r, tap_card, end);
+                tap_card = -1;
+            }
+        }
+        node_sched_complete(&s, job, (uint64_t)end);
+        now = end;
+    }
+}
+
+// Captures that had an I2C transaction anywhere inside them.
+static size_t disturbed(const run_t *r)
+{
+    size_t hits = 0, x = 0;
+    for (size_t w = 0; w < r->window_count; w++) {
+        const span_t *win = &r->windows[w];
+        while (x < r->xfer_count && r->xfers[x].end_us <= win->start_us) x++;
+        for (size_t k = x; k < r->xfer_count && r->xfers[k].start_us < win->end_us; k++) {
+            if (r->xfers[k].end_us > win->start_us) {
+                hits++;
+                break;
+            }
+        }
+    }
+    return hits;
+}
+
+static int cmp_span(const void *a, const void *b)
+{
+    return cmp_double(&((const span_t *)a)->start_us, &((const span_t *)b)->start_us);
+}
+
+static void print_run(const char *name, run_t *r, int last)
+{
+    qsort(r->xfers, r->xfer_count, sizeof(*r->xfers), cmp_span);
+
+    series_t latency = {0};
+    size_t missed = 0;
+    for (size_t i = 0; i < r->card_count; i++) {
+        const card_t *c = &r->cards[i];
+        if (c->enter_us >= r->duration_us - 2e6) continue;   // may not have had its chance yet
+        if (c->published_us == 0.0) missed++;
+        else series_push(&latency, c->published_us - c->enter_us);
+    }
+
+    char lateness[96] = "null";
+    if (r->lateness.n) {
+        snprintf(lateness, sizeof(lateness), "{\"p50\":%.0f,\"p99\":%.0f,\"max\":%.0f}",
+                 pct(&r->lateness, 50), pct(&r->lateness, 99), pct(&r->lateness, 100));
+    }
+
+    double bus_us = 0.0;
+    for (size_t i = 0; i < r->xfer_count; i++) bus_us += r->xfers[i].end_us - r->xfers[i].start_us;
+
+    printf("    \"%s\":{\"samples\":%zu,\"disturbedSamples\":%zu,"
+           "\"jitterUs\":{\"p50\":%.0f,\"p99\":%.0f,\"max\":%.0f},"
+           "\"latenessUs\":%s,\n"
+           "      \"taps\":%zu,\"missedTaps\":%zu,\"repeatTaps\":%zu,"
+           "\"tapLatencyMs\":{\"p50\":%.1f,\"p95\":%.1f,\"p99\":%.1f,\"max\":%.1f},"
+           "\"i2cTransactions\":%zu,\"i2cStalls\":%zu,\"i2cBusyPct\":%.3f}%s\n",
+           name, r->window_count, disturbed(r),
+           pct(&r->interval_err, 50), pct(&r->interval_err, 99), pct(&r->interval_err, 100),
+           lateness,
+           latency.n, missed, r->repeats,
+           pct(&latency, 50) / 1000.0, pct(&latency, 95) / 1000.0, pct(&latency, 99) / 1000.0,
+           pct(&latency, 100) / 1000.0,
+           r->xfer_count, r->stalls, 100.0 * bus_us / r->duration_us, last ? "" : ",");
+    free(latency.v);
+}
+
+static void run_free(run_t *r)
+{
+    free(r->windows);
+    free(r->xfers);
+    free(r->interval_err.v);
+    free(r->lateness.v);
+    free(r->cards);
+}
+
+static size_t make_cards(card_t **out, double duration_us, double mean_gap_us)
+{
+    size_t n = 0, cap = 256;
+    card_t *cards = malloc(cap * sizeof(*cards));
+    if (!cards) abort();
+    double t = 0.0;
+    for (;;) {
+        t += -log(1.0 - rand_unit()) * mean_gap_us;
+        if (t >= duration_us) break;
+        if (n == cap) {
+            cap *= 2;
+            cards = realloc(cards, cap * sizeof(*cards));
+            if (!cards) abort();
+        }
+        card_t *c = &cards[n++];
+        memset(c, 0, sizeof(*c));
+        c->enter_us = t;
+        c->leave_us = t + uniform(200000.0, 800000.0);
+        t = c->leave_us + 100000.0;
+    }
+    *out = cards;
+    return n;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --duration-s S         simulated time (default 3600)\n"
+            "  --period-ms MS         DHT22 sample period (default 2000, the sensor's minimum)\n"
+            "  --tap-interval-ms MS   mean gap between cards (default 3000)\n"
+            "  --stall-pct P          I2C transfers stuck until the driver timeout (default 0.1)\n"
+            "  --seed N\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option opts[] = {
+        {"duration-s", required_argument, NULL, 'd'},
+        {"period-ms", required_argument, NULL, 'p'},
+        {"tap-interval-ms", required_argument, NULL, 't'},
+        {"stall-pct", required_argument, NULL, 'x'},
+        {"seed", required_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    double duration_s = 3600.0, period_ms = 2000.0, tap_interval_ms = 3000.0, stall_pct = 0.1;
+    uint64_t seed = s_rng;
+    int c;
+    while ((c = getopt_long(argc, argv, "d:p:t:x:s:h", opts, NULL)) != -1) {
+        switch (c) {
+        case 'd': duration_s = atof(optarg); break;
+        case 'p': period_ms = atof(optarg); break;
+        case 't': tap_interval_ms = atof(optarg); break;
+        case 'x': stall_pct = atof(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 0) | 1; break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 2;
+        }
+    }
+    if (duration_s <= 0 || period_ms < 100 || tap_interval_ms <= 0 || stall_pct < 0 || stall_pct > 100) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    static const char *const names[] = { "tasks", "unguarded", "scheduled" };
+    printf("{\n  \"durationS\":%.0f,\"periodMs\":%.0f,\"tapIntervalMs\":%.0f,\"stallPct\":%g,\n  \"modes\":{\n",
+           duration_s, period_ms, tap_interval_ms, stall_pct);
+    for (int m = 0; m < 3; m++) {
+        // Same cards for every mode.
+        s_rng = seed;
+        run_t r = {0};
+        r.duration_us = duration_s * 1e6;
+        r.period_us = period_ms * 1000.0;
+        r.stall_rate = stall_pct / 100.0;
+        r.card_count = make_cards(&r.cards, r.duration_us, tap_interval_ms * 1000.0);
+
+        if (m == 0) run_tasks(&r);
+        else run_scheduled(&r, m == 2);
+        print_run(names[m], &r, m == 2);
+        run_free(&r);
+    }
+    printf("  }\n}\n");
+    return 0;
+}
@@ -0,0 +1,408 @@
+// Replays a temperature/humidity trace through the firmware's sampling
+// policies and reports samples taken against excursion-detection latency.
+//
+//   sched_replay TRACE.csv          lines of "seconds,temp_c,humi_pct", in order
+//   sched_replay --synthesize H     a generated H-hour reefer trace with door openings
+//   sched_replay --write-trace F    also write the generated trace to F
+//
+// The trace is ground truth: an excursion starts at the first out-of-bounds
+// point and ends when the value is back in bounds. Sensor noise flickering
+// across a bound is folded into one excursion, and blips shorter than
+// --min-excursion are ignored. A policy detects an excursion when one of its
+// samples falls inside it and reads out of bounds.
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sample_sched.h"
+
+// Must match main/main.c
+#define FW_TEMP_MIN_ALLOWED_C    (-10.0f)
+#define FW_TEMP_MAX_ALLOWED_C    (60.0f)
+#define FW_HUMI_MIN_ALLOWED_PCT  (0.0f)
+#define FW_HUMI_MAX_ALLOWED_PCT  (100.0f)
+#define FW_SAMPLE_PERIOD_MIN_MS  DHT22_MIN_INTERVAL_MS
+#define FW_SAMPLE_PERIOD_MAX_MS  60000
+#define FW_TEMP_GUARD_C          2.0f
+#define FW_HUMI_GUARD_PCT        5.0f
+#define FW_SAMPLES_TO_EXCURSION  4.0f
+#define FW_FIXED_PERIOD_MS       5000   // period before the adaptive scheduler
+
+#define EXCURSION_MERGE_GAP_S    60.0
+#define DEFAULT_MIN_EXCURSION_S  10.0
+
+// Cold-chain limits used for the synthetic trace unless overridden.
+#define SYN_TEMP_MIN_C    2.0f
+#define SYN_TEMP_MAX_C    8.0f
+#define SYN_HUMI_MIN_PCT  30.0f
+#define SYN_HUMI_MAX_PCT  90.0f
+
+typedef struct {
+    double t_s;
+    float temp;
+    float humi;
+} point_t;
+
+typedef struct {
+    point_t *pts;
+    size_t count;
+} trace_t;
+
+typedef struct {
+    double start_s;
+    double end_s;
+} excursion_t;
+
+typedef struct {
+    const char *name;
+    size_t samples;
+    size_t detected;
+    size_t missed;
+    double *latency_s;       // one per detected excursion
+} result_t;
+
+static uint64_t s_rng = 0x2545F4914F6CDD1Dull;
+
+static double rand_unit(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / (double)(1ull << 53);
+}
+
+static int trace_push(trace_t *tr, size_t *cap, point_t p)
+{
+    if (tr->count == *cap) {
+        size_t grown_cap = *cap ? *cap * 2 : 4096;
+        point_t *grown = realloc(tr->pts, grown_cap * sizeof(*grown));
+        if (!grown) return -1;
+        tr->pts = grown;
+        *cap = grown_cap;
+    }
+    tr->pts[tr->count++] = p;
+    return 0;
+}
+
+static int load_trace(const char *path, trace_t *tr)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    size_t cap = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        point_t p;
+        if (sscanf(line, "%lf,%f,%f", &p.t_s, &p.temp, &p.humi) != 3) continue;   // header, comments
+        if (tr->count && p.t_s <= tr->pts[tr->count - 1].t_s) continue;
+        if (trace_push(tr, &cap, p) != 0) break;
+    }
+    fclose(f);
+    return tr->count >= 2 ? 0 : -1;
+}
+
+// A reefer held at 4 C with a door opening every couple of hours; while open
+// the box relaxes toward dock air, then recovers once closed. Values are
+// quantized like the DHT22's 0.1 steps.
+static int synthesize_trace(double hours, trace_t *tr)
+{
+    const double step_s = 1.0;
+    const double tau_open_s = 480.0;
+    const double tau_close_s = 300.0;
+    const float set_temp = 4.0f, dock_temp = 20.0f;
+    const float set_humi = 60.0f, dock_humi = 85.0f;
+
+    size_t cap = 0;
+    double temp = set_temp, humi = set_humi;
+    double next_open_s = 1800.0 + rand_unit() * 7200.0;
+    double close_s = -1.0;
+
+    for (double t = 0.0; t <= hours * 3600.0; t += step_s) {
+        if (close_s < 0.0 && t >= next_open_s) {
+            close_s = t + 60.0 + rand_unit() * 540.0;
+        }
+        bool open = close_s >= 0.0 && t < close_s;
+        if (close_s >= 0.0 && t >= close_s) {
+            close_s = -1.0;
+            next_open_s = t + 1800.0 + rand_unit() * 7200.0;
+        }
+
+        double target_t = open ? dock_temp : set_temp + 0.3 * sin(t / 5400.0);
+        double target_h = open ? dock_humi : set_humi;
+        double tau = open ? tau_open_s : tau_close_s;
+        temp += (target_t - temp) * step_s / tau;
+        humi += (target_h - humi) * step_s / tau;
+
+        point_t p = {
+            .t_s = t,
+            .temp = roundf((float)(temp + (rand_unit() - 0.5) * 0.1) * 10.0f) / 10.0f,
+            .humi = roundf((float)(humi + (rand_unit() - 0.5) * 0.4) * 10.0f) / 10.0f,
+        };
+        if (trace_push(tr, &cap, p) != 0) return -1;
+    }
+    return 0;
+}
+
+static point_t sample_at(const trace_t *tr, double t_s, size_t *cursor)
+{
+    while (*cursor + 1 < tr->count && tr->pts[*cursor + 1].t_s <= t_s) (*cursor)++;
+    return tr->pts[*cursor];
+}
+
+static bool out_of_bounds(const sample_sched_config_t *cfg, float temp, float humi)
+{
+    return temp < cfg->temp_min_c || temp > cfg->temp_max_c ||
+           humi < cfg->humi_min_pct || humi > cfg->humi_max_pct;
+}
+
+static size_t find_excursions(const trace_t *tr, const sample_sched_config_t *cfg, double min_s, excursion_t **out)
+{
+    size_t n = 0, cap = 16;
+    excursion_t *ex = malloc(cap * sizeof(*ex));
+    bool inside = false;
+
+    for (size_t i = 0; ex && i < tr->count; i++) {
+        bool oob = out_of_bounds(cfg, tr->pts[i].temp, tr->pts[i].humi);
+        if (oob && !inside && n && tr->pts[i].t_s - ex[n - 1].end_s < EXCURSION_MERGE_GAP_S) {
+            ex[n - 1].end_s = tr->pts[tr->count - 1].t_s;
+        } else if (oob && !inside) {
+            if (n && ex[n - 1].end_s - ex[n - 1].start_s < min_s) n--;
+            if (n == cap) {
+                cap *= 2;
+                excursion_t *grown = realloc(ex, cap * sizeof(*ex));
+                if (!grown) break;
+                ex = grown;
+            }
+            ex[n].start_s = tr->pts[i].t_s;
+            ex[n].end_s = tr->pts[tr->count - 1].t_s;
+            n++;
+        } else if (!oob && inside) {
+            ex[n - 1].end_s = tr->pts[i].t_s;
+        }
+        inside = oob;
+    }
+    if (n && ex[n - 1].end_s - ex[n - 1].start_s < min_s) n--;
+    *out = ex;
+    return n;
+}
+
+// fixed_ms == 0 runs the adaptive scheduler.
+static void run_policy(const trace_t *tr, const sample_sched_config_t *cfg, uint32_t fixed_ms,
+                       const excursion_t *ex, size_t ex_count, result_t *res)
+{
+    sample_sched_t sched;
+    sample_sched_init(&sched, cfg);
+
+    double *first_seen = malloc(ex_count * sizeof(*first_seen));
+    for (size_t i = 0; i < ex_count; i++) first_seen[i] = -1.0;
+
+    size_t cursor = 0, ex_idx = 0;
+    double start = tr->pts[0].t_s, end = tr->pts[tr->count - 1].t_s;
+    res->samples = 0;
+
+    for (double t = start; t <= end;) {
+        point_t p = sample_at(tr, t, &cursor);
+        res->samples++;
+
+        while (ex_idx < ex_count && ex[ex_idx].end_s <= t) ex_idx++;
+        if (ex_idx < ex_count && t >= ex[ex_idx].start_s && first_seen[ex_idx] < 0.0 &&
+            out_of_bounds(cfg, p.temp, p.humi)) {
+            first_seen[ex_idx] = t;
+        }
+
+        uint32_t period_ms = fixed_ms;
+        if (!fixed_ms) period_ms = sample_sched_update(&sched, (uint32_t)((t - start) * 1000.0), p.temp, p.humi);
+        t += period_ms / 1000.0;
+    }
+
+    res->detected = 0;
+    res->missed = 0;
+    res->latency_s = malloc((ex_count ? ex_count : 1) * sizeof(*res->latency_s));
+    for (size_t i = 0; i < ex_count; i++) {
+        if (first_seen[i] < 0.0) {
+            res->missed++;
+        } else {
+            res->latency_s[res->detected++] = first_seen[i] - ex[i].start_s;
+        }
+    }
+    free(first_seen);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t n, double p)
+{
+    if (!n) return 0.0;
+    size_t idx = (size_t)(p / 100.0 * (double)n);
+    return sorted[idx < n ? idx : n - 1];
+}
+
+static void print_result(const result_t *res, const result_t *baseline, bool last)
+{
+    qsort(res->latency_s, res->detected, sizeof(double), cmp_double);
+    double mean = 0.0;
+    for (size_t i = 0; i < res->detected; i++) mean += res->latency_s[i];
+    if (res->detected) mean /= (double)res->detected;
+
+    printf("    {\"policy\":\"%s\",\"samples\":%zu,\"samplesSavedPct\":%.1f,\"detected\":%zu,\"missed\":%zu,"
+           "\"latencyS\":{\"mean\":%.1f,\"p50\":%.1f,\"p95\":%.1f,\"max\":%.1f}}%s\n",
+           res->name, res->samples,
+           baseline->samples ? 100.0 * (1.0 - (double)res->samples / (double)baseline->samples) : 0.0,
+           res->detected, res->missed, mean,
+           percentile(res->latency_s, res->detected, 50), percentile(res->latency_s, res->detected, 95),
+           res->detected ? res->latency_s[res->detected - 1] : 0.0, last ? "" : ",");
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options] TRACE.csv | --synthesize HOURS\n"
+            "  --synthesize H      generate an H-hour reefer trace instead of reading one\n"
+            "  --write-trace F     write the generated trace as CSV\n"
+            "  --seed N            seed for the generated trace\n"
+            "  --temp-min C  --temp-max C  --humi-min P  --humi-max P\n"
+            "                      bounds (default: firmware values, or cold-chain 2..8 C,\n"
+            "                      30..90%% for a generated trace)\n"
+            "  --min-ms N  --max-ms N  --guard-temp C  --guard-humi P  --samples-ahead N\n"
+            "                      scheduler settings (default: firmware values)\n"
+            "  --fixed-ms N        fixed-period baseline (default %d)\n"
+            "  --min-excursion S   ignore excursions shorter than S seconds (default %.0f)\n",
+            argv0, FW_FIXED_PERIOD_MS, DEFAULT_MIN_EXCURSION_S);
+}
+
+int main(int argc, char **argv)
+{
+    enum { OPT_TMIN = 256, OPT_TMAX, OPT_HMIN, OPT_HMAX, OPT_MIN, OPT_MAX, OPT_GT, OPT_GH, OPT_AHEAD, OPT_FIXED, OPT_MINEX };
+    static const struct option opts[] = {
+        {"synthesize", required_argument, NULL, 's'},
+        {"write-trace", required_argument, NULL, 'w'},
+        {"seed", required_argument, NULL, 'S'},
+        {"temp-min", required_argument, NULL, OPT_TMIN},
+        {"temp-max", required_argument, NULL, OPT_TMAX},
+        {"humi-min", required_argument, NULL, OPT_HMIN},
+        {"humi-max", required_argument, NULL, OPT_HMAX},
+        {"min-ms", required_argument, NULL, OPT_MIN},
+        {"max-ms", required_argument, NULL, OPT_MAX},
+        {"guard-temp", required_argument, NULL, OPT_GT},
+        {"guard-humi", required_argument, NULL, OPT_GH},
+        {"samples-ahead", required_argument, NULL, OPT_AHEAD},
+        {"fixed-ms", required_argument, NULL, OPT_FIXED},
+        {"min-excursion", required_argument, NULL, OPT_MINEX},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    sample_sched_config_t cfg = {
+        .min_period_ms = FW_SAMPLE_PERIOD_MIN_MS,
+        .max_period_ms = FW_SAMPLE_PERIOD_MAX_MS,
+        .temp_min_c = NAN,
+        .temp_max_c = NAN,
+        .humi_min_pct = NAN,
+        .humi_max_pct = NAN,
+        .temp_guard_c = FW_TEMP_GUARD_C,
+        .humi_guard_pct = FW_HUMI_GUARD_PCT,
+        .samples_to_excursion = FW_SAMPLES_TO_EXCURSION,
+    };
+    double synth_hours = 0.0;
+    const char *write_path = NULL;
+    uint32_t fixed_ms = FW_FIXED_PERIOD_MS;
+    double min_excursion_s = DEFAULT_MIN_EXCURSION_S;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "s:w:S:h", opts, NULL)) != -1) {
+        switch (c) {
+        case 's': synth_hours = atof(optarg); break;
+        case 'w': write_path = optarg; break;
+        case 'S': s_rng = strtoull(optarg, NULL, 0) | 1; break;
+        case OPT_TMIN: cfg.temp_min_c = strtof(optarg, NULL); break;
+        case OPT_TMAX: cfg.temp_max_c = strtof(optarg, NULL); break;
+        case OPT_HMIN: cfg.humi_min_pct = strtof(optarg, NULL); break;
+        case OPT_HMAX: cfg.humi_max_pct = strtof(optarg, NULL); break;
+        case OPT_MIN: cfg.min_period_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_MAX: cfg.max_period_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_GT: cfg.temp_guard_c = strtof(optarg, NULL); break;
+        case OPT_GH: cfg.humi_guard_pct = strtof(optarg, NULL); break;
+        case OPT_AHEAD: cfg.samples_to_excursion = strtof(optarg, NULL); break;
+        case OPT_FIXED: fixed_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_MINEX: min_excursion_s = atof(optarg); break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 2;
+        }
+    }
+
+    trace_t tr = {0};
+    const char *source;
+    if (synth_hours > 0.0) {
+        if (synthesize_trace(synth_hours, &tr) != 0) return 1;
+        source = "synthetic";
+        if (isnan(cfg.temp_min_c)) cfg.temp_min_c = SYN_TEMP_MIN_C;
+        if (isnan(cfg.temp_max_c)) cfg.temp_max_c = SYN_TEMP_MAX_C;
+        if (isnan(cfg.humi_min_pct)) cfg.humi_min_pct = SYN_HUMI_MIN_PCT;
+        if (isnan(cfg.humi_max_pct)) cfg.humi_max_pct = SYN_HUMI_MAX_PCT;
+    } else if (optind == argc - 1) {
+        if (load_trace(argv[optind], &tr) != 0) {
+            fprintf(stderr, "%s: need at least two \"seconds,temp,humi\" lines\n", argv[optind]);
+            return 1;
+        }
+        source = argv[optind];
+    } else {
+        usage(argv[0]);
+        return 2;
+    }
+    if (isnan(cfg.temp_min_c)) cfg.temp_min_c = FW_TEMP_MIN_ALLOWED_C;
+    if (isnan(cfg.temp_max_c)) cfg.temp_max_c = FW_TEMP_MAX_ALLOWED_C;
+    if (isnan(cfg.humi_min_pct)) cfg.humi_min_pct = FW_HUMI_MIN_ALLOWED_PCT;
+    if (isnan(cfg.humi_max_pct)) cfg.humi_max_pct = FW_HUMI_MAX_ALLOWED_PCT;
+    if (fixed_ms < DHT22_MIN_INTERVAL_MS) fixed_ms = DHT22_MIN_INTERVAL_MS;
+
+    if (write_path) {
+        FILE *f = fopen(write_path, "w");
+        if (!f) {
+            perror(write_path);
+            return 1;
+        }
+        fprintf(f, "seconds,temp_c,humi_pct\n");
+        for (size_t i = 0; i < tr.count; i++) {
+            fprintf(f, "%.1f,%.1f,%.1f\n", tr.pts[i].t_s, tr.pts[i].temp, tr.pts[i].humi);
+        }
+        fclose(f);
+    }
+
+    excursion_t *ex = NULL;
+    size_t ex_count = find_excursions(&tr, &cfg, min_excursion_s, &ex);
+
+    // The floor period as a latency reference, the old fixed period as the
+    // sample-count baseline, and the adaptive policy.
+    result_t results[3] = {
+        {.name = "fixed-min"},
+        {.name = "fixed"},
+        {.name = "adaptive"},
+    };
+    run_policy(&tr, &cfg, cfg.min_period_ms < DHT22_MIN_INTERVAL_MS ? DHT22_MIN_INTERVAL_MS : cfg.min_period_ms,
+               ex, ex_count, &results[0]);
+    run_policy(&tr, &cfg, fixed_ms, ex, ex_count, &results[1]);
+    run_policy(&tr, &cfg, 0, ex, ex_count, &results[2]);
+
+    printf("{\n  \"trace\":\"%s\",\"hours\":%.2f,\"excursions\":%zu,\n", source,
+           (tr.pts[tr.count - 1].t_s - tr.pts[0].t_s) / 3600.0, ex_count);
+    printf("  \"bounds\":{\"tempC\":[%.1f,%.1f],\"humiPct\":[%.1f,%.1f]},\n",
+           cfg.temp_min_c, cfg.temp_max_c, cfg.humi_min_pct, cfg.humi_max_pct);
+    printf("  \"scheduler\":{\"minMs\":%u,\"maxMs\":%u,\"guardTempC\":%.1f,\"guardHumiPct\":%.1f,\"samplesAhead\":%.1f},\n",
+           cfg.min_period_ms, cfg.max_period_ms, cfg.temp_guard_c, cfg.humi_guard_pct, cfg.samples_to_excursion);
+    printf("  \"fixedMs\":%u,\n  \"results\":[\n", fixed_ms);
+    for (int i = 0; i < 3; i++) print_result(&results[i], &results[1], i == 2);
+    printf("  ]\n}\n");
+
+    for (int i = 0; i < 3; i++) free(results[i].latency_s);
+    free(ex);
+    free(tr.pts);
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "dht_array.h"
+
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+
+#include "dht_decode.h"
+
+static const char *TAG = "DHT_ARRAY";
+
+// DHT22 wake-up needs the line held low for at least 1 ms.
+#define START_LOW_US         1100
+// A frame is under 5 ms; two ticks at 100 Hz leaves slack for a late sensor.
+#define CAPTURE_TIMEOUT_MS   20
+#define EDGES_MAX            (DHT_FRAME_EDGES + 4)
+
+typedef struct {
+    gpio_num_t pin;
+    volatile uint32_t count;
+    uint32_t edges[EDGES_MAX];
+} dht_channel_t;
+
+static dht_channel_t s_channels[DHT_ARRAY_MAX];
+static size_t s_count;
+static TaskHandle_t s_waiter;
+static volatile uint32_t s_pending;
+
+// Timestamps every falling edge; the line's own timing is decoded later, so
+// the ISR only has to be quick enough not to smear edges on other lines.
+static void IRAM_ATTR edge_isr(void *arg)
+{
+    dht_channel_t *ch = (dht_channel_t *)arg;
+    uint32_t now = (uint32_t)esp_timer_get_time();
+
+    uint32_t n = ch->count;
+    if (n >= EDGES_MAX) return;
+    ch->edges[n] = now;
+    ch->count = n + 1;
+
+    if (n + 1 == DHT_FRAME_EDGES && --s_pending == 0) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(s_waiter, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+esp_err_t dht_array_init(const gpio_num_t *pins, size_t count)
+{
+    if (count == 0 || count > DHT_ARRAY_MAX) return ESP_ERR_INVALID_ARG;
+
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; i++) mask |= 1ULL << pins[i];
+
+    gpio_config_t io = {
+        .pin_bit_mask = mask,
+        .mode = GPIO_MODE_INPUT_OUTPUT_OD,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    esp_err_t err = gpio_config(&io);
+    if (err != ESP_OK) return err;
+
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;   // already installed
+
+    for (size_t i = 0; i < count; i++) {
+        s_channels[i].pin = pins[i];
+        gpio_set_level(pins[i], 1);
+        gpio_intr_disable(pins[i]);
+        err = gpio_isr_handler_add(pins[i], edge_isr, &s_channels[i]);
+        if (err != ESP_OK) return err;
+    }
+    s_count = count;
+    s_waiter = xTaskGetCurrentTaskHandle();
+    return ESP_OK;
+}
+
+esp_err_t dht_array_read(dht_reading_t *out)
+{
+    if (s_count == 0) return ESP_ERR_INVALID_STATE;
+
+    for (size_t i = 0; i < s_count; i++) s_channels[i].count = 0;
+    s_pending = (uint32_t)s_count;
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    // One shared start pulse: the sensors then answer in parallel.
+    for (size_t i = 0; i < s_count; i++) gpio_set_level(s_channels[i].pin, 0);
+    esp_rom_delay_us(START_LOW_US);
+    for (size_t i = 0; i < s_count; i++) {
+        gpio_set_level(s_channels[i].pin, 1);
+        gpio_intr_enable(s_channels[i].pin);
+    }
+
+    bool complete = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CAPTURE_TIMEOUT_MS)) != 0;
+
+    for (size_t i = 0; i < s_count; i++) gpio_intr_disable(s_channels[i].pin);
+    if (!complete) ESP_LOGD(TAG, "Capture timed out, %lu sensor(s) silent", (unsigned long)s_pending);
+
+    int ok = 0;
+    for (size_t i = 0; i < s_count; i++) {
+        dht_channel_t *ch = &s_channels[i];
+        dht_reading_t *r = &out[i];
+        switch (dht_decode_edges(ch->edges, ch->count, &r->temp_c, &r->humi_pct)) {
+        case DHT_DECODE_OK: r->err = ESP_OK; ok++; break;
+        case DHT_DECODE_CRC: r->err = ESP_ERR_INVALID_CRC; break;
+        default: r->err = ESP_ERR_TIMEOUT; break;
+        }
+    }
+    return ok ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stddef.h>
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+#define DHT_ARRAY_MAX  4
+
+typedef struct {
+    esp_err_t err;          // ESP_OK, ESP_ERR_TIMEOUT or ESP_ERR_INVALID_CRC
+    float temp_c;
+    float humi_pct;
+} dht_reading_t;
+
+// Configures the pins as open-drain inputs with pull-ups and hooks a falling
+// edge interrupt to each. Call once from the task that will read.
+esp_err_t dht_array_init(const gpio_num_t *pins, size_t count);
+
+// Starts every sensor at once, blocks (without spinning) until all frames
+// are in or the capture times out, then decodes each one independently.
+esp_err_t dht_array_read(dht_reading_t *out);
@@ -0,0 +1,44 @@
+#include "dht_decode.h"
+
+// Response: 80 us low + 80 us high. Bits: 50 us low + 26 us (0) or 70 us (1)
+// high, so falling edges are 76 or 120 us apart. The limits leave room for
+// sensor tolerance and for interrupt latency when several lines are captured
+// at once.
+#define RESPONSE_MIN_US  120
+#define RESPONSE_MAX_US  220
+#define BIT_MIN_US       55
+#define BIT_MAX_US       160
+#define BIT_ONE_US       98
+
+dht_decode_status_t dht_decode_edges(const uint32_t *edges_us, size_t count, float *temp_c, float *humi_pct)
+{
+    if (count < DHT_FRAME_EDGES) return DHT_DECODE_SHORT;
+
+    uint32_t response = edges_us[1] - edges_us[0];
+    if (response < RESPONSE_MIN_US || response > RESPONSE_MAX_US) return DHT_DECODE_TIMING;
+
+    uint8_t data[5] = {0};
+    for (int i = 0; i < 40; i++) {
+        uint32_t period = edges_us[i + 2] - edges_us[i + 1];
+        if (period < BIT_MIN_US || period > BIT_MAX_US) return DHT_DECODE_TIMING;
+        int bit = (period > BIT_ONE_US) ? 1 : 0;
+        data[i / 8] = (uint8_t)((data[i / 8] << 1) | (uint8_t)bit);
+    }
+
+    uint8_t sum = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+    if (sum != data[4]) return DHT_DECODE_CRC;
+
+    uint16_t rh = (uint16_t)((data[0] << 8) | data[1]);
+    uint16_t rt = (uint16_t)((data[2] << 8) | data[3]);
+
+    float hum = rh / 10.0f;
+
+    int neg = (rt & 0x8000) != 0;
+    rt &= 0x7FFF;
+    float temp = rt / 10.0f;
+    if (neg) temp = -temp;
+
+    *temp_c = temp;
+    *humi_pct = hum;
+    return DHT_DECODE_OK;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// A DHT22 frame seen as falling edges: the sensor's response, the start of
+// bit 0, then one edge after each of the 40 bits.
+#define DHT_FRAME_EDGES  42
+
+typedef enum {
+    DHT_DECODE_OK = 0,
+    DHT_DECODE_SHORT,       // fewer than DHT_FRAME_EDGES edges captured
+    DHT_DECODE_TIMING,      // an interval no DHT22 would produce
+    DHT_DECODE_CRC,
+} dht_decode_status_t;
+
+// Plain C with no ESP-IDF dependencies so host/dht_capture_sim can decode
+// simulated captures with the firmware's own code.
+dht_decode_status_t dht_decode_edges(const uint32_t *edges_us, size_t count, float *temp_c, float *humi_pct);
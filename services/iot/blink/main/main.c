@@ -7,13 +7,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 
 #include "nvs_flash.h"
 #include "esp_log.h"
 #include "esp_err.h"
 
 #include "driver/gpio.h"
-#include "esp_rom_sys.h"
+#include "esp_timer.h"
 
 #include "os/os_mbuf.h"
 #include "nimble/nimble_port.h"
@@ -22,18 +23,28 @@
 #include "services/gap/ble_svc_gap.h"
 #include "services/gatt/ble_svc_gatt.h"
 
-#define DHT_GPIO              GPIO_NUM_4
-#define SAMPLE_PERIOD_MS      5000
+#include "dht_array.h"
+#include "node_sched.h"
+#include "payload.h"
+#include "pn532.h"
+#include "sample_chain.h"
+#include "sample_sched.h"
+#include "time_sync.h"
+
+// One DHT22 per pin, e.g. GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_10 for front,
+// middle and rear probes; up to PAYLOAD_MAX_SENSORS.
+#define DHT_GPIOS             GPIO_NUM_4
+#define SAMPLE_PERIOD_MIN_MS  DHT22_MIN_INTERVAL_MS
+#define SAMPLE_PERIOD_MAX_MS  60000
+#define SAMPLE_TEMP_GUARD_C   2.0f
+#define SAMPLE_HUMI_GUARD_PCT 5.0f
+#define SAMPLES_TO_EXCURSION  4.0f
 
 #define TEMP_MIN_ALLOWED_C    (-10.0f)
 #define TEMP_MAX_ALLOWED_C    (60.0f)
 #define HUMI_MIN_ALLOWED_PCT  (0.0f)
 #define HUMI_MAX_ALLOWED_PCT  (100.0f)
 
-#define FLAG_OK        0x0
-#define FLAG_TEMP_OOR  0x1
-#define FLAG_HUMI_OOR  0x2
-
 #define MANUAL_MODE 1
 
 #define MAN_TEMP_MIN  10.0f
@@ -42,23 +53,59 @@
 #define MAN_HUMI_MAX  60.0f
 #define MAN_FLAG      2   // 0,1,2
 
-static const char *TAG = "BLE_DHT22";
+#define CHAIN_BENCHMARK 0
+
+// PN532 on I2C (wiring in pn532.c). Without it the node runs sensor-only.
+#define NFC_READER            1
+#define NFC_POLL_INTERVAL_MS  100
+#define NFC_TAP_HOLDOFF_MS    1500    // same card seen again within this is not a new tap
+
+// Scheduler jobs, see node_sched.h. A sample holds the dispatcher for the
+// start pulse plus the capture timeout in dht_array.c. An NFC step usually
+// takes under 3 ms, but one stuck on the bus runs until the I2C driver's
+// timeout, and the protected window has to hold against that.
+#define SAMPLE_WCET_US        22000
+#define SAMPLE_GUARD_US       1000
+#define NFC_STEP_WCET_US      PN532_STEP_WCET_US
+#define PUBLISH_WCET_US       4000
+#define STATS_PERIOD_S        600
+
+// Sealed samples wait here while no gateway is subscribed and go out oldest
+// first when one is; each carries its own t_ms, so a late sample keeps the
+// time it was taken. Drained PUBLISH_BURST per publish run so a long backlog
+// does not hold the dispatcher past a sample's guard window.
+#define PUBLISH_BACKLOG       64
+#define PUBLISH_BURST         8
+#define PUBLISH_RETRY_MS      50
 
-typedef struct __attribute__((packed)) {
-    float temp_min;
-    float temp_max;
-    float humi_min;
-    float humi_max;
-    uint8_t flag2;
-} payload_t;
+static const char *TAG = "BLE_DHT22";
 
 static payload_t g_payload;
-static bool g_initialized = false;
+static size_t g_payload_len = PAYLOAD_LEGACY_LEN;
 static SemaphoreHandle_t g_lock;
 
 static uint8_t g_own_addr_type;
 static uint16_t g_conn_handle = BLE_HS_CONN_HANDLE_NONE;
 static uint16_t g_attr_handle_payload;
+static uint16_t g_attr_handle_device_key;
+static uint16_t g_attr_handle_nfc_tap;
+
+static uint16_t g_attr_handle_time_sync;
+static bool g_payload_subscribed = false;
+
+static nfc_tap_t g_tap;
+static bool g_tap_valid = false;
+
+typedef struct {
+    uint8_t len;
+    payload_t payload;
+} sealed_sample_t;
+
+// Guarded by g_lock: seal_task appends, the dispatcher drains.
+static sealed_sample_t g_backlog[PUBLISH_BACKLOG];
+static size_t g_backlog_head;
+static size_t g_backlog_count;
+static uint32_t g_backlog_dropped;
 
 static const ble_uuid128_t g_svc_uuid =
     BLE_UUID128_INIT(0x9a,0x8b,0x7c,0x6d,0x5e,0x4f,0x3a,0x2b,0x1c,0x0d,0xfe,0xed,0xbe,0xef,0x10,0x01);
@@ -66,121 +113,172 @@ static const ble_uuid128_t g_svc_uuid =
 static const ble_uuid128_t g_chr_uuid =
     BLE_UUID128_INIT(0x9a,0x8b,0x7c,0x6d,0x5e,0x4f,0x3a,0x2b,0x1c,0x0d,0xfe,0xed,0xbe,0xef,0x10,0x02);
 
-static inline int wait_level(gpio_num_t pin, int level, uint32_t timeout_us)
+static const ble_uuid128_t g_key_chr_uuid =
+    BLE_UUID128_INIT(0x9a,0x8b,0x7c,0x6d,0x5e,0x4f,0x3a,0x2b,0x1c,0x0d,0xfe,0xed,0xbe,0xef,0x10,0x03);
+
+static const ble_uuid128_t g_tap_chr_uuid =
+    BLE_UUID128_INIT(0x9a,0x8b,0x7c,0x6d,0x5e,0x4f,0x3a,0x2b,0x1c,0x0d,0xfe,0xed,0xbe,0xef,0x10,0x04);
+
+static const ble_uuid128_t g_time_chr_uuid =
+    BLE_UUID128_INIT(0x9a,0x8b,0x7c,0x6d,0x5e,0x4f,0x3a,0x2b,0x1c,0x0d,0xfe,0xed,0xbe,0xef,0x10,0x05);
+
+static uint8_t compute_flag(float t, float h)
 {
-    uint32_t t = 0;
-    while (gpio_get_level(pin) != level) {
-        if (t++ >= timeout_us) return -1;
-        esp_rom_delay_us(1);
-    }
-    return 0;
+    if (t < TEMP_MIN_ALLOWED_C || t > TEMP_MAX_ALLOWED_C) return FLAG_TEMP_OOR;
+    if (h < HUMI_MIN_ALLOWED_PCT || h > HUMI_MAX_ALLOWED_PCT) return FLAG_HUMI_OOR;
+    return FLAG_OK;
 }
 
-static inline int measure_level(gpio_num_t pin, int level, uint32_t timeout_us, uint32_t *dur_us)
+static int16_t to_tenths(float v)
 {
-    uint32_t t = 0;
-    while (gpio_get_level(pin) == level) {
-        if (t++ >= timeout_us) return -1;
-        esp_rom_delay_us(1);
-    }
-    *dur_us = t;
-    return 0;
+    return (int16_t)lroundf(v * 10.0f);
 }
 
-static esp_err_t dht22_read(gpio_num_t pin, float *temp_c, float *humi_pct)
+// The min/max fields span this sample's probes only: gateways aggregate them
+// into windows, so extremes carried over from earlier samples would leak into
+// every later window.
+static void update_payload(const dht_reading_t *readings, size_t count, uint32_t period_ms, uint32_t t_ms)
 {
-    uint8_t data[5] = {0};
-
-    gpio_set_direction(pin, GPIO_MODE_OUTPUT);
-    gpio_set_level(pin, 0);
-    vTaskDelay(pdMS_TO_TICKS(2));
-    gpio_set_level(pin, 1);
-    esp_rom_delay_us(40);
-    gpio_set_direction(pin, GPIO_MODE_INPUT);
-
-    if (wait_level(pin, 0, 100) != 0) return ESP_ERR_TIMEOUT;
-    if (wait_level(pin, 1, 100) != 0) return ESP_ERR_TIMEOUT;
-    if (wait_level(pin, 0, 100) != 0) return ESP_ERR_TIMEOUT;
-
-    for (int i = 0; i < 40; i++) {
-        if (wait_level(pin, 1, 70) != 0) return ESP_ERR_TIMEOUT;
-        uint32_t high_us = 0;
-        if (measure_level(pin, 1, 120, &high_us) != 0) return ESP_ERR_TIMEOUT;
-        int bit = (high_us > 40) ? 1 : 0;
-        data[i / 8] = (uint8_t)((data[i / 8] << 1) | (uint8_t)bit);
-    }
-
-    uint8_t sum = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
-    if (sum != data[4]) return ESP_ERR_INVALID_CRC;
-
-    uint16_t rh = (uint16_t)((data[0] << 8) | data[1]);
-    uint16_t rt = (uint16_t)((data[2] << 8) | data[3]);
+    xSemaphoreTake(g_lock, portMAX_DELAY);
 
-    float hum = rh / 10.0f;
+    bool first = true;
+    uint8_t flags = FLAG_OK;
+    for (size_t i = 0; i < count; i++) {
+        const dht_reading_t *r = &readings[i];
+        sensor_record_t *rec = &g_payload.sensors[i];
+        if (r->err != ESP_OK) {
+            rec->temp_dc = 0;
+            rec->humi_dpct = 0;
+            rec->flags = FLAG_SENSOR_ERR;
+            flags |= FLAG_SENSOR_ERR;
+            continue;
+        }
 
-    bool neg = (rt & 0x8000) != 0;
-    rt &= 0x7FFF;
-    float temp = rt / 10.0f;
-    if (neg) temp = -temp;
+        float t = r->temp_c, h = r->humi_pct;
+        rec->temp_dc = to_tenths(t);
+        rec->humi_dpct = (uint16_t)to_tenths(h);
+        rec->flags = compute_flag(t, h);
+        flags |= rec->flags;
+
+        if (first) {
+            g_payload.temp_min = t;
+            g_payload.temp_max = t;
+            g_payload.humi_min = h;
+            g_payload.humi_max = h;
+            first = false;
+        } else {
+            if (t < g_payload.temp_min) g_payload.temp_min = t;
+            if (t > g_payload.temp_max) g_payload.temp_max = t;
+            if (h < g_payload.humi_min) g_payload.humi_min = h;
+            if (h > g_payload.humi_max) g_payload.humi_max = h;
+        }
+    }
 
-    *temp_c = temp;
-    *humi_pct = hum;
-    return ESP_OK;
-}
+    g_payload.flag2 = flags;
+    g_payload.period_ms = (uint16_t)(period_ms > UINT16_MAX ? UINT16_MAX : period_ms);
+    g_payload.sensor_count = (uint8_t)count;
+    g_payload.t_ms = t_ms;
+    g_payload.boot = (uint16_t)time_sync_boot_id();
 
-static uint8_t compute_flag(float t, float h)
-{
-    if (t < TEMP_MIN_ALLOWED_C || t > TEMP_MAX_ALLOWED_C) return FLAG_TEMP_OOR;
-    if (h < HUMI_MIN_ALLOWED_PCT || h > HUMI_MAX_ALLOWED_PCT) return FLAG_HUMI_OOR;
-    return FLAG_OK;
+    xSemaphoreGive(g_lock);
 }
 
-static void update_payload(float t, float h)
+// Extends the hash chain over the new reading; every
+// CHAIN_CHECKPOINT_INTERVAL-th sample is also signed. Signing runs outside
+// g_lock so BLE reads are not held up by the ECDSA operation.
+static void seal_payload(void)
 {
+    payload_t snap;
     xSemaphoreTake(g_lock, portMAX_DELAY);
+    snap = g_payload;
+    xSemaphoreGive(g_lock);
 
-    uint8_t flag = compute_flag(t, h);
+    snap.seq = sample_chain_next_seq();
+    if (sample_chain_link(&snap, PAYLOAD_CHAINED_BODY, snap.link) != ESP_OK) return;
 
-    if (!g_initialized) {
-        g_payload.temp_min = t;
-        g_payload.temp_max = t;
-        g_payload.humi_min = h;
-        g_payload.humi_max = h;
-        g_initialized = true;
-    } else {
-        if (t < g_payload.temp_min) g_payload.temp_min = t;
-        if (t > g_payload.temp_max) g_payload.temp_max = t;
-        if (h < g_payload.humi_min) g_payload.humi_min = h;
-        if (h > g_payload.humi_max) g_payload.humi_max = h;
+    size_t len = PAYLOAD_SAMPLE_LEN;
+    if (sample_chain_checkpoint_due(snap.seq) &&
+        sample_chain_sign(snap.seq, snap.link, snap.sig) == ESP_OK) {
+        len = PAYLOAD_CHECKPOINT_LEN;
     }
 
-    g_payload.flag2 = flag;
-
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    g_payload.seq = snap.seq;
+    memcpy(g_payload.link, snap.link, sizeof(snap.link));
+    memcpy(g_payload.sig, snap.sig, sizeof(snap.sig));
+    g_payload_len = len;
+
+    // A full backlog loses its oldest sample; the gap shows up at the
+    // gateway as a seq jump, the chain still verifies from the next one.
+    if (g_backlog_count == PUBLISH_BACKLOG) {
+        g_backlog_head = (g_backlog_head + 1) % PUBLISH_BACKLOG;
+        g_backlog_count--;
+        g_backlog_dropped++;
+    }
+    sealed_sample_t *slot = &g_backlog[(g_backlog_head + g_backlog_count) % PUBLISH_BACKLOG];
+    slot->len = (uint8_t)len;
+    slot->payload = snap;
+    g_backlog_count++;
     xSemaphoreGive(g_lock);
 }
 
-static void maybe_notify(void)
+static bool link_encrypted(void)
 {
-    if (g_conn_handle == BLE_HS_CONN_HANDLE_NONE) return;
+    if (g_conn_handle == BLE_HS_CONN_HANDLE_NONE) return false;
 
     struct ble_gap_conn_desc desc;
-    if (ble_gap_conn_find(g_conn_handle, &desc) != 0) return;
-    if (!desc.sec_state.encrypted) return;
+    if (ble_gap_conn_find(g_conn_handle, &desc) != 0) return false;
+    return desc.sec_state.encrypted;
+}
 
-    payload_t snap;
+// Sends backlog entries oldest first, at most PUBLISH_BURST of them.
+// ESP_ERR_NOT_FINISHED: entries are left for another run. ESP_ERR_NO_MEM:
+// the stack is out of buffers, retry after PUBLISH_RETRY_MS.
+static esp_err_t notify_backlog(void)
+{
+    if (!link_encrypted() || !g_payload_subscribed) return ESP_OK;
+
+    for (int sent = 0; sent < PUBLISH_BURST; sent++) {
+        sealed_sample_t snap;
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        if (g_backlog_count == 0) {
+            xSemaphoreGive(g_lock);
+            return ESP_OK;
+        }
+        snap = g_backlog[g_backlog_head];
+        xSemaphoreGive(g_lock);
+
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(&snap.payload, snap.len);
+        if (!om) return ESP_ERR_NO_MEM;
+        // The entry stays queued until a notify for it succeeds; if the link
+        // went away the next subscribe starts from it again.
+        if (ble_gatts_notify_custom(g_conn_handle, g_attr_handle_payload, om) != 0) return ESP_ERR_NO_MEM;
+
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        g_backlog_head = (g_backlog_head + 1) % PUBLISH_BACKLOG;
+        g_backlog_count--;
+        xSemaphoreGive(g_lock);
+    }
+    return ESP_ERR_NOT_FINISHED;
+}
+
+static void maybe_notify_tap(void)
+{
+    if (!link_encrypted()) return;
+
+    nfc_tap_t snap;
     xSemaphoreTake(g_lock, portMAX_DELAY);
-    snap = g_payload;
+    snap = g_tap;
     xSemaphoreGive(g_lock);
 
     struct os_mbuf *om = ble_hs_mbuf_from_flat(&snap, sizeof(snap));
     if (!om) return;
-    ble_gatts_notify_custom(g_conn_handle, g_attr_handle_payload, om);
+    ble_gatts_notify_custom(g_conn_handle, g_attr_handle_nfc_tap, om);
 }
 
 static int gatt_access_cb(uint16_t conn_handle, uint16_t attr_handle,
                           struct ble_gatt_access_ctxt *ctxt, void *arg)
 {
-    (void)attr_handle;
     (void)arg;
 
     struct ble_gap_conn_desc desc;
@@ -190,12 +288,51 @@ static int gatt_access_cb(uint16_t conn_handle, uint16_t attr_handle,
         return BLE_ATT_ERR_UNLIKELY;
     }
 
+    if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR && attr_handle == g_attr_handle_device_key) {
+        uint8_t key[65];
+        if (sample_chain_public_key(key) != ESP_OK) return BLE_ATT_ERR_UNLIKELY;
+        int rc = os_mbuf_append(ctxt->om, key, sizeof(key));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR && attr_handle == g_attr_handle_nfc_tap) {
+        nfc_tap_t snap;
+        bool valid;
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        snap = g_tap;
+        valid = g_tap_valid;
+        xSemaphoreGive(g_lock);
+        if (!valid) return 0;       // empty until the first tap
+        int rc = os_mbuf_append(ctxt->om, &snap, sizeof(snap));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR && attr_handle == g_attr_handle_time_sync) {
+        time_sync_t ts;
+        time_sync_get(&ts);
+        int rc = os_mbuf_append(ctxt->om, &ts, sizeof(ts));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR && attr_handle == g_attr_handle_time_sync) {
+        // Any encrypted peer may read the clock; only a bonded one may set
+        // the epoch the next reader starts from.
+        if (!desc.sec_state.bonded) return BLE_ATT_ERR_INSUFFICIENT_AUTHEN;
+        time_sync_set_t in;
+        uint16_t len = 0;
+        if (OS_MBUF_PKTLEN(ctxt->om) != sizeof(in)) return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        if (ble_hs_mbuf_to_flat(ctxt->om, &in, sizeof(in), &len) != 0) return BLE_ATT_ERR_UNLIKELY;
+        return time_sync_set(&in) == ESP_OK ? 0 : BLE_ATT_ERR_UNLIKELY;
+    }
+
     if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
         payload_t snap;
+        size_t len;
         xSemaphoreTake(g_lock, portMAX_DELAY);
         snap = g_payload;
+        len = g_payload_len;
         xSemaphoreGive(g_lock);
-        int rc = os_mbuf_append(ctxt->om, &snap, sizeof(snap));
+        int rc = os_mbuf_append(ctxt->om, &snap, len);
         return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
     }
 
@@ -213,6 +350,24 @@ static const struct ble_gatt_svc_def gatt_svcs[] = {
                 .val_handle = &g_attr_handle_payload,
                 .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
             },
+            {
+                .uuid = &g_key_chr_uuid.u,
+                .access_cb = gatt_access_cb,
+                .val_handle = &g_attr_handle_device_key,
+                .flags = BLE_GATT_CHR_F_READ,
+            },
+            {
+                .uuid = &g_tap_chr_uuid.u,
+                .access_cb = gatt_access_cb,
+                .val_handle = &g_attr_handle_nfc_tap,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+            },
+            {
+                .uuid = &g_time_chr_uuid.u,
+                .access_cb = gatt_access_cb,
+                .val_handle = &g_attr_handle_time_sync,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC,
+            },
             {0}
         },
     },
@@ -220,6 +375,7 @@ static const struct ble_gatt_svc_def gatt_svcs[] = {
 };
 
 static void adv_start(void);
+static void post_link_up(void);
 
 static int gap_event_cb(struct ble_gap_event *event, void *arg)
 {
@@ -238,9 +394,23 @@ static int gap_event_cb(struct ble_gap_event *event, void *arg)
 
     case BLE_GAP_EVENT_DISCONNECT:
         g_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+        g_payload_subscribed = false;
         adv_start();
         return 0;
 
+    case BLE_GAP_EVENT_ENC_CHANGE:
+        // Notifications need encryption; a gateway that subscribed first
+        // gets the backlog once the link is encrypted.
+        if (event->enc_change.status == 0 && g_payload_subscribed) post_link_up();
+        return 0;
+
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        if (event->subscribe.attr_handle == g_attr_handle_payload) {
+            g_payload_subscribed = event->subscribe.cur_notify;
+            if (g_payload_subscribed) post_link_up();
+        }
+        return 0;
+
     case BLE_GAP_EVENT_ADV_COMPLETE:
         adv_start();
         return 0;
@@ -286,28 +456,284 @@ static void host_task(void *param)
     nimble_port_freertos_deinit();
 }
 
-static void sensor_task(void *param)
+// One dispatcher task owns the DHT lines and the I2C bus and runs the jobs
+// below through node_sched, one at a time, so I2C traffic never overlaps a
+// DHT22 capture. Other tasks only post events. Sealing is CPU work on
+// neither bus and runs in its own lower-priority task, so a checkpoint
+// signature does not hold up NFC polling.
+typedef enum {
+    NODE_EV_WAKE,           // wake timer fired
+    NODE_EV_SEALED,         // seal_task finished the latest sample
+    NODE_EV_LINK_UP,        // a gateway subscribed to samples, drain the backlog
+} node_event_t;
+
+static node_sched_t g_sched;
+static int g_job_sample = -1;
+static int g_job_nfc = -1;
+static int g_job_publish = -1;
+static int g_job_stats = -1;
+static QueueHandle_t g_events;
+static esp_timer_handle_t g_wake_timer;
+static TaskHandle_t g_seal_task;
+
+// Dispatcher only.
+static size_t g_dht_count;
+static sample_sched_t g_sample_sched[PAYLOAD_MAX_SENSORS];
+static pn532_poller_t g_poller;
+static uint8_t g_last_uid[PN532_UID_MAX];
+static size_t g_last_uid_len;
+static uint64_t g_last_uid_us;
+static bool g_tap_pending;
+
+static void seal_task(void *param)
+{
+    (void)param;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        seal_payload();
+        node_event_t ev = NODE_EV_SEALED;
+        xQueueSend(g_events, &ev, portMAX_DELAY);
+    }
+}
+
+static void post_link_up(void)
+{
+    node_event_t ev = NODE_EV_LINK_UP;
+    xQueueSend(g_events, &ev, 0);
+}
+
+static void wake_timer_cb(void *arg)
+{
+    (void)arg;
+    node_event_t ev = NODE_EV_WAKE;
+    xQueueSend(g_events, &ev, 0);
+}
+
+static uint64_t now_us(void)
+{
+    return (uint64_t)esp_timer_get_time();
+}
+
+static esp_err_t sample_setup(void)
+{
+    static const gpio_num_t pins[] = { DHT_GPIOS };
+    const size_t count = sizeof(pins) / sizeof(pins[0]);
+    _Static_assert(sizeof(pins) / sizeof(pins[0]) <= PAYLOAD_MAX_SENSORS, "too many DHT_GPIOS");
+
+    esp_err_t err = dht_array_init(pins, count);
+    if (err != ESP_OK) return err;
+
+    const sample_sched_config_t sched_cfg = {
+        .min_period_ms = SAMPLE_PERIOD_MIN_MS,
+        .max_period_ms = SAMPLE_PERIOD_MAX_MS,
+        .temp_min_c = TEMP_MIN_ALLOWED_C,
+        .temp_max_c = TEMP_MAX_ALLOWED_C,
+        .humi_min_pct = HUMI_MIN_ALLOWED_PCT,
+        .humi_max_pct = HUMI_MAX_ALLOWED_PCT,
+        .temp_guard_c = SAMPLE_TEMP_GUARD_C,
+        .humi_guard_pct = SAMPLE_HUMI_GUARD_PCT,
+        .samples_to_excursion = SAMPLES_TO_EXCURSION,
+    };
+    // One schedule per probe; the node samples as often as its most at-risk
+    // probe needs.
+    for (size_t i = 0; i < count; i++) sample_sched_init(&g_sample_sched[i], &sched_cfg);
+    g_dht_count = count;
+    return ESP_OK;
+}
+
+static void run_sample(void)
+{
+    dht_reading_t readings[PAYLOAD_MAX_SENSORS];
+    uint32_t t_ms = time_sync_uptime_ms();
+    esp_err_t err = dht_array_read(readings);
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    uint32_t period_ms = UINT32_MAX;
+    for (size_t i = 0; i < g_dht_count; i++) {
+        uint32_t p = (readings[i].err == ESP_OK)
+            ? sample_sched_update(&g_sample_sched[i], now_ms, readings[i].temp_c, readings[i].humi_pct)
+            : sample_sched_period(&g_sample_sched[i]);
+        if (p < period_ms) period_ms = p;
+    }
+
+    if (err == ESP_OK) {
+        update_payload(readings, g_dht_count, period_ms, t_ms);
+        xTaskNotifyGive(g_seal_task);
+    }
+
+    // Count from this sample's release rather than from when it finished, so
+    // the period does not stretch by the capture time.
+    uint64_t next = g_sched.jobs[g_job_sample].last_release_us + (uint64_t)period_ms * 1000;
+    uint64_t now = now_us();
+    node_sched_release(&g_sched, g_job_sample, next > now ? next : now);
+}
+
+// A card left on the reader is read every round; only a new card, or the
+// same one after it has been away for NFC_TAP_HOLDOFF_MS, is a tap.
+static bool record_tap(const uint8_t *uid, size_t uid_len, uint64_t at_us)
+{
+    bool same = uid_len == g_last_uid_len && memcmp(uid, g_last_uid, uid_len) == 0;
+    bool repeat = same && at_us - g_last_uid_us < (uint64_t)NFC_TAP_HOLDOFF_MS * 1000;
+    memcpy(g_last_uid, uid, uid_len);
+    g_last_uid_len = uid_len;
+    g_last_uid_us = at_us;
+    if (repeat) return false;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    g_tap.tap_seq++;
+    g_tap.uptime_ms = (uint32_t)(at_us / 1000);
+    g_tap.sample_seq = g_payload.seq;
+    g_tap.uid_len = (uint8_t)uid_len;
+    memset(g_tap.uid, 0, sizeof(g_tap.uid));
+    memcpy(g_tap.uid, uid, uid_len);
+    g_tap_valid = true;
+    xSemaphoreGive(g_lock);
+    return true;
+}
+
+static void run_nfc(uint64_t start_us)
+{
+    _Static_assert(PN532_UID_MAX <= NFC_UID_MAX, "NFC UID does not fit the tap record");
+
+    uint8_t uid[PN532_UID_MAX];
+    size_t uid_len = 0;
+    uint32_t next_us = 0;
+    esp_err_t err = pn532_poll_step(&g_poller, start_us, uid, &uid_len, &next_us);
+    if (err == ESP_ERR_NOT_FINISHED) {
+        node_sched_release(&g_sched, g_job_nfc, start_us + next_us);
+        return;
+    }
+
+    if (err == ESP_OK && record_tap(uid, uid_len, start_us)) {
+        ESP_LOGI(TAG, "NFC tap %lu (%u byte UID)", (unsigned long)g_tap.tap_seq, (unsigned)uid_len);
+        g_tap_pending = true;
+        node_sched_release(&g_sched, g_job_publish, now_us());
+    } else if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGD(TAG, "NFC poll: %s", esp_err_to_name(err));
+    }
+    node_sched_release(&g_sched, g_job_nfc, start_us + (uint64_t)NFC_POLL_INTERVAL_MS * 1000);
+}
+
+static void run_publish(void)
+{
+    if (g_tap_pending) {
+        g_tap_pending = false;
+        maybe_notify_tap();
+    }
+    esp_err_t err = notify_backlog();
+    if (err == ESP_ERR_NOT_FINISHED) node_sched_release(&g_sched, g_job_publish, now_us());
+    else if (err != ESP_OK) node_sched_release(&g_sched, g_job_publish, now_us() + (uint64_t)PUBLISH_RETRY_MS * 1000);
+}
+
+static void run_stats(uint64_t start_us)
+{
+    for (size_t i = 0; i < g_sched.count; i++) {
+        const node_job_t *j = &g_sched.jobs[i];
+        if (j->stats.runs == 0) continue;
+        ESP_LOGI(TAG, "job %s: runs=%lu misses=%lu held=%lu late avg=%lluus max=%luus run max=%luus",
+                 j->cfg.name, (unsigned long)j->stats.runs, (unsigned long)j->stats.misses,
+                 (unsigned long)j->stats.held, (unsigned long long)(j->stats.lateness_us_total / j->stats.runs),
+                 (unsigned long)j->stats.max_lateness_us, (unsigned long)j->stats.max_run_us);
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    size_t queued = g_backlog_count;
+    uint32_t dropped = g_backlog_dropped;
+    xSemaphoreGive(g_lock);
+    ESP_LOGI(TAG, "publish backlog: %u queued, %lu dropped", (unsigned)queued, (unsigned long)dropped);
+    node_sched_release(&g_sched, g_job_stats, start_us + (uint64_t)STATS_PERIOD_S * 1000000);
+}
+
+static void handle_events(TickType_t wait)
+{
+    node_event_t ev;
+    while (xQueueReceive(g_events, &ev, wait) == pdTRUE) {
+        wait = 0;
+        if (ev == NODE_EV_SEALED || ev == NODE_EV_LINK_UP) {
+            node_sched_release(&g_sched, g_job_publish, now_us());
+        }
+    }
+}
+
+static void arm_wake(uint64_t wake_us, uint64_t now)
+{
+    esp_timer_stop(g_wake_timer);
+    if (wake_us == NODE_SCHED_NEVER) return;
+    esp_timer_start_once(g_wake_timer, wake_us > now ? wake_us - now : 0);
+}
+
+static void node_task(void *param)
 {
     (void)param;
 
-    gpio_config_t io = {
-        .pin_bit_mask = (1ULL << DHT_GPIO),
-        .mode = GPIO_MODE_INPUT_OUTPUT_OD,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
+    node_sched_init(&g_sched);
+    uint64_t now = now_us();
+
+    #if !MANUAL_MODE
+    if (sample_setup() == ESP_OK) {
+        const node_job_config_t sample_job = {
+            .name = "sample",
+            .priority = 3,
+            .wcet_us = SAMPLE_WCET_US,
+            .deadline_us = SAMPLE_WCET_US + SAMPLE_GUARD_US,
+            .guard_us = SAMPLE_GUARD_US,
+            .protected_window = true,
+        };
+        g_job_sample = node_sched_add(&g_sched, &sample_job);
+        node_sched_release(&g_sched, g_job_sample, now);
+    } else {
+        ESP_LOGE(TAG, "DHT22 pin setup failed");
+    }
+    #endif
+
+    #if NFC_READER
+    if (pn532_init() == ESP_OK) {
+        const node_job_config_t nfc_job = {
+            .name = "nfc",
+            .priority = 2,
+            .wcet_us = NFC_STEP_WCET_US,
+            .deadline_us = NFC_STEP_WCET_US + SAMPLE_WCET_US,
+        };
+        g_job_nfc = node_sched_add(&g_sched, &nfc_job);
+        node_sched_release(&g_sched, g_job_nfc, now_us());
+    } else {
+        ESP_LOGW(TAG, "No PN532, running without NFC");
+    }
+    #endif
+
+    const node_job_config_t publish_job = {
+        .name = "publish",
+        .priority = 1,
+        .wcet_us = PUBLISH_WCET_US,
+        .deadline_us = 50000,
+    };
+    g_job_publish = node_sched_add(&g_sched, &publish_job);
+
+    const node_job_config_t stats_job = {
+        .name = "stats",
+        .priority = 0,
+        .wcet_us = 1000,
+        .deadline_us = 1000000,
     };
-    gpio_config(&io);
-    gpio_set_level(DHT_GPIO, 1);
+    g_job_stats = node_sched_add(&g_sched, &stats_job);
+    node_sched_release(&g_sched, g_job_stats, now_us() + (uint64_t)STATS_PERIOD_S * 1000000);
 
     while (1) {
-        float t = NAN, h = NAN;
-        esp_err_t err = dht22_read(DHT_GPIO, &t, &h);
-        if (err == ESP_OK) {
-            update_payload(t, h);
-            maybe_notify();
+        uint64_t wake = NODE_SCHED_NEVER;
+        now = now_us();
+        int job = node_sched_next(&g_sched, now, &wake);
+        if (job < 0) {
+            arm_wake(wake, now);
+            handle_events(portMAX_DELAY);
+            continue;
         }
-        vTaskDelay(pdMS_TO_TICKS(SAMPLE_PERIOD_MS));
+
+        if (job == g_job_sample) run_sample();
+        else if (job == g_job_nfc) run_nfc(now);
+        else if (job == g_job_publish) run_publish();
+        else if (job == g_job_stats) run_stats(now);
+        node_sched_complete(&g_sched, job, now_us());
+        handle_events(0);
     }
 }
 
@@ -320,6 +746,19 @@ void app_main(void)
     }
 
     g_lock = xSemaphoreCreateMutex();
+    time_sync_init();
+    g_events = xQueueCreate(8, sizeof(node_event_t));
+
+    const esp_timer_create_args_t wake_args = {
+        .callback = wake_timer_cb,
+        .name = "node_wake",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&wake_args, &g_wake_timer));
+
+    ESP_ERROR_CHECK(sample_chain_init());
+    #if CHAIN_BENCHMARK
+    sample_chain_benchmark();
+    #endif
 
     #if MANUAL_MODE
     xSemaphoreTake(g_lock, portMAX_DELAY);
@@ -328,7 +767,6 @@ void app_main(void)
     g_payload.humi_min = MAN_HUMI_MIN;
     g_payload.humi_max = MAN_HUMI_MAX;
     g_payload.flag2    = (uint8_t)MAN_FLAG;
-    g_initialized = true;
     xSemaphoreGive(g_lock);
     #endif
 
@@ -361,7 +799,6 @@ void app_main(void)
 
     nimble_port_freertos_init(host_task);
 
-    #if !MANUAL_MODE
-    xTaskCreate(sensor_task, "sensor", 4096, NULL, 5, NULL);
-    #endif
+    xTaskCreate(seal_task, "seal", 4096, NULL, 4, &g_seal_task);
+    xTaskCreate(node_task, "node", 4096, NULL, 5, NULL);
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "node_sched.h"
+
+#include <string.h>
+
+void node_sched_init(node_sched_t *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+int node_sched_add(node_sched_t *s, const node_job_config_t *cfg)
+{
+    if (s->count >= NODE_SCHED_MAX_JOBS) return -1;
+    node_job_t *j = &s->jobs[s->count];
+    memset(j, 0, sizeof(*j));
+    j->cfg = *cfg;
+    return (int)s->count++;
+}
+
+void node_sched_release(node_sched_t *s, int job, uint64_t at_us)
+{
+    node_job_t *j = &s->jobs[job];
+    if (j->released && j->release_us <= at_us) return;
+    j->released = true;
+    j->release_us = at_us;
+}
+
+void node_sched_cancel(node_sched_t *s, int job)
+{
+    s->jobs[job].released = false;
+}
+
+// True if starting j at now_us could still be running when some other
+// protected job's quiet time begins.
+static bool blocks_window(const node_sched_t *s, const node_job_t *j, uint64_t now_us)
+{
+    for (size_t i = 0; i < s->count; i++) {
+        const node_job_t *p = &s->jobs[i];
+        if (p == j || !p->released || !p->cfg.protected_window || p->release_us <= now_us) continue;
+        uint64_t quiet_from = p->release_us > p->cfg.guard_us ? p->release_us - p->cfg.guard_us : 0;
+        if (now_us + j->cfg.wcet_us > quiet_from) return true;
+    }
+    return false;
+}
+
+static bool runs_before(const node_job_t *a, const node_job_t *b)
+{
+    if (a->cfg.priority != b->cfg.priority) return a->cfg.priority > b->cfg.priority;
+    return a->release_us + a->cfg.deadline_us < b->release_us + b->cfg.deadline_us;
+}
+
+int node_sched_next(node_sched_t *s, uint64_t now_us, uint64_t *wake_us)
+{
+    uint64_t wake = NODE_SCHED_NEVER;
+    int best = -1;
+
+    for (size_t i = 0; i < s->count; i++) {
+        node_job_t *j = &s->jobs[i];
+        if (!j->released) continue;
+        if (j->release_us > now_us) {
+            if (j->release_us < wake) wake = j->release_us;
+            continue;
+        }
+        if (blocks_window(s, j, now_us)) {
+            j->stats.held++;
+            continue;
+        }
+        if (best < 0 || runs_before(j, &s->jobs[best])) best = (int)i;
+    }
+
+    if (best < 0) {
+        *wake_us = wake;
+        return -1;
+    }
+
+    node_job_t *j = &s->jobs[best];
+    uint64_t lateness = now_us - j->release_us;
+    j->released = false;
+    j->last_release_us = j->release_us;
+    j->last_start_us = now_us;
+    j->stats.runs++;
+    j->stats.lateness_us_total += lateness;
+    if (lateness > j->stats.max_lateness_us) j->stats.max_lateness_us = (uint32_t)lateness;
+    *wake_us = now_us;
+    return best;
+}
+
+void node_sched_complete(node_sched_t *s, int job, uint64_t end_us)
+{
+    node_job_t *j = &s->jobs[job];
+    uint64_t run = end_us - j->last_start_us;
+    if (run > j->stats.max_run_us) j->stats.max_run_us = (uint32_t)run;
+    if (end_us > j->last_release_us + j->cfg.deadline_us) j->stats.misses++;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NODE_SCHED_MAX_JOBS  8
+#define NODE_SCHED_NEVER     UINT64_MAX
+
+// Non-preemptive scheduler for the work that shares the node's buses: one
+// dispatcher runs one job at a time, so an I2C transaction can never be in
+// flight while a DHT22 frame is being captured. Plain C with no ESP-IDF
+// dependencies so host/node_sched_sim can run the same policy.
+//
+// Among released jobs the highest priority runs first, then the earliest
+// deadline. A job with a protected window additionally keeps the dispatcher
+// idle for guard_us before its release: any other job whose wcet_us would
+// run into that window is held back, so the protected job starts on time
+// instead of waiting behind a step it cannot preempt.
+typedef struct {
+    const char *name;
+    uint8_t priority;           // higher runs first
+    uint32_t wcet_us;           // longest single run, used to keep protected windows clear
+    uint32_t deadline_us;       // relative to release; finishing later counts as a miss
+    uint32_t guard_us;          // protected jobs: quiet time wanted before release
+    bool protected_window;
+} node_job_config_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t misses;
+    uint32_t held;              // selections skipped to keep a protected window clear
+    uint32_t max_lateness_us;   // start - release
+    uint32_t max_run_us;
+    uint64_t lateness_us_total;
+} node_job_stats_t;
+
+typedef struct {
+    node_job_config_t cfg;
+    bool released;
+    uint64_t release_us;        // pending release, valid while released
+    uint64_t last_release_us;   // release of the run in progress or last run
+    uint64_t last_start_us;
+    node_job_stats_t stats;
+} node_job_t;
+
+typedef struct {
+    node_job_t jobs[NODE_SCHED_MAX_JOBS];
+    size_t count;
+} node_sched_t;
+
+void node_sched_init(node_sched_t *s);
+
+// Returns the job id, or -1 when the table is full.
+int node_sched_add(node_sched_t *s, const node_job_config_t *cfg);
+
+// Makes the job runnable from at_us on. A job already released keeps the
+// earlier of the two times, so a burst of events runs it once.
+void node_sched_release(node_sched_t *s, int job, uint64_t at_us);
+void node_sched_cancel(node_sched_t *s, int job);
+
+// Picks the job to run at now_us and takes its release; the caller runs it
+// and then calls node_sched_complete. Returns -1 when nothing may start yet,
+// with *wake_us set to the next time worth asking again (NODE_SCHED_NEVER
+// when nothing is released).
+int node_sched_next(node_sched_t *s, uint64_t now_us, uint64_t *wake_us);
+void node_sched_complete(node_sched_t *s, int job, uint64_t end_us);
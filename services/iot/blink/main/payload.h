@@ -0,0 +1,91 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLAG_OK          0x0
+#define FLAG_TEMP_OOR    0x1
+#define FLAG_HUMI_OOR    0x2
+#define FLAG_SENSOR_ERR  0x4
+
+#define PAYLOAD_MAX_SENSORS  4
+
+#define PAYLOAD_LINK_LEN  32
+#define PAYLOAD_SIG_LEN   64
+
+// Latest reading of one probe, in the DHT22's native 0.1 units.
+typedef struct __attribute__((packed)) {
+    int16_t temp_dc;
+    uint16_t humi_dpct;               // 0.1 %RH
+    uint8_t flags;                    // FLAG_*; FLAG_SENSOR_ERR if the read failed
+} sensor_record_t;
+
+// Sent over BLE as-is (little-endian). The min/max fields span every probe
+// read for this sample; they are not carried over between samples.
+// Regular samples stop before sig; every CHAIN_CHECKPOINT_INTERVAL-th sample
+// also carries the signature.
+typedef struct __attribute__((packed)) {
+    float temp_min;
+    float temp_max;
+    float humi_min;
+    float humi_max;
+    uint8_t flag2;
+    uint32_t seq;
+    uint16_t period_ms;               // delay until the next sample, see sample_sched.h
+    uint8_t sensor_count;
+    sensor_record_t sensors[PAYLOAD_MAX_SENSORS];
+    uint32_t t_ms;                    // tag uptime when the probes were read, see time_sync.h
+    uint16_t boot;                    // low 16 bits of time_sync_t.boot_id, t_ms restarts with it
+    uint8_t link[PAYLOAD_LINK_LEN];   // SHA-256(previous link || bytes before link)
+    uint8_t sig[PAYLOAD_SIG_LEN];     // ECDSA P-256 r||s over link, checkpoints only
+} payload_t;
+
+#define PAYLOAD_LEGACY_LEN      offsetof(payload_t, seq)
+#define PAYLOAD_CHAINED_BODY    offsetof(payload_t, link)
+#define PAYLOAD_SAMPLE_LEN      offsetof(payload_t, sig)
+#define PAYLOAD_CHECKPOINT_LEN  sizeof(payload_t)
+
+// Receivers tell the formats apart by length alone, so a new field must not
+// produce a sample or checkpoint length that an older format already uses.
+
+// Chained firmware from before t_ms: the same fields without t_ms and boot.
+#define PAYLOAD_UNTIMED_BODY            offsetof(payload_t, t_ms)
+#define PAYLOAD_UNTIMED_SAMPLE_LEN      (PAYLOAD_UNTIMED_BODY + PAYLOAD_LINK_LEN)
+#define PAYLOAD_UNTIMED_CHECKPOINT_LEN  (PAYLOAD_UNTIMED_SAMPLE_LEN + PAYLOAD_SIG_LEN)
+
+// Before the per-probe records: seq and period_ms only (55 bytes), and before
+// the adaptive period just seq (53 bytes).
+#define PAYLOAD_PERIOD_BODY             offsetof(payload_t, sensor_count)
+#define PAYLOAD_PERIOD_SAMPLE_LEN       (PAYLOAD_PERIOD_BODY + PAYLOAD_LINK_LEN)
+#define PAYLOAD_PERIOD_CHECKPOINT_LEN   (PAYLOAD_PERIOD_SAMPLE_LEN + PAYLOAD_SIG_LEN)
+#define PAYLOAD_SEQ_BODY                offsetof(payload_t, period_ms)
+#define PAYLOAD_SEQ_SAMPLE_LEN          (PAYLOAD_SEQ_BODY + PAYLOAD_LINK_LEN)
+#define PAYLOAD_SEQ_CHECKPOINT_LEN      (PAYLOAD_SEQ_SAMPLE_LEN + PAYLOAD_SIG_LEN)
+
+#define NFC_UID_MAX  10
+
+// Sent on the NFC tap characteristic when the reader sees a new card.
+typedef struct __attribute__((packed)) {
+    uint32_t tap_seq;                 // taps since boot
+    uint32_t uptime_ms;               // when the card was read
+    uint32_t sample_seq;              // payload seq at the time, ties the carton to the chain
+    uint8_t uid_len;
+    uint8_t uid[NFC_UID_MAX];
+} nfc_tap_t;
+
+// Time-sync characteristic. A read returns the tag's clock and the epoch the
+// last gateway set; gateways that bracket the read with their own clock get
+// one offset measurement per read. Only bonded peers may write time_sync_set_t.
+typedef struct __attribute__((packed)) {
+    uint64_t uptime_us;               // tag clock when the read was served
+    uint32_t boot_id;                 // random per boot; a change means uptime restarted
+    uint64_t unix_ms;                 // wall time at synced_uptime_ms, 0 until a gateway sets it
+    uint32_t synced_uptime_ms;
+    int32_t drift_ppb;                // tag clock rate error seen by that gateway, + = tag fast
+    uint16_t sync_count;              // writes since boot
+} time_sync_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t unix_ms;                 // gateway's estimate of wall time at at_uptime_ms
+    uint32_t at_uptime_ms;
+    int32_t drift_ppb;
+} time_sync_set_t;
@@ -1,4 +1,5 @@
-#include <stdio.h>
+#include "pn532.h"
+
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -41,11 +42,24 @@ static const char *TAG = "PN532_I2C";
 // Commands
 #define PN532_CMD_GETFIRMWAREVERSION  0x02
 #define PN532_CMD_SAMCONFIGURATION    0x14
+#define PN532_CMD_RFCONFIGURATION     0x32
 #define PN532_CMD_INLISTPASSIVETARGET 0x4A
 
+// RFConfiguration item 5: MxRtyATR, MxRtyPSL, MxRtyPassiveActivation. The
+// default 0xFF makes InListPassiveTarget wait for a card forever; a couple of
+// activation attempts keeps each poll round to a few milliseconds.
+#define PN532_CFG_MAX_RETRIES         0x05
+#define PN532_PASSIVE_RETRIES         0x02
+
 // PN532 I2C ready byte (read 1 byte; 0x01 means ready)
 #define PN532_I2C_READY      0x01
 
+// Poller pacing: how often to check the ready byte, and when to give up on a
+// command and abort it.
+#define PN532_READY_POLL_US      2000
+#define PN532_ACK_TIMEOUT_US     50000
+#define PN532_RESPONSE_TIMEOUT_US 250000
+
 static i2c_master_bus_handle_t s_bus = NULL;
 static i2c_master_dev_handle_t s_dev = NULL;
 
@@ -65,12 +79,20 @@ static esp_err_t pn532_i2c_write(const uint8_t *data, size_t len)
 
     buf[0] = 0x00;
     memcpy(&buf[1], data, len);
-    return i2c_master_transmit(s_dev, buf, len + 1, 1000);
+    return i2c_master_transmit(s_dev, buf, len + 1, PN532_XFER_TIMEOUT_MS);
 }
 
 static esp_err_t pn532_i2c_read(uint8_t *data, size_t len)
 {
-    return i2c_master_receive(s_dev, data, len, 1000);
+    return i2c_master_receive(s_dev, data, len, PN532_XFER_TIMEOUT_MS);
+}
+
+static esp_err_t pn532_is_ready(bool *ready)
+{
+    uint8_t b = 0x00;
+    esp_err_t err = pn532_i2c_read(&b, 1);
+    *ready = (err == ESP_OK && b == PN532_I2C_READY);
+    return err;
 }
 
 static esp_err_t pn532_wait_ready(uint32_t timeout_ms)
@@ -79,16 +101,15 @@ static esp_err_t pn532_wait_ready(uint32_t timeout_ms)
     TickType_t timeout_ticks = pdMS_TO_TICKS(timeout_ms);
 
     while ((xTaskGetTickCount() - start) < timeout_ticks) {
-        uint8_t b = 0x00;
-        esp_err_t err = pn532_i2c_read(&b, 1);
-        if (err == ESP_OK && b == PN532_I2C_READY) return ESP_OK;
+        bool ready = false;
+        if (pn532_is_ready(&ready) == ESP_OK && ready) return ESP_OK;
         vTaskDelay(pdMS_TO_TICKS(10));
     }
     return ESP_ERR_TIMEOUT;
 }
 
-// Build and send a PN532 command frame: (TFI + CMD + DATA...)
-static esp_err_t pn532_send_command(const uint8_t *cmd_data, size_t cmd_len)
+// Build and write a PN532 command frame: (TFI + CMD + DATA...)
+static esp_err_t pn532_write_command(const uint8_t *cmd_data, size_t cmd_len)
 {
     if (cmd_len == 0 || cmd_len > 255) return ESP_ERR_INVALID_SIZE;
 
@@ -111,16 +132,14 @@ static esp_err_t pn532_send_command(const uint8_t *cmd_data, size_t cmd_len)
     frame[idx++] = dcs;
     frame[idx++] = PN532_POSTAMBLE;
 
-    esp_err_t err = pn532_i2c_write(frame, idx);
-    if (err != ESP_OK) return err;
-
-    // Wait for ACK
-    err = pn532_wait_ready(1000);
-    if (err != ESP_OK) return err;
+    return pn532_i2c_write(frame, idx);
+}
 
+static esp_err_t pn532_read_ack(void)
+{
     // ACK: status + 6 bytes => 01 00 00 FF 00 FF 00
     uint8_t ack[1 + 6] = {0};
-    err = pn532_i2c_read(ack, sizeof(ack));
+    esp_err_t err = pn532_i2c_read(ack, sizeof(ack));
     if (err != ESP_OK) return err;
 
     if (!(ack[1] == 0x00 && ack[2] == 0x00 && ack[3] == 0xFF &&
@@ -130,17 +149,31 @@ static esp_err_t pn532_send_command(const uint8_t *cmd_data, size_t cmd_len)
     return ESP_OK;
 }
 
-// Read PN532 response payload (TFI..), returns payload length
-static esp_err_t pn532_read_response(uint8_t *out, size_t out_max, size_t *out_len, uint32_t timeout_ms)
+static esp_err_t pn532_send_command(const uint8_t *cmd_data, size_t cmd_len)
 {
-    if (!out || !out_len) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = pn532_write_command(cmd_data, cmd_len);
+    if (err != ESP_OK) return err;
 
-    esp_err_t err = pn532_wait_ready(timeout_ms);
+    err = pn532_wait_ready(1000);
     if (err != ESP_OK) return err;
+    return pn532_read_ack();
+}
+
+// Writing an ACK frame makes the PN532 drop the command in progress.
+static esp_err_t pn532_abort(void)
+{
+    static const uint8_t ack[] = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+    return pn532_i2c_write(ack, sizeof(ack));
+}
+
+// Read PN532 response payload (TFI..) once the ready byte is set
+static esp_err_t pn532_read_frame(uint8_t *out, size_t out_max, size_t *out_len)
+{
+    if (!out || !out_len) return ESP_ERR_INVALID_ARG;
 
     // Read: status + 00 00 FF LEN LCS
     uint8_t hdr[1 + 5] = {0};
-    err = pn532_i2c_read(hdr, sizeof(hdr));
+    esp_err_t err = pn532_i2c_read(hdr, sizeof(hdr));
     if (err != ESP_OK) return err;
 
     if (hdr[1] != 0x00 || hdr[2] != 0x00 || hdr[3] != 0xFF) {
@@ -183,6 +216,13 @@ static esp_err_t pn532_read_response(uint8_t *out, size_t out_max, size_t *out_l
     return ESP_OK;
 }
 
+static esp_err_t pn532_read_response(uint8_t *out, size_t out_max, size_t *out_len, uint32_t timeout_ms)
+{
+    esp_err_t err = pn532_wait_ready(timeout_ms);
+    if (err != ESP_OK) return err;
+    return pn532_read_frame(out, out_max, out_len);
+}
+
 // ------------------- PN532 Commands -------------------
 static esp_err_t pn532_get_firmware(uint32_t *fw)
 {
@@ -229,39 +269,101 @@ static esp_err_t pn532_sam_config(void)
     return ESP_OK;
 }
 
-static esp_err_t pn532_poll_uid(uint8_t *uid, size_t uid_max, size_t *uid_len)
+static esp_err_t pn532_set_passive_retries(uint8_t retries)
 {
-    if (!uid || !uid_len) return ESP_ERR_INVALID_ARG;
-
-    uint8_t cmd[] = { PN532_HOSTTOPN532, PN532_CMD_INLISTPASSIVETARGET, 0x01, 0x00 };
+    uint8_t cmd[] = { PN532_HOSTTOPN532, PN532_CMD_RFCONFIGURATION, PN532_CFG_MAX_RETRIES, 0xFF, 0x01, retries };
 
     esp_err_t err = pn532_send_command(cmd, sizeof(cmd));
     if (err != ESP_OK) return err;
 
-    uint8_t resp[128] = {0};
+    uint8_t resp[32] = {0};
     size_t rlen = 0;
 
-    err = pn532_read_response(resp, sizeof(resp), &rlen, 1500);
+    err = pn532_read_response(resp, sizeof(resp), &rlen, 1000);
     if (err != ESP_OK) return err;
 
+    if (rlen < 2 || resp[0] != PN532_PN532TOHOST || resp[1] != (PN532_CMD_RFCONFIGURATION + 1)) {
+        ESP_LOGE(TAG, "Unexpected RFConfiguration response");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static const uint8_t s_list_cmd[] = { PN532_HOSTTOPN532, PN532_CMD_INLISTPASSIVETARGET, 0x01, 0x00 };
+
+static esp_err_t pn532_parse_uid(const uint8_t *resp, size_t rlen, uint8_t *uid, size_t *uid_len)
+{
     // Response: D5 4B NbTg Tg SensRes(2) SelRes NFCIDLen NFCID...
-    if (rlen < 8 || resp[0] != PN532_PN532TOHOST || resp[1] != (PN532_CMD_INLISTPASSIVETARGET + 1)) {
+    if (rlen < 3 || resp[0] != PN532_PN532TOHOST || resp[1] != (PN532_CMD_INLISTPASSIVETARGET + 1)) {
         return ESP_FAIL;
     }
 
     if (resp[2] == 0x00) return ESP_ERR_NOT_FOUND;
+    if (rlen < 8) return ESP_FAIL;
 
     uint8_t nfcid_len = resp[7];
-    if (8 + nfcid_len > rlen) return ESP_FAIL;
-    if (nfcid_len > uid_max) return ESP_ERR_NO_MEM;
+    if ((size_t)8 + nfcid_len > rlen) return ESP_FAIL;
+    if (nfcid_len > PN532_UID_MAX) return ESP_ERR_NO_MEM;
 
     memcpy(uid, &resp[8], nfcid_len);
     *uid_len = nfcid_len;
     return ESP_OK;
 }
 
+esp_err_t pn532_poll_step(pn532_poller_t *p, uint64_t now_us, uint8_t *uid, size_t *uid_len, uint32_t *next_us)
+{
+    if (!p || !uid || !uid_len || !next_us) return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err;
+    bool ready = false;
+    *next_us = PN532_READY_POLL_US;
+
+    switch (p->state) {
+    case PN532_POLL_IDLE:
+        err = pn532_write_command(s_list_cmd, sizeof(s_list_cmd));
+        if (err != ESP_OK) break;
+        p->state = PN532_POLL_ACK;
+        p->since_us = now_us;
+        return ESP_ERR_NOT_FINISHED;
+
+    case PN532_POLL_ACK:
+    case PN532_POLL_RESPONSE: {
+        err = pn532_is_ready(&ready);
+        if (err != ESP_OK) break;
+        if (!ready) {
+            uint64_t limit = p->state == PN532_POLL_ACK ? PN532_ACK_TIMEOUT_US : PN532_RESPONSE_TIMEOUT_US;
+            if (now_us - p->since_us < limit) return ESP_ERR_NOT_FINISHED;
+            pn532_abort();
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+        if (p->state == PN532_POLL_ACK) {
+            err = pn532_read_ack();
+            if (err != ESP_OK) break;
+            p->state = PN532_POLL_RESPONSE;
+            p->since_us = now_us;
+            return ESP_ERR_NOT_FINISHED;
+        }
+
+        uint8_t resp[64] = {0};
+        size_t rlen = 0;
+        err = pn532_read_frame(resp, sizeof(resp), &rlen);
+        if (err == ESP_OK) err = pn532_parse_uid(resp, rlen, uid, uid_len);
+        break;
+    }
+
+    default:
+        err = ESP_ERR_INVALID_STATE;
+        break;
+    }
+
+    p->state = PN532_POLL_IDLE;
+    *next_us = 0;
+    return err;
+}
+
 // ------------------- I2C Init -------------------
-static void i2c_init(void)
+static esp_err_t i2c_init(void)
 {
     i2c_master_bus_config_t bus_cfg = {
         .clk_source = I2C_CLK_SRC_DEFAULT,
@@ -271,29 +373,31 @@ static void i2c_init(void)
         .glitch_ignore_cnt = 7,
         .flags.enable_internal_pullup = true,
     };
-    ESP_ERROR_CHECK(i2c_new_master_bus(&bus_cfg, &s_bus));
+    ESP_RETURN_ON_ERROR(i2c_new_master_bus(&bus_cfg, &s_bus), TAG, "I2C bus");
 
     i2c_device_config_t dev_cfg = {
         .dev_addr_length = I2C_ADDR_BIT_LEN_7,
         .device_address = PN532_I2C_ADDR,
         .scl_speed_hz = I2C_FREQ_HZ,
     };
-    ESP_ERROR_CHECK(i2c_master_bus_add_device(s_bus, &dev_cfg, &s_dev));
+    ESP_RETURN_ON_ERROR(i2c_master_bus_add_device(s_bus, &dev_cfg, &s_dev), TAG, "PN532 device");
+    return ESP_OK;
 }
 
-// ------------------- app_main -------------------
-void app_main(void)
+// ------------------- Public API -------------------
+esp_err_t pn532_init(void)
 {
-    i2c_init();
+    esp_err_t err = i2c_init();
+    if (err != ESP_OK) return err;
     ESP_LOGI(TAG, "I2C ready. SDA=%d SCL=%d", I2C_SDA_GPIO, I2C_SCL_GPIO);
 
     vTaskDelay(pdMS_TO_TICKS(200));
 
     uint32_t fw = 0;
-    esp_err_t err = pn532_get_firmware(&fw);
+    err = pn532_get_firmware(&fw);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "PN532 not responding over I2C. err=%s", esp_err_to_name(err));
-        return;
+        return err;
     }
 
     ESP_LOGI(TAG, "PN532 FW: IC=0x%02X Ver=%u Rev=%u Support=0x%02X",
@@ -302,26 +406,15 @@ void app_main(void)
     err = pn532_sam_config();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "SAM config failed: %s", esp_err_to_name(err));
-        return;
+        return err;
     }
 
-    ESP_LOGI(TAG, "SAM configured. Tap a card...");
-
-    while (1) {
-        uint8_t uid[10] = {0};
-        size_t uid_len = 0;
-
-        err = pn532_poll_uid(uid, sizeof(uid), &uid_len);
-        if (err == ESP_OK) {
-            char hex[3 * 10 + 1] = {0};
-            for (size_t i = 0; i < uid_len; i++) {
-                snprintf(&hex[i * 3], sizeof(hex) - (i * 3),
-                         "%02X%s", uid[i], (i + 1 < uid_len) ? ":" : "");
-            }
-            ESP_LOGI(TAG, "Card UID (%u bytes): %s", (unsigned)uid_len, hex);
-            vTaskDelay(pdMS_TO_TICKS(1500));
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(300));
-        }
+    err = pn532_set_passive_retries(PN532_PASSIVE_RETRIES);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "RF retry config failed: %s", esp_err_to_name(err));
+        return err;
     }
+
+    ESP_LOGI(TAG, "SAM configured. Tap a card...");
+    return ESP_OK;
 }
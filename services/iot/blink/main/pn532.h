@@ -0,0 +1,42 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define PN532_UID_MAX  10
+
+// Longest a pn532_poll_step call can run. A frame takes under 7 ms at
+// 100 kHz, but a transfer stuck on the bus (SCL held low, no completion
+// interrupt) only returns when the I2C driver's timeout expires, and a
+// step makes up to three transfers (status read, frame header, frame body).
+// The timeout is counted in 10 ms FreeRTOS ticks and may end up to a tick
+// early, so two ticks are the least that never cuts a healthy frame short.
+#define PN532_XFER_TIMEOUT_MS  20
+#define PN532_STEP_MAX_XFERS   3
+#define PN532_STEP_WCET_US     (PN532_STEP_MAX_XFERS * PN532_XFER_TIMEOUT_MS * 1000)
+
+typedef enum {
+    PN532_POLL_IDLE = 0,
+    PN532_POLL_ACK,             // InListPassiveTarget written, waiting for the ACK
+    PN532_POLL_RESPONSE,        // ACK read, waiting for a card or the retry limit
+} pn532_poll_state_t;
+
+typedef struct {
+    pn532_poll_state_t state;
+    uint64_t since_us;
+} pn532_poller_t;
+
+// Brings up the I2C bus and configures the PN532 (SAM, bounded activation
+// retries). Blocks for a few hundred milliseconds; call before the node's
+// scheduler starts.
+esp_err_t pn532_init(void);
+
+// One poll round split into single I2C transactions, none of which waits on
+// the PN532, so a scheduler can interleave them with other work. Each call
+// runs one step and sets *next_us to the delay wanted before the next.
+// Returns ESP_ERR_NOT_FINISHED mid-round; at the end of a round ESP_OK with
+// uid (PN532_UID_MAX bytes) filled, ESP_ERR_NOT_FOUND when no card answered,
+// or the bus error.
+esp_err_t pn532_poll_step(pn532_poller_t *p, uint64_t now_us, uint8_t *uid, size_t *uid_len, uint32_t *next_us);
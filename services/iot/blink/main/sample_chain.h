@@ -0,0 +1,31 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// One signature per this many samples; at the 5 s sample period this is hourly.
+#define CHAIN_CHECKPOINT_INTERVAL  720
+
+// Loads the device key (generating it on first boot) and the last checkpoint
+// from NVS. The sequence resumes past any sample sent after that checkpoint.
+esp_err_t sample_chain_init(void);
+
+// Sequence number for the next sample.
+uint32_t sample_chain_next_seq(void);
+
+// Extends the chain over body (the payload bytes before the link) and writes
+// the new link.
+esp_err_t sample_chain_link(const void *body, size_t len, uint8_t link[32]);
+
+bool sample_chain_checkpoint_due(uint32_t seq);
+
+// Signs link and records (seq, link) as the restart point in NVS.
+esp_err_t sample_chain_sign(uint32_t seq, const uint8_t link[32], uint8_t sig[64]);
+
+// Uncompressed SEC1 point (0x04 || X || Y).
+esp_err_t sample_chain_public_key(uint8_t out[65]);
+
+// Logs per-sample hashing and per-checkpoint signing cost.
+void sample_chain_benchmark(void);
@@ -0,0 +1,85 @@
+#include "sample_sched.h"
+
+#include <math.h>
+
+// Weight of the newest rate estimate; DHT22 quantizes to 0.1, so a single
+// step between two close samples should not swing the period on its own.
+#define RATE_ALPHA       0.4f
+
+// The period may at most double per sample when things calm down, but drops
+// to the target at once when they do not.
+#define MAX_GROWTH       2.0f
+
+static float time_to_bound(float value, float rate, float lo, float hi)
+{
+    if (rate > 0.0f) return (hi - value) / rate;
+    if (rate < 0.0f) return (value - lo) / -rate;
+    return INFINITY;
+}
+
+static float guard_scale(float value, float lo, float hi, float guard)
+{
+    float margin = fminf(value - lo, hi - value);
+    if (guard <= 0.0f || margin >= guard) return 1.0f;
+    return fmaxf(margin, 0.0f) / guard;
+}
+
+void sample_sched_init(sample_sched_t *s, const sample_sched_config_t *cfg)
+{
+    s->cfg = *cfg;
+    if (s->cfg.min_period_ms < DHT22_MIN_INTERVAL_MS) s->cfg.min_period_ms = DHT22_MIN_INTERVAL_MS;
+    if (s->cfg.max_period_ms < s->cfg.min_period_ms) s->cfg.max_period_ms = s->cfg.min_period_ms;
+    if (s->cfg.samples_to_excursion < 1.0f) s->cfg.samples_to_excursion = 1.0f;
+
+    s->primed = false;
+    s->last_ms = 0;
+    s->last_temp = 0.0f;
+    s->last_humi = 0.0f;
+    s->temp_rate = 0.0f;
+    s->humi_rate = 0.0f;
+    s->period_ms = s->cfg.min_period_ms;
+}
+
+uint32_t sample_sched_update(sample_sched_t *s, uint32_t now_ms, float temp_c, float humi_pct)
+{
+    const sample_sched_config_t *cfg = &s->cfg;
+
+    if (s->primed && now_ms > s->last_ms) {
+        float dt = (float)(now_ms - s->last_ms) / 1000.0f;
+        s->temp_rate += RATE_ALPHA * ((temp_c - s->last_temp) / dt - s->temp_rate);
+        s->humi_rate += RATE_ALPHA * ((humi_pct - s->last_humi) / dt - s->humi_rate);
+    }
+    s->primed = true;
+    s->last_ms = now_ms;
+    s->last_temp = temp_c;
+    s->last_humi = humi_pct;
+
+    bool out_of_range = temp_c < cfg->temp_min_c || temp_c > cfg->temp_max_c ||
+                        humi_pct < cfg->humi_min_pct || humi_pct > cfg->humi_max_pct;
+    if (out_of_range) {
+        s->period_ms = cfg->min_period_ms;
+        return s->period_ms;
+    }
+
+    // Sample often enough to see a projected crossing several times over,
+    // and more often the closer the reading already is to a bound.
+    float tte_s = fminf(time_to_bound(temp_c, s->temp_rate, cfg->temp_min_c, cfg->temp_max_c),
+                        time_to_bound(humi_pct, s->humi_rate, cfg->humi_min_pct, cfg->humi_max_pct));
+    float target_ms = tte_s * 1000.0f / cfg->samples_to_excursion;
+    float scale = fminf(guard_scale(temp_c, cfg->temp_min_c, cfg->temp_max_c, cfg->temp_guard_c),
+                        guard_scale(humi_pct, cfg->humi_min_pct, cfg->humi_max_pct, cfg->humi_guard_pct));
+    target_ms = fminf(target_ms, (float)cfg->max_period_ms * scale);
+
+    float grown = (float)s->period_ms * MAX_GROWTH;
+    if (target_ms > grown) target_ms = grown;
+    if (target_ms < (float)cfg->min_period_ms) target_ms = (float)cfg->min_period_ms;
+    if (target_ms > (float)cfg->max_period_ms) target_ms = (float)cfg->max_period_ms;
+
+    s->period_ms = (uint32_t)target_ms;
+    return s->period_ms;
+}
+
+uint32_t sample_sched_period(const sample_sched_t *s)
+{
+    return s->period_ms;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// The DHT22 returns stale data if polled faster than this.
+#define DHT22_MIN_INTERVAL_MS  2000
+
+// Plain C with no ESP-IDF dependencies so host/sched_replay can run the same
+// policy against recorded traces.
+typedef struct {
+    uint32_t min_period_ms;     // raised to DHT22_MIN_INTERVAL_MS if lower
+    uint32_t max_period_ms;
+    float temp_min_c;
+    float temp_max_c;
+    float humi_min_pct;
+    float humi_max_pct;
+    float temp_guard_c;         // margin below which the period shrinks with distance
+    float humi_guard_pct;
+    float samples_to_excursion; // samples wanted before a projected bound crossing
+} sample_sched_config_t;
+
+typedef struct {
+    sample_sched_config_t cfg;
+    bool primed;
+    uint32_t last_ms;
+    float last_temp;
+    float last_humi;
+    float temp_rate;            // smoothed, per second
+    float humi_rate;
+    uint32_t period_ms;
+} sample_sched_t;
+
+void sample_sched_init(sample_sched_t *s, const sample_sched_config_t *cfg);
+
+// Feeds a reading taken at now_ms and returns the delay until the next one.
+uint32_t sample_sched_update(sample_sched_t *s, uint32_t now_ms, float temp_c, float humi_pct);
+
+// Delay after a failed read; keeps the current period.
+uint32_t sample_sched_period(const sample_sched_t *s);
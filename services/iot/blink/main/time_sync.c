@@ -0,0 +1,65 @@
+#include "time_sync.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+static const char *TAG = "TIME_SYNC";
+
+#define EPOCH_MIN_MS   1577836800000ull    // 2020-01-01
+#define EPOCH_MAX_MS   4102444800000ull    // 2100-01-01
+#define DRIFT_MAX_PPB  500000
+
+static SemaphoreHandle_t s_lock;
+static uint32_t s_boot_id;
+static time_sync_set_t s_set;
+static uint16_t s_sync_count;
+
+void time_sync_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_boot_id = esp_random();
+}
+
+uint32_t time_sync_uptime_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+uint32_t time_sync_boot_id(void)
+{
+    return s_boot_id;
+}
+
+void time_sync_get(time_sync_t *out)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    out->uptime_us = (uint64_t)esp_timer_get_time();
+    out->boot_id = s_boot_id;
+    out->unix_ms = s_set.unix_ms;
+    out->synced_uptime_ms = s_set.at_uptime_ms;
+    out->drift_ppb = s_set.drift_ppb;
+    out->sync_count = s_sync_count;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t time_sync_set(const time_sync_set_t *in)
+{
+    if (in->unix_ms < EPOCH_MIN_MS || in->unix_ms >= EPOCH_MAX_MS) return ESP_ERR_INVALID_ARG;
+    if (in->drift_ppb > DRIFT_MAX_PPB || in->drift_ppb < -DRIFT_MAX_PPB) return ESP_ERR_INVALID_ARG;
+    if (in->at_uptime_ms > time_sync_uptime_ms()) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_set = *in;
+    s_sync_count++;
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGD(TAG, "Epoch set: %llu ms at uptime %lu ms, drift %ld ppb",
+             (unsigned long long)in->unix_ms, (unsigned long)in->at_uptime_ms, (long)in->drift_ppb);
+    return ESP_OK;
+}
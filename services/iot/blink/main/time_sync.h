@@ -0,0 +1,25 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "payload.h"
+
+// The tag's sample clock is esp_timer: microseconds since boot from the main
+// crystal, monotonic and never adjusted. Payloads carry it as t_ms; gateways
+// map it to wall time from reads of the time-sync characteristic, so a
+// sample sent late (from the publish backlog) keeps the time it was taken.
+// The epoch a gateway writes back is only kept so the next reader (another
+// gateway, a phone) has a starting point before it has measured its own.
+void time_sync_init(void);
+
+uint32_t time_sync_uptime_ms(void);
+
+// Random per boot, so a reader can tell a restarted uptime from a slow one.
+uint32_t time_sync_boot_id(void);
+
+void time_sync_get(time_sync_t *out);
+
+// Rejects epochs outside 2020..2100, drifts beyond 500 ppm and at_uptime_ms
+// values in the future.
+esp_err_t time_sync_set(const time_sync_set_t *in);
@@ -0,0 +1,170 @@
+#include "aggregate.h"
+
+#include <stdlib.h>
+
+#include "hash.h"
+
+int gw_aggregate_init(gw_aggregate_t *a, size_t expected_devices, uint32_t window_ms,
+                      uint32_t max_samples, gw_window_emit_fn emit, void *emit_ctx)
+{
+    a->capacity = gw_hash_capacity_for(expected_devices);
+    a->count = 0;
+    a->window_ns = (uint64_t)window_ms * 1000000ull;
+    a->window_ms = window_ms;
+    a->max_samples = max_samples;
+    a->emit = emit;
+    a->emit_ctx = emit_ctx;
+    a->slots = calloc(a->capacity, sizeof(*a->slots));
+    return a->slots ? 0 : -1;
+}
+
+void gw_aggregate_destroy(gw_aggregate_t *a)
+{
+    free(a->slots);
+    a->slots = NULL;
+}
+
+// Devices are 48-bit addresses, which leaves room for the probe.
+static uint64_t window_key(uint64_t device, uint8_t probe)
+{
+    return device | ((uint64_t)probe << 48);
+}
+
+static gw_aggregate_slot_t *find_slot(gw_aggregate_slot_t *slots, size_t capacity, uint64_t key)
+{
+    size_t mask = capacity - 1;
+    size_t i = (size_t)gw_hash_u64(key) & mask;
+    while (slots[i].used && window_key(slots[i].window.device, slots[i].window.probe) != key) i = (i + 1) & mask;
+    return &slots[i];
+}
+
+static int grow(gw_aggregate_t *a)
+{
+    size_t capacity = a->capacity * 2;
+    gw_aggregate_slot_t *slots = calloc(capacity, sizeof(*slots));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < a->capacity; i++) {
+        const gw_window_t *w = &a->slots[i].window;
+        if (a->slots[i].used) *find_slot(slots, capacity, window_key(w->device, w->probe)) = a->slots[i];
+    }
+    free(a->slots);
+    a->slots = slots;
+    a->capacity = capacity;
+    return 0;
+}
+
+static void close_window(gw_aggregate_t *a, gw_aggregate_slot_t *s)
+{
+    s->open = false;
+    a->emit(&s->window, a->emit_ctx);
+}
+
+// Readings of one sample as they fold into one window.
+typedef struct {
+    float temp_min;
+    float temp_max;
+    float humi_min;
+    float humi_max;
+    uint8_t flags;
+    bool failed;            // probe not read: nothing to fold but the flags
+} span_t;
+
+static void add_span(gw_aggregate_t *a, const gw_reading_t *r, uint8_t probe, const span_t *v)
+{
+    if ((a->count + 1) * 10 > a->capacity * 7) grow(a);
+
+    gw_aggregate_slot_t *s = find_slot(a->slots, a->capacity, window_key(r->device, probe));
+    if (v->failed) {
+        // No reading to fold; only a window already open records the failure.
+        if (s->used && s->open) s->window.flags |= v->flags;
+        return;
+    }
+    if (!s->used) {
+        s->used = true;
+        s->open = false;
+        a->count++;
+    }
+
+    if (s->open && a->max_samples && s->window.samples >= a->max_samples) close_window(a, s);
+    if (s->open && r->unix_ms && s->window.first_unix_ms) {
+        uint64_t lo = r->unix_ms < s->window.first_unix_ms ? r->unix_ms : s->window.first_unix_ms;
+        uint64_t hi = r->unix_ms > s->window.last_unix_ms ? r->unix_ms : s->window.last_unix_ms;
+        if (hi - lo >= a->window_ms) close_window(a, s);
+    }
+
+    gw_window_t *w = &s->window;
+    if (!s->open) {
+        w->device = r->device;
+        w->probe = probe;
+        w->first_seq = r->seq;
+        w->last_seq = r->seq;
+        w->samples = 0;
+        w->temp_min = v->temp_min;
+        w->temp_max = v->temp_max;
+        w->humi_min = v->humi_min;
+        w->humi_max = v->humi_max;
+        w->flags = 0;
+        w->opened_ns = r->rx_ns;
+        w->first_unix_ms = r->unix_ms;
+        w->last_unix_ms = r->unix_ms;
+        w->time_err_ms = 0;
+        s->open = true;
+    }
+
+    if (r->unix_ms) {
+        if (!w->first_unix_ms || r->unix_ms < w->first_unix_ms) w->first_unix_ms = r->unix_ms;
+        if (r->unix_ms > w->last_unix_ms) w->last_unix_ms = r->unix_ms;
+        if (r->time_err_ms > w->time_err_ms) w->time_err_ms = r->time_err_ms;
+    }
+
+    if (r->seq < w->first_seq) w->first_seq = r->seq;
+    if (r->seq > w->last_seq) w->last_seq = r->seq;
+    if (v->temp_min < w->temp_min) w->temp_min = v->temp_min;
+    if (v->temp_max > w->temp_max) w->temp_max = v->temp_max;
+    if (v->humi_min < w->humi_min) w->humi_min = v->humi_min;
+    if (v->humi_max > w->humi_max) w->humi_max = v->humi_max;
+    w->flags |= v->flags;
+    w->samples++;
+}
+
+void gw_aggregate_add(gw_aggregate_t *a, const gw_reading_t *r)
+{
+    if (r->probe_count == 0) {
+        // Firmware without per-probe records: the leading fields span the
+        // sample's probes.
+        span_t v = { r->temp_min, r->temp_max, r->humi_min, r->humi_max, r->flags, false };
+        add_span(a, r, 0, &v);
+        return;
+    }
+    for (uint8_t i = 0; i < r->probe_count; i++) {
+        const gw_probe_reading_t *p = &r->probes[i];
+        span_t v = { p->temp, p->temp, p->humi, p->humi, p->flags, (p->flags & GW_FLAG_SENSOR_ERR) != 0 };
+        add_span(a, r, r->probe_count > 1 ? (uint8_t)(i + 1) : 0, &v);
+    }
+}
+
+size_t gw_aggregate_expire(gw_aggregate_t *a, uint64_t now_ns)
+{
+    size_t emitted = 0;
+    for (size_t i = 0; i < a->capacity; i++) {
+        gw_aggregate_slot_t *s = &a->slots[i];
+        if (s->open && now_ns - s->window.opened_ns >= a->window_ns) {
+            close_window(a, s);
+            emitted++;
+        }
+    }
+    return emitted;
+}
+
+size_t gw_aggregate_flush(gw_aggregate_t *a)
+{
+    size_t emitted = 0;
+    for (size_t i = 0; i < a->capacity; i++) {
+        if (a->slots[i].open) {
+            close_window(a, &a->slots[i]);
+            emitted++;
+        }
+    }
+    return emitted;
+}
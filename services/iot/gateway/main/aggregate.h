@@ -0,0 +1,61 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "payload.h"
+
+// One per device (or probe, for tags with several) and time window; this is
+// what ends up on chain.
+typedef struct {
+    uint64_t device;
+    uint8_t probe;          // 0 for the tag as a whole, else probe index + 1
+    uint32_t first_seq;
+    uint32_t last_seq;
+    uint32_t samples;
+    float temp_min;
+    float temp_max;
+    float humi_min;
+    float humi_max;
+    uint8_t flags;
+    uint64_t opened_ns;     // rx time of the first reading in the window
+    uint64_t first_unix_ms; // reconstructed sample times, 0 when unknown
+    uint64_t last_unix_ms;
+    uint32_t time_err_ms;   // largest error bound among them, or GW_TIME_ERR_UNBOUNDED
+} gw_window_t;
+
+typedef void (*gw_window_emit_fn)(const gw_window_t *window, void *ctx);
+
+typedef struct {
+    gw_window_t window;
+    bool used;
+    bool open;
+} gw_aggregate_slot_t;
+
+typedef struct {
+    gw_aggregate_slot_t *slots;
+    size_t capacity;
+    size_t count;
+    uint64_t window_ns;
+    uint64_t window_ms;
+    uint32_t max_samples;
+    gw_window_emit_fn emit;
+    void *emit_ctx;
+} gw_aggregate_t;
+
+int gw_aggregate_init(gw_aggregate_t *a, size_t expected_devices, uint32_t window_ms,
+                      uint32_t max_samples, gw_window_emit_fn emit, void *emit_ctx);
+void gw_aggregate_destroy(gw_aggregate_t *a);
+
+// Folds a reading into its device's window, or each probe's reading into that
+// probe's window when the tag reports several, emitting a window first if it
+// has already reached max_samples or if the reading was taken (per its
+// reconstructed time) too far from the window's other readings: a backlog
+// flushed in one burst still splits into windows of the configured length.
+void gw_aggregate_add(gw_aggregate_t *a, const gw_reading_t *r);
+
+// Emits every window older than the configured length; returns how many.
+size_t gw_aggregate_expire(gw_aggregate_t *a, uint64_t now_ns);
+
+// Emits every open window regardless of age (shutdown).
+size_t gw_aggregate_flush(gw_aggregate_t *a);
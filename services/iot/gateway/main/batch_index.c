@@ -0,0 +1,455 @@
+#include "batch_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gw_log.h"
+#include "hash.h"
+#include "keccak.h"
+
+static const char *TAG = "INDEX";
+
+#define HEADER_BYTES        4096u
+#define MIN_BATCH_CAPACITY  1024u
+#define MIN_HANDLERS        256u
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static size_t layout_size(uint64_t handler_capacity, uint64_t batch_capacity, uint64_t slot_capacity)
+{
+    return HEADER_BYTES + align8(handler_capacity * 20) + align8(batch_capacity * sizeof(gw_batch_entry_t)) +
+           slot_capacity * sizeof(gw_batch_slot_t);
+}
+
+static void bind_sections(gw_batch_index_t *idx)
+{
+    gw_batch_index_header_t *h = (gw_batch_index_header_t *)idx->map;
+    uint8_t *p = idx->map + HEADER_BYTES;
+    idx->header = h;
+    idx->handlers = (uint8_t (*)[20])p;
+    p += align8((size_t)h->handler_capacity * 20);
+    idx->batches = (gw_batch_entry_t *)p;
+    p += align8(h->batch_capacity * sizeof(gw_batch_entry_t));
+    idx->slots = (gw_batch_slot_t *)p;
+}
+
+static uint64_t hash_tag(const uint8_t hash[32])
+{
+    uint64_t tag;
+    memcpy(&tag, hash, sizeof(tag));
+    return tag;
+}
+
+static uint64_t address_key(const uint8_t addr[20])
+{
+    uint64_t a, b;
+    memcpy(&a, addr, 8);
+    memcpy(&b, addr + 8, 8);
+    return gw_hash_u64(a ^ gw_hash_u64(b));
+}
+
+static int rebuild_handler_map(gw_batch_index_t *idx)
+{
+    free(idx->handler_map);
+    idx->handler_map_capacity = gw_hash_capacity_for(idx->header->handler_capacity);
+    idx->handler_map = calloc(idx->handler_map_capacity, sizeof(*idx->handler_map));
+    if (!idx->handler_map) return -1;
+
+    size_t mask = idx->handler_map_capacity - 1;
+    for (uint32_t i = 1; i < idx->header->handler_count; i++) {
+        size_t pos = (size_t)address_key(idx->handlers[i]) & mask;
+        while (idx->handler_map[pos]) pos = (pos + 1) & mask;
+        idx->handler_map[pos] = (uint16_t)i;
+    }
+    return 0;
+}
+
+static int map_file(gw_batch_index_t *idx, int fd, size_t len)
+{
+    int prot = PROT_READ | (idx->writable ? PROT_WRITE : 0);
+    void *map = mmap(NULL, len, prot, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        GW_LOGE(TAG, "mmap %s (%zu bytes) failed: %s", idx->path, len, strerror(errno));
+        return -1;
+    }
+    idx->fd = fd;
+    idx->map = map;
+    idx->map_len = len;
+    bind_sections(idx);
+    return 0;
+}
+
+static int create_file(const char *path, uint64_t handler_capacity, uint64_t batch_capacity,
+                       uint64_t slot_capacity, int *fd_out, size_t *len_out)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        GW_LOGE(TAG, "Cannot create %s: %s", path, strerror(errno));
+        return -1;
+    }
+    size_t len = layout_size(handler_capacity, batch_capacity, slot_capacity);
+    // Sparse: untouched pages of the slot table cost nothing on disk.
+    if (ftruncate(fd, (off_t)len) != 0) {
+        GW_LOGE(TAG, "Cannot size %s to %zu bytes: %s", path, len, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    gw_batch_index_header_t h = {
+        .version = GW_BATCH_INDEX_VERSION,
+        .handler_capacity = (uint32_t)handler_capacity,
+        .handler_count = 1,
+        .slot_capacity = slot_capacity,
+        .batch_capacity = batch_capacity,
+    };
+    memcpy(h.magic, GW_BATCH_INDEX_MAGIC, sizeof(h.magic));
+    if (pwrite(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) {
+        GW_LOGE(TAG, "Cannot write header of %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    *fd_out = fd;
+    *len_out = len;
+    return 0;
+}
+
+int gw_batch_index_open(gw_batch_index_t *idx, const char *path, bool writable, size_t expected_batches)
+{
+    memset(idx, 0, sizeof(*idx));
+    idx->fd = -1;
+    idx->writable = writable;
+    snprintf(idx->path, sizeof(idx->path), "%s", path);
+
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    size_t len = 0;
+    if (fd < 0 && errno == ENOENT && writable) {
+        uint64_t batch_capacity = expected_batches + 1 > MIN_BATCH_CAPACITY ? expected_batches + 1 : MIN_BATCH_CAPACITY;
+        if (create_file(path, MIN_HANDLERS, batch_capacity, gw_hash_capacity_for(expected_batches), &fd, &len) != 0) {
+            return -1;
+        }
+        GW_LOGI(TAG, "Created %s for %zu batches", path, expected_batches);
+    } else if (fd < 0) {
+        GW_LOGE(TAG, "Cannot open %s: %s", path, strerror(errno));
+        return -1;
+    } else {
+        gw_batch_index_header_t h;
+        struct stat st;
+        if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, GW_BATCH_INDEX_MAGIC, 8) != 0 ||
+            h.version != GW_BATCH_INDEX_VERSION) {
+            GW_LOGE(TAG, "%s is not a batch index (version %d)", path, GW_BATCH_INDEX_VERSION);
+            close(fd);
+            return -1;
+        }
+        len = layout_size(h.handler_capacity, h.batch_capacity, h.slot_capacity);
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < len) {
+            GW_LOGE(TAG, "%s is truncated", path);
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (map_file(idx, fd, len) != 0) {
+        close(fd);
+        return -1;
+    }
+    pthread_rwlock_init(&idx->lock, NULL);
+    if (writable && rebuild_handler_map(idx) != 0) {
+        gw_batch_index_close(idx);
+        return -1;
+    }
+    return 0;
+}
+
+static void unmap(gw_batch_index_t *idx)
+{
+    if (idx->map) munmap(idx->map, idx->map_len);
+    if (idx->fd >= 0) close(idx->fd);
+    idx->map = NULL;
+    idx->fd = -1;
+}
+
+void gw_batch_index_close(gw_batch_index_t *idx)
+{
+    unmap(idx);
+    free(idx->handler_map);
+    idx->handler_map = NULL;
+    pthread_rwlock_destroy(&idx->lock);
+}
+
+size_t gw_batch_index_file_size(const gw_batch_index_t *idx)
+{
+    return idx->map_len;
+}
+
+int gw_batch_index_commit(gw_batch_index_t *idx, uint64_t next_block)
+{
+    if (msync(idx->map, idx->map_len, MS_SYNC) != 0) return -1;
+    idx->header->next_block = next_block;
+    return msync(idx->map, HEADER_BYTES, MS_SYNC);
+}
+
+int gw_batch_index_bind(gw_batch_index_t *idx, uint64_t chain_id, const uint8_t contract[20])
+{
+    static const uint8_t zero[20];
+    gw_batch_index_header_t *h = idx->header;
+    if (h->chain_id == 0 && memcmp(h->contract, zero, 20) == 0) {
+        h->chain_id = chain_id;
+        memcpy(h->contract, contract, 20);
+        return 0;
+    }
+    if (h->chain_id != chain_id || memcmp(h->contract, contract, 20) != 0) {
+        GW_LOGE(TAG, "%s was built for another chain or contract; remove it to rebuild", idx->path);
+        return -1;
+    }
+    return 0;
+}
+
+static void slot_insert(gw_batch_slot_t *slots, uint64_t capacity, uint64_t tag, uint32_t batch_id)
+{
+    size_t mask = capacity - 1;
+    size_t pos = (size_t)tag & mask;
+    while (slots[pos].batch_id) pos = (pos + 1) & mask;
+    slots[pos].tag_lo = (uint32_t)tag;
+    slots[pos].tag_hi = (uint32_t)(tag >> 32);
+    slots[pos].batch_id = batch_id;
+}
+
+// Writes a larger copy next to the file and renames it over the original.
+// Other processes keep reading the old mapping until they reopen.
+static int resize(gw_batch_index_t *idx, uint64_t handler_capacity, uint64_t batch_capacity, uint64_t slot_capacity)
+{
+    char tmp[sizeof(idx->path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.grow", idx->path);
+
+    int fd;
+    size_t len;
+    if (create_file(tmp, handler_capacity, batch_capacity, slot_capacity, &fd, &len) != 0) return -1;
+
+    gw_batch_index_t next = { .writable = true };
+    snprintf(next.path, sizeof(next.path), "%s", idx->path);
+    if (map_file(&next, fd, len) != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+
+    const gw_batch_index_header_t *old = idx->header;
+    gw_batch_index_header_t *h = next.header;
+    h->handler_count = old->handler_count;
+    h->chain_id = old->chain_id;
+    memcpy(h->contract, old->contract, 20);
+    h->next_block = old->next_block;
+    h->slot_count = old->slot_count;
+    h->max_batch_id = old->max_batch_id;
+    h->ambiguous = old->ambiguous;
+
+    memcpy(next.handlers, idx->handlers, (size_t)old->handler_count * 20);
+    memcpy(next.batches, idx->batches, (size_t)(old->max_batch_id + 1) * sizeof(gw_batch_entry_t));
+    if (slot_capacity == old->slot_capacity) {
+        memcpy(next.slots, idx->slots, slot_capacity * sizeof(gw_batch_slot_t));
+    } else {
+        for (uint64_t i = 0; i < old->slot_capacity; i++) {
+            const gw_batch_slot_t *s = &idx->slots[i];
+            if (s->batch_id) slot_insert(next.slots, slot_capacity, ((uint64_t)s->tag_hi << 32) | s->tag_lo, s->batch_id);
+        }
+    }
+
+    if (msync(next.map, next.map_len, MS_SYNC) != 0 || rename(tmp, idx->path) != 0) {
+        GW_LOGE(TAG, "Cannot replace %s: %s", idx->path, strerror(errno));
+        unmap(&next);
+        unlink(tmp);
+        return -1;
+    }
+
+    unmap(idx);
+    idx->fd = next.fd;
+    idx->map = next.map;
+    idx->map_len = next.map_len;
+    bind_sections(idx);
+    GW_LOGI(TAG, "Resized %s to %llu batches, %llu slots (%zu MiB)", idx->path,
+            (unsigned long long)batch_capacity, (unsigned long long)slot_capacity, idx->map_len >> 20);
+    return rebuild_handler_map(idx);
+}
+
+static int reserve(gw_batch_index_t *idx, uint32_t batch_id, bool new_slot, bool new_handler)
+{
+    const gw_batch_index_header_t *h = idx->header;
+    uint64_t handlers = h->handler_capacity;
+    uint64_t batches = h->batch_capacity;
+    uint64_t slots = h->slot_capacity;
+
+    while (batch_id >= batches) batches *= 2;
+    if (new_slot && (h->slot_count + 1) * 10 > slots * 7) slots *= 2;
+    if (new_handler && h->handler_count == handlers) {
+        if (handlers > GW_BATCH_INDEX_MAX_HANDLERS) {
+            GW_LOGE(TAG, "Handler table full (%d accounts)", GW_BATCH_INDEX_MAX_HANDLERS);
+            return -1;
+        }
+        handlers = handlers * 2 > GW_BATCH_INDEX_MAX_HANDLERS + 1 ? GW_BATCH_INDEX_MAX_HANDLERS + 1 : handlers * 2;
+    }
+
+    if (handlers == h->handler_capacity && batches == h->batch_capacity && slots == h->slot_capacity) return 0;
+    return resize(idx, handlers, batches, slots);
+}
+
+static int handler_index(gw_batch_index_t *idx, const uint8_t addr[20], uint16_t *out)
+{
+    size_t mask = idx->handler_map_capacity - 1;
+    size_t pos = (size_t)address_key(addr) & mask;
+    for (uint16_t i; (i = idx->handler_map[pos]) != 0; pos = (pos + 1) & mask) {
+        if (memcmp(idx->handlers[i], addr, 20) == 0) {
+            *out = i;
+            return 0;
+        }
+    }
+
+    if (reserve(idx, 0, false, true) != 0) return -1;
+    uint32_t i = idx->header->handler_count;
+    memcpy(idx->handlers[i], addr, 20);
+    idx->header->handler_count = i + 1;
+
+    // A resize rebuilt the map, so look the free position up again.
+    mask = idx->handler_map_capacity - 1;
+    pos = (size_t)address_key(addr) & mask;
+    while (idx->handler_map[pos]) pos = (pos + 1) & mask;
+    idx->handler_map[pos] = (uint16_t)i;
+    *out = (uint16_t)i;
+    return 0;
+}
+
+int gw_batch_index_put_batch(gw_batch_index_t *idx, uint32_t batch_id, gw_batch_status_t status,
+                             const uint8_t handler[20])
+{
+    if (batch_id == 0 || batch_id == GW_BATCH_INDEX_AMBIGUOUS) return -1;
+    pthread_rwlock_wrlock(&idx->lock);
+
+    int rc = reserve(idx, batch_id, false, false);
+    uint16_t handler_i = 0;
+    if (rc == 0 && handler) rc = handler_index(idx, handler, &handler_i);
+    if (rc == 0) {
+        gw_batch_entry_t e = idx->batches[batch_id];
+        e.status = (uint8_t)status;
+        if (handler) e.handler = handler_i;
+        idx->batches[batch_id] = e;
+        if (batch_id > idx->header->max_batch_id) idx->header->max_batch_id = batch_id;
+    }
+
+    pthread_rwlock_unlock(&idx->lock);
+    return rc;
+}
+
+int gw_batch_index_set_status(gw_batch_index_t *idx, uint32_t batch_id, gw_batch_status_t status)
+{
+    return gw_batch_index_put_batch(idx, batch_id, status, NULL);
+}
+
+int gw_batch_index_put_code(gw_batch_index_t *idx, const uint8_t hash[32], uint32_t batch_id)
+{
+    if (batch_id == 0 || batch_id == GW_BATCH_INDEX_AMBIGUOUS) return -1;
+    pthread_rwlock_wrlock(&idx->lock);
+
+    int rc = reserve(idx, 0, true, false);
+    if (rc == 0) {
+        uint64_t tag = hash_tag(hash);
+        size_t mask = idx->header->slot_capacity - 1;
+        size_t pos = (size_t)tag & mask;
+        gw_batch_slot_t *s;
+        for (;; pos = (pos + 1) & mask) {
+            s = &idx->slots[pos];
+            uint32_t id = __atomic_load_n(&s->batch_id, __ATOMIC_ACQUIRE);
+            if (id == 0) {
+                // Tag first, then the id that makes the slot visible to readers.
+                s->tag_lo = (uint32_t)tag;
+                s->tag_hi = (uint32_t)(tag >> 32);
+                __atomic_store_n(&s->batch_id, batch_id, __ATOMIC_RELEASE);
+                idx->header->slot_count++;
+                break;
+            }
+            if (s->tag_lo == (uint32_t)tag && s->tag_hi == (uint32_t)(tag >> 32)) {
+                // Tracking codes are unique on chain, so another id here means
+                // two codes share the 64-bit prefix.
+                if (id != batch_id && id != GW_BATCH_INDEX_AMBIGUOUS) {
+                    __atomic_store_n(&s->batch_id, GW_BATCH_INDEX_AMBIGUOUS, __ATOMIC_RELEASE);
+                    idx->header->ambiguous++;
+                    GW_LOGW(TAG, "Tracking codes of batches %u and %u share a prefix; scans fall back to RPC",
+                            id, batch_id);
+                }
+                break;
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(&idx->lock);
+    return rc;
+}
+
+// Caller holds the read lock.
+static gw_index_result_t read_batch(const gw_batch_index_t *idx, uint32_t batch_id, gw_batch_info_t *out)
+{
+    if (batch_id == 0 || batch_id > idx->header->max_batch_id) return GW_INDEX_NOT_FOUND;
+    gw_batch_entry_t e = idx->batches[batch_id];
+    out->batch_id = batch_id;
+    out->status = (gw_batch_status_t)e.status;
+    if (e.handler && e.handler < idx->header->handler_count) {
+        memcpy(out->handler, idx->handlers[e.handler], 20);
+    } else {
+        memset(out->handler, 0, 20);
+    }
+    return GW_INDEX_FOUND;
+}
+
+gw_index_result_t gw_batch_index_lookup_hash(gw_batch_index_t *idx, const uint8_t hash[32], gw_batch_info_t *out)
+{
+    gw_index_result_t result = GW_INDEX_NOT_FOUND;
+    uint64_t tag = hash_tag(hash);
+
+    // Only the writer's own mapping moves on resize; read-only handles skip the lock.
+    if (idx->writable) pthread_rwlock_rdlock(&idx->lock);
+    size_t mask = idx->header->slot_capacity - 1;
+    for (size_t pos = (size_t)tag & mask;; pos = (pos + 1) & mask) {
+        const gw_batch_slot_t *s = &idx->slots[pos];
+        uint32_t id = __atomic_load_n(&s->batch_id, __ATOMIC_ACQUIRE);
+        if (id == 0) break;
+        if (s->tag_lo != (uint32_t)tag || s->tag_hi != (uint32_t)(tag >> 32)) continue;
+
+        result = id == GW_BATCH_INDEX_AMBIGUOUS ? GW_INDEX_AMBIGUOUS : read_batch(idx, id, out);
+        break;
+    }
+    if (idx->writable) pthread_rwlock_unlock(&idx->lock);
+    return result;
+}
+
+gw_index_result_t gw_batch_index_get(gw_batch_index_t *idx, uint32_t batch_id, gw_batch_info_t *out)
+{
+    if (idx->writable) pthread_rwlock_rdlock(&idx->lock);
+    gw_index_result_t result = read_batch(idx, batch_id, out);
+    if (idx->writable) pthread_rwlock_unlock(&idx->lock);
+    return result;
+}
+
+gw_index_result_t gw_batch_index_lookup(gw_batch_index_t *idx, const char *tracking_code, size_t len,
+                                        gw_batch_info_t *out)
+{
+    uint8_t hash[32];
+    gw_keccak256(tracking_code, len, hash);
+    return gw_batch_index_lookup_hash(idx, hash, out);
+}
+
+const char *gw_batch_status_name(gw_batch_status_t status)
+{
+    switch (status) {
+    case GW_BATCH_ACTIVE: return "active";
+    case GW_BATCH_IN_TRANSIT: return "in_transit";
+    case GW_BATCH_CONSUMED: return "consumed";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Memory-mapped index from keccak256(trackingCode) to batch id, status and
+// current handler, so a scanned label resolves on the gateway without a
+// getBatchIdByTrackingCode round trip and keeps resolving when the uplink is
+// down. batch_sync.c keeps it current from ChainProof events.
+//
+// File layout, all little-endian:
+//   header (one page) | handlers[handler_capacity][20] | batches[batch_capacity] | slots[slot_capacity]
+//
+// Slots hold the first 8 bytes of the hash and the batch id (12 bytes); the
+// per-batch state lives in a dense table indexed by batch id (4 bytes), so
+// transfer and consume events update it without touching the hash table.
+// Two codes sharing a 64-bit prefix (about 3e-6 odds at 10M batches) mark
+// their slot ambiguous and lookups fall back to the node.
+//
+// One writer. Lookups on the writer's handle take its read lock because a
+// resize remaps it; read-only handles (other threads or processes) need no
+// lock and keep the old file until they reopen after a resize.
+#define GW_BATCH_INDEX_MAGIC        "CPBIDX01"
+#define GW_BATCH_INDEX_VERSION      1
+#define GW_BATCH_INDEX_AMBIGUOUS    UINT32_MAX
+#define GW_BATCH_INDEX_MAX_HANDLERS 65535
+
+typedef enum {
+    GW_BATCH_UNKNOWN = 0,       // batch id seen without its creation event
+    GW_BATCH_ACTIVE,
+    GW_BATCH_IN_TRANSIT,        // transfer initiated, not yet received
+    GW_BATCH_CONSUMED,          // split, merged or transformed into another batch
+} gw_batch_status_t;
+
+typedef enum {
+    GW_INDEX_FOUND = 0,
+    GW_INDEX_NOT_FOUND,
+    GW_INDEX_AMBIGUOUS,         // ask the node
+} gw_index_result_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t handler_capacity;
+    uint32_t handler_count;     // entry 0 is the unknown handler
+    uint32_t reserved;
+    uint64_t chain_id;
+    uint8_t contract[20];
+    uint8_t pad[4];
+    uint64_t next_block;        // first block whose events are not applied yet
+    uint64_t slot_capacity;
+    uint64_t slot_count;
+    uint64_t batch_capacity;
+    uint64_t max_batch_id;
+    uint64_t ambiguous;
+} gw_batch_index_header_t;
+
+typedef struct {
+    uint32_t tag_lo;
+    uint32_t tag_hi;
+    uint32_t batch_id;          // 0 = empty
+} gw_batch_slot_t;
+
+typedef struct {
+    uint16_t handler;
+    uint8_t status;
+    uint8_t reserved;
+} gw_batch_entry_t;
+
+typedef struct {
+    uint32_t batch_id;
+    gw_batch_status_t status;
+    uint8_t handler[20];        // all zero when unknown
+} gw_batch_info_t;
+
+typedef struct {
+    char path[4096];
+    bool writable;
+    int fd;
+    uint8_t *map;
+    size_t map_len;
+
+    gw_batch_index_header_t *header;
+    uint8_t (*handlers)[20];
+    gw_batch_entry_t *batches;
+    gw_batch_slot_t *slots;
+
+    // Writer only: address -> handler index, rebuilt on open.
+    uint16_t *handler_map;
+    size_t handler_map_capacity;
+
+    pthread_rwlock_t lock;
+} gw_batch_index_t;
+
+// Opens an existing index. With writable set, creates it sized for
+// expected_batches if the file does not exist.
+int gw_batch_index_open(gw_batch_index_t *idx, const char *path, bool writable, size_t expected_batches);
+void gw_batch_index_close(gw_batch_index_t *idx);
+
+// Flushes the mapping and then records next_block, so a crash leaves the
+// index at an earlier block and the same events are applied again.
+int gw_batch_index_commit(gw_batch_index_t *idx, uint64_t next_block);
+
+// Sets the chain and contract the index was built from; fails if the index
+// already belongs to another one.
+int gw_batch_index_bind(gw_batch_index_t *idx, uint64_t chain_id, const uint8_t contract[20]);
+
+gw_index_result_t gw_batch_index_lookup(gw_batch_index_t *idx, const char *tracking_code, size_t len,
+                                        gw_batch_info_t *out);
+gw_index_result_t gw_batch_index_lookup_hash(gw_batch_index_t *idx, const uint8_t hash[32], gw_batch_info_t *out);
+gw_index_result_t gw_batch_index_get(gw_batch_index_t *idx, uint32_t batch_id, gw_batch_info_t *out);
+
+// Writer side. All of these are idempotent so replaying a block range after a
+// crash is harmless. handler may be NULL to leave it unchanged.
+int gw_batch_index_put_batch(gw_batch_index_t *idx, uint32_t batch_id, gw_batch_status_t status,
+                             const uint8_t handler[20]);
+int gw_batch_index_put_code(gw_batch_index_t *idx, const uint8_t hash[32], uint32_t batch_id);
+int gw_batch_index_set_status(gw_batch_index_t *idx, uint32_t batch_id, gw_batch_status_t status);
+
+const char *gw_batch_status_name(gw_batch_status_t status);
+size_t gw_batch_index_file_size(const gw_batch_index_t *idx);
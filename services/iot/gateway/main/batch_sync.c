@@ -0,0 +1,451 @@
+#include "batch_sync.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gw_log.h"
+#include "keccak.h"
+
+static const char *TAG = "INDEX_SYNC";
+
+#define CODE_FETCH_BATCH    64
+
+enum {
+    EV_HARVESTED,
+    EV_SPLIT,
+    EV_TRANSFORMED,
+    EV_MERGED,
+    EV_TRANSFER_INITIATED,
+    EV_RECEIVED,
+    EV_CONSUMED,
+    EV_COUNT,
+};
+
+static const char *const EVENT_SIGNATURES[EV_COUNT] = {
+    [EV_HARVESTED] = "BatchHarvested(uint256,address,uint256,string,uint256)",
+    [EV_SPLIT] = "BatchSplit(uint256,uint256[],address,uint256)",
+    [EV_TRANSFORMED] = "BatchTransformed(uint256[],uint256,string,address,uint256)",
+    [EV_MERGED] = "BatchMerged(uint256[],uint256,address,uint256)",
+    [EV_TRANSFER_INITIATED] = "BatchTransferInitiated(uint256,address,address,uint256)",
+    [EV_RECEIVED] = "BatchReceived(uint256,address,uint256)",
+    [EV_CONSUMED] = "BatchConsumed(uint256,address,uint256)",
+};
+
+typedef struct {
+    uint32_t *ids;
+    size_t count;
+    size_t capacity;
+} id_list_t;
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decodes "0x..." text into a malloc'd buffer.
+static uint8_t *hex_decode_text(const char *str, size_t str_len, size_t *len_out)
+{
+    if (str_len < 2 || str[0] != '0' || str[1] != 'x' || str_len % 2 != 0) return NULL;
+    size_t len = (str_len - 2) / 2;
+    uint8_t *out = malloc(len ? len : 1);
+    if (!out) return NULL;
+    for (size_t i = 0; i < len; i++) {
+        int hi = hex_nibble(str[2 + 2 * i]), lo = hex_nibble(str[3 + 2 * i]);
+        if (hi < 0 || lo < 0) {
+            free(out);
+            return NULL;
+        }
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    *len_out = len;
+    return out;
+}
+
+static uint8_t *hex_decode(const gw_json_t *v, size_t *len_out)
+{
+    if (!v || v->type != GW_JSON_STRING) return NULL;
+    return hex_decode_text(v->str, v->len, len_out);
+}
+
+static int hex_word(const gw_json_t *v, uint8_t word[32])
+{
+    size_t len;
+    uint8_t *bytes = hex_decode(v, &len);
+    if (!bytes) return -1;
+    int rc = len == 32 ? 0 : -1;
+    if (rc == 0) memcpy(word, bytes, 32);
+    free(bytes);
+    return rc;
+}
+
+static void hex_encode(const uint8_t *in, size_t len, char *out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = digits[in[i] >> 4];
+        out[2 * i + 1] = digits[in[i] & 0xF];
+    }
+    out[2 * len] = '\0';
+}
+
+// ABI uint256 that must fit a batch id.
+static int word_u32(const uint8_t *word, uint32_t *out)
+{
+    for (int i = 0; i < 28; i++) {
+        if (word[i]) return -1;
+    }
+    *out = (uint32_t)word[28] << 24 | (uint32_t)word[29] << 16 | (uint32_t)word[30] << 8 | word[31];
+    return 0;
+}
+
+static const uint8_t *word_at(const uint8_t *data, size_t len, size_t offset)
+{
+    return offset <= len && len - offset >= 32 ? data + offset : NULL;
+}
+
+// Dynamic bytes/string whose head word sits at head_offset.
+static int abi_bytes(const uint8_t *data, size_t len, size_t head_offset, const uint8_t **out, size_t *out_len)
+{
+    uint32_t offset, n;
+    const uint8_t *w = word_at(data, len, head_offset);
+    if (!w || word_u32(w, &offset) != 0) return -1;
+    if (!(w = word_at(data, len, offset)) || word_u32(w, &n) != 0) return -1;
+    if ((size_t)offset + 32 + n > len) return -1;
+    *out = data + offset + 32;
+    *out_len = n;
+    return 0;
+}
+
+static int id_list_push(id_list_t *l, uint32_t id)
+{
+    if (l->count == l->capacity) {
+        size_t capacity = l->capacity ? l->capacity * 2 : 64;
+        uint32_t *ids = realloc(l->ids, capacity * sizeof(*ids));
+        if (!ids) return -1;
+        l->ids = ids;
+        l->capacity = capacity;
+    }
+    l->ids[l->count++] = id;
+    return 0;
+}
+
+static int create_batch(gw_batch_syncer_t *s, uint32_t id, const uint8_t handler[20])
+{
+    s->stats.batches++;
+    return gw_batch_index_put_batch(s->index, id, GW_BATCH_ACTIVE, handler);
+}
+
+static int apply_log(gw_batch_syncer_t *s, const gw_json_t *log, id_list_t *derived)
+{
+    if (gw_json_get(log, "removed") && gw_json_get(log, "removed")->boolean) return 0;
+
+    const gw_json_t *topics_json = gw_json_get(log, "topics");
+    uint8_t topics[3][32] = { { 0 } };
+    size_t topic_count = gw_json_count(topics_json);
+    if (topic_count == 0) return -1;
+    for (size_t i = 0; i < topic_count && i < 3; i++) {
+        if (hex_word(gw_json_at(topics_json, i), topics[i]) != 0) return -1;
+    }
+
+    int ev = 0;
+    while (ev < EV_COUNT && memcmp(topics[0], s->topics[ev], 32) != 0) ev++;
+    if (ev == EV_COUNT) return 0;
+    if (topic_count < 2) return -1;
+
+    uint32_t id;
+    if (word_u32(topics[1], &id) != 0) return -1;
+    const uint8_t *address = topics[2] + 12;    // creator, handler or receiver
+    s->stats.logs++;
+
+    switch (ev) {
+    case EV_HARVESTED: {
+        size_t len;
+        uint8_t *data = hex_decode(gw_json_get(log, "data"), &len);
+        const uint8_t *code;
+        size_t code_len;
+        // (quantity, trackingCode, timestamp)
+        int rc = data && abi_bytes(data, len, 32, &code, &code_len) == 0 ? 0 : -1;
+        if (rc == 0) rc = create_batch(s, id, address);
+        if (rc == 0 && code_len > 0) {
+            uint8_t hash[32];
+            gw_keccak256(code, code_len, hash);
+            rc = gw_batch_index_put_code(s->index, hash, id);
+        }
+        free(data);
+        return rc;
+    }
+    case EV_SPLIT: {
+        size_t len;
+        uint8_t *data = hex_decode(gw_json_get(log, "data"), &len);
+        // (childIds[], timestamp)
+        uint32_t offset, n;
+        const uint8_t *w;
+        int rc = data && (w = word_at(data, len, 0)) && word_u32(w, &offset) == 0 &&
+                         (w = word_at(data, len, offset)) && word_u32(w, &n) == 0 ? 0 : -1;
+        for (uint32_t i = 0; rc == 0 && i < n; i++) {
+            uint32_t child;
+            w = word_at(data, len, (size_t)offset + 32 + 32 * (size_t)i);
+            rc = w && word_u32(w, &child) == 0 ? 0 : -1;
+            if (rc == 0) rc = create_batch(s, child, address);
+            if (rc == 0) rc = id_list_push(derived, child);
+        }
+        free(data);
+        return rc;
+    }
+    case EV_TRANSFORMED:
+    case EV_MERGED:
+        if (create_batch(s, id, address) != 0) return -1;
+        return id_list_push(derived, id);
+    case EV_TRANSFER_INITIATED: {
+        gw_batch_info_t info;
+        if (gw_batch_index_get(s->index, id, &info) == GW_INDEX_FOUND && info.status == GW_BATCH_CONSUMED) return 0;
+        return gw_batch_index_set_status(s->index, id, GW_BATCH_IN_TRANSIT);
+    }
+    case EV_RECEIVED: {
+        // initiateTransfer does not check status, so a consumed batch can move.
+        gw_batch_info_t info;
+        bool consumed = gw_batch_index_get(s->index, id, &info) == GW_INDEX_FOUND && info.status == GW_BATCH_CONSUMED;
+        return gw_batch_index_put_batch(s->index, id, consumed ? GW_BATCH_CONSUMED : GW_BATCH_ACTIVE, address);
+    }
+    case EV_CONSUMED:
+        return gw_batch_index_set_status(s->index, id, GW_BATCH_CONSUMED);
+    }
+    return 0;
+}
+
+// Reads trackingCode back from the batches(id) getter, CODE_FETCH_BATCH calls
+// per request.
+static int fetch_codes(gw_batch_syncer_t *s, const id_list_t *ids)
+{
+    for (size_t base = 0; base < ids->count; base += CODE_FETCH_BATCH) {
+        size_t count = ids->count - base < CODE_FETCH_BATCH ? ids->count - base : CODE_FETCH_BATCH;
+
+        char *body = NULL;
+        size_t body_len = 0;
+        FILE *f = open_memstream(&body, &body_len);
+        if (!f) return -1;
+        uint64_t first_id = s->rpc.next_id;
+        s->rpc.next_id += count;
+        fputc('[', f);
+        for (size_t i = 0; i < count; i++) {
+            uint8_t call[4 + 32] = { 0 };
+            char call_hex[2 * sizeof(call) + 1];
+            uint32_t id = ids->ids[base + i];
+            memcpy(call, s->batches_selector, 4);
+            call[32] = (uint8_t)(id >> 24);
+            call[33] = (uint8_t)(id >> 16);
+            call[34] = (uint8_t)(id >> 8);
+            call[35] = (uint8_t)id;
+            hex_encode(call, sizeof(call), call_hex);
+            fprintf(f, "%s{\"jsonrpc\":\"2.0\",\"id\":%llu,\"method\":\"eth_call\",\"params\":[{\"to\":\"%s\",\"data\":\"0x%s\"},\"latest\"]}",
+                    i ? "," : "", (unsigned long long)(first_id + i), s->contract, call_hex);
+        }
+        fputc(']', f);
+        fclose(f);
+
+        gw_json_doc_t reply;
+        int rc = gw_rpc_post(&s->rpc, body, body_len, &reply);
+        free(body);
+        if (rc != 0) return -1;
+
+        for (const gw_json_t *c = reply.root ? reply.root->child : NULL; c && rc == 0; c = c->next) {
+            uint64_t reply_id;
+            if (gw_json_u64(gw_json_get(c, "id"), &reply_id) != 0 || reply_id < first_id || reply_id >= first_id + count) {
+                continue;
+            }
+            uint32_t batch_id = ids->ids[base + (reply_id - first_id)];
+
+            size_t len;
+            uint8_t *data = hex_decode(gw_json_get(c, "result"), &len);
+            const uint8_t *code;
+            size_t code_len;
+            // (id, creator, origin, ipfsHash, quantity, trackingCode, ...)
+            if (!data || abi_bytes(data, len, 5 * 32, &code, &code_len) != 0) {
+                char msg[256];
+                GW_LOGW(TAG, "batches(%u) failed: %s", batch_id, gw_rpc_error_message(c, msg, sizeof(msg)));
+                rc = -1;
+            } else if (code_len > 0) {
+                uint8_t hash[32];
+                gw_keccak256(code, code_len, hash);
+                rc = gw_batch_index_put_code(s->index, hash, batch_id);
+                s->stats.codes_fetched++;
+            }
+            free(data);
+        }
+        gw_json_free(&reply);
+        if (rc != 0) return -1;
+    }
+    return 0;
+}
+
+static int apply_range(gw_batch_syncer_t *s, uint64_t from, uint64_t to)
+{
+    char params[1024];
+    int n = snprintf(params, sizeof(params), "[{\"fromBlock\":\"0x%llx\",\"toBlock\":\"0x%llx\",\"address\":\"%s\",\"topics\":[[",
+                     (unsigned long long)from, (unsigned long long)to, s->contract);
+    for (int i = 0; i < EV_COUNT; i++) {
+        char topic[65];
+        hex_encode(s->topics[i], 32, topic);
+        n += snprintf(params + n, sizeof(params) - (size_t)n, "%s\"0x%s\"", i ? "," : "", topic);
+    }
+    snprintf(params + n, sizeof(params) - (size_t)n, "]]}]");
+
+    gw_json_doc_t reply;
+    const gw_json_t *logs;
+    if (gw_rpc_call(&s->rpc, "eth_getLogs", params, &reply, &logs) != 0) return -1;
+
+    id_list_t derived = { 0 };
+    int rc = 0;
+    for (const gw_json_t *log = logs->child; log && rc == 0; log = log->next) {
+        rc = apply_log(s, log, &derived);
+        if (rc != 0) GW_LOGE(TAG, "Malformed event in blocks %llu-%llu", (unsigned long long)from, (unsigned long long)to);
+    }
+    gw_json_free(&reply);
+
+    if (rc == 0) rc = fetch_codes(s, &derived);
+    free(derived.ids);
+    return rc;
+}
+
+int gw_batch_sync_init(gw_batch_syncer_t *s, gw_batch_index_t *index, const gw_batch_sync_config_t *cfg)
+{
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    s->index = index;
+    if (s->cfg.max_block_range == 0) s->cfg.max_block_range = 2000;
+
+    for (int i = 0; i < EV_COUNT; i++) {
+        gw_keccak256(EVENT_SIGNATURES[i], strlen(EVENT_SIGNATURES[i]), s->topics[i]);
+    }
+    uint8_t digest[32];
+    gw_keccak256("batches(uint256)", strlen("batches(uint256)"), digest);
+    memcpy(s->batches_selector, digest, 4);
+
+    return gw_rpc_open(&s->rpc, cfg->rpc_url);
+}
+
+// Resolves the chain and contract on the first run that reaches the node.
+static int bind_chain(gw_batch_syncer_t *s)
+{
+    gw_json_doc_t reply;
+    const gw_json_t *result;
+    if (gw_rpc_call(&s->rpc, "eth_chainId", "[]", &reply, &result) != 0) return -1;
+    int rc = gw_json_u64(result, &s->chain_id);
+    gw_json_free(&reply);
+    if (rc != 0) return -1;
+
+    if (s->cfg.contract) {
+        snprintf(s->contract, sizeof(s->contract), "%s", s->cfg.contract);
+    } else if (gw_rpc_registry_address(s->cfg.registry_path, s->cfg.contract_key, s->chain_id, s->contract,
+                                       sizeof(s->contract)) != 0) {
+        return -1;
+    }
+
+    size_t len;
+    uint8_t *contract = hex_decode_text(s->contract, strlen(s->contract), &len);
+    rc = contract && len == 20 ? gw_batch_index_bind(s->index, s->chain_id, contract) : -1;
+    free(contract);
+    if (rc != 0) {
+        // Another chain's index, or a bad address: retrying will not help.
+        s->unusable = true;
+        return -1;
+    }
+
+    s->bound = true;
+    GW_LOGI(TAG, "Chain %llu, ChainProof at %s, index at block %llu", (unsigned long long)s->chain_id, s->contract,
+            (unsigned long long)s->index->header->next_block);
+    return 0;
+}
+
+void gw_batch_sync_destroy(gw_batch_syncer_t *s)
+{
+    gw_rpc_close(&s->rpc);
+}
+
+int gw_batch_sync_run(gw_batch_syncer_t *s)
+{
+    if (!s->bound && (s->unusable || bind_chain(s) != 0)) return -1;
+
+    gw_json_doc_t reply;
+    const gw_json_t *result;
+    uint64_t head;
+    if (gw_rpc_call(&s->rpc, "eth_blockNumber", "[]", &reply, &result) != 0) return -1;
+    int rc = gw_json_u64(result, &head);
+    gw_json_free(&reply);
+    if (rc != 0 || head < s->cfg.confirmations) return rc;
+
+    uint64_t target = head - s->cfg.confirmations;
+    uint64_t from = s->index->header->next_block;
+    if (from < s->cfg.from_block) from = s->cfg.from_block;
+    uint64_t range = s->cfg.max_block_range;
+
+    while (from <= target) {
+        if (s->stop && atomic_load(s->stop)) return -1;
+
+        uint64_t to = from + range - 1 < target ? from + range - 1 : target;
+        if (apply_range(s, from, to) != 0) {
+            // Nodes cap the log count or response size per call; a partly
+            // applied range is replayed, which the index tolerates.
+            if (range > 1) {
+                range /= 2;
+                continue;
+            }
+            return -1;
+        }
+        if (gw_batch_index_commit(s->index, to + 1) != 0) {
+            GW_LOGE(TAG, "Cannot flush the index");
+            return -1;
+        }
+        s->stats.ranges++;
+        s->stats.head = to;
+        from = to + 1;
+        if (range < s->cfg.max_block_range) range *= 2;
+    }
+    return 0;
+}
+
+static void *sync_thread(void *arg)
+{
+    gw_batch_syncer_t *s = arg;
+    while (!atomic_load(s->stop)) {
+        uint64_t logs = s->stats.logs;
+        int rc = gw_batch_sync_run(s);
+        if (rc != 0 && s->unusable) {
+            GW_LOGE(TAG, "Sync stopped");
+            break;
+        } else if (rc != 0 && !atomic_load(s->stop)) {
+            s->stats.errors++;
+            GW_LOGW(TAG, "Sync failed; serving lookups from block %llu",
+                    (unsigned long long)s->index->header->next_block);
+        } else if (s->stats.logs != logs) {
+            GW_LOGI(TAG, "Applied %llu events up to block %llu (%llu batches, %llu codes read back)",
+                    (unsigned long long)(s->stats.logs - logs), (unsigned long long)s->stats.head,
+                    (unsigned long long)s->stats.batches, (unsigned long long)s->stats.codes_fetched);
+        }
+
+        for (uint32_t i = 0; i < s->cfg.interval_s * 10 && !atomic_load(s->stop); i++) {
+            struct timespec ts = { .tv_sec = 0, .tv_nsec = 100000000L };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+int gw_batch_sync_start(gw_batch_syncer_t *s, atomic_bool *stop)
+{
+    s->stop = stop;
+    if (pthread_create(&s->thread, NULL, sync_thread, s) != 0) return -1;
+    s->thread_started = true;
+    return 0;
+}
+
+void gw_batch_sync_join(gw_batch_syncer_t *s)
+{
+    if (s->thread_started) pthread_join(s->thread, NULL);
+    s->thread_started = false;
+}
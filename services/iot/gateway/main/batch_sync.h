@@ -0,0 +1,69 @@
+#pragma once
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "batch_index.h"
+#include "rpc.h"
+
+// Default depth the sync stays behind head. The index has no undo log, so a
+// reorg deeper than this leaves events from the abandoned blocks applied;
+// rebuild the index if one happens. Automining dev nodes can use 0.
+#define GW_BATCH_SYNC_CONFIRMATIONS 12
+
+// Keeps a batch index current from ChainProof events. BatchHarvested carries
+// the tracking code; batches created by splitBatch, mergeBatches and
+// transformBatches do not, so their codes are read back with batches(id) in
+// one JSON-RPC batch per block range.
+typedef struct {
+    const char *rpc_url;
+    const char *contract;           // ChainProof address; resolved from registry when NULL
+    const char *registry_path;
+    const char *contract_key;
+    uint64_t from_block;            // where an empty index starts, e.g. the deploy block
+    uint32_t confirmations;         // stay this many blocks behind head to avoid reorgs
+    uint32_t max_block_range;       // blocks per eth_getLogs, halved when the node refuses
+    uint32_t interval_s;            // background sync period
+} gw_batch_sync_config_t;
+
+typedef struct {
+    uint64_t logs;
+    uint64_t batches;               // created by harvest, split, merge or transform
+    uint64_t codes_fetched;         // tracking codes read back for derived batches
+    uint64_t ranges;
+    uint64_t errors;
+    uint64_t head;                  // last block applied
+} gw_batch_sync_stats_t;
+
+typedef struct {
+    gw_batch_sync_config_t cfg;
+    gw_batch_index_t *index;
+    gw_rpc_t rpc;
+    uint64_t chain_id;
+    char contract[43];
+    uint8_t topics[7][32];
+    uint8_t batches_selector[4];
+    gw_batch_sync_stats_t stats;
+    bool bound;                     // chain id and contract resolved and checked against the index
+    atomic_bool unusable;           // index belongs to another chain or contract
+
+    pthread_t thread;
+    bool thread_started;
+    atomic_bool *stop;
+} gw_batch_syncer_t;
+
+// Does not contact the node: the chain and contract are resolved and bound to
+// the index on the first run that reaches it.
+int gw_batch_sync_init(gw_batch_syncer_t *s, gw_batch_index_t *index, const gw_batch_sync_config_t *cfg);
+void gw_batch_sync_destroy(gw_batch_syncer_t *s);
+
+// Applies every event up to the confirmed head. Returns 0 when caught up.
+int gw_batch_sync_run(gw_batch_syncer_t *s);
+
+// Re-runs the sync every cfg.interval_s seconds until *stop is set. A failed
+// run (node unreachable) is logged and retried; lookups keep answering from
+// what was applied so far. An index bound to another chain or contract stops
+// the thread.
+int gw_batch_sync_start(gw_batch_syncer_t *s, atomic_bool *stop);
+void gw_batch_sync_join(gw_batch_syncer_t *s);
@@ -0,0 +1,73 @@
+#include "dedupe.h"
+
+#include <stdlib.h>
+
+#include "hash.h"
+
+int gw_dedupe_init(gw_dedupe_t *d, size_t expected_devices)
+{
+    d->capacity = gw_hash_capacity_for(expected_devices);
+    d->count = 0;
+    d->slots = calloc(d->capacity, sizeof(*d->slots));
+    return d->slots ? 0 : -1;
+}
+
+void gw_dedupe_destroy(gw_dedupe_t *d)
+{
+    free(d->slots);
+    d->slots = NULL;
+}
+
+static gw_dedupe_entry_t *find_slot(gw_dedupe_entry_t *slots, size_t capacity, uint64_t device)
+{
+    size_t mask = capacity - 1;
+    size_t i = (size_t)gw_hash_u64(device) & mask;
+    while (slots[i].used && slots[i].device != device) i = (i + 1) & mask;
+    return &slots[i];
+}
+
+static int grow(gw_dedupe_t *d)
+{
+    size_t capacity = d->capacity * 2;
+    gw_dedupe_entry_t *slots = calloc(capacity, sizeof(*slots));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < d->capacity; i++) {
+        if (d->slots[i].used) *find_slot(slots, capacity, d->slots[i].device) = d->slots[i];
+    }
+    free(d->slots);
+    d->slots = slots;
+    d->capacity = capacity;
+    return 0;
+}
+
+bool gw_dedupe_accept(gw_dedupe_t *d, uint64_t device, uint32_t seq)
+{
+    if ((d->count + 1) * 10 > d->capacity * 7 && grow(d) != 0) return true;
+
+    gw_dedupe_entry_t *e = find_slot(d->slots, d->capacity, device);
+    if (!e->used) {
+        e->used = true;
+        e->device = device;
+        e->top = seq;
+        e->seen = 1;
+        d->count++;
+        return true;
+    }
+
+    if (seq > e->top) {
+        uint32_t shift = seq - e->top;
+        e->seen = shift >= GW_DEDUPE_WINDOW ? 0 : e->seen << shift;
+        e->seen |= 1;
+        e->top = seq;
+        return true;
+    }
+
+    uint32_t behind = e->top - seq;
+    if (behind >= GW_DEDUPE_WINDOW) return false;
+
+    uint64_t bit = 1ull << behind;
+    if (e->seen & bit) return false;
+    e->seen |= bit;
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-device replay window: remembers the highest sequence seen and a bitmap
+// of the 64 sequences below it, so reordering between decode workers or a
+// second gateway re-forwarding the same notification is caught.
+#define GW_DEDUPE_WINDOW 64
+
+typedef struct {
+    uint64_t device;
+    uint32_t top;
+    uint64_t seen;
+    bool used;
+} gw_dedupe_entry_t;
+
+typedef struct {
+    gw_dedupe_entry_t *slots;
+    size_t capacity;
+    size_t count;
+} gw_dedupe_t;
+
+int gw_dedupe_init(gw_dedupe_t *d, size_t expected_devices);
+void gw_dedupe_destroy(gw_dedupe_t *d);
+
+// True when (device, seq) has not been seen before and is inside the window.
+bool gw_dedupe_accept(gw_dedupe_t *d, uint64_t device, uint32_t seq);
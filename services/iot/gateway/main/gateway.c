@@ -0,0 +1,341 @@
+#include <getopt.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch_sync.h"
+#include "gw_log.h"
+#include "gw_time.h"
+#include "pipeline.h"
+#include "source.h"
+
+static const char *TAG = "GATEWAY";
+
+#define DEFAULT_SOCKET_PATH     "/tmp/chainproof-gateway.sock"
+#define DEFAULT_REGISTRY_PATH   "../../smart-contracts/config/contracts.json"
+#define DEFAULT_CONTRACT_KEY    "chainproof"
+#define MAX_BLE_TAGS            64
+
+static atomic_bool s_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    atomic_store(&s_stop, true);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "\n"
+            "Sources (at least one):\n"
+            "  --socket PATH           UNIX datagram socket for simulator frames (default " DEFAULT_SOCKET_PATH ")\n"
+            "  --no-socket             do not open the UNIX socket\n"
+            "  --ble ADDR              subscribe to a tag over BLE (repeatable)\n"
+            "\n"
+            "Pipeline:\n"
+            "  --decoders N            decode worker threads (default 2)\n"
+            "  --queue N               capacity of each stage queue (default 65536)\n"
+            "  --devices N             expected tag count, sizes device tables (default 1024)\n"
+            "  --window-ms N           aggregation window per tag (default 60000)\n"
+            "  --window-samples N      close a window early after N samples, 0 = never (default 0)\n"
+            "\n"
+            "Chain submission:\n"
+            "  --rpc URL               JSON-RPC endpoint; omit for a dry run that only counts windows\n"
+            "  --from ADDR             gateway account (must be unlocked on the node)\n"
+            "  --contract ADDR         ChainProof address (default: resolve from registry)\n"
+            "  --registry PATH         contract registry (default " DEFAULT_REGISTRY_PATH ")\n"
+            "  --contract-key KEY      registry key (default " DEFAULT_CONTRACT_KEY ")\n"
+            "  --batch N               transactions per JSON-RPC batch (default 32)\n"
+            "  --inflight N            max unconfirmed transactions (default 128)\n"
+            "  --receipt-poll-ms N     receipt polling interval (default 250)\n"
+            "  --tx-timeout-ms N       pending time before a transaction is rebroadcast (default 60000)\n"
+            "  --gas N                 gas limit per transaction (default 100000)\n"
+            "\n"
+            "Tracking-code index (needs --rpc):\n"
+            "  --batch-index PATH      keep a memory-mapped tracking code -> batch index here\n"
+            "  --index-batches N       initial index size in batches (default 1000000)\n"
+            "  --index-from-block N    first block to scan for a new index (default 0)\n"
+            "  --index-sync-s S        sync period in seconds (default 5)\n"
+            "  --index-confirmations N blocks to stay behind head (default 12, 0 on an automining dev node)\n"
+            "\n"
+            "Metrics:\n"
+            "  --metrics PATH          write Prometheus text metrics here every interval\n"
+            "  --metrics-interval S    reporting interval in seconds (default 5)\n"
+            "  --duration S            exit after S seconds (default: run until signalled)\n",
+            argv0);
+}
+
+typedef struct {
+    gw_batch_index_t *index;        // NULL without --batch-index
+    gw_batch_syncer_t *syncer;      // NULL when the index is read-only
+} tap_resolver_t;
+
+// Cartons with NFC inlays are harvested with the inlay UID, in uppercase hex,
+// as their tracking code, so a tap resolves like a scanned label.
+static void on_tap(void *ctx, uint64_t device, const gw_nfc_tap_t *tap)
+{
+    const tap_resolver_t *r = ctx;
+    char code[2 * GW_NFC_UID_MAX + 1];
+    for (size_t i = 0; i < tap->uid_len; i++) snprintf(code + 2 * i, 3, "%02X", tap->uid[i]);
+    code[2 * tap->uid_len] = '\0';
+
+    gw_batch_info_t info;
+    gw_index_result_t result = GW_INDEX_NOT_FOUND;
+    bool indexed = r->index && !(r->syncer && atomic_load(&r->syncer->unusable));
+    if (indexed) result = gw_batch_index_lookup(r->index, code, 2 * tap->uid_len, &info);
+
+    if (result == GW_INDEX_FOUND) {
+        char handler[41];
+        for (int i = 0; i < 20; i++) snprintf(handler + 2 * i, 3, "%02x", info.handler[i]);
+        GW_LOGI(TAG, "Tap %u on %012llx: %s is batch %u (%s, handler 0x%s)", tap->tap_seq,
+                (unsigned long long)device, code, info.batch_id, gw_batch_status_name(info.status), handler);
+    } else {
+        GW_LOGW(TAG, "Tap %u on %012llx: %s %s; resolve it with getBatchIdByTrackingCode", tap->tap_seq,
+                (unsigned long long)device, code,
+                !indexed ? "without an index" : result == GW_INDEX_AMBIGUOUS ? "is ambiguous in the index"
+                                                                             : "is not in the index");
+    }
+}
+
+static void write_metrics_file(gw_pipeline_t *p, const char *path, double interval_s)
+{
+    if (!path) {
+        gw_pipeline_report(p, NULL, interval_s);
+        return;
+    }
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    gw_pipeline_report(p, f, interval_s);
+    if (f) {
+        fclose(f);
+        rename(tmp, path);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *socket_path = DEFAULT_SOCKET_PATH;
+    const char *ble_addrs[MAX_BLE_TAGS];
+    size_t ble_count = 0;
+    const char *metrics_path = NULL;
+    double metrics_interval_s = 5.0;
+    double duration_s = 0;
+    const char *index_path = NULL;
+    size_t index_batches = 1000000;
+    gw_batch_sync_config_t index_cfg = {
+        .confirmations = GW_BATCH_SYNC_CONFIRMATIONS,
+        .max_block_range = 2000,
+        .interval_s = 5,
+    };
+
+    gw_pipeline_config_t cfg = {
+        .decode_workers = 2,
+        .queue_capacity = 65536,
+        .expected_devices = 1024,
+        .window_ms = 60000,
+        .window_max_samples = 0,
+        .submit = {
+            .rpc_url = NULL,
+            .from = NULL,
+            .contract = NULL,
+            .registry_path = DEFAULT_REGISTRY_PATH,
+            .contract_key = DEFAULT_CONTRACT_KEY,
+            .batch_size = 32,
+            .max_inflight = 128,
+            .receipt_poll_ms = 250,
+            .tx_timeout_ms = 60000,
+            .gas_limit = 100000,
+        },
+    };
+
+    enum {
+        OPT_SOCKET = 1, OPT_NO_SOCKET, OPT_BLE, OPT_DECODERS, OPT_QUEUE, OPT_DEVICES, OPT_WINDOW_MS,
+        OPT_WINDOW_SAMPLES, OPT_RPC, OPT_FROM, OPT_CONTRACT, OPT_REGISTRY, OPT_CONTRACT_KEY, OPT_BATCH,
+        OPT_INFLIGHT, OPT_RECEIPT_POLL, OPT_TX_TIMEOUT, OPT_GAS, OPT_METRICS, OPT_METRICS_INTERVAL,
+        OPT_DURATION, OPT_BATCH_INDEX, OPT_INDEX_BATCHES, OPT_INDEX_FROM_BLOCK, OPT_INDEX_SYNC,
+        OPT_INDEX_CONFIRMATIONS, OPT_HELP,
+    };
+    static const struct option options[] = {
+        { "socket", required_argument, NULL, OPT_SOCKET },
+        { "no-socket", no_argument, NULL, OPT_NO_SOCKET },
+        { "ble", required_argument, NULL, OPT_BLE },
+        { "decoders", required_argument, NULL, OPT_DECODERS },
+        { "queue", required_argument, NULL, OPT_QUEUE },
+        { "devices", required_argument, NULL, OPT_DEVICES },
+        { "window-ms", required_argument, NULL, OPT_WINDOW_MS },
+        { "window-samples", required_argument, NULL, OPT_WINDOW_SAMPLES },
+        { "rpc", required_argument, NULL, OPT_RPC },
+        { "from", required_argument, NULL, OPT_FROM },
+        { "contract", required_argument, NULL, OPT_CONTRACT },
+        { "registry", required_argument, NULL, OPT_REGISTRY },
+        { "contract-key", required_argument, NULL, OPT_CONTRACT_KEY },
+        { "batch", required_argument, NULL, OPT_BATCH },
+        { "inflight", required_argument, NULL, OPT_INFLIGHT },
+        { "receipt-poll-ms", required_argument, NULL, OPT_RECEIPT_POLL },
+        { "tx-timeout-ms", required_argument, NULL, OPT_TX_TIMEOUT },
+        { "gas", required_argument, NULL, OPT_GAS },
+        { "metrics", required_argument, NULL, OPT_METRICS },
+        { "metrics-interval", required_argument, NULL, OPT_METRICS_INTERVAL },
+        { "duration", required_argument, NULL, OPT_DURATION },
+        { "batch-index", required_argument, NULL, OPT_BATCH_INDEX },
+        { "index-batches", required_argument, NULL, OPT_INDEX_BATCHES },
+        { "index-from-block", required_argument, NULL, OPT_INDEX_FROM_BLOCK },
+        { "index-sync-s", required_argument, NULL, OPT_INDEX_SYNC },
+        { "index-confirmations", required_argument, NULL, OPT_INDEX_CONFIRMATIONS },
+        { "help", no_argument, NULL, OPT_HELP },
+        { 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case OPT_SOCKET: socket_path = optarg; break;
+        case OPT_NO_SOCKET: socket_path = NULL; break;
+        case OPT_BLE:
+            if (ble_count == MAX_BLE_TAGS) {
+                GW_LOGE(TAG, "At most %d BLE tags per gateway", MAX_BLE_TAGS);
+                return 2;
+            }
+            ble_addrs[ble_count++] = optarg;
+            break;
+        case OPT_DECODERS: cfg.decode_workers = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_QUEUE: cfg.queue_capacity = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_DEVICES: cfg.expected_devices = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_WINDOW_MS: cfg.window_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_WINDOW_SAMPLES: cfg.window_max_samples = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_RPC: cfg.submit.rpc_url = optarg; break;
+        case OPT_FROM: cfg.submit.from = optarg; break;
+        case OPT_CONTRACT: cfg.submit.contract = optarg; break;
+        case OPT_REGISTRY: cfg.submit.registry_path = optarg; break;
+        case OPT_CONTRACT_KEY: cfg.submit.contract_key = optarg; break;
+        case OPT_BATCH: cfg.submit.batch_size = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_INFLIGHT: cfg.submit.max_inflight = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_RECEIPT_POLL: cfg.submit.receipt_poll_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_TX_TIMEOUT: cfg.submit.tx_timeout_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_GAS: cfg.submit.gas_limit = strtoull(optarg, NULL, 10); break;
+        case OPT_METRICS: metrics_path = optarg; break;
+        case OPT_METRICS_INTERVAL: metrics_interval_s = strtod(optarg, NULL); break;
+        case OPT_DURATION: duration_s = strtod(optarg, NULL); break;
+        case OPT_BATCH_INDEX: index_path = optarg; break;
+        case OPT_INDEX_BATCHES: index_batches = strtoull(optarg, NULL, 10); break;
+        case OPT_INDEX_FROM_BLOCK: index_cfg.from_block = strtoull(optarg, NULL, 10); break;
+        case OPT_INDEX_SYNC: index_cfg.interval_s = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_INDEX_CONFIRMATIONS: index_cfg.confirmations = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_HELP: usage(argv[0]); return 0;
+        default: usage(argv[0]); return 2;
+        }
+    }
+
+    if (!socket_path && ble_count == 0) {
+        GW_LOGE(TAG, "No source configured");
+        usage(argv[0]);
+        return 2;
+    }
+    if (cfg.decode_workers == 0 || cfg.queue_capacity == 0 || cfg.submit.batch_size == 0 ||
+        cfg.submit.max_inflight == 0 || metrics_interval_s <= 0) {
+        GW_LOGE(TAG, "Worker, queue, batch, in-flight and interval settings must be positive");
+        return 2;
+    }
+
+    if (index_path && !cfg.submit.rpc_url) {
+        GW_LOGE(TAG, "--batch-index needs --rpc to follow ChainProof events");
+        return 2;
+    }
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    gw_pipeline_t pipeline;
+    if (gw_pipeline_start(&pipeline, &cfg) != 0) {
+        GW_LOGE(TAG, "Pipeline failed to start");
+        return 1;
+    }
+
+    // Scans resolve from the index; the sync thread only needs the node
+    // when there is something new to apply. Neither a missing node nor an
+    // index this process cannot write stops the gateway: an index that
+    // cannot be written is still opened read-only for lookups.
+    gw_batch_index_t index;
+    gw_batch_syncer_t index_syncer;
+    bool index_open = false;
+    if (index_path) {
+        index_cfg.rpc_url = cfg.submit.rpc_url;
+        index_cfg.contract = cfg.submit.contract;
+        index_cfg.registry_path = cfg.submit.registry_path;
+        index_cfg.contract_key = cfg.submit.contract_key;
+        if (gw_batch_index_open(&index, index_path, true, index_batches) == 0) {
+            index_open = true;
+            if (gw_batch_sync_init(&index_syncer, &index, &index_cfg) != 0 ||
+                gw_batch_sync_start(&index_syncer, &s_stop) != 0) {
+                GW_LOGW(TAG, "Tracking-code index at %s will not be synced", index_path);
+            }
+        } else if (gw_batch_index_open(&index, index_path, false, 0) == 0) {
+            index_open = true;
+            GW_LOGW(TAG, "Tracking-code index at %s is read-only; lookups only", index_path);
+        } else {
+            GW_LOGW(TAG, "Tracking-code index at %s is unavailable", index_path);
+        }
+    }
+
+    gw_source_t unix_source = { .fd = -1 };
+    gw_source_t ble_source = { .fd = -1 };
+    if (socket_path && gw_source_unix_start(&unix_source, socket_path, &pipeline.raw, &s_stop) != 0) {
+        atomic_store(&s_stop, true);
+    }
+    tap_resolver_t taps = {
+        .index = index_open ? &index : NULL,
+        .syncer = index_open && index.writable ? &index_syncer : NULL,
+    };
+    if (ble_count > 0 &&
+        gw_source_ble_start(&ble_source, ble_addrs, ble_count, &pipeline.raw, on_tap, &taps, &s_stop) != 0) {
+        atomic_store(&s_stop, true);
+    }
+
+    uint64_t started = gw_now_ns();
+    uint64_t last_report = started;
+    while (!atomic_load(&s_stop)) {
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = 100000000L };
+        nanosleep(&ts, NULL);
+
+        uint64_t now = gw_now_ns();
+        if ((now - last_report) / 1e9 >= metrics_interval_s) {
+            write_metrics_file(&pipeline, metrics_path, (now - last_report) / 1e9);
+            last_report = now;
+        }
+        if (duration_s > 0 && (now - started) / 1e9 >= duration_s) atomic_store(&s_stop, true);
+    }
+
+    GW_LOGI(TAG, "Stopping: draining pipeline");
+    gw_source_join(&unix_source);
+    gw_source_join(&ble_source);
+    gw_pipeline_stop(&pipeline);
+    if (index_open) {
+        if (index.writable) {
+            gw_batch_sync_join(&index_syncer);
+            gw_batch_sync_destroy(&index_syncer);
+        }
+        gw_batch_index_close(&index);
+    }
+
+    uint64_t now = gw_now_ns();
+    write_metrics_file(&pipeline, metrics_path, (now - last_report) / 1e9);
+
+    gw_submit_stats_t tx = pipeline.submit_snapshot;
+    double elapsed_s = (now - started) / 1e9;
+    GW_LOGI(TAG, "Done in %.1f s: %llu readings decoded, %llu duplicates, %llu windows, %llu confirmed",
+            elapsed_s, (unsigned long long)atomic_load(&pipeline.decode.processed),
+            (unsigned long long)atomic_load(&pipeline.dedupe.filtered),
+            (unsigned long long)atomic_load(&pipeline.submit.processed), (unsigned long long)tx.confirmed);
+    gw_pipeline_destroy(&pipeline);
+    return 0;
+}
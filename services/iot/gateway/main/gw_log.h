@@ -0,0 +1,9 @@
+#pragma once
+#include <stdio.h>
+
+#define GW_LOG(level, tag, fmt, ...) \
+    fprintf(stderr, "%s (%s) " fmt "\n", (level), (tag), ##__VA_ARGS__)
+
+#define GW_LOGE(tag, fmt, ...) GW_LOG("E", tag, fmt, ##__VA_ARGS__)
+#define GW_LOGW(tag, fmt, ...) GW_LOG("W", tag, fmt, ##__VA_ARGS__)
+#define GW_LOGI(tag, fmt, ...) GW_LOG("I", tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t gw_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t gw_now_ms(void)
+{
+    return gw_now_ns() / 1000000ull;
+}
+
+// Wall clock, for stamping time-sync reads; may step when NTP adjusts it.
+static inline uint64_t gw_unix_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+}
+
+// Wall time of an earlier gw_now_ns() reading, using the current offset
+// between the two clocks.
+static inline uint64_t gw_mono_to_unix_ms(uint64_t mono_ns)
+{
+    uint64_t now_ns = gw_now_ns();
+    uint64_t now_unix_us = gw_unix_us();
+    uint64_t ago_us = now_ns > mono_ns ? (now_ns - mono_ns) / 1000ull : 0;
+    return (now_unix_us - ago_us) / 1000ull;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// splitmix64 finalizer; device addresses are sequential in simulation and
+// clustered by vendor prefix on real hardware, so they need mixing.
+static inline uint64_t gw_hash_u64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// Power-of-two capacity that keeps n entries under 70% load.
+static inline size_t gw_hash_capacity_for(size_t n)
+{
+    size_t capacity = 64;
+    while (capacity * 7 < n * 10) capacity <<= 1;
+    return capacity;
+}
@@ -0,0 +1,226 @@
+#include "json.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *p;
+    const char *end;
+    int depth;
+} parser_t;
+
+#define JSON_MAX_DEPTH 32
+
+static void free_node(gw_json_t *n)
+{
+    while (n) {
+        gw_json_t *next = n->next;
+        free_node(n->child);
+        free(n);
+        n = next;
+    }
+}
+
+static void skip_ws(parser_t *ps)
+{
+    while (ps->p < ps->end && isspace((unsigned char)*ps->p)) ps->p++;
+}
+
+static int parse_string_raw(parser_t *ps, const char **out, size_t *out_len)
+{
+    if (ps->p >= ps->end || *ps->p != '"') return -1;
+    const char *start = ++ps->p;
+    while (ps->p < ps->end && *ps->p != '"') {
+        if (*ps->p == '\\') ps->p++;
+        ps->p++;
+    }
+    if (ps->p >= ps->end) return -1;
+    *out = start;
+    *out_len = (size_t)(ps->p - start);
+    ps->p++;
+    return 0;
+}
+
+static gw_json_t *parse_value(parser_t *ps);
+
+static gw_json_t *parse_container(parser_t *ps, gw_json_t *n, char close, bool object)
+{
+    ps->p++;
+    if (++ps->depth > JSON_MAX_DEPTH) return NULL;
+
+    gw_json_t **tail = &n->child;
+    skip_ws(ps);
+    if (ps->p < ps->end && *ps->p == close) {
+        ps->p++;
+        ps->depth--;
+        return n;
+    }
+
+    while (ps->p < ps->end) {
+        const char *key = NULL;
+        size_t key_len = 0;
+        if (object) {
+            skip_ws(ps);
+            if (parse_string_raw(ps, &key, &key_len) != 0) return NULL;
+            skip_ws(ps);
+            if (ps->p >= ps->end || *ps->p != ':') return NULL;
+            ps->p++;
+        }
+
+        gw_json_t *child = parse_value(ps);
+        if (!child) return NULL;
+        child->key = key;
+        child->key_len = key_len;
+        *tail = child;
+        tail = &child->next;
+
+        skip_ws(ps);
+        if (ps->p >= ps->end) return NULL;
+        if (*ps->p == ',') {
+            ps->p++;
+            continue;
+        }
+        if (*ps->p == close) {
+            ps->p++;
+            ps->depth--;
+            return n;
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+static gw_json_t *parse_value(parser_t *ps)
+{
+    skip_ws(ps);
+    if (ps->p >= ps->end) return NULL;
+
+    gw_json_t *n = calloc(1, sizeof(*n));
+    if (!n) return NULL;
+
+    char c = *ps->p;
+    gw_json_t *ok = n;
+    if (c == '{') {
+        n->type = GW_JSON_OBJECT;
+        ok = parse_container(ps, n, '}', true);
+    } else if (c == '[') {
+        n->type = GW_JSON_ARRAY;
+        ok = parse_container(ps, n, ']', false);
+    } else if (c == '"') {
+        n->type = GW_JSON_STRING;
+        if (parse_string_raw(ps, &n->str, &n->len) != 0) ok = NULL;
+    } else if (c == 't' && ps->end - ps->p >= 4 && memcmp(ps->p, "true", 4) == 0) {
+        n->type = GW_JSON_BOOL;
+        n->boolean = true;
+        ps->p += 4;
+    } else if (c == 'f' && ps->end - ps->p >= 5 && memcmp(ps->p, "false", 5) == 0) {
+        n->type = GW_JSON_BOOL;
+        ps->p += 5;
+    } else if (c == 'n' && ps->end - ps->p >= 4 && memcmp(ps->p, "null", 4) == 0) {
+        n->type = GW_JSON_NULL;
+        ps->p += 4;
+    } else if (c == '-' || isdigit((unsigned char)c)) {
+        n->type = GW_JSON_NUMBER;
+        n->str = ps->p;
+        while (ps->p < ps->end && strchr("+-.eE0123456789", *ps->p)) ps->p++;
+        n->len = (size_t)(ps->p - n->str);
+    } else {
+        ok = NULL;
+    }
+
+    if (!ok) {
+        free_node(n);
+        return NULL;
+    }
+    return n;
+}
+
+int gw_json_parse(gw_json_doc_t *doc, char *text, size_t len)
+{
+    parser_t ps = { .p = text, .end = text + len, .depth = 0 };
+    doc->text = text;
+    doc->root = parse_value(&ps);
+    return doc->root ? 0 : -1;
+}
+
+void gw_json_free(gw_json_doc_t *doc)
+{
+    free_node(doc->root);
+    free(doc->text);
+    doc->root = NULL;
+    doc->text = NULL;
+}
+
+const gw_json_t *gw_json_get(const gw_json_t *obj, const char *key)
+{
+    if (!obj || obj->type != GW_JSON_OBJECT) return NULL;
+    size_t key_len = strlen(key);
+    for (const gw_json_t *c = obj->child; c; c = c->next) {
+        if (c->key_len == key_len && memcmp(c->key, key, key_len) == 0) return c;
+    }
+    return NULL;
+}
+
+const gw_json_t *gw_json_at(const gw_json_t *arr, size_t index)
+{
+    if (!arr || arr->type != GW_JSON_ARRAY) return NULL;
+    const gw_json_t *c = arr->child;
+    while (c && index--) c = c->next;
+    return c;
+}
+
+size_t gw_json_count(const gw_json_t *arr)
+{
+    size_t n = 0;
+    if (!arr) return 0;
+    for (const gw_json_t *c = arr->child; c; c = c->next) n++;
+    return n;
+}
+
+bool gw_json_str_eq(const gw_json_t *v, const char *s)
+{
+    size_t len = strlen(s);
+    return v && v->type == GW_JSON_STRING && v->len == len && memcmp(v->str, s, len) == 0;
+}
+
+int gw_json_copy_str(const gw_json_t *v, char *out, size_t out_len)
+{
+    if (!v || v->type != GW_JSON_STRING || v->len + 1 > out_len) return -1;
+    memcpy(out, v->str, v->len);
+    out[v->len] = '\0';
+    return 0;
+}
+
+int gw_json_u64(const gw_json_t *v, uint64_t *out)
+{
+    if (!v) return -1;
+
+    if (v->type == GW_JSON_NUMBER) {
+        uint64_t n = 0;
+        for (size_t i = 0; i < v->len; i++) {
+            if (!isdigit((unsigned char)v->str[i])) return -1;
+            n = n * 10 + (uint64_t)(v->str[i] - '0');
+        }
+        *out = n;
+        return 0;
+    }
+
+    if (v->type != GW_JSON_STRING || v->len < 3 || v->str[0] != '0' || (v->str[1] != 'x' && v->str[1] != 'X')) {
+        return -1;
+    }
+    if (v->len - 2 > 16) return -1;
+
+    uint64_t n = 0;
+    for (size_t i = 2; i < v->len; i++) {
+        char c = v->str[i];
+        int d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        else return -1;
+        n = (n << 4) | (uint64_t)d;
+    }
+    *out = n;
+    return 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Just enough JSON for JSON-RPC responses and the contract registry.
+// Strings are not unescaped; they point into the document text.
+typedef enum {
+    GW_JSON_NULL,
+    GW_JSON_BOOL,
+    GW_JSON_NUMBER,
+    GW_JSON_STRING,
+    GW_JSON_ARRAY,
+    GW_JSON_OBJECT,
+} gw_json_type_t;
+
+typedef struct gw_json {
+    gw_json_type_t type;
+    const char *key;        // member name when the parent is an object
+    size_t key_len;
+    const char *str;        // string contents, or the raw number text
+    size_t len;
+    bool boolean;
+    struct gw_json *child;
+    struct gw_json *next;
+} gw_json_t;
+
+typedef struct {
+    char *text;
+    gw_json_t *root;
+} gw_json_doc_t;
+
+// Takes ownership of text (malloc'd). Returns 0 on success.
+int gw_json_parse(gw_json_doc_t *doc, char *text, size_t len);
+void gw_json_free(gw_json_doc_t *doc);
+
+const gw_json_t *gw_json_get(const gw_json_t *obj, const char *key);
+const gw_json_t *gw_json_at(const gw_json_t *arr, size_t index);
+size_t gw_json_count(const gw_json_t *arr);
+bool gw_json_str_eq(const gw_json_t *v, const char *s);
+
+// Copies a string value into out (NUL-terminated). Returns -1 if it does not fit.
+int gw_json_copy_str(const gw_json_t *v, char *out, size_t out_len);
+
+// Parses a "0x..." quantity string or a plain JSON number.
+int gw_json_u64(const gw_json_t *v, uint64_t *out);
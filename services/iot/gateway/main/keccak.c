@@ -0,0 +1,96 @@
+#include "keccak.h"
+
+#include <string.h>
+
+#define KECCAK_ROUNDS 24
+#define KECCAK256_RATE 136
+
+static const uint64_t s_round_constants[KECCAK_ROUNDS] = {
+    0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808Aull, 0x8000000080008000ull,
+    0x000000000000808Bull, 0x0000000080000001ull, 0x8000000080008081ull, 0x8000000000008009ull,
+    0x000000000000008Aull, 0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000Aull,
+    0x000000008000808Bull, 0x800000000000008Bull, 0x8000000000008089ull, 0x8000000000008003ull,
+    0x8000000000008002ull, 0x8000000000000080ull, 0x000000000000800Aull, 0x800000008000000Aull,
+    0x8000000080008081ull, 0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull,
+};
+
+static const unsigned s_rotations[24] = {
+    1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44,
+};
+
+static const unsigned s_lanes[24] = {
+    10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1,
+};
+
+static inline uint64_t rotl64(uint64_t x, unsigned n)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+static void keccak_f1600(uint64_t st[25])
+{
+    uint64_t bc[5];
+
+    for (int round = 0; round < KECCAK_ROUNDS; round++) {
+        // Theta
+        for (int i = 0; i < 5; i++) {
+            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+        }
+        for (int i = 0; i < 5; i++) {
+            uint64_t t = bc[(i + 4) % 5] ^ rotl64(bc[(i + 1) % 5], 1);
+            for (int j = 0; j < 25; j += 5) st[j + i] ^= t;
+        }
+
+        // Rho + Pi
+        uint64_t t = st[1];
+        for (int i = 0; i < 24; i++) {
+            unsigned j = s_lanes[i];
+            uint64_t tmp = st[j];
+            st[j] = rotl64(t, s_rotations[i]);
+            t = tmp;
+        }
+
+        // Chi
+        for (int j = 0; j < 25; j += 5) {
+            for (int i = 0; i < 5; i++) bc[i] = st[j + i];
+            for (int i = 0; i < 5; i++) st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+        }
+
+        // Iota
+        st[0] ^= s_round_constants[round];
+    }
+}
+
+static uint64_t load64_le(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+void gw_keccak256(const void *data, size_t len, uint8_t out[32])
+{
+    uint64_t st[25];
+    uint8_t block[KECCAK256_RATE];
+    const uint8_t *in = data;
+
+    memset(st, 0, sizeof(st));
+
+    while (len >= KECCAK256_RATE) {
+        for (int i = 0; i < KECCAK256_RATE / 8; i++) st[i] ^= load64_le(in + i * 8);
+        keccak_f1600(st);
+        in += KECCAK256_RATE;
+        len -= KECCAK256_RATE;
+    }
+
+    memset(block, 0, sizeof(block));
+    memcpy(block, in, len);
+    block[len] = 0x01;                       // Keccak padding (SHA3 would use 0x06)
+    block[KECCAK256_RATE - 1] |= 0x80;
+    for (int i = 0; i < KECCAK256_RATE / 8; i++) st[i] ^= load64_le(block + i * 8);
+    keccak_f1600(st);
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 8; b++) out[i * 8 + b] = (uint8_t)(st[i] >> (8 * b));
+    }
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Ethereum Keccak-256 (original padding, not FIPS SHA3-256).
+void gw_keccak256(const void *data, size_t len, uint8_t out[32]);
@@ -0,0 +1,204 @@
+#include "payload.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// DHT22 datasheet range, with a little slack for the sensor's tolerance
+#define TEMP_PLAUSIBLE_MIN_C   (-45.0f)
+#define TEMP_PLAUSIBLE_MAX_C   (85.0f)
+#define HUMI_PLAUSIBLE_MIN_PCT (0.0f)
+#define HUMI_PLAUSIBLE_MAX_PCT (100.0f)
+
+static uint32_t load32_le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t load64_le(const uint8_t *p)
+{
+    return (uint64_t)load32_le(p) | ((uint64_t)load32_le(p + 4) << 32);
+}
+
+static float load_float_le(const uint8_t *p)
+{
+    uint32_t bits = load32_le(p);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static int plausible(float v, float lo, float hi)
+{
+    return isfinite(v) && v >= lo && v <= hi;
+}
+
+static uint64_t load_device(const uint8_t *p)
+{
+    uint64_t device = 0;
+    for (int i = 0; i < 6; i++) device = (device << 8) | p[i];
+    return device;
+}
+
+static int decode_sync(const gw_raw_t *raw, gw_reading_t *out)
+{
+    const uint8_t *p = raw->data;
+    if (raw->len < sizeof(gw_sync_hdr_t) || p[1] != GW_SYNC_VERSION) return -1;
+    uint8_t body_len = p[offsetof(gw_sync_hdr_t, len)];
+    if (body_len != sizeof(gw_time_sync_t) || sizeof(gw_sync_hdr_t) + body_len > raw->len) return -1;
+
+    const uint8_t *body = p + sizeof(gw_sync_hdr_t);
+    memset(out, 0, sizeof(*out));
+    out->kind = GW_READING_SYNC;
+    out->device = load_device(p + offsetof(gw_sync_hdr_t, device));
+    out->rx_ns = raw->rx_ns;
+    out->sync.sent_unix_us = load64_le(p + offsetof(gw_sync_hdr_t, sent_unix_us));
+    out->sync.recv_unix_us = load64_le(p + offsetof(gw_sync_hdr_t, recv_unix_us));
+    out->sync.uptime_us = load64_le(body + offsetof(gw_time_sync_t, uptime_us));
+    out->sync.boot_id = load32_le(body + offsetof(gw_time_sync_t, boot_id));
+    out->sync.drift_ppb = (int32_t)load32_le(body + offsetof(gw_time_sync_t, drift_ppb));
+    out->sync.sync_count = (uint16_t)(body[offsetof(gw_time_sync_t, sync_count)] |
+                                      (body[offsetof(gw_time_sync_t, sync_count) + 1] << 8));
+    if (out->sync.recv_unix_us < out->sync.sent_unix_us) return -1;
+    return 0;
+}
+
+static void decode_probes(const uint8_t *body, gw_reading_t *out)
+{
+    uint8_t count = body[GW_PAYLOAD_PROBES_OFFSET];
+    if (count > GW_MAX_PROBES) count = GW_MAX_PROBES;
+
+    const uint8_t *rec = body + GW_PAYLOAD_PROBES_OFFSET + 1;
+    for (uint8_t i = 0; i < count; i++, rec += GW_PROBE_RECORD_LEN) {
+        gw_probe_reading_t *probe = &out->probes[i];
+        probe->temp = (float)(int16_t)(rec[0] | (rec[1] << 8)) / 10.0f;
+        probe->humi = (float)(uint16_t)(rec[2] | (rec[3] << 8)) / 10.0f;
+        probe->flags = rec[4];
+        if (!plausible(probe->temp, TEMP_PLAUSIBLE_MIN_C, TEMP_PLAUSIBLE_MAX_C) ||
+            !plausible(probe->humi, HUMI_PLAUSIBLE_MIN_PCT, HUMI_PLAUSIBLE_MAX_PCT)) {
+            probe->flags |= GW_FLAG_SENSOR_ERR;
+        }
+    }
+    out->probe_count = count;
+}
+
+// Untimed chained payloads, samples or checkpoints, from any firmware
+// generation; formats differ in length only.
+static bool chained_len(size_t len)
+{
+    static const size_t lens[] = { GW_PAYLOAD_CHAINED_LEN, GW_PAYLOAD_PERIOD_LEN, GW_PAYLOAD_SEQ_LEN };
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        if (len == lens[i] || len == lens[i] + 64) return true;
+    }
+    return false;
+}
+
+int gw_payload_decode(const gw_raw_t *raw, gw_reading_t *out)
+{
+    if (raw->len < 1) return -1;
+    if (raw->data[0] == GW_SYNC_MAGIC) return decode_sync(raw, out);
+    if (raw->len < sizeof(gw_frame_hdr_t)) return -1;
+
+    const uint8_t *p = raw->data;
+    if (p[0] != GW_FRAME_MAGIC || p[1] != GW_FRAME_VERSION) return -1;
+
+    uint8_t payload_len = p[offsetof(gw_frame_hdr_t, len)];
+    if (sizeof(gw_frame_hdr_t) + payload_len > raw->len) return -1;
+
+    uint64_t device = load_device(p + offsetof(gw_frame_hdr_t, device));
+
+    const uint8_t *body = p + sizeof(gw_frame_hdr_t);
+    uint32_t seq;
+    bool timed = payload_len == GW_PAYLOAD_TIMED_LEN || payload_len == GW_PAYLOAD_TIMED_CHECKPOINT_LEN;
+    bool probes = timed || payload_len == GW_PAYLOAD_CHAINED_LEN || payload_len == GW_PAYLOAD_CHECKPOINT_LEN;
+    if (payload_len == sizeof(gw_payload_v0_t)) {
+        seq = load32_le(p + offsetof(gw_frame_hdr_t, seq));
+    } else if (timed || chained_len(payload_len)) {
+        // The tag's own counter survives reconnects, unlike the envelope's.
+        seq = load32_le(body + GW_PAYLOAD_SEQ_OFFSET);
+    } else {
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->kind = GW_READING_SAMPLE;
+    out->has_time = timed;
+    if (timed) {
+        out->device_ms = load32_le(body + GW_PAYLOAD_TIME_OFFSET);
+        out->device_boot = (uint16_t)(body[GW_PAYLOAD_BOOT_OFFSET] | (body[GW_PAYLOAD_BOOT_OFFSET + 1] << 8));
+    }
+    out->device = device;
+    out->seq = seq;
+    out->rx_ns = raw->rx_ns;
+    out->temp_min = load_float_le(body + offsetof(gw_payload_v0_t, temp_min));
+    out->temp_max = load_float_le(body + offsetof(gw_payload_v0_t, temp_max));
+    out->humi_min = load_float_le(body + offsetof(gw_payload_v0_t, humi_min));
+    out->humi_max = load_float_le(body + offsetof(gw_payload_v0_t, humi_max));
+    out->flags = body[offsetof(gw_payload_v0_t, flag2)];
+    if (probes) decode_probes(body, out);
+
+    if (!plausible(out->temp_min, TEMP_PLAUSIBLE_MIN_C, TEMP_PLAUSIBLE_MAX_C)) return -1;
+    if (!plausible(out->temp_max, TEMP_PLAUSIBLE_MIN_C, TEMP_PLAUSIBLE_MAX_C)) return -1;
+    if (!plausible(out->humi_min, HUMI_PLAUSIBLE_MIN_PCT, HUMI_PLAUSIBLE_MAX_PCT)) return -1;
+    if (!plausible(out->humi_max, HUMI_PLAUSIBLE_MIN_PCT, HUMI_PLAUSIBLE_MAX_PCT)) return -1;
+    if (out->temp_min > out->temp_max || out->humi_min > out->humi_max) return -1;
+    return 0;
+}
+
+size_t gw_frame_build(uint8_t *buf, size_t max, uint64_t device, uint32_t seq,
+                      const void *payload, size_t payload_len)
+{
+    size_t total = sizeof(gw_frame_hdr_t) + payload_len;
+    if (payload_len > GW_FRAME_MAX_PAYLOAD || total > max) return 0;
+
+    buf[0] = GW_FRAME_MAGIC;
+    buf[1] = GW_FRAME_VERSION;
+    for (int i = 0; i < 6; i++) {
+        buf[offsetof(gw_frame_hdr_t, device) + i] = (uint8_t)(device >> (8 * (5 - i)));
+    }
+    for (int i = 0; i < 4; i++) {
+        buf[offsetof(gw_frame_hdr_t, seq) + i] = (uint8_t)(seq >> (8 * i));
+    }
+    buf[offsetof(gw_frame_hdr_t, len)] = (uint8_t)payload_len;
+    memcpy(buf + sizeof(gw_frame_hdr_t), payload, payload_len);
+    return total;
+}
+
+size_t gw_sync_frame_build(uint8_t *buf, size_t max, uint64_t device, uint64_t sent_unix_us,
+                           uint64_t recv_unix_us, const void *body, size_t body_len)
+{
+    size_t total = sizeof(gw_sync_hdr_t) + body_len;
+    if (body_len > GW_FRAME_MAX_PAYLOAD || total > max) return 0;
+
+    buf[0] = GW_SYNC_MAGIC;
+    buf[1] = GW_SYNC_VERSION;
+    for (int i = 0; i < 6; i++) {
+        buf[offsetof(gw_sync_hdr_t, device) + i] = (uint8_t)(device >> (8 * (5 - i)));
+    }
+    for (int i = 0; i < 8; i++) {
+        buf[offsetof(gw_sync_hdr_t, sent_unix_us) + i] = (uint8_t)(sent_unix_us >> (8 * i));
+        buf[offsetof(gw_sync_hdr_t, recv_unix_us) + i] = (uint8_t)(recv_unix_us >> (8 * i));
+    }
+    buf[offsetof(gw_sync_hdr_t, len)] = (uint8_t)body_len;
+    memcpy(buf + sizeof(gw_sync_hdr_t), body, body_len);
+    return total;
+}
+
+void gw_device_to_string(uint64_t device, char out[18])
+{
+    snprintf(out, 18, "%02X:%02X:%02X:%02X:%02X:%02X",
+             (unsigned)(device >> 40) & 0xFF, (unsigned)(device >> 32) & 0xFF,
+             (unsigned)(device >> 24) & 0xFF, (unsigned)(device >> 16) & 0xFF,
+             (unsigned)(device >> 8) & 0xFF, (unsigned)device & 0xFF);
+}
+
+int gw_device_from_string(const char *str, uint64_t *device)
+{
+    unsigned b[6];
+    if (sscanf(str, "%2x:%2x:%2x:%2x:%2x:%2x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) return -1;
+
+    uint64_t v = 0;
+    for (int i = 0; i < 6; i++) v = (v << 8) | (b[i] & 0xFF);
+    *device = v;
+    return 0;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Envelope used on the gateway's UNIX datagram socket. The BLE source builds
+// the same envelope from a notification so every later stage sees one format.
+#define GW_FRAME_MAGIC        0xCB
+#define GW_FRAME_VERSION      1
+#define GW_FRAME_MAX_PAYLOAD  244
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t device[6];      // BLE address, most significant byte first
+    uint32_t seq;           // little-endian
+    uint8_t len;
+} gw_frame_hdr_t;
+
+#define GW_FRAME_MAX_LEN (sizeof(gw_frame_hdr_t) + GW_FRAME_MAX_PAYLOAD)
+
+// A read of the tag's time-sync characteristic, bracketed by the gateway's
+// wall clock. Travels the same queue as sample frames so the clock state for
+// a device is only ever touched by the aggregate stage.
+#define GW_SYNC_MAGIC         0xCC
+#define GW_SYNC_VERSION       1
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t device[6];      // as in gw_frame_hdr_t
+    uint64_t sent_unix_us;  // read request handed to the socket
+    uint64_t recv_unix_us;  // read response received
+    uint8_t len;
+} gw_sync_hdr_t;
+
+// time_sync_t in services/iot/blink/main/payload.h
+typedef struct __attribute__((packed)) {
+    uint64_t uptime_us;
+    uint32_t boot_id;
+    uint64_t unix_ms;
+    uint32_t synced_uptime_ms;
+    int32_t drift_ppb;
+    uint16_t sync_count;
+} gw_time_sync_t;
+
+// time_sync_set_t, written back to the tag
+typedef struct __attribute__((packed)) {
+    uint64_t unix_ms;
+    uint32_t at_uptime_ms;
+    int32_t drift_ppb;
+} gw_time_sync_set_t;
+
+// nfc_tap_t, notified on the tag's NFC tap characteristic when its reader
+// sees a new card
+#define GW_NFC_UID_MAX  10
+
+typedef struct __attribute__((packed)) {
+    uint32_t tap_seq;
+    uint32_t uptime_ms;
+    uint32_t sample_seq;    // payload seq at the time of the tap
+    uint8_t uid_len;
+    uint8_t uid[GW_NFC_UID_MAX];
+} gw_nfc_tap_t;
+
+// Leading fields of payload_t in services/iot/blink/main/payload.h
+// (little-endian). Older firmware sends exactly these 17 bytes. Min/max cover
+// one sample's probes; the aggregate stage folds them into windows.
+typedef struct __attribute__((packed)) {
+    float temp_min;
+    float temp_max;
+    float humi_min;
+    float humi_max;
+    uint8_t flag2;
+} gw_payload_v0_t;
+
+// sensor_record_t: temperature in 0.1 C (i16), humidity in 0.1 %RH (u16), flags
+#define GW_MAX_PROBES        4
+#define GW_PROBE_RECORD_LEN  5
+
+// Chained firmware appends seq (u32), the sample period in ms (u16), a probe
+// count and four 5-byte per-probe records, then a 32-byte chain link, plus a
+// 64-byte signature on checkpoints. The gateway reads seq and the records.
+// Chain verification is left to whoever holds the device key
+// (blink/host/chain_verify).
+// Current firmware also puts the tag's uptime in ms (u32) and a boot tag
+// (u16, changes when uptime restarts) before the link.
+#define GW_PAYLOAD_SEQ_OFFSET      sizeof(gw_payload_v0_t)
+#define GW_PAYLOAD_PROBES_OFFSET   (GW_PAYLOAD_SEQ_OFFSET + 4 + 2)
+#define GW_PAYLOAD_TIME_OFFSET     (GW_PAYLOAD_PROBES_OFFSET + 1 + GW_MAX_PROBES * GW_PROBE_RECORD_LEN)
+#define GW_PAYLOAD_CHAINED_LEN     (GW_PAYLOAD_TIME_OFFSET + 32)
+#define GW_PAYLOAD_CHECKPOINT_LEN  (GW_PAYLOAD_CHAINED_LEN + 64)
+#define GW_PAYLOAD_BOOT_OFFSET     (GW_PAYLOAD_TIME_OFFSET + 4)
+#define GW_PAYLOAD_TIMED_LEN       (GW_PAYLOAD_CHAINED_LEN + 6)
+#define GW_PAYLOAD_TIMED_CHECKPOINT_LEN (GW_PAYLOAD_TIMED_LEN + 64)
+// Chained firmware from before the per-probe records sent seq and the period
+// and then the link; the first chained firmware sent only seq.
+#define GW_PAYLOAD_PERIOD_LEN      (GW_PAYLOAD_SEQ_OFFSET + 4 + 2 + 32)
+#define GW_PAYLOAD_SEQ_LEN         (GW_PAYLOAD_SEQ_OFFSET + 4 + 32)
+
+#define GW_FLAG_TEMP_OOR    0x1
+#define GW_FLAG_HUMI_OOR    0x2
+#define GW_FLAG_SENSOR_ERR  0x4     // probe not read, or its record is implausible
+
+typedef struct {
+    uint64_t rx_ns;
+    uint16_t len;           // GW_FRAME_MAX_LEN does not fit in a byte
+    uint8_t data[GW_FRAME_MAX_LEN];
+} gw_raw_t;
+
+typedef enum {
+    GW_READING_SAMPLE = 0,
+    GW_READING_SYNC,        // only device, rx_ns and sync are set
+} gw_reading_kind_t;
+
+typedef struct {
+    uint64_t sent_unix_us;
+    uint64_t recv_unix_us;
+    uint64_t uptime_us;
+    uint32_t boot_id;
+    int32_t drift_ppb;      // as last written to the tag, by any gateway
+    uint16_t sync_count;
+} gw_sync_reading_t;
+
+// One probe's reading at the sample, from its record.
+typedef struct {
+    float temp;
+    float humi;
+    uint8_t flags;          // GW_FLAG_*
+} gw_probe_reading_t;
+
+#define GW_TIME_ERR_UNBOUNDED UINT32_MAX
+
+typedef struct {
+    uint64_t device;
+    uint32_t seq;
+    uint64_t rx_ns;
+    float temp_min;
+    float temp_max;
+    float humi_min;
+    float humi_max;
+    uint8_t flags;
+    uint8_t kind;
+    uint8_t probe_count;    // records decoded into probes, 0 for firmware without them
+    gw_probe_reading_t probes[GW_MAX_PROBES];
+    bool has_time;
+    uint32_t device_ms;     // tag uptime at the reading, when has_time
+    uint16_t device_boot;   // low bits of the tag's boot_id, when has_time
+    uint64_t unix_ms;       // filled in by the aggregate stage, 0 if unknown
+    uint32_t time_err_ms;   // bound on |unix_ms - true time|, GW_TIME_ERR_UNBOUNDED if none
+    gw_sync_reading_t sync;
+} gw_reading_t;
+
+// Returns 0 on success, -1 for a malformed envelope or implausible payload.
+int gw_payload_decode(const gw_raw_t *raw, gw_reading_t *out);
+
+// Builds an envelope into buf and returns its length, or 0 if it does not fit.
+size_t gw_frame_build(uint8_t *buf, size_t max, uint64_t device, uint32_t seq,
+                      const void *payload, size_t payload_len);
+
+// Same for a time-sync read; body is the characteristic value.
+size_t gw_sync_frame_build(uint8_t *buf, size_t max, uint64_t device, uint64_t sent_unix_us,
+                           uint64_t recv_unix_us, const void *body, size_t body_len);
+
+void gw_device_to_string(uint64_t device, char out[18]);
+int gw_device_from_string(const char *str, uint64_t *device);
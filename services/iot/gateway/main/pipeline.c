@@ -0,0 +1,350 @@
+#include "pipeline.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gw_log.h"
+#include "gw_time.h"
+
+static const char *TAG = "PIPELINE";
+
+#define AGGREGATE_TICK_MS      100
+#define SUBMIT_IDLE_WAIT_MS    50
+#define SUBMIT_MAX_RETRIES     3
+
+static void stage_record(gw_stage_stats_t *st, uint64_t started_ns)
+{
+    uint64_t took = gw_now_ns() - started_ns;
+    atomic_fetch_add(&st->processed, 1);
+    atomic_fetch_add(&st->service_ns_total, took);
+
+    uint_fast64_t max = atomic_load(&st->service_ns_max);
+    while (took > max && !atomic_compare_exchange_weak(&st->service_ns_max, &max, took)) {
+    }
+}
+
+static void *decode_task(void *param)
+{
+    gw_pipeline_t *p = param;
+    gw_raw_t raw;
+    gw_reading_t reading;
+
+    while (gw_queue_pop(&p->raw, &raw, -1) == 0) {
+        uint64_t t0 = gw_now_ns();
+        if (gw_payload_decode(&raw, &reading) != 0) {
+            atomic_fetch_add(&p->decode.filtered, 1);
+            stage_record(&p->decode, t0);
+            continue;
+        }
+        stage_record(&p->decode, t0);
+        if (gw_queue_push(&p->decoded, &reading) != 0) break;
+    }
+
+    // Last decoder out closes the next queue so dedupe sees end-of-stream.
+    if (atomic_fetch_sub(&p->decoders_running, 1) == 1) gw_queue_close(&p->decoded);
+    return NULL;
+}
+
+static void *dedupe_task(void *param)
+{
+    gw_pipeline_t *p = param;
+    gw_reading_t reading;
+
+    while (gw_queue_pop(&p->decoded, &reading, -1) == 0) {
+        uint64_t t0 = gw_now_ns();
+        // Sync reads carry no seq; the clock keeps only the best one anyway.
+        bool fresh = reading.kind == GW_READING_SYNC ||
+                     gw_dedupe_accept(&p->dedupe_state, reading.device, reading.seq);
+        if (!fresh) atomic_fetch_add(&p->dedupe.filtered, 1);
+        stage_record(&p->dedupe, t0);
+        if (fresh && gw_queue_push(&p->unique, &reading) != 0) break;
+    }
+    gw_queue_close(&p->unique);
+    return NULL;
+}
+
+static void emit_window(const gw_window_t *window, void *ctx)
+{
+    gw_pipeline_t *p = ctx;
+    gw_queue_push(&p->windows, window);
+}
+
+static void *aggregate_task(void *param)
+{
+    gw_pipeline_t *p = param;
+    gw_reading_t reading;
+    uint64_t next_tick = gw_now_ns() + AGGREGATE_TICK_MS * 1000000ull;
+
+    for (;;) {
+        int rc = gw_queue_pop(&p->unique, &reading, AGGREGATE_TICK_MS);
+        if (rc < 0) break;
+        if (rc == 0) {
+            uint64_t t0 = gw_now_ns();
+            gw_clock_table_apply(&p->clocks, &reading);
+            if (reading.kind == GW_READING_SAMPLE) gw_aggregate_add(&p->aggregate_state, &reading);
+            stage_record(&p->aggregate, t0);
+        }
+
+        uint64_t now = gw_now_ns();
+        if (now >= next_tick) {
+            gw_aggregate_expire(&p->aggregate_state, now);
+            next_tick = now + AGGREGATE_TICK_MS * 1000000ull;
+        }
+    }
+
+    gw_aggregate_flush(&p->aggregate_state);
+    gw_queue_close(&p->windows);
+    return NULL;
+}
+
+static void publish_submit_stats(gw_pipeline_t *p)
+{
+    pthread_mutex_lock(&p->submit_lock);
+    p->submit_snapshot = p->submitter.stats;
+    p->inflight_snapshot = gw_submit_inflight(&p->submitter);
+    pthread_mutex_unlock(&p->submit_lock);
+}
+
+static void *submit_task(void *param)
+{
+    gw_pipeline_t *p = param;
+    gw_submitter_t *s = &p->submitter;
+    size_t batch_max = p->cfg.submit.batch_size;
+    gw_window_t *batch = calloc(batch_max, sizeof(*batch));
+    // Room for a full batch of rejected sends plus every window whose
+    // transaction was replaced.
+    size_t retry_max = batch_max + p->cfg.submit.max_inflight;
+    gw_window_t *retry = calloc(retry_max, sizeof(*batch));
+    size_t retry_count = 0;
+    int retry_rounds = 0;
+    bool closed = false;
+
+    while (batch && retry) {
+        gw_submit_poll(s, false);
+        retry_count += gw_submit_take_requeued(s, retry + retry_count, retry_max - retry_count);
+
+        size_t room = gw_submit_capacity(s);
+        if (room > batch_max) room = batch_max;
+        if (room == 0) {
+            publish_submit_stats(p);
+            struct timespec ts = { .tv_sec = 0, .tv_nsec = SUBMIT_IDLE_WAIT_MS * 1000000L };
+            nanosleep(&ts, NULL);
+            gw_submit_poll(s, true);
+            continue;
+        }
+
+        // Retries keep their place at the front so nonces stay in order.
+        size_t count = retry_count < room ? retry_count : room;
+        memcpy(batch, retry, count * sizeof(*batch));
+        memmove(retry, retry + count, (retry_count - count) * sizeof(*retry));
+        retry_count -= count;
+
+        if (!closed && count < room) {
+            int rc = gw_queue_pop(&p->windows, &batch[count], count ? 0 : SUBMIT_IDLE_WAIT_MS);
+            if (rc < 0) closed = true;
+            if (rc == 0) count++;
+            while (rc == 0 && count < room) {
+                rc = gw_queue_pop(&p->windows, &batch[count], 0);
+                if (rc == 0) count++;
+                if (rc < 0) closed = true;
+            }
+        }
+
+        if (count == 0) {
+            publish_submit_stats(p);
+            if (closed && retry_count == 0) break;
+            continue;
+        }
+
+        uint64_t t0 = gw_now_ns();
+        size_t failed = gw_submit_send(s, batch, count, retry + retry_count);
+        for (size_t i = 0; i < count; i++) stage_record(&p->submit, t0);
+
+        if (failed > 0 && ++retry_rounds > SUBMIT_MAX_RETRIES) {
+            GW_LOGE(TAG, "Dropping %zu windows after %d retries", failed, SUBMIT_MAX_RETRIES);
+            s->stats.failed += failed;
+            atomic_fetch_add(&p->submit.filtered, failed);
+            failed = 0;
+            retry_rounds = 0;
+        } else if (failed == 0) {
+            retry_rounds = 0;
+        }
+        retry_count += failed;
+        publish_submit_stats(p);
+    }
+
+    // Drain: give in-flight transactions up to one timeout to land.
+    uint64_t deadline = gw_now_ns() + (uint64_t)p->cfg.submit.tx_timeout_ms * 1000000ull;
+    while (gw_submit_inflight(s) > 0 && gw_now_ns() < deadline) {
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = (long)p->cfg.submit.receipt_poll_ms * 1000000L };
+        nanosleep(&ts, NULL);
+        gw_submit_poll(s, true);
+    }
+    size_t unsent = retry_count + gw_submit_take_requeued(s, retry + retry_count, retry_max - retry_count);
+    if (unsent > 0) GW_LOGW(TAG, "Stopping with %zu windows not resubmitted", unsent);
+    publish_submit_stats(p);
+
+    free(batch);
+    free(retry);
+    return NULL;
+}
+
+int gw_pipeline_start(gw_pipeline_t *p, const gw_pipeline_config_t *cfg)
+{
+    memset(p, 0, sizeof(*p));
+    p->cfg = *cfg;
+    p->decode.name = "decode";
+    p->dedupe.name = "dedupe";
+    p->aggregate.name = "aggregate";
+    p->submit.name = "submit";
+    pthread_mutex_init(&p->submit_lock, NULL);
+
+    if (gw_queue_init(&p->raw, "raw", sizeof(gw_raw_t), cfg->queue_capacity) != 0 ||
+        gw_queue_init(&p->decoded, "decoded", sizeof(gw_reading_t), cfg->queue_capacity) != 0 ||
+        gw_queue_init(&p->unique, "unique", sizeof(gw_reading_t), cfg->queue_capacity) != 0 ||
+        gw_queue_init(&p->windows, "windows", sizeof(gw_window_t), cfg->queue_capacity) != 0) {
+        GW_LOGE(TAG, "Queue allocation failed");
+        return -1;
+    }
+
+    if (gw_dedupe_init(&p->dedupe_state, cfg->expected_devices) != 0 ||
+        gw_clock_table_init(&p->clocks, cfg->expected_devices) != 0 ||
+        gw_aggregate_init(&p->aggregate_state, cfg->expected_devices, cfg->window_ms,
+                          cfg->window_max_samples, emit_window, p) != 0) {
+        GW_LOGE(TAG, "Device table allocation failed");
+        return -1;
+    }
+
+    if (gw_submit_init(&p->submitter, &cfg->submit) != 0) return -1;
+
+    p->decode_threads = calloc(cfg->decode_workers, sizeof(pthread_t));
+    if (!p->decode_threads) return -1;
+    atomic_store(&p->decoders_running, cfg->decode_workers);
+    for (uint32_t i = 0; i < cfg->decode_workers; i++) {
+        pthread_create(&p->decode_threads[i], NULL, decode_task, p);
+    }
+    pthread_create(&p->dedupe_thread, NULL, dedupe_task, p);
+    pthread_create(&p->aggregate_thread, NULL, aggregate_task, p);
+    pthread_create(&p->submit_thread, NULL, submit_task, p);
+    return 0;
+}
+
+void gw_pipeline_stop(gw_pipeline_t *p)
+{
+    gw_queue_close(&p->raw);
+    for (uint32_t i = 0; i < p->cfg.decode_workers; i++) pthread_join(p->decode_threads[i], NULL);
+    pthread_join(p->dedupe_thread, NULL);
+    pthread_join(p->aggregate_thread, NULL);
+    pthread_join(p->submit_thread, NULL);
+    free(p->decode_threads);
+    p->decode_threads = NULL;
+}
+
+void gw_pipeline_destroy(gw_pipeline_t *p)
+{
+    gw_submit_destroy(&p->submitter);
+    gw_aggregate_destroy(&p->aggregate_state);
+    gw_clock_table_destroy(&p->clocks);
+    gw_dedupe_destroy(&p->dedupe_state);
+    gw_queue_destroy(&p->raw);
+    gw_queue_destroy(&p->decoded);
+    gw_queue_destroy(&p->unique);
+    gw_queue_destroy(&p->windows);
+    pthread_mutex_destroy(&p->submit_lock);
+}
+
+static void report_queue(FILE *prom, gw_queue_t *q, gw_queue_stats_t *qs)
+{
+    gw_queue_stats(q, qs);
+    if (!prom) return;
+    fprintf(prom, "gateway_queue_depth{queue=\"%s\"} %zu\n", q->name, qs->depth);
+    fprintf(prom, "gateway_queue_depth_peak{queue=\"%s\"} %zu\n", q->name, qs->max_depth);
+    fprintf(prom, "gateway_queue_capacity{queue=\"%s\"} %zu\n", q->name, qs->capacity);
+    fprintf(prom, "gateway_queue_pushed_total{queue=\"%s\"} %llu\n", q->name, (unsigned long long)qs->pushed);
+    fprintf(prom, "gateway_queue_dropped_total{queue=\"%s\"} %llu\n", q->name, (unsigned long long)qs->dropped);
+    fprintf(prom, "gateway_queue_wait_seconds_sum{queue=\"%s\"} %.9f\n", q->name, qs->wait_ns_total / 1e9);
+    fprintf(prom, "gateway_queue_wait_seconds_count{queue=\"%s\"} %llu\n", q->name, (unsigned long long)qs->popped);
+    fprintf(prom, "gateway_queue_wait_seconds_peak{queue=\"%s\"} %.9f\n", q->name, qs->wait_ns_max / 1e9);
+}
+
+static void report_clocks(FILE *prom, gw_clock_stats_t *cs)
+{
+    static const char *const modes[] = { "none", "passive", "synced" };
+    if (!prom) return;
+    fprintf(prom, "gateway_clock_syncs_total %llu\n", (unsigned long long)atomic_load(&cs->syncs));
+    fprintf(prom, "gateway_clock_syncs_rejected_total %llu\n", (unsigned long long)atomic_load(&cs->syncs_rejected));
+    fprintf(prom, "gateway_clock_reboots_total %llu\n", (unsigned long long)atomic_load(&cs->reboots));
+    fprintf(prom, "gateway_clock_stale_total %llu\n", (unsigned long long)atomic_load(&cs->stale));
+    fprintf(prom, "gateway_clock_untimed_total %llu\n", (unsigned long long)atomic_load(&cs->untimed));
+    for (int i = 0; i < 3; i++) {
+        fprintf(prom, "gateway_clock_stamped_total{mode=\"%s\"} %llu\n", modes[i],
+                (unsigned long long)atomic_load(&cs->stamped[i]));
+    }
+    fprintf(prom, "gateway_clock_error_seconds_sum %.3f\n", atomic_load(&cs->err_ms_total) / 1e3);
+    fprintf(prom, "gateway_clock_error_seconds_peak %.3f\n", atomic_exchange(&cs->err_ms_max, 0) / 1e3);
+    fprintf(prom, "gateway_clock_delay_seconds_sum %.3f\n", atomic_load(&cs->delay_ms_total) / 1e3);
+}
+
+static void report_stage(FILE *prom, gw_stage_stats_t *st)
+{
+    uint64_t processed = atomic_load(&st->processed);
+    uint64_t service = atomic_load(&st->service_ns_total);
+    uint64_t peak = atomic_exchange(&st->service_ns_max, 0);
+    if (!prom) return;
+    fprintf(prom, "gateway_stage_processed_total{stage=\"%s\"} %llu\n", st->name, (unsigned long long)processed);
+    fprintf(prom, "gateway_stage_filtered_total{stage=\"%s\"} %llu\n", st->name,
+            (unsigned long long)atomic_load(&st->filtered));
+    fprintf(prom, "gateway_stage_service_seconds_sum{stage=\"%s\"} %.9f\n", st->name, service / 1e9);
+    fprintf(prom, "gateway_stage_service_seconds_peak{stage=\"%s\"} %.9f\n", st->name, peak / 1e9);
+}
+
+void gw_pipeline_report(gw_pipeline_t *p, FILE *prom, double interval_s)
+{
+    gw_queue_t *queues[] = { &p->raw, &p->decoded, &p->unique, &p->windows };
+    gw_stage_stats_t *stages[] = { &p->decode, &p->dedupe, &p->aggregate, &p->submit };
+    gw_queue_stats_t qs[4];
+    uint64_t processed[4];
+
+    for (int i = 0; i < 4; i++) {
+        report_queue(prom, queues[i], &qs[i]);
+        processed[i] = atomic_load(&stages[i]->processed);
+        report_stage(prom, stages[i]);
+    }
+
+    report_clocks(prom, &p->clocks.stats);
+
+    pthread_mutex_lock(&p->submit_lock);
+    gw_submit_stats_t tx = p->submit_snapshot;
+    size_t inflight = p->inflight_snapshot;
+    pthread_mutex_unlock(&p->submit_lock);
+
+    if (prom) {
+        fprintf(prom, "gateway_tx_sent_total %llu\n", (unsigned long long)tx.sent);
+        fprintf(prom, "gateway_tx_confirmed_total %llu\n", (unsigned long long)tx.confirmed);
+        fprintf(prom, "gateway_tx_reverted_total %llu\n", (unsigned long long)tx.reverted);
+        fprintf(prom, "gateway_tx_failed_total %llu\n", (unsigned long long)tx.failed);
+        fprintf(prom, "gateway_tx_replaced_total %llu\n", (unsigned long long)tx.replaced);
+        fprintf(prom, "gateway_tx_rebroadcasts_total %llu\n", (unsigned long long)tx.rebroadcasts);
+        fprintf(prom, "gateway_tx_nonce_resyncs_total %llu\n", (unsigned long long)tx.nonce_resyncs);
+        fprintf(prom, "gateway_tx_gap_fills_total %llu\n", (unsigned long long)tx.gap_fills);
+        fprintf(prom, "gateway_tx_inflight %zu\n", inflight);
+        fprintf(prom, "gateway_tx_confirm_seconds_sum %.9f\n", tx.confirm_ns_total / 1e9);
+        fprintf(prom, "gateway_tx_confirm_seconds_peak %.9f\n", tx.confirm_ns_max / 1e9);
+    }
+
+    if (interval_s <= 0) interval_s = 1;
+    GW_LOGI(TAG,
+            "rx %.0f/s (drop %llu) | decode %.0f/s q%zu | dedupe %.0f/s q%zu dup %llu | "
+            "aggregate %.0f/s q%zu | windows q%zu | tx %.1f/s inflight %zu ok %llu fail %llu",
+            (qs[0].pushed - p->report_prev_rx) / interval_s, (unsigned long long)qs[0].dropped,
+            (processed[0] - p->report_prev_processed[0]) / interval_s, qs[0].depth,
+            (processed[1] - p->report_prev_processed[1]) / interval_s, qs[1].depth,
+            (unsigned long long)atomic_load(&p->dedupe.filtered),
+            (processed[2] - p->report_prev_processed[2]) / interval_s, qs[2].depth, qs[3].depth,
+            (tx.confirmed - p->report_prev_confirmed) / interval_s, inflight,
+            (unsigned long long)tx.confirmed, (unsigned long long)(tx.failed + tx.reverted));
+
+    p->report_prev_rx = qs[0].pushed;
+    memcpy(p->report_prev_processed, processed, sizeof(processed));
+    p->report_prev_confirmed = tx.confirmed;
+}
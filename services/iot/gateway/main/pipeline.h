@@ -0,0 +1,79 @@
+#pragma once
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "aggregate.h"
+#include "dedupe.h"
+#include "payload.h"
+#include "queue.h"
+#include "submit.h"
+#include "timesync.h"
+
+// raw frames -> decode (N workers) -> dedupe -> aggregate -> submit
+//
+// The aggregate stage also owns the per-device clocks (timesync.h): sync
+// reads update them and every timed sample is stamped before it is folded
+// into a window.
+typedef struct {
+    uint32_t decode_workers;
+    uint32_t queue_capacity;
+    uint32_t expected_devices;
+    uint32_t window_ms;
+    uint32_t window_max_samples;
+    gw_submit_config_t submit;
+} gw_pipeline_config_t;
+
+typedef struct {
+    const char *name;
+    atomic_uint_fast64_t processed;
+    atomic_uint_fast64_t filtered;       // decode errors, duplicates
+    atomic_uint_fast64_t service_ns_total;
+    atomic_uint_fast64_t service_ns_max;
+} gw_stage_stats_t;
+
+typedef struct {
+    gw_pipeline_config_t cfg;
+
+    gw_queue_t raw;
+    gw_queue_t decoded;
+    gw_queue_t unique;
+    gw_queue_t windows;
+
+    gw_stage_stats_t decode;
+    gw_stage_stats_t dedupe;
+    gw_stage_stats_t aggregate;
+    gw_stage_stats_t submit;
+
+    gw_dedupe_t dedupe_state;
+    gw_aggregate_t aggregate_state;
+    gw_clock_table_t clocks;
+    gw_submitter_t submitter;
+
+    pthread_t *decode_threads;
+    pthread_t dedupe_thread;
+    pthread_t aggregate_thread;
+    pthread_t submit_thread;
+    atomic_uint decoders_running;
+
+    pthread_mutex_t submit_lock;
+    gw_submit_stats_t submit_snapshot;
+    size_t inflight_snapshot;
+
+    uint64_t report_prev_rx;
+    uint64_t report_prev_processed[4];
+    uint64_t report_prev_confirmed;
+} gw_pipeline_t;
+
+int gw_pipeline_start(gw_pipeline_t *p, const gw_pipeline_config_t *cfg);
+
+// Call after every source has stopped: drains each stage in order, flushes
+// open windows and waits for in-flight transactions before returning.
+void gw_pipeline_stop(gw_pipeline_t *p);
+void gw_pipeline_destroy(gw_pipeline_t *p);
+
+// Writes Prometheus text exposition to prom (may be NULL) and logs one
+// summary line with rates over interval_s.
+void gw_pipeline_report(gw_pipeline_t *p, FILE *prom, double interval_s);
@@ -0,0 +1,151 @@
+#include "queue.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gw_time.h"
+
+int gw_queue_init(gw_queue_t *q, const char *name, size_t item_size, size_t capacity)
+{
+    memset(q, 0, sizeof(*q));
+    q->name = name;
+    q->item_size = item_size;
+    q->slot_size = sizeof(uint64_t) + ((item_size + 7u) & ~(size_t)7u);
+    q->capacity = capacity;
+    q->slots = calloc(capacity, q->slot_size);
+    if (!q->slots) return -1;
+
+    pthread_mutex_init(&q->lock, NULL);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->not_empty, &attr);
+    pthread_cond_init(&q->not_full, &attr);
+    pthread_condattr_destroy(&attr);
+    return 0;
+}
+
+void gw_queue_destroy(gw_queue_t *q)
+{
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    pthread_mutex_destroy(&q->lock);
+    free(q->slots);
+    q->slots = NULL;
+}
+
+static void enqueue_locked(gw_queue_t *q, const void *item)
+{
+    size_t tail = (q->head + q->count) % q->capacity;
+    uint8_t *slot = q->slots + tail * q->slot_size;
+    uint64_t now = gw_now_ns();
+    memcpy(slot, &now, sizeof(now));
+    memcpy(slot + sizeof(uint64_t), item, q->item_size);
+
+    q->count++;
+    q->pushed++;
+    if (q->count > q->max_depth) q->max_depth = q->count;
+    pthread_cond_signal(&q->not_empty);
+}
+
+int gw_queue_push(gw_queue_t *q, const void *item)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity && !q->closed) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return -1;
+    }
+    enqueue_locked(q, item);
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+int gw_queue_try_push(gw_queue_t *q, const void *item)
+{
+    pthread_mutex_lock(&q->lock);
+    if (q->count == q->capacity || q->closed) {
+        q->dropped++;
+        pthread_mutex_unlock(&q->lock);
+        return -1;
+    }
+    enqueue_locked(q, item);
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+int gw_queue_pop(gw_queue_t *q, void *item, int timeout_ms)
+{
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (q->closed) {
+            pthread_mutex_unlock(&q->lock);
+            return -1;
+        }
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&q->not_empty, &q->lock);
+        } else if (pthread_cond_timedwait(&q->not_empty, &q->lock, &deadline) == ETIMEDOUT) {
+            if (q->count == 0) {
+                pthread_mutex_unlock(&q->lock);
+                return q->closed ? -1 : 1;
+            }
+        }
+    }
+
+    uint8_t *slot = q->slots + q->head * q->slot_size;
+    uint64_t queued_at;
+    memcpy(&queued_at, slot, sizeof(queued_at));
+    memcpy(item, slot + sizeof(uint64_t), q->item_size);
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    q->popped++;
+
+    uint64_t waited = gw_now_ns() - queued_at;
+    q->wait_ns_total += waited;
+    if (waited > q->wait_ns_max) q->wait_ns_max = waited;
+
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+void gw_queue_close(gw_queue_t *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void gw_queue_stats(gw_queue_t *q, gw_queue_stats_t *out)
+{
+    pthread_mutex_lock(&q->lock);
+    out->depth = q->count;
+    out->max_depth = q->max_depth;
+    out->capacity = q->capacity;
+    out->pushed = q->pushed;
+    out->popped = q->popped;
+    out->dropped = q->dropped;
+    out->wait_ns_total = q->wait_ns_total;
+    out->wait_ns_max = q->wait_ns_max;
+    q->max_depth = q->count;
+    q->wait_ns_max = 0;
+    pthread_mutex_unlock(&q->lock);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Bounded multi-producer/multi-consumer queue of fixed-size items.
+// Items are copied in and out; each slot remembers when it was queued so
+// the consumer side can account for time spent waiting.
+typedef struct {
+    const char *name;
+    uint8_t *slots;
+    size_t item_size;
+    size_t slot_size;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    bool closed;
+
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+
+    // Counters, guarded by lock
+    size_t max_depth;
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t dropped;
+    uint64_t wait_ns_total;
+    uint64_t wait_ns_max;
+} gw_queue_t;
+
+typedef struct {
+    size_t depth;
+    size_t max_depth;
+    size_t capacity;
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t dropped;
+    uint64_t wait_ns_total;
+    uint64_t wait_ns_max;
+} gw_queue_stats_t;
+
+int gw_queue_init(gw_queue_t *q, const char *name, size_t item_size, size_t capacity);
+void gw_queue_destroy(gw_queue_t *q);
+
+// Blocks while the queue is full. Returns -1 once the queue is closed.
+int gw_queue_push(gw_queue_t *q, const void *item);
+// Never blocks. Returns -1 and counts a drop when the queue is full or closed.
+int gw_queue_try_push(gw_queue_t *q, const void *item);
+
+// Blocks up to timeout_ms (negative waits forever). Returns 0 on success,
+// 1 on timeout and -1 when the queue is closed and drained.
+int gw_queue_pop(gw_queue_t *q, void *item, int timeout_ms);
+
+// Wakes every waiter; pops keep returning items until the queue is empty.
+void gw_queue_close(gw_queue_t *q);
+
+// Snapshot of the counters. max_depth and wait_ns_max are peaks since the
+// previous snapshot.
+void gw_queue_stats(gw_queue_t *q, gw_queue_stats_t *out);
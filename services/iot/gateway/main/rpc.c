@@ -0,0 +1,357 @@
+#include "rpc.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "gw_log.h"
+
+static const char *TAG = "RPC";
+
+#define RPC_HEADER_MAX  8192
+#define RPC_BODY_MAX    (64u * 1024u * 1024u)
+
+int gw_rpc_open(gw_rpc_t *rpc, const char *url)
+{
+    memset(rpc, 0, sizeof(*rpc));
+    rpc->fd = -1;
+    rpc->next_id = 1;
+
+    const char *prefix = "http://";
+    if (strncmp(url, prefix, strlen(prefix)) != 0) {
+        GW_LOGE(TAG, "Only http:// RPC URLs are supported: %s", url);
+        return -1;
+    }
+
+    const char *host = url + strlen(prefix);
+    const char *path = strchr(host, '/');
+    size_t host_len = path ? (size_t)(path - host) : strlen(host);
+    snprintf(rpc->path, sizeof(rpc->path), "%s", path ? path : "/");
+
+    const char *colon = memchr(host, ':', host_len);
+    size_t name_len = colon ? (size_t)(colon - host) : host_len;
+    if (name_len == 0 || name_len >= sizeof(rpc->host)) return -1;
+    memcpy(rpc->host, host, name_len);
+    rpc->host[name_len] = '\0';
+
+    if (colon) {
+        size_t port_len = host_len - name_len - 1;
+        if (port_len == 0 || port_len >= sizeof(rpc->port)) return -1;
+        memcpy(rpc->port, colon + 1, port_len);
+        rpc->port[port_len] = '\0';
+    } else {
+        snprintf(rpc->port, sizeof(rpc->port), "80");
+    }
+    return 0;
+}
+
+void gw_rpc_close(gw_rpc_t *rpc)
+{
+    if (rpc->fd >= 0) close(rpc->fd);
+    rpc->fd = -1;
+}
+
+static int connect_node(gw_rpc_t *rpc)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    int rc = getaddrinfo(rpc->host, rpc->port, &hints, &res);
+    if (rc != 0) {
+        GW_LOGE(TAG, "Resolve %s:%s failed: %s", rpc->host, rpc->port, gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        GW_LOGE(TAG, "Connect %s:%s failed: %s", rpc->host, rpc->port, strerror(errno));
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    rpc->fd = fd;
+    return 0;
+}
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// True if the node has closed an idle connection (EOF or reset pending).
+static bool peer_closed(int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, 0) <= 0) return false;
+    char byte;
+    ssize_t n = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+// Buffered reader over the socket for header lines, fixed bodies and chunks.
+typedef struct {
+    int fd;
+    char buf[RPC_HEADER_MAX];
+    size_t start;
+    size_t end;
+} reader_t;
+
+static int fill(reader_t *r)
+{
+    if (r->start > 0) {
+        memmove(r->buf, r->buf + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+    }
+    if (r->end == sizeof(r->buf)) return -1;
+
+    ssize_t n;
+    do {
+        n = recv(r->fd, r->buf + r->end, sizeof(r->buf) - r->end, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+    r->end += (size_t)n;
+    return 0;
+}
+
+static int read_line(reader_t *r, char *line, size_t max)
+{
+    for (;;) {
+        char *nl = memchr(r->buf + r->start, '\n', r->end - r->start);
+        if (nl) {
+            size_t len = (size_t)(nl - (r->buf + r->start));
+            if (len > 0 && r->buf[r->start + len - 1] == '\r') len--;
+            if (len >= max) return -1;
+            memcpy(line, r->buf + r->start, len);
+            line[len] = '\0';
+            r->start = (size_t)(nl - r->buf) + 1;
+            return 0;
+        }
+        if (fill(r) != 0) return -1;
+    }
+}
+
+static int read_exact(reader_t *r, char *out, size_t len)
+{
+    while (len > 0) {
+        if (r->start == r->end && fill(r) != 0) return -1;
+        size_t n = r->end - r->start;
+        if (n > len) n = len;
+        memcpy(out, r->buf + r->start, n);
+        r->start += n;
+        out += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int read_response(gw_rpc_t *rpc, char **body_out, size_t *body_len_out, int *keep_alive)
+{
+    reader_t *r = malloc(sizeof(*r));
+    if (!r) return -1;
+    r->fd = rpc->fd;
+    r->start = r->end = 0;
+
+    char line[1024];
+    int status = 0;
+    long content_length = -1;
+    int chunked = 0;
+    *keep_alive = 1;
+
+    if (read_line(r, line, sizeof(line)) != 0 || sscanf(line, "HTTP/%*s %d", &status) != 1) goto fail;
+
+    for (;;) {
+        if (read_line(r, line, sizeof(line)) != 0) goto fail;
+        if (line[0] == '\0') break;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) content_length = strtol(line + 15, NULL, 10);
+        if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line + 18, "chunked")) chunked = 1;
+        if (strncasecmp(line, "Connection:", 11) == 0 && strstr(line + 11, "close")) *keep_alive = 0;
+    }
+
+    char *body = NULL;
+    size_t body_len = 0;
+    if (chunked) {
+        for (;;) {
+            if (read_line(r, line, sizeof(line)) != 0) goto fail_body;
+            unsigned long chunk = strtoul(line, NULL, 16);
+            if (chunk == 0) {
+                read_line(r, line, sizeof(line));
+                break;
+            }
+            if (body_len + chunk > RPC_BODY_MAX) goto fail_body;
+            char *grown = realloc(body, body_len + chunk + 1);
+            if (!grown) goto fail_body;
+            body = grown;
+            if (read_exact(r, body + body_len, chunk) != 0) goto fail_body;
+            body_len += chunk;
+            if (read_line(r, line, sizeof(line)) != 0) goto fail_body;
+        }
+    } else if (content_length >= 0) {
+        if ((unsigned long)content_length > RPC_BODY_MAX) goto fail;
+        body = malloc((size_t)content_length + 1);
+        if (!body) goto fail;
+        if (read_exact(r, body, (size_t)content_length) != 0) goto fail_body;
+        body_len = (size_t)content_length;
+    } else {
+        goto fail;
+    }
+
+    if (!body) body = malloc(1);
+    if (!body) goto fail;
+    body[body_len] = '\0';
+    free(r);
+
+    if (status != 200) {
+        GW_LOGW(TAG, "HTTP %d from node", status);
+        free(body);
+        return -1;
+    }
+    *body_out = body;
+    *body_len_out = body_len;
+    return 0;
+
+fail_body:
+    free(body);
+fail:
+    free(r);
+    *keep_alive = 0;
+    return -1;
+}
+
+int gw_rpc_post(gw_rpc_t *rpc, const char *body, size_t body_len, gw_json_doc_t *reply)
+{
+    char header[512];
+    int header_len = snprintf(header, sizeof(header),
+                              "POST %s HTTP/1.1\r\n"
+                              "Host: %s:%s\r\n"
+                              "Content-Type: application/json\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: keep-alive\r\n\r\n",
+                              rpc->path, rpc->host, rpc->port, body_len);
+
+    // A kept-alive connection may have been closed by the node while idle.
+    // Only retry on a fresh connection if the request cannot have been
+    // processed: once it is fully sent a lost reply is reported, since
+    // resending eth_sendTransaction could record a window twice.
+    if (rpc->fd >= 0 && peer_closed(rpc->fd)) gw_rpc_close(rpc);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (rpc->fd < 0 && connect_node(rpc) != 0) return -1;
+
+        if (send_all(rpc->fd, header, (size_t)header_len) != 0 || send_all(rpc->fd, body, body_len) != 0) {
+            gw_rpc_close(rpc);
+            continue;
+        }
+
+        char *resp = NULL;
+        size_t resp_len = 0;
+        int keep_alive = 0;
+        if (read_response(rpc, &resp, &resp_len, &keep_alive) != 0) {
+            gw_rpc_close(rpc);
+            return -1;
+        }
+        if (!keep_alive) gw_rpc_close(rpc);
+        if (gw_json_parse(reply, resp, resp_len) != 0) {
+            GW_LOGE(TAG, "Malformed JSON-RPC reply");
+            gw_json_free(reply);
+            return -1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+int gw_rpc_call(gw_rpc_t *rpc, const char *method, const char *params_json,
+                gw_json_doc_t *reply, const gw_json_t **result)
+{
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *f = open_memstream(&body, &body_len);
+    if (!f) return -1;
+    fprintf(f, "{\"jsonrpc\":\"2.0\",\"id\":%llu,\"method\":\"%s\",\"params\":%s}",
+            (unsigned long long)rpc->next_id++, method, params_json ? params_json : "[]");
+    fclose(f);
+
+    int rc = gw_rpc_post(rpc, body, body_len, reply);
+    free(body);
+    if (rc != 0) return -1;
+
+    const gw_json_t *res = gw_json_get(reply->root, "result");
+    if (!res) {
+        char msg[256];
+        GW_LOGW(TAG, "%s failed: %s", method, gw_rpc_error_message(reply->root, msg, sizeof(msg)));
+        gw_json_free(reply);
+        return -1;
+    }
+    *result = res;
+    return 0;
+}
+
+const char *gw_rpc_error_message(const gw_json_t *response, char *buf, size_t buf_len)
+{
+    const gw_json_t *err = gw_json_get(response, "error");
+    const gw_json_t *msg = gw_json_get(err, "message");
+    if (!msg || gw_json_copy_str(msg, buf, buf_len) != 0) {
+        snprintf(buf, buf_len, "%s", err ? "unknown error" : "no error");
+    }
+    return buf;
+}
+
+int gw_rpc_registry_address(const char *registry_path, const char *contract_key, uint64_t chain_id,
+                            char *out, size_t out_len)
+{
+    FILE *f = fopen(registry_path, "rb");
+    if (!f) {
+        GW_LOGE(TAG, "Cannot open registry %s", registry_path);
+        return -1;
+    }
+    char *text = NULL;
+    size_t len = 0;
+    FILE *mem = open_memstream(&text, &len);
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) fwrite(chunk, 1, n, mem);
+    fclose(f);
+    fclose(mem);
+
+    gw_json_doc_t doc;
+    if (gw_json_parse(&doc, text, len) != 0) {
+        GW_LOGE(TAG, "Registry %s is not valid JSON", registry_path);
+        gw_json_free(&doc);
+        return -1;
+    }
+
+    char chain_key[24];
+    snprintf(chain_key, sizeof(chain_key), "%llu", (unsigned long long)chain_id);
+    const gw_json_t *entry = gw_json_get(gw_json_get(doc.root, contract_key), chain_key);
+    int rc = gw_json_copy_str(gw_json_get(entry, "address"), out, out_len);
+    gw_json_free(&doc);
+
+    if (rc != 0) {
+        GW_LOGE(TAG, "No contract registry entry found for key \"%s\" on chain %s", contract_key, chain_key);
+    }
+    return rc;
+}
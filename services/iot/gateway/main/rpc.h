@@ -0,0 +1,34 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json.h"
+
+// Blocking JSON-RPC over HTTP/1.1 with a kept-alive connection. Plain http://
+// only: the gateway talks to a node on the same host or LAN.
+typedef struct {
+    char host[128];
+    char port[8];
+    char path[128];
+    int fd;
+    uint64_t next_id;
+} gw_rpc_t;
+
+int gw_rpc_open(gw_rpc_t *rpc, const char *url);
+void gw_rpc_close(gw_rpc_t *rpc);
+
+// Posts a request body (a single call or a batch array) and parses the reply.
+int gw_rpc_post(gw_rpc_t *rpc, const char *body, size_t body_len, gw_json_doc_t *reply);
+
+// Single call; params_json is the JSON text of the params array. On success
+// *result points into reply and stays valid until gw_json_free(reply).
+int gw_rpc_call(gw_rpc_t *rpc, const char *method, const char *params_json,
+                gw_json_doc_t *reply, const gw_json_t **result);
+
+// Copies the error message of a JSON-RPC response object, if any.
+const char *gw_rpc_error_message(const gw_json_t *response, char *buf, size_t buf_len);
+
+// Looks up the contract address for chain_id in the ChainProof registry file
+// (services/smart-contracts/config/contracts.json).
+int gw_rpc_registry_address(const char *registry_path, const char *contract_key, uint64_t chain_id,
+                            char *out, size_t out_len);
@@ -0,0 +1,463 @@
+#include "source.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "gw_log.h"
+#include "gw_time.h"
+#include "payload.h"
+#include "timesync.h"
+
+static const char *TAG = "SOURCE";
+
+#define UNIX_RECV_BATCH 64
+
+static void *unix_source_task(void *param)
+{
+    gw_source_t *src = param;
+    gw_raw_t *frames = calloc(UNIX_RECV_BATCH, sizeof(*frames));
+    if (!frames) return NULL;
+
+    struct mmsghdr msgs[UNIX_RECV_BATCH];
+    struct iovec iov[UNIX_RECV_BATCH];
+
+    for (int i = 0; i < UNIX_RECV_BATCH; i++) {
+        iov[i].iov_base = frames[i].data;
+        iov[i].iov_len = sizeof(frames[i].data);
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (!atomic_load(src->stop)) {
+        int n = recvmmsg(src->fd, msgs, UNIX_RECV_BATCH, MSG_WAITFORONE, NULL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            GW_LOGE(TAG, "recvmmsg failed: %s", strerror(errno));
+            break;
+        }
+
+        uint64_t now = gw_now_ns();
+        for (int i = 0; i < n; i++) {
+            frames[i].rx_ns = now;
+            frames[i].len = (uint16_t)(msgs[i].msg_len > GW_FRAME_MAX_LEN ? GW_FRAME_MAX_LEN : msgs[i].msg_len);
+            gw_queue_try_push(src->out, &frames[i]);
+        }
+    }
+    free(frames);
+    return NULL;
+}
+
+int gw_source_unix_start(gw_source_t *src, const char *path, gw_queue_t *out, atomic_bool *stop)
+{
+    memset(src, 0, sizeof(*src));
+    src->name = "unix";
+    src->out = out;
+    src->stop = stop;
+    src->unix_path = path;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        GW_LOGE(TAG, "Socket path too long: %s", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    src->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (src->fd < 0) return -1;
+
+    unlink(path);
+    if (bind(src->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        GW_LOGE(TAG, "Bind %s failed: %s", path, strerror(errno));
+        close(src->fd);
+        return -1;
+    }
+
+    // Large receive buffer absorbs bursts from thousands of tags; the short
+    // timeout lets the thread notice shutdown.
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(src->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 200000 };
+    setsockopt(src->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    src->threads = calloc(1, sizeof(pthread_t));
+    if (!src->threads || pthread_create(&src->threads[0], NULL, unix_source_task, src) != 0) {
+        close(src->fd);
+        return -1;
+    }
+    src->thread_count = 1;
+    GW_LOGI(TAG, "Listening on %s", path);
+    return 0;
+}
+
+#if GATEWAY_ENABLE_BLE
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/l2cap.h>
+
+#define ATT_CID                     4
+#define ATT_OP_ERROR_RSP            0x01
+#define ATT_OP_MTU_REQ              0x02
+#define ATT_OP_MTU_RSP              0x03
+#define ATT_OP_READ_BY_TYPE_REQ     0x08
+#define ATT_OP_READ_BY_TYPE_RSP     0x09
+#define ATT_OP_READ_REQ             0x0A
+#define ATT_OP_READ_RSP             0x0B
+#define ATT_OP_WRITE_REQ            0x12
+#define ATT_OP_WRITE_RSP            0x13
+#define ATT_OP_HANDLE_VALUE_NTF     0x1B
+#define ATT_OP_HANDLE_VALUE_IND     0x1D
+#define ATT_OP_HANDLE_VALUE_CFM     0x1E
+#define GATT_CHARACTERISTIC_UUID    0x2803
+#define ATT_PREFERRED_MTU           247
+#define BLE_RECONNECT_DELAY_MS      2000
+
+// Time-sync reads: a few in quick succession after connecting, so one of
+// them is likely to catch a short round trip, then one every
+// SYNC_INTERVAL_S to follow the tag's drift.
+#define SYNC_BURST                  4
+#define SYNC_BURST_GAP_MS           1000
+#define SYNC_INTERVAL_S             600
+
+// g_chr_uuid in services/iot/blink/main/main.c, in over-the-air byte order
+static const uint8_t s_payload_chr_uuid[16] = {
+    0x9a, 0x8b, 0x7c, 0x6d, 0x5e, 0x4f, 0x3a, 0x2b, 0x1c, 0x0d, 0xfe, 0xed, 0xbe, 0xef, 0x10, 0x02,
+};
+
+// g_tap_chr_uuid; only tags with an NFC reader notify on it
+static const uint8_t s_tap_chr_uuid[16] = {
+    0x9a, 0x8b, 0x7c, 0x6d, 0x5e, 0x4f, 0x3a, 0x2b, 0x1c, 0x0d, 0xfe, 0xed, 0xbe, 0xef, 0x10, 0x04,
+};
+
+// g_time_chr_uuid; tags from before it lack the characteristic
+static const uint8_t s_time_chr_uuid[16] = {
+    0x9a, 0x8b, 0x7c, 0x6d, 0x5e, 0x4f, 0x3a, 0x2b, 0x1c, 0x0d, 0xfe, 0xed, 0xbe, 0xef, 0x10, 0x05,
+};
+
+typedef struct {
+    uint16_t handle;        // 0 when the tag has no time-sync characteristic
+    bool outstanding;
+    uint64_t sent_unix_us;
+    uint64_t sent_ns;
+    uint64_t next_ns;
+    int burst_left;
+    gw_clock_t clock;       // this link's own view, for writing the epoch back
+} ble_sync_t;
+
+typedef struct {
+    gw_source_t *src;
+    const char *addr;
+    ble_sync_t sync;
+} ble_link_t;
+
+static int att_request(int fd, const uint8_t *req, size_t req_len, uint8_t *rsp, size_t rsp_max, uint8_t expect)
+{
+    if (send(fd, req, req_len, 0) != (ssize_t)req_len) return -1;
+    for (;;) {
+        ssize_t n = recv(fd, rsp, rsp_max, 0);
+        if (n <= 0) return -1;
+        if (rsp[0] == expect || rsp[0] == ATT_OP_ERROR_RSP) return (int)n;
+        // Notifications can arrive before discovery finishes; drop them.
+    }
+}
+
+typedef struct {
+    uint16_t value;
+    uint16_t tap;           // 0 when absent
+    uint16_t time;          // 0 when absent
+} ble_handles_t;
+
+static int find_handles(int fd, ble_handles_t *h)
+{
+    uint16_t start = 0x0001;
+    memset(h, 0, sizeof(*h));
+    uint8_t rsp[ATT_PREFERRED_MTU];
+
+    while (start != 0) {
+        uint8_t req[7] = {
+            ATT_OP_READ_BY_TYPE_REQ,
+            (uint8_t)start, (uint8_t)(start >> 8),
+            0xFF, 0xFF,
+            (uint8_t)GATT_CHARACTERISTIC_UUID, (uint8_t)(GATT_CHARACTERISTIC_UUID >> 8),
+        };
+        int n = att_request(fd, req, sizeof(req), rsp, sizeof(rsp), ATT_OP_READ_BY_TYPE_RSP);
+        if (n < 2 || rsp[0] != ATT_OP_READ_BY_TYPE_RSP) return -1;
+
+        // Entries: handle(2) properties(1) value_handle(2) uuid(2 or 16)
+        size_t entry_len = rsp[1];
+        if (entry_len < 7) return -1;
+        uint16_t last = 0;
+        for (size_t off = 2; off + entry_len <= (size_t)n; off += entry_len) {
+            last = (uint16_t)(rsp[off] | (rsp[off + 1] << 8));
+            if (entry_len != 21) continue;
+            uint16_t handle = (uint16_t)(rsp[off + 3] | (rsp[off + 4] << 8));
+            if (memcmp(&rsp[off + 5], s_payload_chr_uuid, 16) == 0) h->value = handle;
+            if (memcmp(&rsp[off + 5], s_tap_chr_uuid, 16) == 0) h->tap = handle;
+            if (memcmp(&rsp[off + 5], s_time_chr_uuid, 16) == 0) h->time = handle;
+        }
+        // The time-sync characteristic is declared last.
+        if (h->value && h->time) break;
+        start = (uint16_t)(last + 1);
+    }
+    return h->value ? 0 : -1;
+}
+
+static int ble_connect(const char *addr, uint64_t *device)
+{
+    int fd = socket(AF_BLUETOOTH, SOCK_SEQPACKET, BTPROTO_L2CAP);
+    if (fd < 0) return -1;
+
+    struct sockaddr_l2 local = { .l2_family = AF_BLUETOOTH, .l2_cid = htobs(ATT_CID), .l2_bdaddr_type = BDADDR_LE_PUBLIC };
+    bacpy(&local.l2_bdaddr, BDADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0) goto fail;
+
+    // The tag rejects reads and notifications on unencrypted links.
+    struct bt_security sec = { .level = BT_SECURITY_MEDIUM };
+    if (setsockopt(fd, SOL_BLUETOOTH, BT_SECURITY, &sec, sizeof(sec)) != 0) goto fail;
+
+    struct sockaddr_l2 remote = { .l2_family = AF_BLUETOOTH, .l2_cid = htobs(ATT_CID), .l2_bdaddr_type = BDADDR_LE_PUBLIC };
+    if (str2ba(addr, &remote.l2_bdaddr) != 0) goto fail;
+    if (connect(fd, (struct sockaddr *)&remote, sizeof(remote)) != 0) goto fail;
+
+    *device = 0;
+    for (int i = 5; i >= 0; i--) *device = (*device << 8) | remote.l2_bdaddr.b[i];
+    return fd;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+static int ble_discover(int fd, ble_handles_t *h)
+{
+    uint8_t rsp[ATT_PREFERRED_MTU];
+    uint8_t mtu_req[3] = { ATT_OP_MTU_REQ, (uint8_t)ATT_PREFERRED_MTU, (uint8_t)(ATT_PREFERRED_MTU >> 8) };
+    att_request(fd, mtu_req, sizeof(mtu_req), rsp, sizeof(rsp), ATT_OP_MTU_RSP);
+    return find_handles(fd, h);
+}
+
+static int ble_subscribe(int fd, uint16_t value_handle)
+{
+    uint8_t rsp[ATT_PREFERRED_MTU];
+    // NimBLE places the CCCD right after the value attribute.
+    uint16_t cccd = (uint16_t)(value_handle + 1);
+    uint8_t write_req[5] = { ATT_OP_WRITE_REQ, (uint8_t)cccd, (uint8_t)(cccd >> 8), 0x01, 0x00 };
+    int n = att_request(fd, write_req, sizeof(write_req), rsp, sizeof(rsp), ATT_OP_WRITE_RSP);
+    return (n >= 1 && rsp[0] == ATT_OP_WRITE_RSP) ? 0 : -1;
+}
+
+static void sync_poll(int fd, ble_sync_t *sync, uint64_t now_ns)
+{
+    if (!sync->handle) return;
+    if (sync->outstanding && now_ns - sync->sent_ns > (uint64_t)GW_CLOCK_MAX_RTT_MS * 1000000ull) {
+        sync->outstanding = false;
+    }
+    if (sync->outstanding || now_ns < sync->next_ns) return;
+
+    uint8_t req[3] = { ATT_OP_READ_REQ, (uint8_t)sync->handle, (uint8_t)(sync->handle >> 8) };
+    sync->sent_unix_us = gw_unix_us();
+    sync->sent_ns = now_ns;
+    if (send(fd, req, sizeof(req), 0) == (ssize_t)sizeof(req)) sync->outstanding = true;
+}
+
+// Forwards a read response to the pipeline and, at the end of a burst,
+// writes the epoch this link has measured back to the tag. The tag only
+// accepts that from a bonded gateway; a refusal is harmless.
+static void sync_response(int fd, gw_source_t *src, ble_sync_t *sync, uint64_t device,
+                          const uint8_t *value, size_t len)
+{
+    uint64_t recv_unix_us = gw_unix_us();
+    uint64_t now_ns = gw_now_ns();
+    sync->outstanding = false;
+    bool burst_done = --sync->burst_left <= 0;
+    sync->next_ns = now_ns + (burst_done ? SYNC_INTERVAL_S * 1000000000ull : SYNC_BURST_GAP_MS * 1000000ull);
+    if (burst_done) sync->burst_left = 1;   // later reads come one at a time
+    if (len != sizeof(gw_time_sync_t)) return;
+
+    gw_raw_t raw;
+    raw.rx_ns = now_ns;
+    raw.len = (uint16_t)gw_sync_frame_build(raw.data, sizeof(raw.data), device, sync->sent_unix_us,
+                                           recv_unix_us, value, len);
+    gw_reading_t reading;
+    if (!raw.len || gw_payload_decode(&raw, &reading) != 0) return;
+    gw_queue_try_push(src->out, &raw);
+
+    if (gw_clock_add_sync(&sync->clock, &reading.sync) != 0 || !burst_done) return;
+    gw_time_sync_set_t set;
+    uint64_t uptime_ms = reading.sync.uptime_us / 1000;
+    uint64_t unix_ms;
+    uint32_t err_ms;
+    if (gw_clock_to_unix(&sync->clock, uptime_ms, &unix_ms, &err_ms) != GW_CLOCK_SYNCED) return;
+    set.unix_ms = unix_ms;
+    set.at_uptime_ms = (uint32_t)uptime_ms;
+    set.drift_ppb = gw_clock_drift_ppb(&sync->clock);
+
+    uint8_t req[3 + sizeof(set)] = { ATT_OP_WRITE_REQ, (uint8_t)sync->handle, (uint8_t)(sync->handle >> 8) };
+    memcpy(req + 3, &set, sizeof(set));
+    send(fd, req, sizeof(req), 0);
+}
+
+// Reads the clock once before subscribing: the tag starts sending its
+// backlog on subscribe, and the pipeline can only place those samples
+// precisely once it has a sync read for the boot they come from.
+static void sync_first(int fd, gw_source_t *src, ble_sync_t *sync, uint64_t device)
+{
+    if (!sync->handle) return;
+    uint8_t req[3] = { ATT_OP_READ_REQ, (uint8_t)sync->handle, (uint8_t)(sync->handle >> 8) };
+    uint8_t rsp[ATT_PREFERRED_MTU];
+    sync->sent_unix_us = gw_unix_us();
+    sync->sent_ns = gw_now_ns();
+    int n = att_request(fd, req, sizeof(req), rsp, sizeof(rsp), ATT_OP_READ_RSP);
+    if (n >= 1 && rsp[0] == ATT_OP_READ_RSP) sync_response(fd, src, sync, device, rsp + 1, (size_t)n - 1);
+}
+
+static void *ble_link_task(void *param)
+{
+    ble_link_t *link = param;
+    gw_source_t *src = link->src;
+    uint32_t seq = 0;
+
+    while (!atomic_load(src->stop)) {
+        uint64_t device = 0;
+        ble_handles_t h = { 0 };
+        ble_sync_t *sync = &link->sync;
+        int fd = ble_connect(link->addr, &device);
+        if (fd >= 0 && ble_discover(fd, &h) == 0) {
+            sync->handle = h.time;
+            sync->outstanding = false;
+            sync->burst_left = SYNC_BURST;
+            sync->next_ns = gw_now_ns();
+            sync_first(fd, src, sync, device);
+            // Before the payload, whose backlog would otherwise arrive while
+            // this write waits for its response and be dropped.
+            if (h.tap && src->on_tap && ble_subscribe(fd, h.tap) != 0) {
+                GW_LOGW(TAG, "BLE %s: cannot subscribe to NFC taps", link->addr);
+                h.tap = 0;
+            }
+        }
+        uint16_t value_handle = h.value;
+        if (fd < 0 || !value_handle || ble_subscribe(fd, value_handle) != 0) {
+            GW_LOGW(TAG, "BLE %s: connect/subscribe failed, retrying", link->addr);
+            if (fd >= 0) close(fd);
+            usleep(BLE_RECONNECT_DELAY_MS * 1000);
+            continue;
+        }
+        GW_LOGI(TAG, "BLE %s: subscribed to handle 0x%04X%s%s", link->addr, value_handle,
+                h.time ? "" : " (no time sync)", h.tap && src->on_tap ? " and NFC taps" : "");
+
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 200000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        uint8_t pdu[ATT_PREFERRED_MTU];
+        while (!atomic_load(src->stop)) {
+            sync_poll(fd, sync, gw_now_ns());
+            ssize_t n = recv(fd, pdu, sizeof(pdu), 0);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+            if (n <= 0) break;
+
+            if (pdu[0] == ATT_OP_READ_RSP && sync->outstanding) {
+                sync_response(fd, src, sync, device, pdu + 1, (size_t)n - 1);
+                continue;
+            }
+            if (pdu[0] == ATT_OP_ERROR_RSP && n >= 2 && pdu[1] == ATT_OP_READ_REQ) {
+                sync->outstanding = false;
+                sync->next_ns = gw_now_ns() + SYNC_INTERVAL_S * 1000000000ull;
+                continue;
+            }
+
+            if (pdu[0] == ATT_OP_HANDLE_VALUE_IND) {
+                uint8_t cfm = ATT_OP_HANDLE_VALUE_CFM;
+                send(fd, &cfm, 1, 0);
+            } else if (pdu[0] != ATT_OP_HANDLE_VALUE_NTF) {
+                continue;
+            }
+            if (n < 3) continue;
+            uint16_t handle = (uint16_t)(pdu[1] | (pdu[2] << 8));
+            if (h.tap && handle == h.tap) {
+                gw_nfc_tap_t tap;
+                if ((size_t)n - 3 != sizeof(tap)) continue;
+                memcpy(&tap, pdu + 3, sizeof(tap));
+                if (tap.uid_len <= GW_NFC_UID_MAX) src->on_tap(src->tap_ctx, device, &tap);
+                continue;
+            }
+            if (handle != value_handle) continue;
+
+            // The link is ordered and reliable, so a gateway-local counter is
+            // enough to give the dedupe stage a sequence for legacy payloads;
+            // chained payloads carry the tag's own and the decoder uses that.
+            gw_raw_t raw;
+            raw.rx_ns = gw_now_ns();
+            raw.len = (uint16_t)gw_frame_build(raw.data, sizeof(raw.data), device, seq++, pdu + 3, (size_t)n - 3);
+            if (raw.len) gw_queue_try_push(src->out, &raw);
+        }
+
+        close(fd);
+        GW_LOGW(TAG, "BLE %s: link lost", link->addr);
+    }
+    free(link);
+    return NULL;
+}
+
+int gw_source_ble_start(gw_source_t *src, const char **addrs, size_t count, gw_queue_t *out, gw_tap_fn on_tap,
+                        void *tap_ctx, atomic_bool *stop)
+{
+    memset(src, 0, sizeof(*src));
+    src->name = "ble";
+    src->out = out;
+    src->on_tap = on_tap;
+    src->tap_ctx = tap_ctx;
+    src->stop = stop;
+    src->fd = -1;
+    src->ble_addrs = addrs;
+    src->ble_count = count;
+    src->threads = calloc(count, sizeof(pthread_t));
+    if (!src->threads) return -1;
+
+    for (size_t i = 0; i < count; i++) {
+        ble_link_t *link = calloc(1, sizeof(*link));
+        if (!link) return -1;
+        gw_clock_init(&link->sync.clock);
+        link->src = src;
+        link->addr = addrs[i];
+        if (pthread_create(&src->threads[i], NULL, ble_link_task, link) != 0) {
+            free(link);
+            return -1;
+        }
+        src->thread_count++;
+    }
+    return 0;
+}
+
+#else
+
+int gw_source_ble_start(gw_source_t *src, const char **addrs, size_t count, gw_queue_t *out, gw_tap_fn on_tap,
+                        void *tap_ctx, atomic_bool *stop)
+{
+    (void)addrs;
+    (void)count;
+    (void)out;
+    (void)on_tap;
+    (void)tap_ctx;
+    (void)stop;
+    memset(src, 0, sizeof(*src));
+    src->fd = -1;
+    GW_LOGE(TAG, "BLE support not built; reconfigure with -DGATEWAY_ENABLE_BLE=ON");
+    return -1;
+}
+
+#endif
+
+void gw_source_join(gw_source_t *src)
+{
+    for (size_t i = 0; i < src->thread_count; i++) pthread_join(src->threads[i], NULL);
+    free(src->threads);
+    src->threads = NULL;
+    src->thread_count = 0;
+    if (src->fd >= 0) close(src->fd);
+    src->fd = -1;
+    if (src->unix_path) unlink(src->unix_path);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "payload.h"
+#include "queue.h"
+
+// Called from the link's thread for each NFC tap a tag reports.
+typedef void (*gw_tap_fn)(void *ctx, uint64_t device, const gw_nfc_tap_t *tap);
+
+// Producers for the raw frame queue. Each source runs its own thread(s) and
+// drops frames (counted on the queue) rather than block the radio or socket.
+typedef struct {
+    const char *name;
+    gw_queue_t *out;
+    atomic_bool *stop;
+    int fd;
+    const char *unix_path;
+    pthread_t *threads;
+    size_t thread_count;
+    // BLE only
+    const char **ble_addrs;
+    size_t ble_count;
+    gw_tap_fn on_tap;
+    void *tap_ctx;
+} gw_source_t;
+
+// Listens for simulator or forwarder datagrams on a UNIX socket.
+int gw_source_unix_start(gw_source_t *src, const char *path, gw_queue_t *out, atomic_bool *stop);
+
+// Connects to each tag over LE ATT and subscribes to its payload notifications,
+// and to NFC tap notifications on tags with a reader, which go to on_tap (may
+// be NULL). Only available when built with GATEWAY_ENABLE_BLE.
+int gw_source_ble_start(gw_source_t *src, const char **addrs, size_t count, gw_queue_t *out, gw_tap_fn on_tap,
+                        void *tap_ctx, atomic_bool *stop);
+
+void gw_source_join(gw_source_t *src);
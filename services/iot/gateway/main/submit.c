@@ -0,0 +1,631 @@
+#include "submit.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "gw_log.h"
+#include "gw_time.h"
+#include "keccak.h"
+
+static const char *TAG = "SUBMIT";
+
+#define RECORD_WINDOW_SIGNATURE \
+    "recordSensorWindow(bytes32,uint32,uint32,uint32,int16,int16,uint16,uint16,uint8,uint64,uint64,uint32)"
+#define RECORD_WINDOW_WORDS 12
+#define CALLDATA_HEX_LEN (2 + 2 * (4 + 32 * RECORD_WINDOW_WORDS))
+
+static void hex_encode(const uint8_t *in, size_t len, char *out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = digits[in[i] >> 4];
+        out[2 * i + 1] = digits[in[i] & 0xF];
+    }
+    out[2 * len] = '\0';
+}
+
+static void put_word_u64(uint8_t word[32], uint64_t v)
+{
+    memset(word, 0, 32);
+    for (int i = 0; i < 8; i++) word[31 - i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_word_i64(uint8_t word[32], int64_t v)
+{
+    memset(word, v < 0 ? 0xFF : 0x00, 32);
+    for (int i = 0; i < 8; i++) word[31 - i] = (uint8_t)((uint64_t)v >> (8 * i));
+}
+
+static int16_t to_centi_i16(float v)
+{
+    float c = roundf(v * 100.0f);
+    if (c > INT16_MAX) return INT16_MAX;
+    if (c < INT16_MIN) return INT16_MIN;
+    return (int16_t)c;
+}
+
+static uint16_t to_centi_u16(float v)
+{
+    float c = roundf(v * 100.0f);
+    if (c > UINT16_MAX) return UINT16_MAX;
+    if (c < 0) return 0;
+    return (uint16_t)c;
+}
+
+static void encode_calldata(const gw_submitter_t *s, const gw_window_t *w, char out[CALLDATA_HEX_LEN + 1])
+{
+    uint8_t data[4 + 32 * RECORD_WINDOW_WORDS];
+    uint8_t *word = data + 4;
+    memcpy(data, s->selector, 4);
+
+    memset(word, 0, 32);
+    for (int i = 0; i < 6; i++) word[i] = (uint8_t)(w->device >> (8 * (5 - i)));
+    word[6] = w->probe;
+    put_word_u64(word += 32, w->first_seq);
+    put_word_u64(word += 32, w->last_seq);
+    put_word_u64(word += 32, w->samples);
+    put_word_i64(word += 32, to_centi_i16(w->temp_min));
+    put_word_i64(word += 32, to_centi_i16(w->temp_max));
+    put_word_u64(word += 32, to_centi_u16(w->humi_min));
+    put_word_u64(word += 32, to_centi_u16(w->humi_max));
+    put_word_u64(word += 32, w->flags);
+    put_word_u64(word += 32, w->first_unix_ms);
+    put_word_u64(word += 32, w->last_unix_ms);
+    put_word_u64(word += 32, w->time_err_ms);
+
+    out[0] = '0';
+    out[1] = 'x';
+    hex_encode(data, sizeof(data), out + 2);
+}
+
+static int fetch_nonce(gw_submitter_t *s, const char *block_tag, uint64_t *nonce)
+{
+    char params[96];
+    snprintf(params, sizeof(params), "[\"%s\",\"%s\"]", s->cfg.from, block_tag);
+
+    gw_json_doc_t reply;
+    const gw_json_t *result;
+    if (gw_rpc_call(&s->rpc, "eth_getTransactionCount", params, &reply, &result) != 0) return -1;
+    int rc = gw_json_u64(result, nonce);
+    gw_json_free(&reply);
+    return rc;
+}
+
+static int resync_nonce(gw_submitter_t *s)
+{
+    uint64_t nonce;
+    if (fetch_nonce(s, "pending", &nonce) != 0) return -1;
+    // Nonces pinned to in-flight windows stay theirs even if the node lost
+    // those transactions; gw_submit_poll resends them.
+    for (size_t i = 0; i < s->inflight_count; i++) {
+        if (s->inflight[i].nonce >= nonce) nonce = s->inflight[i].nonce + 1;
+    }
+    if (nonce != s->next_nonce) {
+        GW_LOGW(TAG, "Nonce resync %llu -> %llu", (unsigned long long)s->next_nonce, (unsigned long long)nonce);
+    }
+    s->next_nonce = nonce;
+    s->stats.nonce_resyncs++;
+    return 0;
+}
+
+static int resolve_contract(gw_submitter_t *s)
+{
+    if (s->cfg.contract) {
+        snprintf(s->contract, sizeof(s->contract), "%s", s->cfg.contract);
+        return 0;
+    }
+    return gw_rpc_registry_address(s->cfg.registry_path, s->cfg.contract_key, s->chain_id, s->contract,
+                                   sizeof(s->contract));
+}
+
+int gw_submit_init(gw_submitter_t *s, const gw_submit_config_t *cfg)
+{
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    s->dry_run = cfg->rpc_url == NULL;
+    s->inflight = calloc(cfg->max_inflight, sizeof(*s->inflight));
+    s->requeued = calloc(cfg->max_inflight, sizeof(*s->requeued));
+    s->gaps = calloc(cfg->max_inflight, sizeof(*s->gaps));
+    if (!s->inflight || !s->requeued || !s->gaps) return -1;
+
+    uint8_t digest[32];
+    gw_keccak256(RECORD_WINDOW_SIGNATURE, strlen(RECORD_WINDOW_SIGNATURE), digest);
+    memcpy(s->selector, digest, 4);
+
+    if (s->dry_run) {
+        GW_LOGI(TAG, "Dry run: windows are counted but not submitted");
+        return 0;
+    }
+
+    if (!cfg->from) {
+        GW_LOGE(TAG, "A gateway account (--from) is required to submit transactions");
+        return -1;
+    }
+    if (gw_rpc_open(&s->rpc, cfg->rpc_url) != 0) return -1;
+
+    gw_json_doc_t reply;
+    const gw_json_t *result;
+    if (gw_rpc_call(&s->rpc, "eth_chainId", "[]", &reply, &result) != 0) return -1;
+    int rc = gw_json_u64(result, &s->chain_id);
+    gw_json_free(&reply);
+    if (rc != 0) return -1;
+
+    if (resolve_contract(s) != 0) return -1;
+    if (fetch_nonce(s, "pending", &s->next_nonce) != 0) return -1;
+
+    GW_LOGI(TAG, "Chain %llu, ChainProof at %s, sending from %s starting at nonce %llu",
+            (unsigned long long)s->chain_id, s->contract, cfg->from, (unsigned long long)s->next_nonce);
+    return 0;
+}
+
+void gw_submit_destroy(gw_submitter_t *s)
+{
+    gw_rpc_close(&s->rpc);
+    free(s->inflight);
+    free(s->requeued);
+    free(s->gaps);
+    s->inflight = NULL;
+    s->requeued = NULL;
+    s->gaps = NULL;
+}
+
+size_t gw_submit_capacity(const gw_submitter_t *s)
+{
+    return s->cfg.max_inflight - s->inflight_count;
+}
+
+size_t gw_submit_inflight(const gw_submitter_t *s)
+{
+    return s->inflight_count;
+}
+
+static void record_confirmed(gw_submitter_t *s, uint64_t sent_ns)
+{
+    uint64_t took = gw_now_ns() - sent_ns;
+    s->stats.confirmed++;
+    s->stats.confirm_ns_total += took;
+    if (took > s->stats.confirm_ns_max) s->stats.confirm_ns_max = took;
+}
+
+static bool is_nonce_error(const char *msg)
+{
+    return strstr(msg, "nonce") || strstr(msg, "Nonce") || strstr(msg, "already known") ||
+           strstr(msg, "replacement transaction");
+}
+
+static void fill_gaps(gw_submitter_t *s);
+
+size_t gw_submit_send(gw_submitter_t *s, const gw_window_t *windows, size_t count, gw_window_t *retry)
+{
+    if (count > gw_submit_capacity(s)) count = gw_submit_capacity(s);
+    if (count > s->cfg.batch_size) count = s->cfg.batch_size;
+    if (count == 0) return 0;
+
+    if (s->dry_run) {
+        uint64_t now = gw_now_ns();
+        for (size_t i = 0; i < count; i++) {
+            s->next_nonce++;
+            s->stats.sent++;
+            record_confirmed(s, now);
+        }
+        return 0;
+    }
+
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *f = open_memstream(&body, &body_len);
+    if (!f) return 0;
+
+    uint64_t first_id = s->rpc.next_id;
+    s->rpc.next_id += count;
+    fputc('[', f);
+    for (size_t i = 0; i < count; i++) {
+        char data[CALLDATA_HEX_LEN + 1];
+        encode_calldata(s, &windows[i], data);
+        fprintf(f,
+                "%s{\"jsonrpc\":\"2.0\",\"id\":%llu,\"method\":\"eth_sendTransaction\",\"params\":[{"
+                "\"from\":\"%s\",\"to\":\"%s\",\"gas\":\"0x%llx\",\"nonce\":\"0x%llx\",\"data\":\"%s\"}]}",
+                i ? "," : "", (unsigned long long)(first_id + i), s->cfg.from, s->contract,
+                (unsigned long long)s->cfg.gas_limit, (unsigned long long)(s->next_nonce + i), data);
+    }
+    fputc(']', f);
+    fclose(f);
+
+    gw_json_doc_t reply;
+    uint64_t sent_ns = gw_now_ns();
+    int rc = gw_rpc_post(&s->rpc, body, body_len, &reply);
+    free(body);
+
+    if (rc != 0) {
+        // Some of the batch may have reached the node. Track every window
+        // under the nonce it was sent with; gw_submit_poll asks the node which
+        // ones it has and resends the rest with the same nonces, so none can
+        // be recorded twice.
+        for (size_t i = 0; i < count; i++) {
+            gw_inflight_t *slot = &s->inflight[s->inflight_count++];
+            memset(slot, 0, sizeof(*slot));
+            slot->nonce = s->next_nonce + i;
+            slot->first_sent_ns = slot->sent_ns = sent_ns;
+            slot->window = windows[i];
+            s->stats.sent++;
+        }
+        GW_LOGW(TAG, "Send of %zu transactions (nonces %llu-%llu) failed; checking them against the node", count,
+                (unsigned long long)s->next_nonce, (unsigned long long)(s->next_nonce + count - 1));
+        s->next_nonce += count;
+        return 0;
+    }
+
+    size_t retries = 0;
+    bool resync = false;
+    for (size_t i = 0; i < count; i++) {
+        const gw_json_t *resp = NULL;
+        for (const gw_json_t *c = reply.root ? reply.root->child : NULL; c; c = c->next) {
+            uint64_t id;
+            if (gw_json_u64(gw_json_get(c, "id"), &id) == 0 && id == first_id + i) {
+                resp = c;
+                break;
+            }
+        }
+
+        const gw_json_t *result = gw_json_get(resp, "result");
+        gw_inflight_t *slot = &s->inflight[s->inflight_count];
+        if (result && gw_json_copy_str(result, slot->hash, sizeof(slot->hash)) == 0) {
+            slot->nonce = s->next_nonce + i;
+            slot->first_sent_ns = slot->sent_ns = sent_ns;
+            slot->window = windows[i];
+            slot->rebroadcasts = 0;
+            s->inflight_count++;
+            s->stats.sent++;
+            continue;
+        }
+
+        char msg[256];
+        gw_rpc_error_message(resp, msg, sizeof(msg));
+        resync = true;
+        if (is_nonce_error(msg)) {
+            retry[retries++] = windows[i];
+        } else {
+            char dev[18];
+            gw_device_to_string(windows[i].device, dev);
+            GW_LOGW(TAG, "Window %s seq %u-%u rejected: %s", dev, windows[i].first_seq, windows[i].last_seq, msg);
+            s->stats.failed++;
+            if (s->gap_count < s->cfg.max_inflight) s->gaps[s->gap_count++] = s->next_nonce + i;
+        }
+    }
+    gw_json_free(&reply);
+
+    s->next_nonce += count;
+    if (resync) resync_nonce(s);
+    fill_gaps(s);
+    return retries;
+}
+
+
+// Like gw_rpc_call, but a JSON-RPC error is returned (1, with its message in
+// msg) rather than logged: the recovery path expects some of them.
+static int call_checked(gw_submitter_t *s, const char *method, const char *params, gw_json_doc_t *reply,
+                        const gw_json_t **result, char *msg, size_t msg_len)
+{
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *f = open_memstream(&body, &body_len);
+    if (!f) return -1;
+    fprintf(f, "{\"jsonrpc\":\"2.0\",\"id\":%llu,\"method\":\"%s\",\"params\":%s}",
+            (unsigned long long)s->rpc.next_id++, method, params);
+    fclose(f);
+
+    int rc = gw_rpc_post(&s->rpc, body, body_len, reply);
+    free(body);
+    if (rc != 0) return -1;
+
+    *result = gw_json_get(reply->root, "result");
+    if (!*result) {
+        gw_rpc_error_message(reply->root, msg, msg_len);
+        gw_json_free(reply);
+        return 1;
+    }
+    return 0;
+}
+
+// A nonce the node rejected a window under holds back every later one from
+// the account until something uses it. Nonces at or past next_nonce are not
+// gaps: the resync found nothing after them and the next window takes them.
+// The rest get a zero-value transfer to the gateway account; one the node
+// refuses over its nonce was already used, anything else is retried on the
+// next poll.
+static void fill_gaps(gw_submitter_t *s)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < s->gap_count; i++) {
+        uint64_t nonce = s->gaps[i];
+        if (nonce >= s->next_nonce) continue;
+
+        char params[256];
+        snprintf(params, sizeof(params),
+                 "[{\"from\":\"%s\",\"to\":\"%s\",\"value\":\"0x0\",\"gas\":\"0x5208\",\"nonce\":\"0x%llx\"}]",
+                 s->cfg.from, s->cfg.from, (unsigned long long)nonce);
+        gw_json_doc_t reply;
+        const gw_json_t *result;
+        char msg[256];
+        int rc = call_checked(s, "eth_sendTransaction", params, &reply, &result, msg, sizeof(msg));
+        if (rc == 0) {
+            gw_json_free(&reply);
+            GW_LOGW(TAG, "Filled nonce %llu left by a rejected window", (unsigned long long)nonce);
+            s->stats.gap_fills++;
+        } else if (rc > 0 && is_nonce_error(msg)) {
+            continue;
+        } else {
+            if (rc > 0) GW_LOGW(TAG, "Filling nonce %llu failed: %s", (unsigned long long)nonce, msg);
+            s->gaps[kept++] = nonce;
+        }
+    }
+    s->gap_count = kept;
+}
+
+// Settles tx from its receipt; returns false if it has none yet.
+static bool settle(gw_submitter_t *s, const gw_inflight_t *tx, const gw_json_t *receipt)
+{
+    if (!receipt || receipt->type != GW_JSON_OBJECT) return false;
+    if (gw_json_str_eq(gw_json_get(receipt, "status"), "0x1")) {
+        record_confirmed(s, tx->first_sent_ns);
+    } else {
+        s->stats.reverted++;
+        GW_LOGW(TAG, "Transaction %s reverted", tx->hash);
+    }
+    return true;
+}
+
+// Sends tx's window again under its own nonce. The node either accepts it,
+// or rejects it because that nonce is already pooled or mined, which the next
+// recovery pass resolves.
+static void resend(gw_submitter_t *s, gw_inflight_t *tx, uint64_t now)
+{
+    char data[CALLDATA_HEX_LEN + 1];
+    char params[CALLDATA_HEX_LEN + 256];
+    encode_calldata(s, &tx->window, data);
+    snprintf(params, sizeof(params),
+             "[{\"from\":\"%s\",\"to\":\"%s\",\"gas\":\"0x%llx\",\"nonce\":\"0x%llx\",\"data\":\"%s\"}]", s->cfg.from,
+             s->contract, (unsigned long long)s->cfg.gas_limit, (unsigned long long)tx->nonce, data);
+
+    gw_json_doc_t reply;
+    const gw_json_t *result;
+    char msg[256];
+    int rc = call_checked(s, "eth_sendTransaction", params, &reply, &result, msg, sizeof(msg));
+    tx->sent_ns = now;
+    if (rc < 0) return;
+    if (rc > 0) {
+        if (!is_nonce_error(msg)) GW_LOGW(TAG, "Resend of nonce %llu failed: %s", (unsigned long long)tx->nonce, msg);
+        return;
+    }
+    gw_json_copy_str(result, tx->hash, sizeof(tx->hash));
+    gw_json_free(&reply);
+    tx->rebroadcasts++;
+    s->stats.rebroadcasts++;
+}
+
+// Rebroadcasts the signed transaction the node still holds, for peers whose
+// pools dropped it. Nodes without eth_getRawTransactionByHash skip this.
+static void rebroadcast(gw_submitter_t *s, gw_inflight_t *tx, uint64_t now)
+{
+    char params[80];
+    snprintf(params, sizeof(params), "[\"%s\"]", tx->hash);
+    tx->sent_ns = now;
+
+    gw_json_doc_t reply;
+    const gw_json_t *result;
+    char msg[256];
+    if (call_checked(s, "eth_getRawTransactionByHash", params, &reply, &result, msg, sizeof(msg)) != 0) return;
+    char *raw_params = NULL;
+    if (result->type == GW_JSON_STRING && (raw_params = malloc(result->len + 5)) != NULL) {
+        snprintf(raw_params, result->len + 5, "[\"%.*s\"]", (int)result->len, result->str);
+    }
+    gw_json_free(&reply);
+    if (!raw_params) return;
+
+    if (call_checked(s, "eth_sendRawTransaction", raw_params, &reply, &result, msg, sizeof(msg)) == 0) {
+        gw_json_free(&reply);
+    }
+    free(raw_params);
+    tx->rebroadcasts++;
+    s->stats.rebroadcasts++;
+}
+
+typedef struct {
+    uint64_t latest;    // next nonce to be mined
+    uint64_t pending;   // next nonce the node's pool expects
+    bool have_latest;
+    bool have_pending;
+} nonce_view_t;
+
+static int view_nonce(gw_submitter_t *s, nonce_view_t *v, bool pending, uint64_t *out)
+{
+    bool *have = pending ? &v->have_pending : &v->have_latest;
+    uint64_t *nonce = pending ? &v->pending : &v->latest;
+    if (!*have && fetch_nonce(s, pending ? "pending" : "latest", nonce) != 0) return -1;
+    *have = true;
+    *out = *nonce;
+    return 0;
+}
+
+// Finds the mined transaction that used tx's nonce, for a send whose reply
+// was lost: the account's nonce passed tx's in the first block where
+// eth_getTransactionCount at that block exceeds it. The search gallops back
+// from the head, so it only needs the recent state a pruned node still has.
+// Returns 1 and fills in tx->hash if that transaction carries tx's window, 0
+// if another transaction from the account used the nonce, -1 if the node
+// could not be asked.
+static int find_by_nonce(gw_submitter_t *s, gw_inflight_t *tx)
+{
+    gw_json_doc_t reply;
+    const gw_json_t *result;
+    char msg[256];
+    char params[48];
+    uint64_t head, count;
+    if (call_checked(s, "eth_blockNumber", "[]", &reply, &result, msg, sizeof(msg)) != 0) return -1;
+    int rc = gw_json_u64(result, &head);
+    gw_json_free(&reply);
+    if (rc != 0) return -1;
+
+    // Nonce past tx's at hi, not yet at lo (or lo is before genesis).
+    uint64_t hi = head, lo = head, step = 1;
+    for (;;) {
+        lo = lo > step ? lo - step : 0;
+        snprintf(params, sizeof(params), "0x%llx", (unsigned long long)lo);
+        if (fetch_nonce(s, params, &count) != 0) return -1;
+        if (count <= tx->nonce) break;
+        hi = lo;
+        if (lo == 0) break;
+        step *= 2;
+    }
+    while (lo + 1 < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        snprintf(params, sizeof(params), "0x%llx", (unsigned long long)mid);
+        if (fetch_nonce(s, params, &count) != 0) return -1;
+        if (count > tx->nonce) hi = mid;
+        else lo = mid;
+    }
+
+    snprintf(params, sizeof(params), "[\"0x%llx\",true]", (unsigned long long)hi);
+    if (call_checked(s, "eth_getBlockByNumber", params, &reply, &result, msg, sizeof(msg)) != 0) return -1;
+    char data[CALLDATA_HEX_LEN + 1];
+    encode_calldata(s, &tx->window, data);
+    int found = -1;
+    const gw_json_t *txs = gw_json_get(result, "transactions");
+    for (const gw_json_t *t = txs ? txs->child : NULL; t && found < 0; t = t->next) {
+        const gw_json_t *from = gw_json_get(t, "from");
+        uint64_t nonce;
+        if (!from || from->len != strlen(s->cfg.from) || strncasecmp(from->str, s->cfg.from, from->len) != 0 ||
+            gw_json_u64(gw_json_get(t, "nonce"), &nonce) != 0 || nonce != tx->nonce) {
+            continue;
+        }
+        found = gw_json_str_eq(gw_json_get(t, "input"), data) &&
+                gw_json_copy_str(gw_json_get(t, "hash"), tx->hash, sizeof(tx->hash)) == 0;
+    }
+    gw_json_free(&reply);
+    return found;
+}
+
+// Works out what became of a transaction with no receipt: one whose send
+// reply was lost, or one past the timeout. Returns true once it is settled.
+static bool recover(gw_submitter_t *s, gw_inflight_t *tx, nonce_view_t *v, uint64_t now)
+{
+    gw_json_doc_t reply;
+    const gw_json_t *result;
+    char msg[256];
+    char params[80];
+    uint64_t nonce;
+    if (view_nonce(s, v, false, &nonce) != 0) return false;
+
+    if (nonce > tx->nonce) {
+        // Something used the nonce. Without a hash, the block it went into
+        // tells whether that was this window or another sender on the account.
+        int ours = tx->hash[0] ? 1 : find_by_nonce(s, tx);
+        if (ours < 0) return false;
+        if (ours) {
+            // The receipt may have appeared since the batched poll.
+            snprintf(params, sizeof(params), "[\"%s\"]", tx->hash);
+            if (call_checked(s, "eth_getTransactionReceipt", params, &reply, &result, msg, sizeof(msg)) != 0) {
+                return false;
+            }
+            bool settled = settle(s, tx, result);
+            gw_json_free(&reply);
+            if (settled) return true;
+        }
+        if (s->requeued_count == s->cfg.max_inflight) return false;
+
+        GW_LOGW(TAG, "Nonce %llu went to another transaction; requeueing its window", (unsigned long long)tx->nonce);
+        s->stats.replaced++;
+        s->requeued[s->requeued_count++] = tx->window;
+        return true;
+    }
+
+    if (tx->hash[0]) {
+        snprintf(params, sizeof(params), "[\"%s\"]", tx->hash);
+        if (call_checked(s, "eth_getTransactionByHash", params, &reply, &result, msg, sizeof(msg)) != 0) {
+            return false;
+        }
+        bool known = result->type == GW_JSON_OBJECT;
+        gw_json_free(&reply);
+        if (known) {
+            if (tx->rebroadcasts == 0) {
+                GW_LOGW(TAG, "Transaction %s still pending after %u ms; rebroadcasting", tx->hash,
+                        s->cfg.tx_timeout_ms);
+            }
+            rebroadcast(s, tx, now);
+            return false;
+        }
+        GW_LOGW(TAG, "Transaction %s (nonce %llu) dropped from the pool; resending", tx->hash,
+                (unsigned long long)tx->nonce);
+    } else {
+        // Pooled under a hash the lost reply would have carried; wait for it
+        // to be mined.
+        if (view_nonce(s, v, true, &nonce) != 0) return false;
+        if (nonce > tx->nonce) return false;
+    }
+    resend(s, tx, now);
+    return false;
+}
+
+void gw_submit_poll(gw_submitter_t *s, bool force)
+{
+    uint64_t now = gw_now_ns();
+    if (s->dry_run || s->inflight_count == 0) return;
+    if (!force && now - s->last_poll_ns < (uint64_t)s->cfg.receipt_poll_ms * 1000000ull) return;
+    s->last_poll_ns = now;
+    if (s->gap_count) fill_gaps(s);
+
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *f = open_memstream(&body, &body_len);
+    if (!f) return;
+
+    uint64_t first_id = s->rpc.next_id;
+    s->rpc.next_id += s->inflight_count;
+    size_t requests = 0;
+    fputc('[', f);
+    for (size_t i = 0; i < s->inflight_count; i++) {
+        if (!s->inflight[i].hash[0]) continue;
+        fprintf(f, "%s{\"jsonrpc\":\"2.0\",\"id\":%llu,\"method\":\"eth_getTransactionReceipt\",\"params\":[\"%s\"]}",
+                requests++ ? "," : "", (unsigned long long)(first_id + i), s->inflight[i].hash);
+    }
+    fputc(']', f);
+    fclose(f);
+
+    gw_json_doc_t reply = { 0 };
+    int rc = requests ? gw_rpc_post(&s->rpc, body, body_len, &reply) : 0;
+    free(body);
+    if (rc != 0) return;
+
+    nonce_view_t view = { 0 };
+    uint64_t timeout_ns = (uint64_t)s->cfg.tx_timeout_ms * 1000000ull;
+    size_t kept = 0;
+    for (size_t i = 0; i < s->inflight_count; i++) {
+        gw_inflight_t *tx = &s->inflight[i];
+        const gw_json_t *resp = NULL;
+        for (const gw_json_t *c = reply.root && tx->hash[0] ? reply.root->child : NULL; c; c = c->next) {
+            uint64_t id;
+            if (gw_json_u64(gw_json_get(c, "id"), &id) == 0 && id == first_id + i) {
+                resp = c;
+                break;
+            }
+        }
+
+        if (settle(s, tx, gw_json_get(resp, "result"))) continue;
+        if ((!tx->hash[0] || now - tx->sent_ns > timeout_ns) && recover(s, tx, &view, now)) continue;
+        s->inflight[kept++] = *tx;
+    }
+    s->inflight_count = kept;
+    if (requests) gw_json_free(&reply);
+}
+
+size_t gw_submit_take_requeued(gw_submitter_t *s, gw_window_t *out, size_t max)
+{
+    size_t n = s->requeued_count < max ? s->requeued_count : max;
+    memcpy(out, s->requeued, n * sizeof(*out));
+    memmove(s->requeued, s->requeued + n, (s->requeued_count - n) * sizeof(*out));
+    s->requeued_count -= n;
+    return n;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aggregate.h"
+#include "rpc.h"
+
+// Turns closed windows into ChainProof.recordSensorWindow transactions.
+//
+// Signing is left to the node (eth_sendTransaction from an unlocked gateway
+// account, as on the local Hardhat node); the gateway owns the nonce so it can
+// put a whole batch on the wire at once instead of one round trip per window.
+typedef struct {
+    const char *rpc_url;            // NULL: dry run, windows are counted only
+    const char *from;               // gateway account, 0x-prefixed
+    const char *contract;           // ChainProof address; resolved from registry when NULL
+    const char *registry_path;
+    const char *contract_key;
+    uint32_t batch_size;            // transactions per JSON-RPC batch request
+    uint32_t max_inflight;          // sent but not yet mined
+    uint32_t receipt_poll_ms;
+    uint32_t tx_timeout_ms;
+    uint64_t gas_limit;
+} gw_submit_config_t;
+
+// A window's nonce is fixed when it is first sent and every resend reuses it,
+// so however often a transaction is rebroadcast at most one copy is mined.
+typedef struct {
+    char hash[67];          // empty while the node has not acknowledged the send
+    uint64_t nonce;
+    uint64_t first_sent_ns;
+    uint64_t sent_ns;       // last (re)broadcast
+    gw_window_t window;
+    uint32_t rebroadcasts;
+} gw_inflight_t;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t confirmed;
+    uint64_t reverted;
+    uint64_t failed;
+    uint64_t replaced;              // nonce taken by another transaction; window requeued
+    uint64_t rebroadcasts;
+    uint64_t nonce_resyncs;
+    uint64_t gap_fills;             // self-transfers sent for nonces the node rejected a window under
+    uint64_t confirm_ns_total;
+    uint64_t confirm_ns_max;
+} gw_submit_stats_t;
+
+typedef struct {
+    gw_submit_config_t cfg;
+    gw_rpc_t rpc;
+    bool dry_run;
+    uint64_t chain_id;
+    char contract[43];
+    uint8_t selector[4];
+    uint64_t next_nonce;
+
+    gw_inflight_t *inflight;
+    size_t inflight_count;
+    gw_window_t *requeued;          // windows whose transaction was replaced
+    size_t requeued_count;
+    uint64_t *gaps;                 // rejected nonces below later in-flight ones, not yet filled
+    size_t gap_count;
+    uint64_t last_poll_ns;
+
+    gw_submit_stats_t stats;
+} gw_submitter_t;
+
+int gw_submit_init(gw_submitter_t *s, const gw_submit_config_t *cfg);
+void gw_submit_destroy(gw_submitter_t *s);
+
+// Free in-flight slots; the caller never hands over more windows than this.
+size_t gw_submit_capacity(const gw_submitter_t *s);
+
+// Sends up to cfg.batch_size windows in one JSON-RPC batch. Windows the node
+// rejected over their nonce are copied back to retry[] (same order) and their
+// count returned. A window rejected for any other reason is dropped, and if
+// later nonces went out with it a zero-value transfer to the gateway account
+// takes its nonce, so they are not held back behind the gap.
+size_t gw_submit_send(gw_submitter_t *s, const gw_window_t *windows, size_t count, gw_window_t *retry);
+
+// Polls receipts for in-flight transactions if the poll interval elapsed.
+// A transaction without a receipt after cfg.tx_timeout_ms is rebroadcast with
+// its nonce if the node still has it, resent with its nonce if the node lost
+// it, and its window requeued if another transaction took the nonce. Sends
+// whose reply was lost are resolved the same way on the next poll, finding
+// the transaction that took the nonce from the block it was mined in, and gap
+// fills that could not be sent are retried.
+void gw_submit_poll(gw_submitter_t *s, bool force);
+
+// Moves up to max requeued windows to out; they need a new nonce.
+size_t gw_submit_take_requeued(gw_submitter_t *s, gw_window_t *out, size_t max);
+
+size_t gw_submit_inflight(const gw_submitter_t *s);
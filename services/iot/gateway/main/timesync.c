@@ -0,0 +1,392 @@
+#include "timesync.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gw_time.h"
+#include "hash.h"
+
+#define UPTIME_WRAP        (1ull << 32)
+#define SYNC_STALE_MS      60000    // sync older than samples already placed
+#define T_MS_RESOLUTION    1.0      // t_ms is truncated to whole ms
+
+void gw_clock_init(gw_clock_t *c)
+{
+    memset(c, 0, sizeof(*c));
+}
+
+static void points_clear(gw_clock_points_t *ps)
+{
+    ps->count = 0;
+}
+
+// Keeps one point per bucket of uptime: the tightest sync read, or the lowest
+// notification bound. When full, the point with the oldest uptime goes.
+static bool points_add(gw_clock_points_t *ps, double u_ms, double offset_ms, double err_ms, bool bound)
+{
+    uint64_t bucket = (uint64_t)(u_ms / GW_CLOCK_BUCKET_MS);
+    size_t oldest = 0;
+    for (size_t i = 0; i < ps->count; i++) {
+        gw_clock_point_t *p = &ps->points[i];
+        if ((uint64_t)(p->u_ms / GW_CLOCK_BUCKET_MS) == bucket) {
+            bool better = bound ? offset_ms < p->offset_ms : err_ms < p->err_ms;
+            if (!better) return false;
+            p->u_ms = u_ms;
+            p->offset_ms = offset_ms;
+            p->err_ms = err_ms;
+            return true;
+        }
+        if (p->u_ms < ps->points[oldest].u_ms) oldest = i;
+    }
+
+    gw_clock_point_t *slot;
+    if (ps->count < GW_CLOCK_POINTS) {
+        slot = &ps->points[ps->count++];
+    } else {
+        if (u_ms <= ps->points[oldest].u_ms) return false;
+        slot = &ps->points[oldest];
+    }
+    slot->u_ms = u_ms;
+    slot->offset_ms = offset_ms;
+    slot->err_ms = err_ms;
+    return true;
+}
+
+// Drift is kept: it belongs to the crystal, not the boot.
+static void new_boot(gw_clock_t *c, uint16_t boot)
+{
+    points_clear(&c->synced);
+    points_clear(&c->passive);
+    c->have_prev_boot = true;
+    c->prev_boot = c->boot;
+    c->boot = boot;
+    c->have_last = false;
+    c->uptime_base = 0;
+    c->fit_valid = false;
+    c->reboots++;
+}
+
+int gw_clock_add_sync(gw_clock_t *c, const gw_sync_reading_t *s)
+{
+    double rtt_ms = (double)(s->recv_unix_us - s->sent_unix_us) / 1000.0;
+    if (s->recv_unix_us < s->sent_unix_us || rtt_ms > GW_CLOCK_MAX_RTT_MS) return -1;
+
+    uint64_t uptime_ms = s->uptime_us / 1000;
+    uint16_t boot = (uint16_t)s->boot_id;
+    if (c->have_boot && boot != c->boot) {
+        if (c->have_prev_boot && boot == c->prev_boot) return -1;
+        new_boot(c, boot);
+    } else if (c->have_last && uptime_ms + SYNC_STALE_MS < c->uptime_base + c->last_t_ms) {
+        return -1;
+    }
+    c->have_boot = true;
+    c->boot = boot;
+    if (!c->have_last) c->uptime_base = uptime_ms & ~(UPTIME_WRAP - 1);
+
+    if (!c->have_drift && s->sync_count > 0 && s->drift_ppb != 0) {
+        c->have_drift = true;
+        c->drift_ppm = s->drift_ppb / 1000.0;
+        c->drift_err_ppm = GW_CLOCK_PRIOR_PPM;
+    }
+
+    double mid_ms = ((double)s->sent_unix_us + (double)s->recv_unix_us) / 2000.0;
+    double u_ms = (double)s->uptime_us / 1000.0;
+    if (points_add(&c->synced, u_ms, mid_ms - u_ms, rtt_ms / 2.0, false)) c->fit_valid = false;
+    return 0;
+}
+
+// Samples of one boot are minutes apart at most, so a wrap goes from the top
+// half of the u32 to the bottom half.
+static bool wrapped(uint32_t last_t_ms, uint32_t t_ms)
+{
+    return last_t_ms >= UPTIME_WRAP / 2 && t_ms < UPTIME_WRAP / 2;
+}
+
+int gw_clock_uptime(gw_clock_t *c, uint32_t seq, uint16_t boot, uint32_t t_ms, uint64_t *uptime_ms)
+{
+    if (c->have_boot && boot != c->boot) {
+        // seq keeps counting across reboots, so a lower one is older.
+        if ((c->have_prev_boot && boot == c->prev_boot) || (c->have_last && seq < c->last_seq)) return -1;
+        new_boot(c, boot);
+    }
+    c->have_boot = true;
+    c->boot = boot;
+
+    if (!c->have_last) {
+        c->have_last = true;
+        c->last_seq = seq;
+        c->last_t_ms = t_ms;
+        *uptime_ms = c->uptime_base + t_ms;
+        return 0;
+    }
+
+    if (seq >= c->last_seq && t_ms < c->last_t_ms && !wrapped(c->last_t_ms, t_ms)) {
+        // The boot tag is only 16 bits of a random id; a later sample whose
+        // uptime went back without wrapping is a new boot that drew the same.
+        new_boot(c, boot);
+        c->have_last = true;
+        c->last_seq = seq;
+        c->last_t_ms = t_ms;
+        *uptime_ms = t_ms;
+        return 0;
+    }
+
+    if (seq >= c->last_seq) {
+        // Same boot, so a smaller t_ms means the u32 wrapped (49.7 days).
+        if (t_ms < c->last_t_ms) c->uptime_base += UPTIME_WRAP;
+        c->last_seq = seq;
+        c->last_t_ms = t_ms;
+        *uptime_ms = c->uptime_base + t_ms;
+        return 0;
+    }
+
+    // An earlier sample of this boot arriving late; a larger t_ms can only
+    // come from before the last wrap.
+    if (t_ms > c->last_t_ms) {
+        if (c->uptime_base < UPTIME_WRAP) return -1;
+        *uptime_ms = c->uptime_base - UPTIME_WRAP + t_ms;
+        return 0;
+    }
+    *uptime_ms = c->uptime_base + t_ms;
+    return 0;
+}
+
+void gw_clock_add_bound(gw_clock_t *c, uint64_t uptime_ms, uint64_t rx_unix_ms)
+{
+    double u_ms = (double)uptime_ms;
+    if (points_add(&c->passive, u_ms, (double)rx_unix_ms - u_ms, 0, true) &&
+        c->synced.count == 0) {
+        c->fit_valid = false;
+    }
+}
+
+static void drift_prior(const gw_clock_t *c, double *slope, double *slope_err)
+{
+    if (c->have_drift) {
+        *slope = -c->drift_ppm * 1e-6;
+        *slope_err = c->drift_err_ppm * 1e-6;
+    } else {
+        *slope = 0;
+        *slope_err = GW_CLOCK_DRIFT_MAX_PPM * 1e-6;
+    }
+}
+
+static void fit(gw_clock_t *c)
+{
+    const gw_clock_points_t *ps = c->synced.count ? &c->synced : &c->passive;
+    c->fit_mode = c->synced.count ? GW_CLOCK_SYNCED : c->passive.count ? GW_CLOCK_PASSIVE : GW_CLOCK_NONE;
+    c->fit_valid = true;
+    if (c->fit_mode == GW_CLOCK_NONE) return;
+    if (c->fit_mode == GW_CLOCK_PASSIVE) {
+        // Bounds are one-sided, so no line is fitted through them; see
+        // passive_to_unix.
+        drift_prior(c, &c->fit_slope, &c->fit_slope_err);
+        return;
+    }
+
+    double sw = 0, su = 0, umin = INFINITY, umax = -INFINITY;
+    for (size_t i = 0; i < ps->count; i++) {
+        const gw_clock_point_t *p = &ps->points[i];
+        double w = 1.0 / (p->err_ms * p->err_ms + 1.0);
+        sw += w;
+        su += w * p->u_ms;
+        if (p->u_ms < umin) umin = p->u_ms;
+        if (p->u_ms > umax) umax = p->u_ms;
+    }
+    double u0 = su / sw;
+    double drift_max = GW_CLOCK_DRIFT_MAX_PPM * 1e-6;
+
+    double slope, slope_err;
+    if (ps->count >= 2 && umax - umin >= GW_CLOCK_MIN_SPAN_MS) {
+        double so = 0, suu = 0, suo = 0;
+        for (size_t i = 0; i < ps->count; i++) {
+            const gw_clock_point_t *p = &ps->points[i];
+            double w = 1.0 / (p->err_ms * p->err_ms + 1.0);
+            so += w * p->offset_ms;
+        }
+        double o0 = so / sw;
+        for (size_t i = 0; i < ps->count; i++) {
+            const gw_clock_point_t *p = &ps->points[i];
+            double w = 1.0 / (p->err_ms * p->err_ms + 1.0);
+            suu += w * (p->u_ms - u0) * (p->u_ms - u0);
+            suo += w * (p->u_ms - u0) * (p->offset_ms - o0);
+        }
+        slope = suo / suu;
+        if (slope > drift_max) slope = drift_max;
+        if (slope < -drift_max) slope = -drift_max;
+
+        // The line cannot be steeper or flatter than the worst-case errors
+        // at the two ends allow.
+        double err_lo = 0, err_hi = 0;
+        for (size_t i = 0; i < ps->count; i++) {
+            if (ps->points[i].u_ms == umin) err_lo = ps->points[i].err_ms;
+            if (ps->points[i].u_ms == umax) err_hi = ps->points[i].err_ms;
+        }
+        // The rate also wanders while the points were taken, so the line
+        // is only their average; allow for how far it may have moved.
+        slope_err = (err_lo + err_hi) / (umax - umin) +
+                    GW_CLOCK_WANDER_PPM * 1e-6 * sqrt((umax - umin) / 3600e3);
+        if (slope_err > drift_max) slope_err = drift_max;
+
+        if (c->fit_mode == GW_CLOCK_SYNCED) {
+            c->have_drift = true;
+            c->drift_ppm = -slope * 1e6;
+            c->drift_err_ppm = slope_err * 1e6;
+        }
+    } else {
+        drift_prior(c, &slope, &slope_err);
+    }
+
+    double so = 0;
+    for (size_t i = 0; i < ps->count; i++) {
+        const gw_clock_point_t *p = &ps->points[i];
+        double w = 1.0 / (p->err_ms * p->err_ms + 1.0);
+        so += w * (p->offset_ms - slope * (p->u_ms - u0));
+    }
+
+    c->fit_u0 = u0;
+    c->fit_offset = so / sw;
+    c->fit_slope = slope;
+    c->fit_slope_err = slope_err;
+}
+
+// Every bound, carried to u along the drift, is still an upper bound on the
+// offset there once the drift uncertainty is added; the lowest one wins.
+static double passive_to_unix(const gw_clock_t *c, double u)
+{
+    double best = INFINITY;
+    for (size_t i = 0; i < c->passive.count; i++) {
+        const gw_clock_point_t *p = &c->passive.points[i];
+        double slack = fabs(u - p->u_ms) * c->fit_slope_err;
+        double bound = p->offset_ms + c->fit_slope * (u - p->u_ms) + slack;
+        if (bound < best) best = bound;
+    }
+    return u + best;
+}
+
+gw_clock_mode_t gw_clock_to_unix(gw_clock_t *c, uint64_t uptime_ms, uint64_t *unix_ms, uint32_t *err_ms)
+{
+    if (!c->fit_valid) fit(c);
+    *unix_ms = 0;
+    *err_ms = 0;
+    if (c->fit_mode == GW_CLOCK_NONE) return GW_CLOCK_NONE;
+
+    double u = (double)uptime_ms;
+    if (c->fit_mode == GW_CLOCK_PASSIVE) {
+        double wall = passive_to_unix(c, u);
+        if (wall < 0) return GW_CLOCK_NONE;
+        *unix_ms = (uint64_t)llround(wall);
+        *err_ms = GW_TIME_ERR_UNBOUNDED;
+        return GW_CLOCK_PASSIVE;
+    }
+
+    double best = INFINITY;
+    for (size_t i = 0; i < c->synced.count; i++) {
+        const gw_clock_point_t *p = &c->synced.points[i];
+        double miss = fabs(c->fit_offset + c->fit_slope * (p->u_ms - c->fit_u0) - p->offset_ms);
+        double e = p->err_ms + miss + fabs(u - p->u_ms) * c->fit_slope_err;
+        if (e < best) best = e;
+    }
+    double wall = u + c->fit_offset + c->fit_slope * (u - c->fit_u0);
+    if (wall < 0) return GW_CLOCK_NONE;
+    best += T_MS_RESOLUTION;
+    *unix_ms = (uint64_t)llround(wall);
+    *err_ms = best >= GW_TIME_ERR_UNBOUNDED ? GW_TIME_ERR_UNBOUNDED - 1 : (uint32_t)ceil(best);
+    return GW_CLOCK_SYNCED;
+}
+
+int32_t gw_clock_drift_ppb(gw_clock_t *c)
+{
+    if (!c->fit_valid) fit(c);
+    return c->have_drift ? (int32_t)lround(c->drift_ppm * 1000.0) : 0;
+}
+
+int gw_clock_table_init(gw_clock_table_t *t, size_t expected_devices)
+{
+    memset(t, 0, sizeof(*t));
+    t->capacity = gw_hash_capacity_for(expected_devices);
+    t->slots = calloc(t->capacity, sizeof(*t->slots));
+    return t->slots ? 0 : -1;
+}
+
+void gw_clock_table_destroy(gw_clock_table_t *t)
+{
+    free(t->slots);
+    t->slots = NULL;
+}
+
+static gw_clock_t *find_slot(gw_clock_t *slots, size_t capacity, uint64_t device)
+{
+    size_t mask = capacity - 1;
+    size_t i = (size_t)gw_hash_u64(device) & mask;
+    while (slots[i].used && slots[i].device != device) i = (i + 1) & mask;
+    return &slots[i];
+}
+
+static int grow(gw_clock_table_t *t)
+{
+    size_t capacity = t->capacity * 2;
+    gw_clock_t *slots = calloc(capacity, sizeof(*slots));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < t->capacity; i++) {
+        if (t->slots[i].used) *find_slot(slots, capacity, t->slots[i].device) = t->slots[i];
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->capacity = capacity;
+    return 0;
+}
+
+static void stat_max(atomic_uint_fast64_t *max, uint64_t v)
+{
+    uint_fast64_t cur = atomic_load(max);
+    while (v > cur && !atomic_compare_exchange_weak(max, &cur, v)) {
+    }
+}
+
+void gw_clock_table_apply(gw_clock_table_t *t, gw_reading_t *r)
+{
+    gw_clock_stats_t *st = &t->stats;
+    r->unix_ms = 0;
+    r->time_err_ms = 0;
+    if (r->kind == GW_READING_SAMPLE && !r->has_time) {
+        atomic_fetch_add(&st->untimed, 1);
+        return;
+    }
+
+    if ((t->count + 1) * 10 > t->capacity * 7) grow(t);
+    gw_clock_t *c = find_slot(t->slots, t->capacity, r->device);
+    if (!c->used) {
+        gw_clock_init(c);
+        c->used = true;
+        c->device = r->device;
+        t->count++;
+    }
+    uint32_t reboots = c->reboots;
+
+    if (r->kind == GW_READING_SYNC) {
+        if (gw_clock_add_sync(c, &r->sync) == 0) atomic_fetch_add(&st->syncs, 1);
+        else atomic_fetch_add(&st->syncs_rejected, 1);
+    } else {
+        uint64_t uptime;
+        if (gw_clock_uptime(c, r->seq, r->device_boot, r->device_ms, &uptime) != 0) {
+            atomic_fetch_add(&st->stale, 1);
+        } else {
+            uint64_t rx_unix_ms = gw_mono_to_unix_ms(r->rx_ns);
+            gw_clock_add_bound(c, uptime, rx_unix_ms);
+            gw_clock_mode_t mode = gw_clock_to_unix(c, uptime, &r->unix_ms, &r->time_err_ms);
+            atomic_fetch_add(&st->stamped[mode], 1);
+            if (mode == GW_CLOCK_SYNCED) {
+                atomic_fetch_add(&st->err_ms_total, r->time_err_ms);
+                stat_max(&st->err_ms_max, r->time_err_ms);
+            }
+            if (mode != GW_CLOCK_NONE && rx_unix_ms > r->unix_ms) {
+                atomic_fetch_add(&st->delay_ms_total, rx_unix_ms - r->unix_ms);
+            }
+        }
+    }
+
+    if (c->reboots != reboots) atomic_fetch_add(&st->reboots, c->reboots - reboots);
+}
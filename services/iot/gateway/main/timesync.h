@@ -0,0 +1,138 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "payload.h"
+
+// Maps a tag's uptime (the t_ms in its payloads) to wall time, so samples
+// that reach the gateway late - from the tag's publish backlog, a batch, a
+// forwarder - keep the time they were taken rather than the time they
+// arrived.
+//
+// The model per boot of a tag is offset(u) = wall - u, linear in u: a fixed
+// epoch plus the tag crystal's rate error. Two kinds of evidence feed it:
+//
+//  - Sync reads. The gateway reads the tag's uptime and stamps the request
+//    and the response with its own clock; the tag served the read somewhere
+//    in between, so the midpoint is off by at most half the round trip. The
+//    best read per GW_CLOCK_BUCKET_MS of uptime is kept.
+//  - Notifications (passive). A sample cannot arrive before it was taken, so
+//    rx time - t_ms is an upper bound on the offset; the lowest per bucket
+//    is kept. Only used until the current boot has answered a sync read.
+//
+// A weighted least-squares line through the sync points gives offset and
+// drift once they span GW_CLOCK_MIN_SPAN_MS; before that the drift is the
+// last fitted one, else what a gateway last wrote to the tag, else zero.
+// Passive bounds are one-sided and get no line: the lowest bound, carried
+// along that drift, is the estimate. Synced estimates come with a bound on
+// their error; passive ones only with a latest time (see gw_clock_to_unix).
+#define GW_CLOCK_POINTS           16
+#define GW_CLOCK_BUCKET_MS        (15u * 60u * 1000u)
+#define GW_CLOCK_MIN_SPAN_MS      (30u * 60u * 1000u)
+#define GW_CLOCK_MAX_RTT_MS       2000      // slower reads are not worth keeping
+#define GW_CLOCK_DRIFT_MAX_PPM    50.0      // ESP32 crystal plus temperature, worst case
+#define GW_CLOCK_WANDER_PPM       1.0       // rate change per sqrt(hour) allowed for; temperature swings
+#define GW_CLOCK_PRIOR_PPM        10.0      // uncertainty of a drift another gateway measured
+
+typedef enum {
+    GW_CLOCK_NONE = 0,      // nothing known for this boot
+    GW_CLOCK_PASSIVE,       // from notification arrival times only
+    GW_CLOCK_SYNCED,        // from sync reads
+} gw_clock_mode_t;
+
+typedef struct {
+    double u_ms;            // tag uptime, unwrapped
+    double offset_ms;       // wall - uptime
+    double err_ms;
+} gw_clock_point_t;
+
+typedef struct {
+    gw_clock_point_t points[GW_CLOCK_POINTS];
+    size_t count;
+} gw_clock_points_t;
+
+typedef struct {
+    uint64_t device;
+    bool used;
+
+    // Current boot, by the low 16 bits of the tag's boot_id
+    bool have_boot;
+    uint16_t boot;
+    bool have_prev_boot;
+    uint16_t prev_boot;     // its samples may still trickle in; they are dropped
+    bool have_last;
+    uint32_t last_seq;
+    uint32_t last_t_ms;
+    uint64_t uptime_base;   // added to t_ms; steps by 2^32 on wrap
+
+    gw_clock_points_t synced;
+    gw_clock_points_t passive;
+
+    // Drift carries over reboots: it belongs to the crystal, not the boot.
+    bool have_drift;
+    double drift_ppm;       // + = tag clock fast
+    double drift_err_ppm;
+
+    bool fit_valid;
+    gw_clock_mode_t fit_mode;
+    double fit_u0;
+    double fit_offset;
+    double fit_slope;       // d offset / d uptime = -drift
+    double fit_slope_err;
+
+    uint32_t reboots;
+} gw_clock_t;
+
+void gw_clock_init(gw_clock_t *c);
+
+// Adds one sync read; returns -1 when it is unusable (clock went backwards,
+// round trip too long, from a boot already replaced).
+int gw_clock_add_sync(gw_clock_t *c, const gw_sync_reading_t *s);
+
+// Unwraps a sample's t_ms into uptime; a new boot tag starts over. Returns -1
+// for a sample from a boot that has already been replaced, which can no
+// longer be placed.
+int gw_clock_uptime(gw_clock_t *c, uint32_t seq, uint16_t boot, uint32_t t_ms, uint64_t *uptime_ms);
+
+// Records that a sample taken at uptime_ms was received at rx_unix_ms.
+void gw_clock_add_bound(gw_clock_t *c, uint64_t uptime_ms, uint64_t rx_unix_ms);
+
+// Wall time at uptime_ms and a bound on its error. Synced: the error of the
+// best sync point, plus how far the fitted line misses it, plus the drift
+// uncertainty times the distance to it. Passive: GW_TIME_ERR_UNBOUNDED. The
+// sample was taken no later than unix_ms, but nothing bounds how much earlier:
+// a tag that comes back in range only uploads its backlog, whose every
+// notification arrives long after the sample.
+gw_clock_mode_t gw_clock_to_unix(gw_clock_t *c, uint64_t uptime_ms, uint64_t *unix_ms, uint32_t *err_ms);
+
+// Fitted tag drift in ppb (+ = fast), 0 when none is known yet.
+int32_t gw_clock_drift_ppb(gw_clock_t *c);
+
+typedef struct {
+    atomic_uint_fast64_t syncs;
+    atomic_uint_fast64_t syncs_rejected;
+    atomic_uint_fast64_t reboots;
+    atomic_uint_fast64_t stale;             // samples from a replaced boot or out of order
+    atomic_uint_fast64_t stamped[3];        // by gw_clock_mode_t
+    atomic_uint_fast64_t untimed;           // payloads without t_ms
+    atomic_uint_fast64_t err_ms_total;      // over stamped synced
+    atomic_uint_fast64_t err_ms_max;
+    atomic_uint_fast64_t delay_ms_total;    // rx time - sample time
+} gw_clock_stats_t;
+
+// One clock per device, owned by the aggregate stage.
+typedef struct {
+    gw_clock_t *slots;
+    size_t capacity;
+    size_t count;
+    gw_clock_stats_t stats;
+} gw_clock_table_t;
+
+int gw_clock_table_init(gw_clock_table_t *t, size_t expected_devices);
+void gw_clock_table_destroy(gw_clock_table_t *t);
+
+// Feeds a sync reading into its device's clock, or stamps a sample reading
+// with unix_ms and time_err_ms (left 0 when the time cannot be known).
+void gw_clock_table_apply(gw_clock_table_t *t, gw_reading_t *r);
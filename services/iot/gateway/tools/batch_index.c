@@ -0,0 +1,327 @@
+// Builds, queries and benchmarks the tracking-code index the gateway keeps
+// for dock-door scans.
+//
+//   gateway-batch-index sync   --index PATH --rpc URL [--contract ADDR | --registry PATH]
+//   gateway-batch-index lookup --index PATH CODE...
+//   gateway-batch-index bench  [--batches N] [--lookups N] [--threads N] [--index PATH]
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch_index.h"
+#include "batch_sync.h"
+#include "gw_log.h"
+#include "gw_time.h"
+#include "keccak.h"
+
+static const char *TAG = "BATCH_INDEX";
+
+#define DEFAULT_REGISTRY_PATH   "../../smart-contracts/config/contracts.json"
+#define DEFAULT_CONTRACT_KEY    "chainproof"
+#define BENCH_HANDLERS          48
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s COMMAND [options]\n"
+            "\n"
+            "  sync     apply ChainProof events up to the confirmed head, then exit\n"
+            "             --index PATH --rpc URL [--contract ADDR] [--registry PATH] [--contract-key KEY]\n"
+            "             [--from-block N] [--confirmations N] (default 12) [--range N] [--expected N]\n"
+            "  lookup   resolve tracking codes from the index, one JSON line each\n"
+            "             --index PATH CODE...\n"
+            "  bench    build a synthetic index and measure lookups\n"
+            "             [--batches N] (default 10000000) [--lookups N] (default 5000000)\n"
+            "             [--threads N] (default 1) [--index PATH] (default /tmp/chainproof-index-bench.bin)\n",
+            argv0);
+}
+
+static void print_address(FILE *f, const uint8_t addr[20])
+{
+    fputs("0x", f);
+    for (int i = 0; i < 20; i++) fprintf(f, "%02x", addr[i]);
+}
+
+static int cmd_sync(const char *index_path, const gw_batch_sync_config_t *cfg, size_t expected)
+{
+    if (!index_path || !cfg->rpc_url) {
+        GW_LOGE(TAG, "sync needs --index and --rpc");
+        return 2;
+    }
+
+    gw_batch_index_t idx;
+    if (gw_batch_index_open(&idx, index_path, true, expected) != 0) return 1;
+
+    gw_batch_syncer_t syncer;
+    uint64_t started = gw_now_ns();
+    int rc = gw_batch_sync_init(&syncer, &idx, cfg) == 0 ? gw_batch_sync_run(&syncer) : -1;
+    double elapsed_s = (gw_now_ns() - started) / 1e9;
+
+    printf("{\"ok\":%s,\"head\":%llu,\"events\":%llu,\"batches\":%llu,\"codesReadBack\":%llu,\"ranges\":%llu,"
+           "\"codes\":%llu,\"ambiguous\":%llu,\"fileBytes\":%zu,\"elapsedS\":%.2f}\n",
+           rc == 0 ? "true" : "false", (unsigned long long)syncer.stats.head, (unsigned long long)syncer.stats.logs,
+           (unsigned long long)syncer.stats.batches, (unsigned long long)syncer.stats.codes_fetched,
+           (unsigned long long)syncer.stats.ranges, (unsigned long long)idx.header->slot_count,
+           (unsigned long long)idx.header->ambiguous, gw_batch_index_file_size(&idx), elapsed_s);
+
+    gw_batch_sync_destroy(&syncer);
+    gw_batch_index_close(&idx);
+    return rc == 0 ? 0 : 1;
+}
+
+static int cmd_lookup(const char *index_path, char **codes, int count)
+{
+    if (!index_path || count == 0) {
+        GW_LOGE(TAG, "lookup needs --index and at least one tracking code");
+        return 2;
+    }
+
+    gw_batch_index_t idx;
+    if (gw_batch_index_open(&idx, index_path, false, 0) != 0) return 1;
+
+    int missing = 0;
+    for (int i = 0; i < count; i++) {
+        gw_batch_info_t info;
+        gw_index_result_t r = gw_batch_index_lookup(&idx, codes[i], strlen(codes[i]), &info);
+        // Codes are printed as given; labels are plain ASCII.
+        printf("{\"trackingCode\":\"%s\",", codes[i]);
+        if (r == GW_INDEX_FOUND) {
+            printf("\"found\":true,\"batchId\":%u,\"status\":\"%s\",\"handler\":\"", info.batch_id,
+                   gw_batch_status_name(info.status));
+            print_address(stdout, info.handler);
+            printf("\"}\n");
+        } else {
+            printf("\"found\":false,\"ambiguous\":%s}\n", r == GW_INDEX_AMBIGUOUS ? "true" : "false");
+            missing++;
+        }
+    }
+    printf("{\"indexedThroughBlock\":%llu}\n", (unsigned long long)(idx.header->next_block ? idx.header->next_block - 1 : 0));
+    gw_batch_index_close(&idx);
+    return missing ? 1 : 0;
+}
+
+typedef struct {
+    gw_batch_index_t *idx;
+    const uint8_t (*hashes)[32];
+    size_t hash_count;
+    size_t lookups;
+    uint64_t seed;
+    size_t found;
+    double elapsed_s;
+} bench_worker_t;
+
+static uint64_t xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// Half the probes are labels in the index, half are unknown pallets.
+static void *bench_worker(void *arg)
+{
+    bench_worker_t *w = arg;
+    uint64_t started = gw_now_ns();
+    for (size_t i = 0; i < w->lookups; i++) {
+        uint64_t r = xorshift(&w->seed);
+        gw_batch_info_t info;
+        if (r & 1) {
+            if (gw_batch_index_lookup_hash(w->idx, w->hashes[(r >> 1) % w->hash_count], &info) == GW_INDEX_FOUND) w->found++;
+        } else {
+            uint8_t miss[32];
+            memcpy(miss, &r, sizeof(r));
+            memcpy(miss + 8, &r, sizeof(r));
+            if (gw_batch_index_lookup_hash(w->idx, miss, &info) == GW_INDEX_FOUND) w->found++;
+        }
+    }
+    w->elapsed_s = (gw_now_ns() - started) / 1e9;
+    return NULL;
+}
+
+static double run_lookups(gw_batch_index_t *idx, const uint8_t (*hashes)[32], size_t hash_count, size_t lookups,
+                          unsigned threads, size_t *found)
+{
+    bench_worker_t workers[64];
+    pthread_t tids[64];
+    uint64_t started = gw_now_ns();
+    for (unsigned t = 0; t < threads; t++) {
+        workers[t] = (bench_worker_t){
+            .idx = idx,
+            .hashes = hashes,
+            .hash_count = hash_count,
+            .lookups = lookups / threads,
+            .seed = 0x9E3779B97F4A7C15ull * (t + 1),
+        };
+        pthread_create(&tids[t], NULL, bench_worker, &workers[t]);
+    }
+    *found = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        *found += workers[t].found;
+    }
+    return (gw_now_ns() - started) / 1e9;
+}
+
+static int cmd_bench(const char *index_path, size_t batches, size_t lookups, unsigned threads)
+{
+    if (batches == 0 || lookups == 0 || threads == 0 || threads > 64) {
+        GW_LOGE(TAG, "bench needs positive --batches and --lookups and 1-64 --threads");
+        return 2;
+    }
+    unlink(index_path);
+
+    gw_batch_index_t idx;
+    if (gw_batch_index_open(&idx, index_path, true, batches) != 0) return 1;
+
+    // Lookups sample a subset of the codes so the benchmark itself does not
+    // need 320 MB of hashes; the index still holds every batch.
+    size_t sample = batches < 1000000 ? batches : 1000000;
+    uint8_t (*hashes)[32] = malloc(sample * sizeof(*hashes));
+    if (!hashes) return 1;
+
+    uint8_t handlers[BENCH_HANDLERS][20];
+    for (int i = 0; i < BENCH_HANDLERS; i++) {
+        memset(handlers[i], 0, 20);
+        handlers[i][0] = 0xCB;
+        handlers[i][19] = (uint8_t)(i + 1);
+    }
+
+    // Build the way a sync would: harvest, then about a tenth of the batches
+    // move to a warehouse and a twentieth are split (consumed).
+    uint64_t started = gw_now_ns();
+    size_t stride = batches / sample;
+    for (size_t i = 1; i <= batches; i++) {
+        char code[32];
+        uint8_t hash[32];
+        int len = snprintf(code, sizeof(code), "PAL-%010zu", i);
+        gw_keccak256(code, (size_t)len, hash);
+
+        uint32_t id = (uint32_t)i;
+        if (gw_batch_index_put_batch(&idx, id, GW_BATCH_ACTIVE, handlers[i % 16]) != 0 ||
+            gw_batch_index_put_code(&idx, hash, id) != 0) {
+            GW_LOGE(TAG, "Insert of batch %zu failed", i);
+            return 1;
+        }
+        if (i % 10 == 0) gw_batch_index_put_batch(&idx, id, GW_BATCH_ACTIVE, handlers[16 + i % 32]);
+        if (i % 20 == 0) gw_batch_index_set_status(&idx, id, GW_BATCH_CONSUMED);
+        if ((i - 1) % stride == 0 && (i - 1) / stride < sample) memcpy(hashes[(i - 1) / stride], hash, 32);
+    }
+    double build_s = (gw_now_ns() - started) / 1e9;
+
+    started = gw_now_ns();
+    gw_batch_index_commit(&idx, 1);
+    double commit_s = (gw_now_ns() - started) / 1e9;
+    uint64_t codes = idx.header->slot_count, ambiguous = idx.header->ambiguous;
+    gw_batch_index_close(&idx);
+
+    struct stat st;
+    stat(index_path, &st);
+
+    // A reader process: open the file read-only as `lookup` would.
+    started = gw_now_ns();
+    if (gw_batch_index_open(&idx, index_path, false, 0) != 0) return 1;
+    double open_s = (gw_now_ns() - started) / 1e9;
+
+    size_t found;
+    double elapsed_s = run_lookups(&idx, (const uint8_t (*)[32])hashes, sample, lookups, threads, &found);
+
+    // Label to answer, keccak included, as a scan would pay it.
+    started = gw_now_ns();
+    size_t scans = lookups / 10, scan_hits = 0;
+    for (size_t i = 0; i < scans; i++) {
+        char code[32];
+        int len = snprintf(code, sizeof(code), "PAL-%010zu", 1 + (i * 7919) % batches);
+        gw_batch_info_t info;
+        if (gw_batch_index_lookup(&idx, code, (size_t)len, &info) == GW_INDEX_FOUND) scan_hits++;
+    }
+    double scan_s = (gw_now_ns() - started) / 1e9;
+
+    printf("{\n"
+           "  \"batches\":%zu,\"codes\":%llu,\"ambiguous\":%llu,\n"
+           "  \"fileBytes\":%zu,\"diskBytes\":%llu,\"bytesPerBatch\":%.1f,\n"
+           "  \"buildS\":%.2f,\"commitS\":%.2f,\"openS\":%.4f,\n"
+           "  \"lookups\":{\"threads\":%u,\"count\":%zu,\"hitRatio\":%.3f,\"perSecond\":%.0f,\"nsPerLookup\":%.1f},\n"
+           "  \"scans\":{\"count\":%zu,\"found\":%zu,\"perSecond\":%.0f,\"usPerScan\":%.2f}\n"
+           "}\n",
+           batches, (unsigned long long)codes, (unsigned long long)ambiguous, gw_batch_index_file_size(&idx),
+           (unsigned long long)st.st_blocks * 512ull, (double)gw_batch_index_file_size(&idx) / (double)batches, build_s,
+           commit_s, open_s, threads, lookups, (double)found / (double)lookups, lookups / elapsed_s,
+           elapsed_s * 1e9 * threads / (double)lookups, scans, scan_hits, scans / scan_s, scan_s * 1e6 / (double)scans);
+
+    gw_batch_index_close(&idx);
+    free(hashes);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || strcmp(argv[1], "--help") == 0) {
+        usage(argv[0]);
+        return argc < 2 ? 2 : 0;
+    }
+    const char *command = argv[1];
+
+    const char *index_path = NULL;
+    size_t expected = 1000000;
+    size_t batches = 10000000, lookups = 5000000;
+    unsigned threads = 1;
+    gw_batch_sync_config_t cfg = {
+        .registry_path = DEFAULT_REGISTRY_PATH,
+        .contract_key = DEFAULT_CONTRACT_KEY,
+        .confirmations = GW_BATCH_SYNC_CONFIRMATIONS,
+        .max_block_range = 2000,
+    };
+
+    enum {
+        OPT_INDEX = 1, OPT_RPC, OPT_CONTRACT, OPT_REGISTRY, OPT_CONTRACT_KEY, OPT_FROM_BLOCK, OPT_CONFIRMATIONS,
+        OPT_RANGE, OPT_EXPECTED, OPT_BATCHES, OPT_LOOKUPS, OPT_THREADS,
+    };
+    static const struct option options[] = {
+        { "index", required_argument, NULL, OPT_INDEX },
+        { "rpc", required_argument, NULL, OPT_RPC },
+        { "contract", required_argument, NULL, OPT_CONTRACT },
+        { "registry", required_argument, NULL, OPT_REGISTRY },
+        { "contract-key", required_argument, NULL, OPT_CONTRACT_KEY },
+        { "from-block", required_argument, NULL, OPT_FROM_BLOCK },
+        { "confirmations", required_argument, NULL, OPT_CONFIRMATIONS },
+        { "range", required_argument, NULL, OPT_RANGE },
+        { "expected", required_argument, NULL, OPT_EXPECTED },
+        { "batches", required_argument, NULL, OPT_BATCHES },
+        { "lookups", required_argument, NULL, OPT_LOOKUPS },
+        { "threads", required_argument, NULL, OPT_THREADS },
+        { 0 },
+    };
+
+    optind = 2;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case OPT_INDEX: index_path = optarg; break;
+        case OPT_RPC: cfg.rpc_url = optarg; break;
+        case OPT_CONTRACT: cfg.contract = optarg; break;
+        case OPT_REGISTRY: cfg.registry_path = optarg; break;
+        case OPT_CONTRACT_KEY: cfg.contract_key = optarg; break;
+        case OPT_FROM_BLOCK: cfg.from_block = strtoull(optarg, NULL, 10); break;
+        case OPT_CONFIRMATIONS: cfg.confirmations = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_RANGE: cfg.max_block_range = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case OPT_EXPECTED: expected = strtoull(optarg, NULL, 10); break;
+        case OPT_BATCHES: batches = strtoull(optarg, NULL, 10); break;
+        case OPT_LOOKUPS: lookups = strtoull(optarg, NULL, 10); break;
+        case OPT_THREADS: threads = (unsigned)strtoul(optarg, NULL, 10); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+
+    if (strcmp(command, "sync") == 0) return cmd_sync(index_path, &cfg, expected);
+    if (strcmp(command, "lookup") == 0) return cmd_lookup(index_path, argv + optind, argc - optind);
+    if (strcmp(command, "bench") == 0) {
+        return cmd_bench(index_path ? index_path : "/tmp/chainproof-index-bench.bin", batches, lookups, threads);
+    }
+    usage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,466 @@
+// Checks the gateway's time reconstruction (main/timesync.h) against
+// simulated tags whose true sample times are known: each tag's crystal runs
+// fast or slow and wanders, the tag reboots now and then, and it is only in
+// range of the gateway part of the time, so most samples arrive late from
+// its publish backlog. Every sample is placed three ways:
+//
+//   arrival  the gateway's receive time, what it did before tags sent t_ms
+//   passive  t_ms mapped with notification arrival times only
+//   synced   t_ms mapped with time-sync reads (burst on connect, then every
+//            --sync-s seconds), as the BLE source does
+//
+// and the error against the true time is reported as percentiles, together
+// with how often it exceeded the bound the clock claimed. Passive estimates
+// claim no bound, only that the sample was not taken after them; that is
+// counted instead. --check exits non-zero if synced errors break their bound,
+// or passive samples turn out later than their estimate, more than
+// --max-violations of the time, or if synced is not better than arrival time.
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gw_log.h"
+#include "timesync.h"
+
+static const char *TAG = "CLOCK_SIM";
+
+#define EPOCH_MS            1767225600000.0     // 2026-01-01
+#define BACKLOG_MAX         64                  // PUBLISH_BACKLOG in blink/main/main.c
+#define SUBSCRIBE_DELAY_MS  1000.0              // connect, encrypt, subscribe
+#define NOTIFY_GAP_MS       10.0                // backlog drains a few per connection event
+#define SYNC_BURST          4
+#define SYNC_BURST_GAP_MS   1000.0
+#define CHECKPOINT_INTERVAL 720                 // CHAIN_CHECKPOINT_INTERVAL in blink/main/sample_chain.h
+
+typedef enum { MODE_ARRIVAL, MODE_PASSIVE, MODE_SYNCED, MODE_COUNT } mode_t_;
+
+static const char *const s_mode_names[MODE_COUNT] = { "arrival", "passive", "synced" };
+
+typedef struct {
+    double period_s;
+    double hours;
+    double drift_ppm;
+    double wander_ppm;
+    double online;
+    double session_min;
+    double reboots_per_day;
+    double sync_s;
+    double conn_interval_ms;
+} sim_config_t;
+
+typedef struct {
+    double rx_ms;           // gateway wall time the event arrives
+    bool sync;
+    // sample
+    uint32_t seq;
+    uint16_t boot;
+    uint32_t t_ms;
+    double true_ms;
+    // sync
+    gw_sync_reading_t reading;
+} sim_event_t;
+
+typedef struct {
+    double *err;            // |estimate - truth|, ms
+    double *backlog_err;    // same, samples delivered more than a minute late
+    size_t count;
+    size_t backlog_count;
+    size_t violations;      // |error| > claimed bound
+    size_t after_estimate;  // unbounded estimates the sample was taken after
+    size_t unplaced;
+    double bound_total;
+} mode_report_t;
+
+// Sync reads draw from their own stream so the runs with and without them
+// see the same tag history.
+static uint64_t s_rng = 0x9E3779B97F4A7C15ull;
+static uint64_t s_sync_rng = 0xD1B54A32D192ED03ull;
+
+static double rand_unit_r(uint64_t *rng)
+{
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    return (double)(*rng >> 11) / (double)(1ull << 53);
+}
+
+static double rand_unit(void)
+{
+    return rand_unit_r(&s_rng);
+}
+
+static double rand_exp_r(uint64_t *rng, double mean)
+{
+    return -mean * log(1.0 - rand_unit_r(rng));
+}
+
+static double rand_exp(double mean)
+{
+    return rand_exp_r(&s_rng, mean);
+}
+
+static double rand_normal(void)
+{
+    double u1 = rand_unit() + 1e-12, u2 = rand_unit();
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+// One BLE hop: the next connection event plus a little host latency.
+static double hop_ms(const sim_config_t *cfg, uint64_t *rng)
+{
+    return rand_unit_r(rng) * cfg->conn_interval_ms + rand_exp_r(rng, 3.0);
+}
+
+static int cmp_event(const void *a, const void *b)
+{
+    double x = ((const sim_event_t *)a)->rx_ms, y = ((const sim_event_t *)b)->rx_ms;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    sim_event_t *v;
+    size_t count;
+    size_t cap;
+} event_list_t;
+
+static sim_event_t *push_event(event_list_t *l)
+{
+    if (l->count == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 1024;
+        sim_event_t *grown = realloc(l->v, l->cap * sizeof(*grown));
+        if (!grown) exit(1);
+        l->v = grown;
+    }
+    memset(&l->v[l->count], 0, sizeof(sim_event_t));
+    return &l->v[l->count++];
+}
+
+// A sync read sent at sent_ms; the tag's clock is known at wall (uptime,
+// drift), which may be a little after the read was served.
+static void push_sync(const sim_config_t *cfg, event_list_t *out, double sent_ms, double wall, double uptime,
+                      double drift, uint32_t boot_id)
+{
+    // The request waits for the next connection event; the response
+    // usually goes out one event later.
+    double served = sent_ms + hop_ms(cfg, &s_sync_rng);
+    double at = uptime + (served - wall) * (1 + drift);
+    if (at < 0) return;     // served before a reboot inside this step; counted as a failed read
+    sim_event_t *e = push_event(out);
+    e->sync = true;
+    e->rx_ms = served + cfg->conn_interval_ms + rand_exp_r(&s_sync_rng, 3.0);
+    e->reading.sent_unix_us = (uint64_t)(sent_ms * 1000.0);
+    e->reading.recv_unix_us = (uint64_t)(e->rx_ms * 1000.0);
+    e->reading.uptime_us = (uint64_t)(at * 1000.0);
+    e->reading.boot_id = boot_id;
+}
+
+// Walks one tag through the simulated time in sample periods and records
+// what the gateway would receive and when. Returns the final true drift.
+static double simulate_tag(const sim_config_t *cfg, bool with_sync, uint32_t *seq_io, event_list_t *out)
+{
+    double end_ms = cfg->hours * 3600e3;
+    double drift = (rand_unit() * 2 - 1) * cfg->drift_ppm * 1e-6;
+    double wall = EPOCH_MS + rand_unit() * 86400e3;
+    double uptime = rand_unit() * 3600e3;       // tag has been up a while already
+    uint32_t boot_id = (uint32_t)(rand_unit() * 4294967295.0);
+
+    double online_mean = cfg->session_min * 60e3;
+    double offline_mean = cfg->online > 0 ? online_mean * (1 - cfg->online) / cfg->online : end_ms;
+    bool online = rand_unit() < cfg->online;
+    double switch_at = wall + rand_exp(online ? online_mean : offline_mean);
+    double next_reboot = wall + (cfg->reboots_per_day > 0 ? rand_exp(86400e3 / cfg->reboots_per_day) : 2 * end_ms);
+    double next_sync = online && with_sync ? wall + rand_unit_r(&s_sync_rng) * cfg->sync_s * 1e3 : INFINITY;
+    int burst_left = 0;
+
+    sim_event_t backlog[BACKLOG_MAX];
+    size_t backlog_head = 0, backlog_count = 0;
+    double start = wall;
+    double period_ms = cfg->period_s * 1e3;
+
+    while (wall - start < end_ms) {
+        // Advance one sample period of tag time.
+        double step_wall = period_ms / (1 + drift);
+        double t_end = wall + step_wall;
+
+        while (online && next_sync < t_end) {
+            push_sync(cfg, out, next_sync, wall, uptime, drift, boot_id);
+            if (--burst_left > 0) next_sync += SYNC_BURST_GAP_MS;
+            else next_sync += cfg->sync_s * 1e3;
+        }
+
+        wall = t_end;
+        uptime += period_ms;
+        drift += rand_normal() * cfg->wander_ppm * 1e-6 * sqrt(cfg->period_s / 3600.0);
+
+        if (wall >= next_reboot) {
+            // RAM backlog is lost; seq resumes past the last checkpoint.
+            uptime = rand_unit() * 2000.0;
+            boot_id = (uint32_t)(rand_unit() * 4294967295.0);
+            backlog_count = 0;
+            *seq_io = (*seq_io / CHECKPOINT_INTERVAL) * CHECKPOINT_INTERVAL + CHECKPOINT_INTERVAL + 1;
+            next_reboot = wall + rand_exp(86400e3 / cfg->reboots_per_day);
+        }
+
+        while (wall >= switch_at) {
+            online = !online;
+            if (online) {
+                // Backlog goes out once the gateway has subscribed again;
+                // the gateway reads the clock once just before that.
+                double t = switch_at + SUBSCRIBE_DELAY_MS;
+                for (size_t i = 0; i < backlog_count; i++) {
+                    sim_event_t *e = push_event(out);
+                    *e = backlog[(backlog_head + i) % BACKLOG_MAX];
+                    e->rx_ms = t + hop_ms(cfg, &s_rng);
+                    t += NOTIFY_GAP_MS;
+                }
+                backlog_count = 0;
+                if (with_sync) {
+                    double sent = switch_at + SUBSCRIBE_DELAY_MS / 2;
+                    push_sync(cfg, out, sent, wall, uptime, drift, boot_id);
+                    next_sync = sent + SYNC_BURST_GAP_MS;
+                    burst_left = SYNC_BURST - 1;
+                }
+            } else {
+                next_sync = INFINITY;
+            }
+            switch_at += rand_exp(online ? online_mean : offline_mean);
+        }
+
+        sim_event_t s;
+        memset(&s, 0, sizeof(s));
+        s.seq = (*seq_io)++;
+        s.boot = (uint16_t)boot_id;
+        s.t_ms = (uint32_t)floor(uptime);
+        s.true_ms = wall;
+        if (online) {
+            sim_event_t *e = push_event(out);
+            *e = s;
+            e->rx_ms = wall + hop_ms(cfg, &s_rng);
+        } else {
+            if (backlog_count == BACKLOG_MAX) {
+                backlog_head = (backlog_head + 1) % BACKLOG_MAX;
+                backlog_count--;
+            }
+            backlog[(backlog_head + backlog_count++) % BACKLOG_MAX] = s;
+        }
+    }
+    return drift;
+}
+
+static void record(mode_report_t *m, double err, double bound, bool backlog)
+{
+    m->err[m->count++] = fabs(err);
+    if (backlog) m->backlog_err[m->backlog_count++] = fabs(err);
+    if (isinf(bound)) {
+        if (err < -1.0) m->after_estimate++;    // t_ms resolution
+        return;
+    }
+    if (fabs(err) > bound) m->violations++;
+    m->bound_total += bound;
+}
+
+static double pct(double *v, size_t n, double p)
+{
+    if (n == 0) return 0;
+    size_t i = (size_t)ceil(p * (double)n) - 1;
+    return v[i < n ? i : n - 1];
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --tags N            simulated tags (default 200)\n"
+            "  --hours H           simulated time per tag (default 24)\n"
+            "  --period-s S        sample period (default 15)\n"
+            "  --drift-ppm P       crystal error, uniform in +-P (default 40)\n"
+            "  --wander-ppm P      random walk of the drift per sqrt(hour) (default 0.5)\n"
+            "  --online F          fraction of time in range of the gateway (default 0.3)\n"
+            "  --session-min M     mean time in range per visit (default 20)\n"
+            "  --reboots-per-day R (default 0.5)\n"
+            "  --sync-s S          time-sync read interval while connected (default 600)\n"
+            "  --conn-ms MS        BLE connection interval (default 50)\n"
+            "  --seed N\n"
+            "  --check             exit 1 if synced errors break their bound too often\n"
+            "  --max-violations F  allowed fraction for --check (default 0.01)\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    sim_config_t cfg = {
+        .period_s = 15,
+        .hours = 24,
+        .drift_ppm = 40,
+        .wander_ppm = 0.5,
+        .online = 0.3,
+        .session_min = 20,
+        .reboots_per_day = 0.5,
+        .sync_s = 600,
+        .conn_interval_ms = 50,
+    };
+    uint32_t tags = 200;
+    bool check = false;
+    double max_violations = 0.01;
+
+    static const struct option opts[] = {
+        { "tags", required_argument, NULL, 't' },
+        { "hours", required_argument, NULL, 'H' },
+        { "period-s", required_argument, NULL, 'p' },
+        { "drift-ppm", required_argument, NULL, 'd' },
+        { "wander-ppm", required_argument, NULL, 'w' },
+        { "online", required_argument, NULL, 'o' },
+        { "session-min", required_argument, NULL, 'm' },
+        { "reboots-per-day", required_argument, NULL, 'r' },
+        { "sync-s", required_argument, NULL, 's' },
+        { "conn-ms", required_argument, NULL, 'c' },
+        { "seed", required_argument, NULL, 'S' },
+        { "check", no_argument, NULL, 'k' },
+        { "max-violations", required_argument, NULL, 'v' },
+        { "help", no_argument, NULL, 'h' },
+        { 0 },
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", opts, NULL)) != -1) {
+        switch (opt) {
+        case 't': tags = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'H': cfg.hours = atof(optarg); break;
+        case 'p': cfg.period_s = atof(optarg); break;
+        case 'd': cfg.drift_ppm = atof(optarg); break;
+        case 'w': cfg.wander_ppm = atof(optarg); break;
+        case 'o': cfg.online = atof(optarg); break;
+        case 'm': cfg.session_min = atof(optarg); break;
+        case 'r': cfg.reboots_per_day = atof(optarg); break;
+        case 's': cfg.sync_s = atof(optarg); break;
+        case 'c': cfg.conn_interval_ms = atof(optarg); break;
+        case 'S': s_rng = strtoull(optarg, NULL, 10) | 1; break;
+        case 'k': check = true; break;
+        case 'v': max_violations = atof(optarg); break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (tags == 0 || cfg.period_s <= 0 || cfg.hours <= 0 || cfg.online <= 0 || cfg.online > 1 ||
+        cfg.sync_s <= 0 || cfg.session_min <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    size_t cap = (size_t)tags * (size_t)(cfg.hours * 3600.0 / cfg.period_s + 2);
+    mode_report_t rep[MODE_COUNT];
+    for (int m = 0; m < MODE_COUNT; m++) {
+        memset(&rep[m], 0, sizeof(rep[m]));
+        rep[m].err = malloc(cap * sizeof(double));
+        rep[m].backlog_err = malloc(cap * sizeof(double));
+        if (!rep[m].err || !rep[m].backlog_err) {
+            GW_LOGE(TAG, "Out of memory for %zu samples", cap);
+            return 1;
+        }
+    }
+
+    double drift_err_total = 0;
+    size_t drift_fits = 0;
+    event_list_t events = { 0 };
+
+    for (uint32_t tag = 0; tag < tags; tag++) {
+        // The same tag history, once without and once with sync reads; the
+        // RNG is rewound so both runs see identical samples.
+        uint64_t rng_at_tag = s_rng;
+        for (int pass = 0; pass < 2; pass++) {
+            bool with_sync = pass == 1;
+            s_rng = rng_at_tag;
+            events.count = 0;
+            uint32_t seq = 1000;
+            double true_drift = simulate_tag(&cfg, with_sync, &seq, &events);
+            qsort(events.v, events.count, sizeof(*events.v), cmp_event);
+
+            gw_clock_t clock;
+            gw_clock_init(&clock);
+            mode_report_t *mode = &rep[with_sync ? MODE_SYNCED : MODE_PASSIVE];
+            for (size_t i = 0; i < events.count; i++) {
+                sim_event_t *e = &events.v[i];
+                if (e->sync) {
+                    gw_clock_add_sync(&clock, &e->reading);
+                    continue;
+                }
+                bool late = e->rx_ms - e->true_ms > 60e3;
+                if (!with_sync) record(&rep[MODE_ARRIVAL], e->rx_ms - e->true_ms, INFINITY, late);
+
+                uint64_t uptime, unix_ms;
+                uint32_t err_ms;
+                if (gw_clock_uptime(&clock, e->seq, e->boot, e->t_ms, &uptime) != 0) {
+                    mode->unplaced++;
+                    continue;
+                }
+                gw_clock_add_bound(&clock, uptime, (uint64_t)e->rx_ms);
+                if (gw_clock_to_unix(&clock, uptime, &unix_ms, &err_ms) == GW_CLOCK_NONE) {
+                    mode->unplaced++;
+                    continue;
+                }
+                record(mode, (double)unix_ms - e->true_ms,
+                       err_ms == GW_TIME_ERR_UNBOUNDED ? INFINITY : (double)err_ms, late);
+            }
+            if (with_sync && clock.have_drift) {
+                drift_err_total += fabs(gw_clock_drift_ppb(&clock) / 1000.0 - true_drift * 1e6);
+                drift_fits++;
+            }
+        }
+    }
+
+    bool ok = true;
+    for (int m = 0; m < MODE_COUNT; m++) {
+        mode_report_t *r = &rep[m];
+        qsort(r->err, r->count, sizeof(double), cmp_double);
+        qsort(r->backlog_err, r->backlog_count, sizeof(double), cmp_double);
+        double violation_rate = r->count ? (double)r->violations / (double)r->count : 0;
+        printf("{\"mode\":\"%s\",\"samples\":%zu,\"unplaced\":%zu,\"errP50Ms\":%.1f,\"errP95Ms\":%.1f,"
+               "\"errP99Ms\":%.1f,\"errMaxMs\":%.1f,\"backlogSamples\":%zu,\"backlogErrP99Ms\":%.1f",
+               s_mode_names[m], r->count, r->unplaced, pct(r->err, r->count, 0.50), pct(r->err, r->count, 0.95),
+               pct(r->err, r->count, 0.99), r->count ? r->err[r->count - 1] : 0.0, r->backlog_count,
+               pct(r->backlog_err, r->backlog_count, 0.99));
+        if (m == MODE_PASSIVE) {
+            printf(",\"bounded\":false,\"afterEstimate\":%zu,\"afterEstimateRate\":%.5f", r->after_estimate,
+                   r->count ? (double)r->after_estimate / (double)r->count : 0.0);
+        }
+        if (m == MODE_SYNCED) {
+            printf(",\"boundMeanMs\":%.1f,\"boundViolations\":%zu,\"violationRate\":%.5f",
+                   r->count ? r->bound_total / (double)r->count : 0.0, r->violations, violation_rate);
+            printf(",\"driftFits\":%zu,\"driftErrMeanPpm\":%.3f", drift_fits,
+                   drift_fits ? drift_err_total / (double)drift_fits : 0.0);
+        }
+        printf("}\n");
+    }
+
+    if (check) {
+        mode_report_t *s = &rep[MODE_SYNCED], *p = &rep[MODE_PASSIVE], *a = &rep[MODE_ARRIVAL];
+        double rate = s->count ? (double)s->violations / (double)s->count : 1;
+        if (rate > max_violations) {
+            GW_LOGE(TAG, "synced errors exceeded their bound %.3f%% of the time", rate * 100);
+            ok = false;
+        }
+        rate = p->count ? (double)p->after_estimate / (double)p->count : 1;
+        if (rate > max_violations) {
+            GW_LOGE(TAG, "passive samples were taken after their estimate %.3f%% of the time", rate * 100);
+            ok = false;
+        }
+        if (pct(s->err, s->count, 0.99) >= pct(a->err, a->count, 0.99)) {
+            GW_LOGE(TAG, "synced p99 error is not below arrival-time p99");
+            ok = false;
+        }
+    }
+
+    for (int m = 0; m < MODE_COUNT; m++) {
+        free(rep[m].err);
+        free(rep[m].backlog_err);
+    }
+    free(events.v);
+    return ok ? 0 : 1;
+}
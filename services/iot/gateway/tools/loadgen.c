@@ -0,0 +1,328 @@
+// Simulates a fleet of ESP32 tags by sending gateway frames to the daemon's
+// UNIX socket, so the pipeline can be pushed to 10k+ tags without radios.
+// Tags send any payload generation the gateway decodes (main/payload.h), with
+// a checkpoint signature every CHECKPOINT_INTERVAL samples, and tags on timed
+// firmware also answer time-sync reads as the BLE source would see them.
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gw_log.h"
+#include "gw_time.h"
+#include "payload.h"
+
+static const char *TAG = "LOADGEN";
+
+#define DEFAULT_SOCKET_PATH  "/tmp/chainproof-gateway.sock"
+#define SEND_BATCH           64
+#define DEVICE_BASE          0xCB0000000000ull
+#define CHECKPOINT_INTERVAL  720                 // CHAIN_CHECKPOINT_INTERVAL in blink/main/sample_chain.h
+#define LINK_LEN             32
+#define SIG_LEN              64
+#define PERIOD_MS            60000
+
+// Firmware generations, oldest first; "mix" spreads tags across all of them.
+typedef enum { FMT_V0, FMT_SEQ, FMT_PERIOD, FMT_CHAINED, FMT_TIMED, FMT_COUNT, FMT_MIX = FMT_COUNT } format_t;
+
+static const char *const s_format_names[FMT_COUNT + 1] = { "v0", "seq", "period", "chained", "timed", "mix" };
+
+// Sample length without the checkpoint signature.
+static const size_t s_format_lens[FMT_COUNT] = {
+    sizeof(gw_payload_v0_t), GW_PAYLOAD_SEQ_LEN, GW_PAYLOAD_PERIOD_LEN, GW_PAYLOAD_CHAINED_LEN, GW_PAYLOAD_TIMED_LEN,
+};
+
+typedef struct {
+    uint32_t seq;
+    float temp;
+    float humi;
+    format_t format;
+    uint32_t boot_id;
+    uint64_t uptime_base_ms;    // tag uptime when the run started
+    uint16_t sync_count;
+} tag_state_t;
+
+static uint64_t s_rng = 0x9E3779B97F4A7C15ull;
+
+static double rand_unit(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / (double)(1ull << 53);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --socket PATH     gateway socket (default " DEFAULT_SOCKET_PATH ")\n"
+            "  --tags N          simulated tags (default 10000)\n"
+            "  --rate N          frames per second across all tags, 0 = as fast as possible (default 20000)\n"
+            "  --duration S      seconds to run (default 30)\n"
+            "  --dup P           probability of re-sending a frame, 0..1 (default 0.05)\n"
+            "  --excursion P     probability a sample is out of range, 0..1 (default 0.01)\n"
+            "  --format F        v0, seq, period, chained, timed or mix (default timed)\n"
+            "  --probes N        probe records in chained and timed payloads, 1..%d (default 2)\n"
+            "  --sync P          probability a timed tag's sample follows a time-sync read, 0..1 (default 0.02)\n",
+            argv0, GW_MAX_PROBES);
+}
+
+static int parse_format(const char *name, format_t *out)
+{
+    for (int f = 0; f <= FMT_COUNT; f++) {
+        if (strcmp(name, s_format_names[f]) == 0) {
+            *out = (format_t)f;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void store16_le(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store32_le(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void store64_le(uint8_t *p, uint64_t v)
+{
+    store32_le(p, (uint32_t)v);
+    store32_le(p + 4, (uint32_t)(v >> 32));
+}
+
+static void fill_random(uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++) p[i] = (uint8_t)(rand_unit() * 256.0);
+}
+
+static uint64_t tag_uptime_ms(const tag_state_t *tag, uint64_t started_ns)
+{
+    return tag->uptime_base_ms + (gw_now_ns() - started_ns) / 1000000ull;
+}
+
+static void next_sample(tag_state_t *tag, double excursion, gw_payload_v0_t *out)
+{
+    // Slow random walk around a reefer set point.
+    tag->temp += (float)((rand_unit() - 0.5) * 0.2);
+    tag->humi += (float)((rand_unit() - 0.5) * 0.5);
+    if (tag->temp < 0.0f) tag->temp = 0.0f;
+    if (tag->temp > 10.0f) tag->temp = 10.0f;
+    if (tag->humi < 60.0f) tag->humi = 60.0f;
+    if (tag->humi > 95.0f) tag->humi = 95.0f;
+
+    float t = tag->temp;
+    out->flag2 = 0;
+    if (rand_unit() < excursion) {
+        t = 25.0f + (float)(rand_unit() * 10.0);
+        out->flag2 = GW_FLAG_TEMP_OOR;
+    }
+    out->temp_min = t - 0.1f;
+    out->temp_max = t + 0.1f;
+    out->humi_min = tag->humi - 0.5f;
+    out->humi_max = tag->humi + 0.5f;
+}
+
+// Lays out the tag's next payload in its firmware's format and returns its
+// length. The link and signature are random: the gateway does not verify the
+// chain.
+static size_t next_payload(tag_state_t *tag, double excursion, uint32_t probes, uint64_t started_ns,
+                           uint8_t out[GW_FRAME_MAX_PAYLOAD])
+{
+    gw_payload_v0_t v0;
+    next_sample(tag, excursion, &v0);
+    memcpy(out, &v0, sizeof(v0));
+    size_t len = s_format_lens[tag->format];
+    if (tag->format == FMT_V0) return len;
+
+    store32_le(out + GW_PAYLOAD_SEQ_OFFSET, tag->seq);
+    if (tag->format != FMT_SEQ) store16_le(out + GW_PAYLOAD_SEQ_OFFSET + 4, PERIOD_MS);
+    if (tag->format >= FMT_CHAINED) {
+        // The probes straddle the sample's min/max, as the firmware's do.
+        uint8_t *rec = out + GW_PAYLOAD_PROBES_OFFSET + 1;
+        memset(rec, 0, GW_MAX_PROBES * GW_PROBE_RECORD_LEN);
+        out[GW_PAYLOAD_PROBES_OFFSET] = (uint8_t)probes;
+        for (uint32_t i = 0; i < probes; i++, rec += GW_PROBE_RECORD_LEN) {
+            float k = probes > 1 ? (float)i / (float)(probes - 1) : 0.5f;
+            float t = v0.temp_min + k * (v0.temp_max - v0.temp_min);
+            float h = v0.humi_min + k * (v0.humi_max - v0.humi_min);
+            store16_le(rec, (uint16_t)(int16_t)lroundf(t * 10.0f));
+            store16_le(rec + 2, (uint16_t)lroundf(h * 10.0f));
+            rec[4] = v0.flag2;
+        }
+    }
+    if (tag->format == FMT_TIMED) {
+        store32_le(out + GW_PAYLOAD_TIME_OFFSET, (uint32_t)tag_uptime_ms(tag, started_ns));
+        store16_le(out + GW_PAYLOAD_BOOT_OFFSET, (uint16_t)tag->boot_id);
+    }
+    fill_random(out + len - LINK_LEN, LINK_LEN);
+    if (tag->seq % CHECKPOINT_INTERVAL == 0) {
+        fill_random(out + len, SIG_LEN);
+        len += SIG_LEN;
+    }
+    return len;
+}
+
+// A read of the tag's time-sync characteristic, bracketed by a simulated
+// round trip of 20-200 ms with the tag's clock read halfway through.
+static size_t next_sync(tag_state_t *tag, uint64_t device, uint64_t started_ns, uint8_t *frame, size_t max)
+{
+    uint64_t rtt_us = 20000 + (uint64_t)(rand_unit() * 180000.0);
+    uint64_t sent_unix_us = gw_unix_us();
+    uint8_t body[sizeof(gw_time_sync_t)] = { 0 };
+    store64_le(body + offsetof(gw_time_sync_t, uptime_us), tag_uptime_ms(tag, started_ns) * 1000ull + rtt_us / 2);
+    store32_le(body + offsetof(gw_time_sync_t, boot_id), tag->boot_id);
+    store16_le(body + offsetof(gw_time_sync_t, sync_count), tag->sync_count++);
+    return gw_sync_frame_build(frame, max, device, sent_unix_us, sent_unix_us + rtt_us, body, sizeof(body));
+}
+
+int main(int argc, char **argv)
+{
+    const char *socket_path = DEFAULT_SOCKET_PATH;
+    uint32_t tags = 10000;
+    double rate = 20000;
+    double duration_s = 30;
+    double dup = 0.05;
+    double excursion = 0.01;
+    format_t format = FMT_TIMED;
+    uint32_t probes = 2;
+    double sync = 0.02;
+
+    static const struct option options[] = {
+        { "socket", required_argument, NULL, 's' },
+        { "tags", required_argument, NULL, 't' },
+        { "rate", required_argument, NULL, 'r' },
+        { "duration", required_argument, NULL, 'd' },
+        { "dup", required_argument, NULL, 'u' },
+        { "excursion", required_argument, NULL, 'e' },
+        { "format", required_argument, NULL, 'f' },
+        { "probes", required_argument, NULL, 'p' },
+        { "sync", required_argument, NULL, 'y' },
+        { "help", no_argument, NULL, 'h' },
+        { 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 's': socket_path = optarg; break;
+        case 't': tags = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'r': rate = strtod(optarg, NULL); break;
+        case 'd': duration_s = strtod(optarg, NULL); break;
+        case 'u': dup = strtod(optarg, NULL); break;
+        case 'e': excursion = strtod(optarg, NULL); break;
+        case 'f':
+            if (parse_format(optarg, &format) != 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'p': probes = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'y': sync = strtod(optarg, NULL); break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (tags == 0 || probes == 0 || probes > GW_MAX_PROBES) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        GW_LOGE(TAG, "Cannot connect to %s; is the gateway running?", socket_path);
+        return 1;
+    }
+    int sndbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    tag_state_t *state = calloc(tags, sizeof(*state));
+    if (!state) return 1;
+    for (uint32_t i = 0; i < tags; i++) {
+        state[i].temp = 4.0f + (float)rand_unit();
+        state[i].humi = 80.0f + (float)(rand_unit() * 5.0);
+        state[i].seq = (uint32_t)(rand_unit() * CHECKPOINT_INTERVAL);
+        state[i].format = format == FMT_MIX ? (format_t)(i % FMT_COUNT) : format;
+        state[i].boot_id = (uint32_t)(rand_unit() * 4294967296.0);
+        state[i].uptime_base_ms = (uint64_t)(rand_unit() * 86400e3);
+    }
+
+    uint64_t started = gw_now_ns();
+    uint64_t end = started + (uint64_t)(duration_s * 1e9);
+    uint64_t sent = 0, duplicates = 0, send_errors = 0, syncs = 0, checkpoints = 0;
+    uint32_t next_tag = 0;
+    uint64_t next_log = started + 1000000000ull;
+
+    while (gw_now_ns() < end) {
+        for (int b = 0; b < SEND_BATCH; b++) {
+            tag_state_t *tag = &state[next_tag];
+            uint64_t device = DEVICE_BASE + next_tag;
+            uint8_t frame[GW_FRAME_MAX_LEN];
+
+            if (tag->format == FMT_TIMED && rand_unit() < sync) {
+                size_t len = next_sync(tag, device, started, frame, sizeof(frame));
+                if (send(fd, frame, len, 0) == (ssize_t)len) {
+                    sent++;
+                    syncs++;
+                } else {
+                    send_errors++;
+                }
+            }
+
+            uint8_t payload[GW_FRAME_MAX_PAYLOAD];
+            size_t payload_len = next_payload(tag, excursion, probes, started, payload);
+            if (payload_len > s_format_lens[tag->format]) checkpoints++;
+            size_t len = gw_frame_build(frame, sizeof(frame), device, tag->seq++, payload, payload_len);
+            int copies = rand_unit() < dup ? 2 : 1;
+            for (int c = 0; c < copies; c++) {
+                if (send(fd, frame, len, 0) == (ssize_t)len) {
+                    sent++;
+                    if (c) duplicates++;
+                } else {
+                    send_errors++;
+                }
+            }
+            next_tag = (next_tag + 1) % tags;
+        }
+
+        uint64_t now = gw_now_ns();
+        if (rate > 0) {
+            // Pace against the schedule rather than per-frame sleeps.
+            uint64_t due = started + (uint64_t)((double)sent / rate * 1e9);
+            if (due > now) {
+                struct timespec ts = { .tv_sec = (time_t)((due - now) / 1000000000ull),
+                                       .tv_nsec = (long)((due - now) % 1000000000ull) };
+                nanosleep(&ts, NULL);
+            }
+        }
+        if (now >= next_log) {
+            GW_LOGI(TAG, "%llu frames sent (%.0f/s), %llu duplicates, %llu send errors",
+                    (unsigned long long)sent, sent / ((now - started) / 1e9),
+                    (unsigned long long)duplicates, (unsigned long long)send_errors);
+            next_log += 1000000000ull;
+        }
+    }
+
+    double elapsed_s = (gw_now_ns() - started) / 1e9;
+    printf("{\"tags\":%u,\"format\":\"%s\",\"frames\":%llu,\"syncFrames\":%llu,\"checkpoints\":%llu,"
+           "\"duplicates\":%llu,\"sendErrors\":%llu,\"elapsedSeconds\":%.3f,\"framesPerSecond\":%.1f}\n",
+           tags, s_format_names[format], (unsigned long long)sent, (unsigned long long)syncs,
+           (unsigned long long)checkpoints, (unsigned long long)duplicates, (unsigned long long)send_errors,
+           elapsed_s, sent / elapsed_s);
+
+    free(state);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,588 @@
+// Runs the submit stage (main/submit.h) against an in-process JSON-RPC node
+// that mines every transaction as soon as its nonce is next, and checks what
+// ends up on the fake chain. Each case sets the node up to misbehave in one
+// way; a case passes when every window is recorded exactly once with the
+// calldata ChainProof.recordSensorWindow expects and the account's nonces
+// have no gap. Exits non-zero if any case fails.
+#include <getopt.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "gw_log.h"
+#include "gw_time.h"
+#include "json.h"
+#include "keccak.h"
+#include "submit.h"
+
+static const char *TAG = "SUBMIT_SIM";
+
+// As declared in services/smart-contracts/contracts/ChainProof.sol, kept
+// apart from main/submit.c so a mismatch between the two shows up here.
+#define CONTRACT_SIGNATURE \
+    "recordSensorWindow(bytes32,uint32,uint32,uint32,int16,int16,uint16,uint16,uint8,uint64,uint64,uint32)"
+#define CONTRACT_WORDS  12
+
+#define GATEWAY_ACCOUNT "0x00000000000000000000000000000000000000aa"
+#define CONTRACT_ADDR   "0x00000000000000000000000000000000000000cc"
+#define NODE_MAX_TXS    4096
+#define DATA_HEX_MAX    (2 + 2 * (4 + 32 * CONTRACT_WORDS))
+#define DRIVE_LIMIT_NS  (5ull * 1000000000ull)
+
+typedef struct {
+    char hash[67];
+    uint64_t nonce;
+    uint64_t block;         // 0 while pooled; every transaction gets its own
+    char data[DATA_HEX_MAX + 1];
+} node_tx_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    int listen_fd;
+    uint16_t port;
+    atomic_bool stop;
+    pthread_t thread;
+
+    uint64_t latest;        // next nonce to be mined
+    uint64_t blocks;
+    node_tx_t txs[NODE_MAX_TXS];
+    size_t tx_count;
+
+    char reject[DATA_HEX_MAX + 1];  // calldata the node refuses, for a reason other than its nonce
+    uint32_t lose_reply;            // send request (1-based) processed but answered by a closed connection
+    uint32_t sends;
+} fake_node_t;
+
+// ---- fake node ----
+
+static node_tx_t *node_find_nonce(fake_node_t *n, uint64_t nonce)
+{
+    for (size_t i = 0; i < n->tx_count; i++) {
+        if (n->txs[i].nonce == nonce) return &n->txs[i];
+    }
+    return NULL;
+}
+
+static node_tx_t *node_find_block(fake_node_t *n, uint64_t block)
+{
+    for (size_t i = 0; i < n->tx_count; i++) {
+        if (n->txs[i].block == block) return &n->txs[i];
+    }
+    return NULL;
+}
+
+static node_tx_t *node_find_hash(fake_node_t *n, const gw_json_t *hash)
+{
+    for (size_t i = 0; hash && i < n->tx_count; i++) {
+        if (gw_json_str_eq(hash, n->txs[i].hash)) return &n->txs[i];
+    }
+    return NULL;
+}
+
+static void node_mine(fake_node_t *n)
+{
+    for (node_tx_t *tx = node_find_nonce(n, n->latest); tx && !tx->block; tx = node_find_nonce(n, n->latest)) {
+        tx->block = ++n->blocks;
+        n->latest++;
+    }
+}
+
+static void put_error(FILE *out, const char *msg)
+{
+    fprintf(out, "\"error\":{\"code\":-32000,\"message\":\"%s\"}", msg);
+}
+
+// Pools a transaction from the gateway account, as another process holding
+// its key would.
+static node_tx_t *node_add(fake_node_t *n, uint64_t nonce, const char *data)
+{
+    if (n->tx_count == NODE_MAX_TXS) return NULL;
+    node_tx_t *tx = &n->txs[n->tx_count++];
+    memset(tx, 0, sizeof(*tx));
+    tx->nonce = nonce;
+    snprintf(tx->data, sizeof(tx->data), "%s", data);
+    snprintf(tx->hash, sizeof(tx->hash), "0x%064zx", n->tx_count);
+    return tx;
+}
+
+static void node_send(fake_node_t *n, const gw_json_t *params, FILE *out)
+{
+    const gw_json_t *req = gw_json_at(params, 0);
+    uint64_t nonce;
+    node_tx_t tx = { 0 };
+    if (gw_json_u64(gw_json_get(req, "nonce"), &nonce) != 0) {
+        put_error(out, "nonce required");
+        return;
+    }
+    const gw_json_t *data = gw_json_get(req, "data");
+    if (data && gw_json_copy_str(data, tx.data, sizeof(tx.data)) != 0) {
+        put_error(out, "unexpected calldata length");
+        return;
+    }
+    if (nonce < n->latest) {
+        put_error(out, "nonce too low");
+        return;
+    }
+    if (n->reject[0] && strcmp(tx.data, n->reject) == 0) {
+        put_error(out, "sender doesn't have enough funds to send tx");
+        return;
+    }
+    if (node_find_nonce(n, nonce)) {
+        put_error(out, "replacement transaction underpriced");
+        return;
+    }
+    node_tx_t *added = node_add(n, nonce, tx.data);
+    if (!added) {
+        put_error(out, "pool full");
+        return;
+    }
+    fprintf(out, "\"result\":\"%s\"", added->hash);
+}
+
+static void node_call(fake_node_t *n, const gw_json_t *call, FILE *out)
+{
+    const gw_json_t *method = gw_json_get(call, "method");
+    const gw_json_t *params = gw_json_get(call, "params");
+    const gw_json_t *id = gw_json_get(call, "id");
+    fprintf(out, "{\"jsonrpc\":\"2.0\",\"id\":%.*s,", id ? (int)id->len : 1, id ? id->str : "1");
+
+    if (gw_json_str_eq(method, "eth_chainId")) {
+        fprintf(out, "\"result\":\"0x539\"");
+    } else if (gw_json_str_eq(method, "eth_getTransactionCount")) {
+        // Queued transactions past a gap do not count towards pending.
+        uint64_t count = n->latest, block;
+        if (gw_json_u64(gw_json_at(params, 1), &block) == 0) {
+            count = 0;
+            for (size_t i = 0; i < n->tx_count; i++) count += n->txs[i].block && n->txs[i].block <= block;
+        }
+        fprintf(out, "\"result\":\"0x%llx\"", (unsigned long long)count);
+    } else if (gw_json_str_eq(method, "eth_sendTransaction")) {
+        node_send(n, params, out);
+    } else if (gw_json_str_eq(method, "eth_getTransactionReceipt")) {
+        node_tx_t *tx = node_find_hash(n, gw_json_at(params, 0));
+        if (tx && tx->block) {
+            fprintf(out, "\"result\":{\"transactionHash\":\"%s\",\"status\":\"0x1\",\"blockNumber\":\"0x%llx\"}",
+                    tx->hash, (unsigned long long)tx->block);
+        } else {
+            fprintf(out, "\"result\":null");
+        }
+    } else if (gw_json_str_eq(method, "eth_blockNumber")) {
+        fprintf(out, "\"result\":\"0x%llx\"", (unsigned long long)n->blocks);
+    } else if (gw_json_str_eq(method, "eth_getBlockByNumber")) {
+        uint64_t number;
+        node_tx_t *tx = gw_json_u64(gw_json_at(params, 0), &number) == 0 ? node_find_block(n, number) : NULL;
+        if (tx) {
+            fprintf(out,
+                    "\"result\":{\"number\":\"0x%llx\",\"transactions\":[{\"hash\":\"%s\",\"from\":\"%s\","
+                    "\"nonce\":\"0x%llx\",\"input\":\"%s\"}]}",
+                    (unsigned long long)number, tx->hash, GATEWAY_ACCOUNT,
+                    (unsigned long long)tx->nonce, tx->data[0] ? tx->data : "0x");
+        } else {
+            fprintf(out, "\"result\":null");
+        }
+    } else if (gw_json_str_eq(method, "eth_getTransactionByHash")) {
+        node_tx_t *tx = node_find_hash(n, gw_json_at(params, 0));
+        if (tx) {
+            fprintf(out, "\"result\":{\"hash\":\"%s\",\"nonce\":\"0x%llx\"}", tx->hash,
+                    (unsigned long long)tx->nonce);
+        } else {
+            fprintf(out, "\"result\":null");
+        }
+    } else {
+        fprintf(out, "\"error\":{\"code\":-32601,\"message\":\"Method not found\"}");
+    }
+    fputc('}', out);
+}
+
+// Returns the reply body (malloc'd), or NULL for a malformed request or one
+// whose reply is to be lost.
+static char *node_handle(fake_node_t *n, char *request, size_t len, size_t *reply_len)
+{
+    bool sending = strstr(request, "eth_sendTransaction") != NULL;
+    gw_json_doc_t doc;
+    if (gw_json_parse(&doc, request, len) != 0) {
+        gw_json_free(&doc);
+        return NULL;
+    }
+
+    char *reply = NULL;
+    FILE *out = open_memstream(&reply, reply_len);
+    if (!out) {
+        gw_json_free(&doc);
+        return NULL;
+    }
+    pthread_mutex_lock(&n->lock);
+    if (doc.root->type == GW_JSON_ARRAY) {
+        fputc('[', out);
+        for (const gw_json_t *c = doc.root->child; c; c = c->next) {
+            if (c != doc.root->child) fputc(',', out);
+            node_call(n, c, out);
+        }
+        fputc(']', out);
+    } else {
+        node_call(n, doc.root, out);
+    }
+    node_mine(n);
+    bool lost = sending && ++n->sends == n->lose_reply;
+    pthread_mutex_unlock(&n->lock);
+    fclose(out);
+    gw_json_free(&doc);
+    if (lost) {
+        free(reply);
+        return NULL;
+    }
+    return reply;
+}
+
+static int read_request(int fd, char **body, size_t *body_len)
+{
+    char head[8192];
+    size_t have = 0;
+    char *end = NULL;
+    while (!end) {
+        if (have == sizeof(head) - 1) return -1;
+        ssize_t got = recv(fd, head + have, sizeof(head) - 1 - have, 0);
+        if (got <= 0) return -1;
+        have += (size_t)got;
+        head[have] = '\0';
+        end = strstr(head, "\r\n\r\n");
+    }
+    const char *cl = strcasestr(head, "Content-Length:");
+    if (!cl) return -1;
+    size_t len = strtoul(cl + 15, NULL, 10);
+    size_t header_len = (size_t)(end + 4 - head);
+
+    *body = malloc(len + 1);
+    if (!*body) return -1;
+    size_t copied = have - header_len < len ? have - header_len : len;
+    memcpy(*body, head + header_len, copied);
+    while (copied < len) {
+        ssize_t got = recv(fd, *body + copied, len - copied, 0);
+        if (got <= 0) {
+            free(*body);
+            return -1;
+        }
+        copied += (size_t)got;
+    }
+    (*body)[len] = '\0';
+    *body_len = len;
+    return 0;
+}
+
+static void serve_connection(fake_node_t *n, int fd)
+{
+    while (!atomic_load(&n->stop)) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, 50) <= 0) continue;
+
+        char *body;
+        size_t body_len, reply_len = 0;
+        if (read_request(fd, &body, &body_len) != 0) return;
+        char *reply = node_handle(n, body, body_len, &reply_len);
+        if (!reply) return;
+
+        char header[128];
+        int header_len = snprintf(header, sizeof(header),
+                                  "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n",
+                                  reply_len);
+        bool ok = send(fd, header, (size_t)header_len, MSG_NOSIGNAL) == header_len &&
+                  send(fd, reply, reply_len, MSG_NOSIGNAL) == (ssize_t)reply_len;
+        free(reply);
+        if (!ok) return;
+    }
+}
+
+static void *node_thread(void *param)
+{
+    fake_node_t *n = param;
+    while (!atomic_load(&n->stop)) {
+        struct pollfd pfd = { .fd = n->listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 50) <= 0) continue;
+        int fd = accept(n->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        serve_connection(n, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static int node_start(fake_node_t *n)
+{
+    memset(n, 0, sizeof(*n));
+    pthread_mutex_init(&n->lock, NULL);
+    n->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    if (n->listen_fd < 0 || bind(n->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(n->listen_fd, 4) != 0 || getsockname(n->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        GW_LOGE(TAG, "Cannot listen on loopback");
+        return -1;
+    }
+    n->port = ntohs(addr.sin_port);
+    return pthread_create(&n->thread, NULL, node_thread, n) == 0 ? 0 : -1;
+}
+
+static void node_stop(fake_node_t *n)
+{
+    atomic_store(&n->stop, true);
+    pthread_join(n->thread, NULL);
+    close(n->listen_fd);
+    pthread_mutex_destroy(&n->lock);
+}
+
+// ---- expected calldata ----
+
+static void hex_word_u64(char *out, uint64_t v)
+{
+    snprintf(out, 65, "%048x%016llx", 0, (unsigned long long)v);
+}
+
+// Sign-extended to 256 bits.
+static void hex_word_i16(char *out, int16_t v)
+{
+    memset(out, v < 0 ? 'f' : '0', 60);
+    snprintf(out + 60, 5, "%04x", (unsigned)(uint16_t)v);
+}
+
+static void expected_calldata(const gw_window_t *w, char out[DATA_HEX_MAX + 1])
+{
+    uint8_t digest[32];
+    gw_keccak256(CONTRACT_SIGNATURE, strlen(CONTRACT_SIGNATURE), digest);
+    char *p = out;
+    p += sprintf(p, "0x%02x%02x%02x%02x", digest[0], digest[1], digest[2], digest[3]);
+
+    // bytes32 deviceId: 6-byte address, probe, then zeros.
+    p += sprintf(p, "%012llx%02x%050x", (unsigned long long)w->device, w->probe, 0);
+    const uint64_t words[] = {
+        w->first_seq, w->last_seq, w->samples, 0, 0, (uint64_t)lroundf(w->humi_min * 100.0f),
+        (uint64_t)lroundf(w->humi_max * 100.0f), w->flags, w->first_unix_ms, w->last_unix_ms, w->time_err_ms,
+    };
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++, p += 64) {
+        if (i == 3) hex_word_i16(p, (int16_t)lroundf(w->temp_min * 100.0f));
+        else if (i == 4) hex_word_i16(p, (int16_t)lroundf(w->temp_max * 100.0f));
+        else hex_word_u64(p, words[i]);
+    }
+    *p = '\0';
+}
+
+// ---- cases ----
+
+typedef struct {
+    const char *name;
+    size_t windows;
+    uint32_t batch;
+    size_t rejected;        // window the node refuses (index + 1), never mined
+    void (*setup)(fake_node_t *n, gw_window_t *windows, size_t count);
+} sim_case_t;
+
+static void make_windows(gw_window_t *windows, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        gw_window_t *w = &windows[i];
+        memset(w, 0, sizeof(*w));
+        w->device = 0xCB0000000000ull + i;
+        w->probe = (uint8_t)(i % 5);
+        w->first_seq = 1000 + (uint32_t)i * 4;
+        w->last_seq = w->first_seq + 3;
+        w->samples = 4;
+        w->temp_min = -2.5f + (float)(i % 7);
+        w->temp_max = w->temp_min + 0.75f;
+        w->humi_min = 60.0f + (float)(i % 30);
+        w->humi_max = w->humi_min + 1.5f;
+        w->flags = (uint8_t)(i % 8);
+        // Synced, passive and untimed windows in turn.
+        switch (i % 3) {
+        case 0:
+            w->first_unix_ms = 1767225600000ull + i * 60000;
+            w->last_unix_ms = w->first_unix_ms + 45000;
+            w->time_err_ms = 40 + (uint32_t)i;
+            break;
+        case 1:
+            w->first_unix_ms = 1767225600000ull + i * 60000;
+            w->last_unix_ms = w->first_unix_ms + 45000;
+            w->time_err_ms = GW_TIME_ERR_UNBOUNDED;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Hands windows to the submitter the way the pipeline's submit task does:
+// rejected and requeued windows go first, under new nonces.
+static void drive(gw_submitter_t *s, const gw_window_t *windows, size_t count, uint32_t batch)
+{
+    gw_window_t *retry = calloc(count + s->cfg.max_inflight, sizeof(*retry));
+    gw_window_t *out = calloc(batch, sizeof(*out));
+    size_t retry_count = 0, next = 0;
+    uint64_t deadline = gw_now_ns() + DRIVE_LIMIT_NS;
+    while (retry && out && gw_now_ns() < deadline) {
+        gw_submit_poll(s, true);
+        retry_count += gw_submit_take_requeued(s, retry + retry_count, count - retry_count);
+        if (next == count && retry_count == 0 && gw_submit_inflight(s) == 0) break;
+
+        size_t room = gw_submit_capacity(s);
+        if (room > batch) room = batch;
+        size_t n = retry_count < room ? retry_count : room;
+        memcpy(out, retry, n * sizeof(*out));
+        memmove(retry, retry + n, (retry_count - n) * sizeof(*retry));
+        retry_count -= n;
+        while (n < room && next < count) out[n++] = windows[next++];
+        if (n > 0) retry_count += gw_submit_send(s, out, n, retry + retry_count);
+        usleep(1000);
+    }
+    free(retry);
+    free(out);
+}
+
+// Every window on the chain once with the expected calldata, and nothing
+// left pooled behind a gap.
+static bool check_chain(fake_node_t *n, const gw_window_t *windows, size_t count, size_t rejected, char *why,
+                        size_t why_len)
+{
+    char want[DATA_HEX_MAX + 1];
+    pthread_mutex_lock(&n->lock);
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        expected_calldata(&windows[i], want);
+        size_t found = 0;
+        for (size_t t = 0; t < n->tx_count; t++) {
+            if (n->txs[t].block && strcmp(n->txs[t].data, want) == 0) found++;
+        }
+        if (found != (i + 1 == rejected ? 0u : 1u)) {
+            snprintf(why, why_len, "window %zu mined %zu times", i, found);
+            ok = false;
+        }
+    }
+    for (size_t t = 0; t < n->tx_count && ok; t++) {
+        if (!n->txs[t].block) {
+            snprintf(why, why_len, "nonce %llu stuck behind nonce %llu", (unsigned long long)n->txs[t].nonce,
+                     (unsigned long long)n->latest);
+            ok = false;
+        }
+    }
+    pthread_mutex_unlock(&n->lock);
+    return ok;
+}
+
+static bool run_case(const sim_case_t *c)
+{
+    fake_node_t *node = malloc(sizeof(*node));
+    gw_window_t *windows = calloc(c->windows, sizeof(*windows));
+    if (!node || !windows || node_start(node) != 0) {
+        free(node);
+        free(windows);
+        return false;
+    }
+    make_windows(windows, c->windows);
+    if (c->rejected) expected_calldata(&windows[c->rejected - 1], node->reject);
+    if (c->setup) c->setup(node, windows, c->windows);
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u", node->port);
+    gw_submit_config_t cfg = {
+        .rpc_url = url,
+        .from = GATEWAY_ACCOUNT,
+        .contract = CONTRACT_ADDR,
+        .batch_size = c->batch,
+        .max_inflight = 64,
+        .receipt_poll_ms = 0,
+        .tx_timeout_ms = 50,
+        .gas_limit = 100000,
+    };
+    gw_submitter_t s;
+    char why[160] = "";
+    bool ok = gw_submit_init(&s, &cfg) == 0;
+    if (!ok) snprintf(why, sizeof(why), "submitter did not start");
+    if (ok) {
+        drive(&s, windows, c->windows, c->batch);
+        ok = check_chain(node, windows, c->windows, c->rejected, why, sizeof(why));
+    }
+    printf("{\"case\":\"%s\",\"windows\":%zu,\"ok\":%s,\"confirmed\":%llu,\"failed\":%llu,\"replaced\":%llu,"
+           "\"nonceResyncs\":%llu,\"gapFills\":%llu%s%s%s}\n",
+           c->name, c->windows, ok ? "true" : "false", (unsigned long long)s.stats.confirmed,
+           (unsigned long long)s.stats.failed, (unsigned long long)s.stats.replaced,
+           (unsigned long long)s.stats.nonce_resyncs, (unsigned long long)s.stats.gap_fills, why[0] ? ",\"why\":\"" : "", why, why[0] ? "\"" : "");
+
+    gw_submit_destroy(&s);
+    node_stop(node);
+    free(node);
+    free(windows);
+    return ok;
+}
+
+// The node takes the first batch but the reply never arrives, so none of its
+// transactions has a hash.
+static void lose_first_reply(fake_node_t *n, gw_window_t *windows, size_t count)
+{
+    (void)windows;
+    (void)count;
+    n->lose_reply = 1;
+}
+
+// As above, and another process holding the account's key already has a
+// transfer pooled at a nonce the batch goes on to use.
+static void lose_first_reply_foreign(fake_node_t *n, gw_window_t *windows, size_t count)
+{
+    lose_first_reply(n, windows, count);
+    node_add(n, 5, "");
+}
+
+static const sim_case_t s_cases[] = {
+    { .name = "calldata", .windows = 96, .batch = 16 },
+    // The middle of the first batch: later nonces of that batch are pooled
+    // behind it.
+    { .name = "reject-middle", .windows = 48, .batch = 16, .rejected = 8 },
+    { .name = "lost-reply", .windows = 48, .batch = 16, .setup = lose_first_reply },
+    { .name = "lost-reply-foreign", .windows = 48, .batch = 16, .setup = lose_first_reply_foreign },
+};
+
+#define CASE_COUNT (sizeof(s_cases) / sizeof(s_cases[0]))
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--case NAME]\n  cases:", argv0);
+    for (size_t i = 0; i < CASE_COUNT; i++) fprintf(stderr, " %s", s_cases[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *only = NULL;
+    static const struct option opts[] = {
+        { "case", required_argument, NULL, 'c' },
+        { "help", no_argument, NULL, 'h' },
+        { 0 },
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+        switch (opt) {
+        case 'c': only = optarg; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    bool ok = true;
+    size_t ran = 0;
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        if (only && strcmp(only, s_cases[i].name) != 0) continue;
+        ok = run_case(&s_cases[i]) && ok;
+        ran++;
+    }
+    if (ran == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
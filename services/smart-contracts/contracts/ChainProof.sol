@@ -83,6 +83,22 @@ contract ChainProof {
         uint256 timestamp
     );
     event BatchConsumed(uint256 indexed id, address indexed handler, uint256 timestamp);
+    event SensorWindowRecorded(
+        bytes32 indexed deviceId,
+        address indexed gateway,
+        uint32 firstSeq,
+        uint32 lastSeq,
+        uint32 samples,
+        int16 tempMinCentiC,
+        int16 tempMaxCentiC,
+        uint16 humiMinCentiPct,
+        uint16 humiMaxCentiPct,
+        uint8 flags,
+        uint64 firstSampleMs,
+        uint64 lastSampleMs,
+        uint32 sampleTimeErrMs,
+        uint256 timestamp
+    );
 
     modifier onlyOwner() {
         require(msg.sender == owner, "Only owner");
@@ -307,6 +323,46 @@ contract ChainProof {
         emit BatchReceived(batchId, msg.sender, block.timestamp);
     }
 
+    // Gateway anchor for an aggregated window of tag readings. Event-only so
+    // a gateway can afford one transaction per tag per window. Sample times
+    // are the gateway's reconstruction of when the first and last samples
+    // were taken (unix ms, 0 when unknown); sampleTimeErrMs bounds their error,
+    // type(uint32).max when nothing does.
+    function recordSensorWindow(
+        bytes32 deviceId,
+        uint32 firstSeq,
+        uint32 lastSeq,
+        uint32 samples,
+        int16 tempMinCentiC,
+        int16 tempMaxCentiC,
+        uint16 humiMinCentiPct,
+        uint16 humiMaxCentiPct,
+        uint8 flags,
+        uint64 firstSampleMs,
+        uint64 lastSampleMs,
+        uint32 sampleTimeErrMs
+    ) external {
+        require(roles[msg.sender] != Role.None, "Role not allowed");
+        require(samples > 0 && lastSeq >= firstSeq, "Invalid sensor window");
+        require(lastSampleMs >= firstSampleMs, "Invalid sensor window");
+        emit SensorWindowRecorded(
+            deviceId,
+            msg.sender,
+            firstSeq,
+            lastSeq,
+            samples,
+            tempMinCentiC,
+            tempMaxCentiC,
+            humiMinCentiPct,
+            humiMaxCentiPct,
+            flags,
+            firstSampleMs,
+            lastSampleMs,
+            sampleTimeErrMs,
+            block.timestamp
+        );
+    }
+
     function getParentBatches(
         uint256 batchId
     ) external view returns (uint256[] memory) {
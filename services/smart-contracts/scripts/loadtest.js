@@ -0,0 +1,591 @@
+// End-to-end load generator for ChainProof on a local node.
+//
+// Each lineage walks one harvest through the supply chain the way the roles
+// do it by hand:
+//
+//   producer harvest -> transfer -> processor receive -> transform -> split
+//   -> each child to a warehouse -> merge (repack) -> transporter -> customer
+//
+// Lineages run LOADTEST_CONCURRENCY at a time over a pool of role accounts.
+// A simulated gateway fleet can send recordSensorWindow alongside, and some
+// customers trace what they received. Every LOADTEST_READ_EVERY lineages
+// the read paths of services/web/lib/chainproof-read.ts and
+// services/smart-contracts/dashboard/app.py are replayed, query for query,
+// against a sample of tracking codes, so their cost can be followed as the
+// chain grows.
+//
+// The report is one JSON object on stdout (and in LOADTEST_OUT if set);
+// progress goes to stderr.
+//
+//   npx hardhat node
+//   LOADTEST_BATCHES=2000 LOADTEST_OUT=loadtest.json \
+//     npx hardhat run scripts/loadtest.js --network localhost
+const hre = require("hardhat");
+const fs = require("fs");
+const path = require("path");
+
+function envInt(name, fallback) {
+  const value = Number.parseInt(process.env[name] || "", 10);
+  return Number.isFinite(value) ? value : fallback;
+}
+
+function envFloat(name, fallback) {
+  const value = Number.parseFloat(process.env[name] || "");
+  return Number.isFinite(value) ? value : fallback;
+}
+
+const ROLE_VALUES = {
+  producer: 1,
+  processor: 2,
+  warehouse: 3,
+  transporter: 4,
+  customer: 5,
+};
+
+function parseRoleMix(raw) {
+  const mix = {};
+  for (const part of raw.split(",")) {
+    const [name, count] = part.split(":").map((item) => item.trim());
+    if (!(name in ROLE_VALUES)) {
+      throw new Error(`Unknown role "${name}" in LOADTEST_ROLE_MIX`);
+    }
+    mix[name] = Math.max(1, Number.parseInt(count || "1", 10));
+  }
+  for (const name of Object.keys(ROLE_VALUES)) {
+    if (!mix[name]) mix[name] = 1;
+  }
+  return mix;
+}
+
+const BATCHES = envInt("LOADTEST_BATCHES", 200);
+const CONFIG = {
+  batches: BATCHES,
+  concurrency: envInt("LOADTEST_CONCURRENCY", 16),
+  splitChildren: Math.max(2, envInt("LOADTEST_SPLIT", 2)),
+  roleMix: parseRoleMix(
+    process.env.LOADTEST_ROLE_MIX || "producer:3,processor:2,warehouse:3,transporter:4,customer:4"
+  ),
+  // Simulated gateway fleet: one window per tag per window length.
+  sensorTags: envInt("LOADTEST_SENSOR_TAGS", 0),
+  sensorWindowS: Math.max(1, envInt("LOADTEST_SENSOR_WINDOW_S", 60)),
+  // Tags sample adaptively between 2 and 60 s (blink/main sample_sched);
+  // 5 s is the fixed period the scheduler replaced, the busiest steady case.
+  samplePeriodS: Math.min(60, Math.max(2, envFloat("LOADTEST_SAMPLE_PERIOD_S", 5))),
+  // Fraction of delivered lineages whose customer traces the batch.
+  customerTrace: envFloat("LOADTEST_CUSTOMER_TRACE", 0.1),
+  readEvery: Math.max(1, envInt("LOADTEST_READ_EVERY", Math.max(1, Math.ceil(BATCHES / 10)))),
+  readSamples: Math.max(1, envInt("LOADTEST_READ_SAMPLES", 5)),
+  // 0 keeps Hardhat's automine (one block per transaction).
+  blockMs: envInt("LOADTEST_BLOCK_MS", 0),
+  contract: process.env.LOADTEST_CONTRACT || "",
+  out: process.env.LOADTEST_OUT || "",
+};
+
+const UNITS_PER_CHILD = 10;
+
+// ---- statistics ----
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) return 0;
+  const rank = Math.min(sorted.length - 1, Math.max(0, Math.ceil(p * sorted.length) - 1));
+  return sorted[rank];
+}
+
+function round(value, digits = 1) {
+  const scale = 10 ** digits;
+  return Math.round(value * scale) / scale;
+}
+
+function summarize(values) {
+  const sorted = Float64Array.from(values).sort();
+  const total = values.reduce((sum, value) => sum + value, 0);
+  return {
+    count: values.length,
+    meanMs: round(values.length ? total / values.length : 0),
+    p50Ms: round(percentile(sorted, 0.5)),
+    p95Ms: round(percentile(sorted, 0.95)),
+    p99Ms: round(percentile(sorted, 0.99)),
+    maxMs: round(sorted.length ? sorted[sorted.length - 1] : 0),
+  };
+}
+
+// Latencies per operation, kept whole for the final report and read from
+// a moving mark for each checkpoint interval.
+class OperationStats {
+  constructor() {
+    this.latencies = new Map();
+    this.failures = new Map();
+    this.errors = new Map();
+    this.marks = new Map();
+    this.transactions = 0;
+  }
+
+  record(op, ms) {
+    if (!this.latencies.has(op)) this.latencies.set(op, []);
+    this.latencies.get(op).push(ms);
+  }
+
+  fail(op, error) {
+    this.failures.set(op, (this.failures.get(op) || 0) + 1);
+    const message = String(error?.shortMessage || error?.message || error).slice(0, 200);
+    if (!this.errors.has(op)) this.errors.set(op, message);
+  }
+
+  report() {
+    const out = {};
+    for (const [op, values] of this.latencies) {
+      out[op] = { ...summarize(values), failed: this.failures.get(op) || 0 };
+    }
+    for (const [op, failed] of this.failures) {
+      if (!out[op]) out[op] = { ...summarize([]), failed };
+      out[op].firstError = this.errors.get(op);
+    }
+    return out;
+  }
+
+  interval() {
+    const out = {};
+    for (const [op, values] of this.latencies) {
+      const from = this.marks.get(op) || 0;
+      this.marks.set(op, values.length);
+      const slice = values.slice(from);
+      if (slice.length === 0) continue;
+      const { count, p50Ms, p95Ms, maxMs } = summarize(slice);
+      out[op] = { count, p50Ms, p95Ms, maxMs };
+    }
+    return out;
+  }
+}
+
+const stats = new OperationStats();
+
+// Sends one transaction and waits for its receipt; the latency is the
+// whole round trip a user of the web app would wait for.
+async function send(op, call) {
+  const started = performance.now();
+  try {
+    const tx = await call();
+    const receipt = await tx.wait();
+    stats.record(op, performance.now() - started);
+    stats.transactions++;
+    return receipt;
+  } catch (error) {
+    stats.fail(op, error);
+    throw error;
+  }
+}
+
+function eventArgs(contract, receipt, eventName) {
+  const address = contract.target.toLowerCase();
+  for (const log of receipt.logs) {
+    if (log.address.toLowerCase() !== address) continue;
+    const parsed = contract.interface.parseLog(log);
+    if (parsed && parsed.name === eventName) return parsed.args;
+  }
+  throw new Error(`${eventName} missing from receipt ${receipt.hash}`);
+}
+
+// ---- read paths ----
+
+// services/web/lib/chainproof-read.ts readBatchByTrackingOrId, uncached: the
+// block-aware cache only helps repeat reads within a block, so a trace of a
+// new label costs this.
+async function traceWeb(contract, trackingCode) {
+  const steps = {};
+  let logs = 0;
+  const timed = async (name, call) => {
+    const started = performance.now();
+    const result = await call();
+    steps[name] = (steps[name] || 0) + (performance.now() - started);
+    return result;
+  };
+  const started = performance.now();
+  const blockTag = await timed("blockNumber", () => hre.ethers.provider.getBlockNumber());
+  const batchId = Number(
+    await timed("lookup", () => contract.getBatchIdByTrackingCode(trackingCode, { blockTag }))
+  );
+  await timed("batch", () =>
+    Promise.all([
+      contract.batches(batchId, { blockTag }),
+      contract.getParentBatches(batchId, { blockTag }),
+      contract.getChildBatches(batchId, { blockTag }),
+    ])
+  );
+  const queries = [
+    ["BatchHarvested", [batchId]],
+    ["BatchTransferInitiated", [batchId]],
+    ["BatchReceived", [batchId]],
+    ["BatchSplit", []],
+    ["BatchTransformed", [null, batchId]],
+    ["BatchMerged", [null, batchId]],
+  ];
+  for (const [eventName, args] of queries) {
+    const events = await timed(eventName, () =>
+      contract.queryFilter(contract.filters[eventName](...args), 0, blockTag)
+    );
+    logs += events.length;
+  }
+  return { totalMs: performance.now() - started, steps, logs };
+}
+
+// services/smart-contracts/dashboard/app.py "Trace Product": split,
+// transform and merge logs are fetched whole and filtered client-side, and
+// every address shown costs a roles() call.
+async function traceDashboard(contract, trackingCode) {
+  const steps = {};
+  let logs = 0;
+  const timed = async (name, call) => {
+    const started = performance.now();
+    const result = await call();
+    steps[name] = (steps[name] || 0) + (performance.now() - started);
+    return result;
+  };
+  const started = performance.now();
+  const batchId = Number(await timed("lookup", () => contract.getBatchIdByTrackingCode(trackingCode)));
+  const batch = await timed("batch", () => contract.batches(batchId));
+  await timed("roles", () => contract.roles(batch.currentHandler));
+  await timed("batch", () => contract.getParentBatches(batchId));
+  await timed("batch", () => contract.getChildBatches(batchId));
+
+  const queries = [
+    ["BatchHarvested", [batchId], ["creator"]],
+    ["BatchSplit", [], []],
+    ["BatchTransformed", [], []],
+    ["BatchMerged", [], []],
+    ["BatchTransferInitiated", [batchId], ["from", "to"]],
+    ["BatchReceived", [batchId], ["receiver"]],
+    ["BatchConsumed", [batchId], ["handler"]],
+  ];
+  for (const [eventName, args, addressFields] of queries) {
+    const events = await timed(eventName, () => contract.queryFilter(contract.filters[eventName](...args), 0));
+    logs += events.length;
+    for (const event of events) {
+      for (const field of addressFields) {
+        await timed("roles", () => contract.roles(event.args[field]));
+      }
+    }
+  }
+  return { totalMs: performance.now() - started, steps, logs };
+}
+
+function summarizeTraces(traces) {
+  const steps = {};
+  for (const trace of traces) {
+    for (const [name, ms] of Object.entries(trace.steps)) {
+      if (!steps[name]) steps[name] = [];
+      steps[name].push(ms);
+    }
+  }
+  const stepSummary = {};
+  for (const [name, values] of Object.entries(steps)) {
+    const { p50Ms, p95Ms } = summarize(values);
+    stepSummary[name] = { p50Ms, p95Ms };
+  }
+  const { count, p50Ms, p95Ms, maxMs } = summarize(traces.map((trace) => trace.totalMs));
+  return {
+    count,
+    p50Ms,
+    p95Ms,
+    maxMs,
+    logsMean: round(traces.reduce((sum, trace) => sum + trace.logs, 0) / Math.max(1, traces.length)),
+    steps: stepSummary,
+  };
+}
+
+// ---- workload ----
+
+function pick(list, index) {
+  return list[index % list.length];
+}
+
+async function runLineage(contract, accounts, runId, index, codes) {
+  const producer = pick(accounts.producer, index);
+  const processor = pick(accounts.processor, index);
+  const warehouse = pick(accounts.warehouse, index);
+  const transporter = pick(accounts.transporter, index);
+  const customer = pick(accounts.customer, index);
+  const code = (suffix) => `LT-${runId}-${index}${suffix}`;
+  const started = performance.now();
+
+  const transfer = async (batchId, from, to) => {
+    await send("transfer", () => contract.connect(from).initiateTransfer(batchId, to.address));
+    await send("receive", () => contract.connect(to).receiveBatch(batchId));
+  };
+
+  const quantity = CONFIG.splitChildren * UNITS_PER_CHILD;
+  let receipt = await send("harvest", () =>
+    contract.connect(producer).harvestBatch("loadtest-farm", `ipfs://${code("")}`, quantity, code(""))
+  );
+  const harvestedId = eventArgs(contract, receipt, "BatchHarvested").id;
+  codes.push(code(""));
+  await transfer(harvestedId, producer, processor);
+
+  receipt = await send("transform", () =>
+    contract
+      .connect(processor)
+      .transformBatches([harvestedId], "loadtest-plant", `ipfs://${code("-w")}`, quantity, code("-w"), "wash")
+  );
+  const washedId = eventArgs(contract, receipt, "BatchTransformed").outputBatchId;
+  codes.push(code("-w"));
+
+  const childCodes = Array.from({ length: CONFIG.splitChildren }, (_, child) => code(`-c${child}`));
+  receipt = await send("split", () =>
+    contract.connect(processor).splitBatch(
+      washedId,
+      childCodes.map(() => UNITS_PER_CHILD),
+      childCodes.map((childCode) => `ipfs://${childCode}`),
+      childCodes
+    )
+  );
+  const childIds = Array.from(eventArgs(contract, receipt, "BatchSplit").childIds);
+  codes.push(...childCodes);
+  for (const childId of childIds) {
+    await transfer(childId, processor, warehouse);
+  }
+
+  receipt = await send("merge", () =>
+    contract
+      .connect(warehouse)
+      .mergeBatches(childIds, "loadtest-dc", `ipfs://${code("-p")}`, quantity, code("-p"))
+  );
+  const palletId = eventArgs(contract, receipt, "BatchMerged").outputBatchId;
+  codes.push(code("-p"));
+
+  await transfer(palletId, warehouse, transporter);
+  await transfer(palletId, transporter, customer);
+  stats.record("lineage", performance.now() - started);
+
+  if (Math.random() < CONFIG.customerTrace) {
+    const traceStarted = performance.now();
+    await traceWeb(contract, code("-p"));
+    stats.record("customerTrace", performance.now() - traceStarted);
+  }
+}
+
+// Sends one recordSensorWindow per tag per window, spread evenly, from the
+// transporter accounts acting as gateways. Stops when `done` resolves.
+async function runSensorFeed(contract, gateways, done) {
+  if (CONFIG.sensorTags <= 0) return;
+  const perSecond = CONFIG.sensorTags / CONFIG.sensorWindowS;
+  const samples = Math.max(1, Math.round(CONFIG.sensorWindowS / CONFIG.samplePeriodS));
+  const seqs = new Uint32Array(CONFIG.sensorTags);
+  const deviceIds = Array.from({ length: CONFIG.sensorTags }, (_, tag) =>
+    hre.ethers.id(`loadtest-tag-${tag}`)
+  );
+  const inflight = new Set();
+  let finished = false;
+  done.then(() => {
+    finished = true;
+  });
+
+  let credit = 0;
+  let next = 0;
+  let last = performance.now();
+  while (!finished) {
+    await new Promise((resolve) => setTimeout(resolve, 100));
+    const now = performance.now();
+    credit += ((now - last) / 1000) * perSecond;
+    last = now;
+    // Back off rather than queue without bound when the node falls behind.
+    while (credit >= 1 && inflight.size < CONFIG.concurrency * 4) {
+      credit -= 1;
+      const tag = next++ % CONFIG.sensorTags;
+      const firstSeq = seqs[tag];
+      seqs[tag] += samples;
+      const tempMin = 200 + Math.floor(Math.random() * 200);
+      const humiMin = 6000 + Math.floor(Math.random() * 1000);
+      const lastSampleMs = Date.now();
+      const pending = send("sensorWindow", () =>
+        contract
+          .connect(pick(gateways, tag))
+          .recordSensorWindow(
+            deviceIds[tag],
+            firstSeq,
+            firstSeq + samples - 1,
+            samples,
+            tempMin,
+            tempMin + 50,
+            humiMin,
+            humiMin + 300,
+            0,
+            lastSampleMs - Math.round((samples - 1) * CONFIG.samplePeriodS * 1000),
+            lastSampleMs,
+            50 // ms, about what synced tags get (gateway-clock-sim)
+          )
+      ).catch(() => {});
+      inflight.add(pending);
+      pending.finally(() => inflight.delete(pending));
+    }
+    if (credit > perSecond) credit = perSecond;
+  }
+  await Promise.all(inflight);
+}
+
+async function assignRoles(contract, signers) {
+  const needed = Object.values(CONFIG.roleMix).reduce((sum, count) => sum + count, 0);
+  if (signers.length - 1 < needed) {
+    throw new Error(
+      `LOADTEST_ROLE_MIX needs ${needed} accounts besides the deployer; the node has ${signers.length - 1}.`
+    );
+  }
+  const owner = (await contract.owner()).toLowerCase();
+  const admin = signers.find((signer) => signer.address.toLowerCase() === owner);
+
+  const accounts = {};
+  let next = 1;
+  for (const [role, count] of Object.entries(CONFIG.roleMix)) {
+    accounts[role] = signers.slice(next, next + count);
+    next += count;
+    for (const account of accounts[role]) {
+      // A contract deployed by someone else is still usable through the
+      // test-mode self-assignment.
+      await send("assignRole", () =>
+        admin
+          ? contract.connect(admin).assignRole(account.address, ROLE_VALUES[role])
+          : contract.connect(account).assignMyRole(ROLE_VALUES[role])
+      );
+    }
+  }
+  return accounts;
+}
+
+async function main() {
+  const provider = hre.ethers.provider;
+  const signers = await hre.ethers.getSigners();
+  const network = await provider.getNetwork();
+
+  let contract;
+  if (CONFIG.contract) {
+    contract = await hre.ethers.getContractAt("ChainProof", CONFIG.contract);
+  } else {
+    const ChainProof = await hre.ethers.getContractFactory("ChainProof");
+    contract = await ChainProof.deploy();
+    await contract.waitForDeployment();
+  }
+  const address = await contract.getAddress();
+  const accounts = await assignRoles(contract, signers);
+
+  if (CONFIG.blockMs > 0) {
+    await provider.send("evm_setAutomine", [false]);
+    await provider.send("evm_setIntervalMining", [CONFIG.blockMs]);
+  }
+
+  const runId = Date.now().toString(36);
+  const startBlock = await provider.getBlockNumber();
+  const setupTransactions = stats.transactions;
+  stats.interval(); // role assignment is not part of the first interval
+  const started = performance.now();
+  const codes = [];
+  const checkpoints = [];
+  let checkpointRunning = Promise.resolve();
+  let checkpointBusy = false;
+  let lastCheckpoint = { at: started, transactions: stats.transactions };
+
+  let nextLineage = 0;
+  let completed = 0;
+  let failedLineages = 0;
+
+  // Reports the chain as it is when the reads run; lineages keep going
+  // meanwhile.
+  const checkpoint = async () => {
+    const now = performance.now();
+    const intervalTps =
+      ((stats.transactions - lastCheckpoint.transactions) * 1000) / Math.max(1, now - lastCheckpoint.at);
+    lastCheckpoint = { at: now, transactions: stats.transactions };
+    const operations = stats.interval();
+
+    const sample = Array.from(
+      { length: Math.min(CONFIG.readSamples, codes.length) },
+      () => codes[Math.floor(Math.random() * codes.length)]
+    );
+    const web = [];
+    const dashboard = [];
+    for (const trackingCode of sample) {
+      web.push(await traceWeb(contract, trackingCode));
+      dashboard.push(await traceDashboard(contract, trackingCode));
+    }
+    const point = {
+      lineages: completed,
+      batchCount: Number(await contract.batchCount()),
+      blockNumber: await provider.getBlockNumber(),
+      elapsedS: round((now - started) / 1000),
+      intervalTps: round(intervalTps),
+      operations,
+      reads: { web: summarizeTraces(web), dashboard: summarizeTraces(dashboard) },
+    };
+    checkpoints.push(point);
+    console.error(
+      `[loadtest] ${point.lineages}/${CONFIG.batches} lineages, block ${point.blockNumber}, ` +
+        `${point.intervalTps} tx/s, web trace p50 ${point.reads.web.p50Ms} ms, ` +
+        `dashboard trace p50 ${point.reads.dashboard.p50Ms} ms`
+    );
+  };
+
+  const worker = async () => {
+    while (nextLineage < CONFIG.batches) {
+      const index = nextLineage++;
+      try {
+        await runLineage(contract, accounts, runId, index, codes);
+      } catch {
+        failedLineages++;
+      }
+      completed++;
+      // One checkpoint at a time; one that would start while the last is
+      // still reading is skipped rather than queued behind it.
+      if (completed % CONFIG.readEvery === 0 && completed < CONFIG.batches && !checkpointBusy) {
+        checkpointBusy = true;
+        checkpointRunning = checkpoint().finally(() => {
+          checkpointBusy = false;
+        });
+      }
+    }
+  };
+
+  const workers = Promise.all(Array.from({ length: CONFIG.concurrency }, worker));
+  const sensors = runSensorFeed(contract, accounts.transporter, workers);
+  await workers;
+  await sensors;
+  const elapsedMs = performance.now() - started;
+  await checkpointRunning;
+  if (checkpoints.length === 0 || checkpoints[checkpoints.length - 1].lineages !== completed) {
+    await checkpoint();
+  }
+
+  if (CONFIG.blockMs > 0) {
+    await provider.send("evm_setIntervalMining", [0]);
+    await provider.send("evm_setAutomine", [true]);
+  }
+
+  const operations = stats.report();
+  delete operations.assignRole;
+  const report = {
+    config: CONFIG,
+    network: {
+      name: hre.network.name,
+      client: await provider.send("web3_clientVersion", []),
+      chainId: Number(network.chainId),
+      contract: address,
+      startBlock,
+      endBlock: await provider.getBlockNumber(),
+    },
+    lineages: { completed: completed - failedLineages, failed: failedLineages },
+    batchesCreated: codes.length,
+    transactions: stats.transactions - setupTransactions,
+    elapsedS: round(elapsedMs / 1000),
+    throughputTps: round(((stats.transactions - setupTransactions) * 1000) / Math.max(1, elapsedMs)),
+    operations,
+    checkpoints,
+  };
+
+  const json = JSON.stringify(report);
+  if (CONFIG.out) {
+    fs.mkdirSync(path.dirname(path.resolve(CONFIG.out)), { recursive: true });
+    fs.writeFileSync(CONFIG.out, json + "\n");
+  }
+  console.log(json);
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exitCode = 1;
+});
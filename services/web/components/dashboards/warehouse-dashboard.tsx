@@ -7,7 +7,7 @@ import { Input } from '@/components/ui/input';
 import { Label } from '@/components/ui/label';
 import { ReadOnlyChainCard } from './read-only-chain-card';
 import { Archive, Package, ArrowRightLeft, Boxes, TrendingUp } from 'lucide-react';
-import { initiateBatchTransfer, receiveTransferredBatch } from '@/lib/chainproof-write';
+import { initiateBatchTransfer, receiveTransferredBatch, receiveTransferredBatches } from '@/lib/chainproof-write';
 
 type TxFeedback = {
   type: 'success' | 'error';
@@ -71,9 +71,30 @@ export function WarehouseDashboard() {
 
   const handleReceive = async (event: FormEvent<HTMLFormElement>) => {
     event.preventDefault();
+    const lookups = receiveLookup
+      .split(/[,;\n]+/)
+      .map((lookup) => lookup.trim())
+      .filter(Boolean);
     setReceiveSubmitting(true);
     setReceiveFeedback(null);
     try {
+      if (lookups.length > 1) {
+        const result = await receiveTransferredBatches(lookups, {
+          onProgress: ({ done, total }) => {
+            setReceiveFeedback({ type: 'success', message: `Receiving batches: ${done}/${total} confirmed or failed...` });
+          },
+        });
+        const failedLookups = result.failed.map((item) => item.lookup);
+        setReceiveFeedback({
+          type: failedLookups.length > 0 ? 'error' : 'success',
+          message:
+            `${result.received.length}/${lookups.length} batches received in ${(result.elapsedMs / 1000).toFixed(1)}s.` +
+            (failedLookups.length > 0 ? ` Failed: ${failedLookups.join(', ')} (${result.failed[0].error.message})` : ''),
+        });
+        setReceiveLookup(failedLookups.join(', '));
+        return;
+      }
+
       const result = await receiveTransferredBatch({
         lookup: receiveLookup,
       });
@@ -136,12 +157,12 @@ export function WarehouseDashboard() {
           <form onSubmit={handleReceive} className="space-y-3 rounded-lg border bg-white p-4">
             <h4 className="font-semibold text-gray-900">Receive Batch</h4>
             <div className="space-y-2">
-              <Label htmlFor="warehouse-receive-lookup">Batch ID or tracking code</Label>
+              <Label htmlFor="warehouse-receive-lookup">Batch IDs or tracking codes</Label>
               <Input
                 id="warehouse-receive-lookup"
                 value={receiveLookup}
                 onChange={(event) => setReceiveLookup(event.target.value)}
-                placeholder="e.g., 12 or BATCH-2026-001"
+                placeholder="e.g., 12 or BATCH-2026-001, BATCH-2026-002"
                 disabled={receiveSubmitting}
               />
             </div>
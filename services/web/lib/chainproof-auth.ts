@@ -2,6 +2,7 @@
 
 import { Contract } from 'ethers';
 import type { JsonRpcProvider, Signer } from 'ethers';
+import { observeChainproofWriteBlock } from './chainproof-read';
 import type { AppRole } from './wallet-auth';
 import { configuredChainId } from './wallet-auth';
 
@@ -140,7 +141,8 @@ export async function assignMyWalletRole(
     const account = client.account;
     const contract = new Contract(contractAddress, CHAINPROOF_AUTH_ABI, signer);
     const tx = await contract.assignMyRole(ROLE_VALUE_BY_NAME[role]);
-    await tx.wait();
+    const receipt = await tx.wait();
+    if (receipt) await observeChainproofWriteBlock(receipt.blockNumber);
     return {
       txHash: String(tx.hash),
       account,
@@ -0,0 +1,162 @@
+import type { Contract, JsonRpcProvider } from 'ethers';
+
+type CacheEntry = {
+  blockNumber: number;
+  settled: boolean;
+  value: Promise<unknown>;
+};
+
+export type ChainproofReadCacheStats = {
+  blockNumber: number | null;
+  entries: number;
+  hits: number;
+  misses: number;
+  coalesced: number;
+  invalidations: number;
+  hitRate: number;
+};
+
+function serializeArgs(args: unknown[]): string {
+  return JSON.stringify(args, (_key, value) => (typeof value === 'bigint' ? `${value.toString()}n` : value));
+}
+
+// Memoizes contract view calls and event queries per block. Every read is pinned to the
+// block the cache currently tracks, so a cached value is exactly what the node would have
+// returned; a new block moves the cache forward and drops older entries. Block polling lags
+// by a few seconds, so writers report their receipt's block through observeBlock and a read
+// right after a write already sees it.
+export class ChainproofReadCache {
+  private readonly entries = new Map<string, CacheEntry>();
+  private blockNumber: number | null = null;
+  private blockNumberRequest: Promise<number> | null = null;
+  private hits = 0;
+  private misses = 0;
+  private coalesced = 0;
+  private invalidations = 0;
+  private subscribed = false;
+
+  private readonly onBlock = (blockNumber: number) => {
+    this.advance(blockNumber);
+  };
+
+  constructor(
+    private readonly provider: JsonRpcProvider,
+    private readonly contract: Contract
+  ) {}
+
+  call<T = unknown>(method: string, ...args: unknown[]): Promise<T> {
+    return this.read(`call:${method}:${serializeArgs(args)}`, (blockTag) =>
+      this.contract.getFunction(method)(...args, { blockTag })
+    ) as Promise<T>;
+  }
+
+  queryEvents(eventName: string, ...filterArgs: unknown[]) {
+    return this.read(`logs:${eventName}:${serializeArgs(filterArgs)}`, (blockTag) => {
+      const filter = this.contract.filters[eventName](...filterArgs);
+      return this.contract.queryFilter(filter, 0, blockTag);
+    }) as ReturnType<Contract['queryFilter']>;
+  }
+
+  observeBlock(blockNumber: number) {
+    this.advance(blockNumber);
+  }
+
+  stats(): ChainproofReadCacheStats {
+    const lookups = this.hits + this.coalesced + this.misses;
+    return {
+      blockNumber: this.blockNumber,
+      entries: this.entries.size,
+      hits: this.hits,
+      misses: this.misses,
+      coalesced: this.coalesced,
+      invalidations: this.invalidations,
+      hitRate: lookups > 0 ? (this.hits + this.coalesced) / lookups : 0,
+    };
+  }
+
+  resetStats() {
+    this.hits = 0;
+    this.misses = 0;
+    this.coalesced = 0;
+    this.invalidations = 0;
+  }
+
+  invalidate() {
+    this.entries.clear();
+    this.blockNumber = null;
+    this.invalidations++;
+  }
+
+  async dispose() {
+    this.entries.clear();
+    if (!this.subscribed) return;
+    this.subscribed = false;
+    await this.provider.off('block', this.onBlock);
+  }
+
+  private async read(key: string, load: (blockTag: number) => Promise<unknown>): Promise<unknown> {
+    const blockNumber = await this.currentBlock();
+    const existing = this.entries.get(key);
+    if (existing && existing.blockNumber >= blockNumber) {
+      if (existing.settled) {
+        this.hits++;
+      } else {
+        this.coalesced++;
+      }
+      return existing.value;
+    }
+
+    this.misses++;
+    const entry: CacheEntry = { blockNumber, settled: false, value: load(blockNumber) };
+    this.entries.set(key, entry);
+    entry.value.then(
+      () => {
+        entry.settled = true;
+      },
+      () => {
+        if (this.entries.get(key) === entry) {
+          this.entries.delete(key);
+        }
+      }
+    );
+    return entry.value;
+  }
+
+  private async currentBlock(): Promise<number> {
+    this.subscribe();
+    if (this.blockNumber !== null) {
+      return this.blockNumber;
+    }
+    if (!this.blockNumberRequest) {
+      this.blockNumberRequest = this.provider.getBlockNumber().finally(() => {
+        this.blockNumberRequest = null;
+      });
+    }
+    const blockNumber = await this.blockNumberRequest;
+    this.advance(blockNumber);
+    return this.blockNumber ?? blockNumber;
+  }
+
+  private advance(blockNumber: number) {
+    if (this.blockNumber !== null && blockNumber <= this.blockNumber) {
+      return;
+    }
+    this.blockNumber = blockNumber;
+    let dropped = false;
+    for (const [key, entry] of this.entries) {
+      if (entry.blockNumber < blockNumber) {
+        this.entries.delete(key);
+        dropped = true;
+      }
+    }
+    if (dropped) {
+      this.invalidations++;
+    }
+  }
+
+  private subscribe() {
+    if (this.subscribed) return;
+    this.subscribed = true;
+    void this.provider.on('block', this.onBlock);
+  }
+}
@@ -1,6 +1,7 @@
 'use client';
 
 import { Contract, JsonRpcProvider } from 'ethers';
+import { ChainproofReadCache } from './chainproof-read-cache';
 
 export const ROLE_LABELS: Record<number, string> = {
   0: 'None',
@@ -11,7 +12,7 @@ export const ROLE_LABELS: Record<number, string> = {
   5: 'Customer',
 };
 
-const CHAINPROOF_READ_ABI = [
+export const CHAINPROOF_READ_ABI = [
   'function owner() view returns (address)',
   'function batchCount() view returns (uint256)',
   'function roles(address) view returns (uint8)',
@@ -41,12 +42,17 @@ export type ChainproofReadContext = {
   contract: Contract;
   chainId: number;
   contractAddress: string;
+  cache: ChainproofReadCache;
 };
 
 const defaultRpcUrl = process.env.NEXT_PUBLIC_CHAINPROOF_RPC_URL || 'http://127.0.0.1:8545';
 const defaultContractKey = process.env.NEXT_PUBLIC_CHAINPROOF_CONTRACT_KEY || 'chainproof';
 const configuredChainId = Number(process.env.NEXT_PUBLIC_CHAINPROOF_CHAIN_ID || '1337');
 
+let registryRequest: Promise<RegistryShape> | null = null;
+let sharedProvider: JsonRpcProvider | null = null;
+const contextRequests = new Map<string, Promise<ChainproofReadContext>>();
+
 async function fetchRegistry(): Promise<RegistryShape> {
   const response = await fetch('/api/blockchain/registry', { cache: 'no-store' });
   if (!response.ok) {
@@ -55,8 +61,21 @@ async function fetchRegistry(): Promise<RegistryShape> {
   return response.json();
 }
 
-async function getProvider() {
-  return new JsonRpcProvider(defaultRpcUrl);
+function getRegistry(): Promise<RegistryShape> {
+  if (!registryRequest) {
+    registryRequest = fetchRegistry().catch((error) => {
+      registryRequest = null;
+      throw error;
+    });
+  }
+  return registryRequest;
+}
+
+function getProvider() {
+  if (!sharedProvider) {
+    sharedProvider = new JsonRpcProvider(defaultRpcUrl);
+  }
+  return sharedProvider;
 }
 
 function toNumber(value: unknown): number {
@@ -79,10 +98,9 @@ function resolveAddressFromRegistry(registry: RegistryShape, contractKey: string
   return entry?.address || '';
 }
 
-export async function createChainproofReadContext(
-  contractKey: string = defaultContractKey
-): Promise<ChainproofReadContext> {
-  const [registry, provider] = await Promise.all([fetchRegistry(), getProvider()]);
+async function buildChainproofReadContext(contractKey: string): Promise<ChainproofReadContext> {
+  const registry = await getRegistry();
+  const provider = getProvider();
   const network = await provider.getNetwork();
   const detectedChainId = Number(network.chainId);
   const chainId = Number.isFinite(detectedChainId) && detectedChainId > 0 ? detectedChainId : configuredChainId;
@@ -99,17 +117,47 @@ export async function createChainproofReadContext(
 
   const contract = new Contract(contractAddress, CHAINPROOF_READ_ABI, provider);
   await contract.owner();
-  return { provider, contract, chainId, contractAddress };
+  const cache = new ChainproofReadCache(provider, contract);
+  return { provider, contract, chainId, contractAddress, cache };
+}
+
+export function createChainproofReadContext(
+  contractKey: string = defaultContractKey
+): Promise<ChainproofReadContext> {
+  let request = contextRequests.get(contractKey);
+  if (!request) {
+    request = buildChainproofReadContext(contractKey).catch((error) => {
+      contextRequests.delete(contractKey);
+      throw error;
+    });
+    contextRequests.set(contractKey, request);
+  }
+  return request;
+}
+
+// Moves every read cache up to a block a write was just mined in, so a page
+// that reads right after the write sees it without waiting for the next poll.
+export async function observeChainproofWriteBlock(blockNumber: number) {
+  await Promise.all(
+    Array.from(contextRequests.values(), async (request) => {
+      try {
+        (await request).cache.observeBlock(blockNumber);
+      } catch {
+        // Context never finished building; there is nothing cached to move.
+      }
+    })
+  );
 }
 
 export async function readChainproofSummary(viewerAddress?: string) {
   const context = await createChainproofReadContext();
-  const [owner, batchCount] = await Promise.all([context.contract.owner(), context.contract.batchCount()]);
+  const { cache } = context;
+  const [owner, batchCount] = await Promise.all([cache.call('owner'), cache.call('batchCount')]);
 
   let viewerRole: string | null = null;
   if (viewerAddress) {
     try {
-      const roleValue = Number(await context.contract.roles(viewerAddress));
+      const roleValue = Number(await cache.call('roles', viewerAddress));
       viewerRole = ROLE_LABELS[roleValue] ?? 'Unknown';
     } catch {
       viewerRole = null;
@@ -126,6 +174,7 @@ export async function readChainproofSummary(viewerAddress?: string) {
 
 export async function readBatchByTrackingOrId(lookup: string) {
   const context = await createChainproofReadContext();
+  const { cache } = context;
   const trimmed = lookup.trim();
   if (!trimmed) {
     throw new Error('Enter a batch id or tracking code.');
@@ -135,16 +184,27 @@ export async function readBatchByTrackingOrId(lookup: string) {
   const batchId =
     Number.isFinite(parsedId) && parsedId > 0
       ? parsedId
-      : Number(await context.contract.getBatchIdByTrackingCode(trimmed));
+      : Number(await cache.call('getBatchIdByTrackingCode', trimmed));
 
   if (!batchId) {
     throw new Error('Batch not found.');
   }
 
   const [batchRaw, parentsRaw, childrenRaw] = await Promise.all([
-    context.contract.batches(batchId),
-    context.contract.getParentBatches(batchId),
-    context.contract.getChildBatches(batchId),
+    cache.call<{
+      id: bigint;
+      creator: string;
+      origin: string;
+      ipfsHash: string;
+      quantity: bigint;
+      trackingCode: string;
+      status: bigint;
+      createdAt: bigint;
+      updatedAt: bigint;
+      currentHandler: string;
+    }>('batches', batchId),
+    cache.call<bigint[]>('getParentBatches', batchId),
+    cache.call<bigint[]>('getChildBatches', batchId),
   ]);
 
   const batch = {
@@ -165,7 +225,7 @@ export async function readBatchByTrackingOrId(lookup: string) {
 
   const timeline: { type: string; timestamp: number; text: string; txHash: string }[] = [];
 
-  const harvestEvents = await context.contract.queryFilter(context.contract.filters.BatchHarvested(batchId));
+  const harvestEvents = await cache.queryEvents('BatchHarvested', batchId);
   harvestEvents.forEach((rawEvent) => {
     const event = rawEvent as unknown as EventLike;
     timeline.push({
@@ -176,7 +236,7 @@ export async function readBatchByTrackingOrId(lookup: string) {
     });
   });
 
-  const transferEvents = await context.contract.queryFilter(context.contract.filters.BatchTransferInitiated(batchId));
+  const transferEvents = await cache.queryEvents('BatchTransferInitiated', batchId);
   transferEvents.forEach((rawEvent) => {
     const event = rawEvent as unknown as EventLike;
     timeline.push({
@@ -187,7 +247,7 @@ export async function readBatchByTrackingOrId(lookup: string) {
     });
   });
 
-  const receiveEvents = await context.contract.queryFilter(context.contract.filters.BatchReceived(batchId));
+  const receiveEvents = await cache.queryEvents('BatchReceived', batchId);
   receiveEvents.forEach((rawEvent) => {
     const event = rawEvent as unknown as EventLike;
     timeline.push({
@@ -198,7 +258,7 @@ export async function readBatchByTrackingOrId(lookup: string) {
     });
   });
 
-  const splitEvents = await context.contract.queryFilter(context.contract.filters.BatchSplit());
+  const splitEvents = await cache.queryEvents('BatchSplit');
   splitEvents.forEach((rawEvent) => {
     const event = rawEvent as unknown as EventLike;
     const parentId = toNumber(event.args?.parentId);
@@ -213,7 +273,7 @@ export async function readBatchByTrackingOrId(lookup: string) {
     }
   });
 
-  const transformEvents = await context.contract.queryFilter(context.contract.filters.BatchTransformed(null, batchId));
+  const transformEvents = await cache.queryEvents('BatchTransformed', null, batchId);
   transformEvents.forEach((rawEvent) => {
     const event = rawEvent as unknown as EventLike;
     timeline.push({
@@ -224,7 +284,7 @@ export async function readBatchByTrackingOrId(lookup: string) {
     });
   });
 
-  const mergeEvents = await context.contract.queryFilter(context.contract.filters.BatchMerged(null, batchId));
+  const mergeEvents = await cache.queryEvents('BatchMerged', null, batchId);
   mergeEvents.forEach((rawEvent) => {
     const event = rawEvent as unknown as EventLike;
     timeline.push({
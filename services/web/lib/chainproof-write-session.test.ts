@@ -0,0 +1,235 @@
+import assert from 'node:assert/strict';
+import { test } from 'node:test';
+import type { Contract, JsonRpcProvider, Signer, TransactionRequest } from 'ethers';
+import { receiveTransferredBatchesInSession } from './chainproof-write';
+import { ChainproofWriteSession } from './chainproof-write-session';
+import type { ChainproofWriteContext, WriteSessionOptions } from './chainproof-write-session';
+
+const ACCOUNT = '0x00000000000000000000000000000000000000aa';
+const CONTRACT = '0x00000000000000000000000000000000000000cc';
+
+type MockTx = { hash: string; nonce: number; to: string; data: string };
+
+// One account on a node that mines every nonce it holds, in order, whenever
+// a receipt is asked for.
+class MockChain {
+  latest = 0; // next nonce to be mined
+  block = 0;
+  paused = false; // hold everything in the pool unmined
+  readonly pool = new Map<number, MockTx>();
+  readonly receipts = new Map<string, { hash: string; status: number; blockNumber: number }>();
+  readonly sent: MockTx[] = [];
+  private hashes = 0;
+
+  pendingNonce() {
+    let nonce = this.latest;
+    while (this.pool.has(nonce)) nonce++;
+    return nonce;
+  }
+
+  send(request: TransactionRequest) {
+    const nonce = Number(request.nonce);
+    if (nonce < this.latest) throw new Error('nonce too low');
+    const tx: MockTx = {
+      hash: `0x${(++this.hashes).toString(16).padStart(64, '0')}`,
+      nonce,
+      to: String(request.to),
+      data: String(request.data ?? '0x'),
+    };
+    this.sent.push(tx);
+    this.accept(tx);
+    return { hash: tx.hash };
+  }
+
+  protected accept(tx: MockTx) {
+    this.pool.set(tx.nonce, tx);
+  }
+
+  known(hash: string) {
+    return this.receipts.has(hash) || [...this.pool.values()].some((tx) => tx.hash === hash);
+  }
+
+  mine() {
+    if (this.paused) return;
+    this.block++;
+    for (let tx = this.pool.get(this.latest); tx; tx = this.pool.get(this.latest)) {
+      this.pool.delete(this.latest);
+      this.receipts.set(tx.hash, { hash: tx.hash, status: 1, blockNumber: this.block });
+      this.latest++;
+    }
+  }
+
+  context(): ChainproofWriteContext {
+    const provider = {
+      getTransactionCount: async (_account: string, tag: string) => (tag === 'latest' ? this.latest : this.pendingNonce()),
+      getTransactionReceipt: async (hash: string) => {
+        this.mine();
+        return this.receipts.get(hash) ?? null;
+      },
+      getTransaction: async (hash: string) => (this.known(hash) ? { hash } : null),
+      getFeeData: async () => ({ gasPrice: BigInt(1), maxFeePerGas: null, maxPriorityFeePerGas: null }),
+    };
+    const wallet = {
+      estimateGas: async () => BigInt(50000),
+      sendTransaction: async (request: TransactionRequest) => this.send(request),
+    };
+    const contract = {
+      getFunction: (method: string) => ({
+        populateTransaction: async (...args: unknown[]) => ({ to: CONTRACT, data: `${method}(${args.join(',')})` }),
+      }),
+      getBatchIdByTrackingCode: async (code: string) => BigInt(code.replace(/\D/g, '') || '0'),
+    };
+    return {
+      provider: provider as unknown as JsonRpcProvider,
+      wallet: wallet as unknown as Signer,
+      contract: contract as unknown as Contract,
+      chainId: 31337,
+      contractAddress: CONTRACT,
+      account: ACCOUNT,
+    };
+  }
+}
+
+// Accepts every transaction but silently evicts the ones calling 'lost'.
+class DroppingChain extends MockChain {
+  protected accept(tx: MockTx) {
+    if (!tx.data.startsWith('lost(')) super.accept(tx);
+  }
+}
+
+// Another sender on the same key takes the nonce of every 'raced' write.
+class RacingChain extends MockChain {
+  protected accept(tx: MockTx) {
+    super.accept(tx.data.startsWith('raced(') ? { ...tx, hash: `${tx.hash.slice(0, -1)}f`, data: '0x' } : tx);
+  }
+}
+
+// Refuses the first 'lagging' write with a nonce error, as a node behind a
+// load balancer that has not seen the account's latest nonce does.
+class LaggingChain extends DroppingChain {
+  private lagged = false;
+
+  send(request: TransactionRequest) {
+    if (!this.lagged && String(request.data).startsWith('lagging(')) {
+      this.lagged = true;
+      throw new Error('nonce too low');
+    }
+    return super.send(request);
+  }
+}
+
+function openSession(chain: MockChain, options: WriteSessionOptions = {}) {
+  return new ChainproofWriteSession(chain.context(), { pollIntervalMs: 5, ...options });
+}
+
+const STALE_FAST: WriteSessionOptions = { receiptTimeoutMs: 20, maxResubmits: 1 };
+
+test('receives several codes through a session opened without maxInFlight', { timeout: 5000 }, async () => {
+  const chain = new MockChain();
+  // What receiveTransferredBatches passes when the dashboard sets no limit.
+  const session = openSession(chain, { maxInFlight: undefined });
+  const progress: number[] = [];
+  try {
+    const result = await receiveTransferredBatchesInSession(session, ['PAL-0001', 'PAL-0002', '7'], ({ done }) =>
+      progress.push(done)
+    );
+    assert.deepEqual(result.failed, []);
+    assert.deepEqual(result.received.map((item) => item.batchId).sort(), [1, 2, 7]);
+    assert.deepEqual(progress, [1, 2, 3]);
+  } finally {
+    session.close();
+  }
+  assert.deepEqual(
+    chain.sent.map((tx) => tx.nonce),
+    [0, 1, 2]
+  );
+});
+
+test('fills the nonce of a dropped write while later writes wait behind it', { timeout: 5000 }, async () => {
+  const chain = new DroppingChain();
+  const session = openSession(chain, STALE_FAST);
+  try {
+    const outcomes = await Promise.all([
+      session.submit('lost', [1]),
+      session.submit('kept', [2]),
+      session.submit('kept', [3]),
+    ]);
+    assert.deepEqual(
+      outcomes.map((outcome) => [outcome.nonce, outcome.status]),
+      [
+        [0, 'dropped'],
+        [1, 'confirmed'],
+        [2, 'confirmed'],
+      ]
+    );
+    assert.equal(outcomes[0].resubmits, 1);
+    assert.equal(session.stats().gapFills, 1);
+  } finally {
+    session.close();
+  }
+  const filler = chain.sent.filter((tx) => tx.to === ACCOUNT);
+  assert.deepEqual(
+    filler.map((tx) => tx.nonce),
+    [0]
+  );
+  assert.equal(chain.latest, 3);
+});
+
+test('reports a write whose nonce another transaction took as replaced', { timeout: 5000 }, async () => {
+  const chain = new RacingChain();
+  const session = openSession(chain, STALE_FAST);
+  try {
+    const [raced, next] = await Promise.all([session.submit('raced', [1]), session.submit('kept', [2])]);
+    assert.equal(raced.status, 'replaced');
+    assert.equal(raced.nonce, 0);
+    assert.equal(next.status, 'confirmed');
+    assert.equal(session.stats().gapFills, 0);
+  } finally {
+    session.close();
+  }
+});
+
+test('keeps waiting for a write the node still holds after its last resubmit', { timeout: 5000 }, async () => {
+  const chain = new MockChain();
+  chain.paused = true;
+  const session = openSession(chain, STALE_FAST);
+  try {
+    const pending = session.submit('slow', [1]);
+    // Well past receiptTimeoutMs * (maxResubmits + 1).
+    await new Promise((resolve) => setTimeout(resolve, 150));
+    chain.paused = false;
+    const outcome = await pending;
+    assert.equal(outcome.status, 'confirmed');
+    assert.equal(outcome.resubmits, 1);
+    assert.equal(session.stats().dropped, 0);
+    assert.equal(session.stats().gapFills, 0);
+  } finally {
+    session.close();
+  }
+  assert.deepEqual(
+    chain.sent.map((tx) => tx.nonce),
+    [0, 0]
+  );
+});
+
+test('keeps the nonce of a write in flight when a resync lands on it', { timeout: 5000 }, async () => {
+  const chain = new LaggingChain();
+  const session = openSession(chain, STALE_FAST);
+  try {
+    // The node has lost nonce 0, so the resync after the refused send reads
+    // 0 as the pending nonce while 'lost' still holds it.
+    const outcomes = await Promise.all([session.submit('lost', [1]), session.submit('lagging', [2])]);
+    assert.deepEqual(
+      outcomes.map((outcome) => [outcome.nonce, outcome.status]),
+      [
+        [0, 'dropped'],
+        [1, 'confirmed'],
+      ]
+    );
+    assert.equal(session.stats().nonceResyncs, 1);
+    assert.equal(session.stats().gapFills, 1);
+  } finally {
+    session.close();
+  }
+  assert.equal(chain.latest, 2);
+});
@@ -0,0 +1,448 @@
+import { isError } from 'ethers';
+import type { Contract, FeeData, JsonRpcProvider, Signer, TransactionReceipt, TransactionRequest } from 'ethers';
+
+export type ChainproofWriteContext = {
+  provider: JsonRpcProvider;
+  wallet: Signer;
+  contract: Contract;
+  chainId: number;
+  contractAddress: string;
+  account: string;
+};
+
+export type WriteStatus = 'confirmed' | 'reverted' | 'replaced' | 'dropped' | 'failed';
+
+export type WriteOutcome = {
+  id: number;
+  label?: string;
+  method: string;
+  status: WriteStatus;
+  nonce: number | null;
+  txHash: string | null;
+  receipt: TransactionReceipt | null;
+  error: Error | null;
+  resubmits: number;
+  latencyMs: number;
+};
+
+export type WriteSessionOptions = {
+  maxInFlight?: number;
+  pollIntervalMs?: number;
+  receiptTimeoutMs?: number;
+  maxResubmits?: number;
+  feeRefreshMs?: number;
+  onOutcome?: (outcome: WriteOutcome) => void;
+};
+
+export type WriteRequestOptions = {
+  label?: string;
+  // Skips estimateGas, e.g. for a call that depends on an earlier write in
+  // the same session which has not been mined yet.
+  gasLimit?: bigint;
+};
+
+export type WriteSessionStats = {
+  submitted: number;
+  confirmed: number;
+  reverted: number;
+  replaced: number;
+  dropped: number;
+  failed: number;
+  resubmits: number;
+  nonceResyncs: number;
+  gapFills: number;
+  inFlight: number;
+  peakInFlight: number;
+};
+
+type Job = {
+  id: number;
+  method: string;
+  args: unknown[];
+  options: WriteRequestOptions;
+  enqueuedAt: number;
+  resolve: (outcome: WriteOutcome) => void;
+};
+
+type Tracked = {
+  job: Job | null; // null for gap fillers
+  nonce: number;
+  request: TransactionRequest;
+  hashes: string[];
+  sentAt: number;
+  resubmits: number;
+};
+
+const DEFAULTS = {
+  maxInFlight: 16,
+  pollIntervalMs: 1000,
+  receiptTimeoutMs: 60_000,
+  maxResubmits: 2,
+  feeRefreshMs: 15_000,
+};
+
+// Replacements must outbid the stuck transaction; nodes commonly want +10%.
+const FEE_BUMP_PERCENT = BigInt(125);
+
+function toError(error: unknown): Error {
+  return error instanceof Error ? error : new Error(String(error));
+}
+
+function isNonceError(error: unknown) {
+  if (isError(error, 'NONCE_EXPIRED') || isError(error, 'REPLACEMENT_UNDERPRICED')) return true;
+  const message = error instanceof Error ? error.message.toLowerCase() : '';
+  return message.includes('nonce too low') || message.includes('nonce has already been used');
+}
+
+// Submits contract writes back-to-back from one account. Nonces are assigned
+// locally in submission order, at most maxInFlight transactions are unconfirmed
+// at a time, and receipts for everything in flight are polled together. A
+// transaction that outlives receiptTimeoutMs is checked against the account's
+// mined nonce: if that nonce was used by something else it is reported as
+// replaced, otherwise it is re-sent with the same nonce and higher fees. It is
+// only reported dropped once the node knows none of its hashes.
+export class ChainproofWriteSession {
+  private readonly options: Required<Omit<WriteSessionOptions, 'onOutcome'>> & Pick<WriteSessionOptions, 'onOutcome'>;
+  private readonly waiting: Array<() => void> = [];
+  private readonly tracked = new Map<number, Tracked>();
+  private readonly releasedNonces: number[] = [];
+  private sendChain: Promise<void> = Promise.resolve();
+  private nextNonce: number | null = null;
+  private slotsInUse = 0;
+  private queued = 0;
+  private preparing = 0; // holding a slot, nonce not taken yet
+  private nextId = 0;
+  private pollTimer: ReturnType<typeof setTimeout> | null = null;
+  private polling = false;
+  private feeData: { value: Promise<FeeData>; fetchedAt: number } | null = null;
+  private idleWaiters: Array<() => void> = [];
+  private counters: WriteSessionStats = {
+    submitted: 0,
+    confirmed: 0,
+    reverted: 0,
+    replaced: 0,
+    dropped: 0,
+    failed: 0,
+    resubmits: 0,
+    nonceResyncs: 0,
+    gapFills: 0,
+    inFlight: 0,
+    peakInFlight: 0,
+  };
+
+  constructor(
+    readonly context: ChainproofWriteContext,
+    options: WriteSessionOptions = {}
+  ) {
+    // An option passed as undefined keeps its default.
+    const given = Object.fromEntries(Object.entries(options).filter(([, value]) => value !== undefined));
+    this.options = { ...DEFAULTS, ...given };
+  }
+
+  submit(method: string, args: unknown[], options: WriteRequestOptions = {}): Promise<WriteOutcome> {
+    return new Promise<WriteOutcome>((resolve) => {
+      const job: Job = { id: ++this.nextId, method, args, options, enqueuedAt: Date.now(), resolve };
+      this.counters.submitted++;
+      this.queued++;
+
+      // Gas estimation overlaps with earlier sends; broadcasting stays in
+      // submission order so nonces follow it.
+      const prepared = this.acquireSlot().then(() => {
+        this.preparing++;
+        return this.prepare(job);
+      });
+      this.sendChain = this.sendChain
+        .then(() => prepared)
+        .then((request) => (request ? this.broadcast(job, request) : undefined))
+        .catch(() => undefined);
+    });
+  }
+
+  // Resolves once everything submitted so far has an outcome.
+  async drain(): Promise<void> {
+    if (this.queued === 0 && this.tracked.size === 0) return;
+    await new Promise<void>((resolve) => this.idleWaiters.push(resolve));
+  }
+
+  stats(): WriteSessionStats {
+    return { ...this.counters, inFlight: this.tracked.size };
+  }
+
+  close() {
+    if (this.pollTimer) clearTimeout(this.pollTimer);
+    this.pollTimer = null;
+  }
+
+  private acquireSlot(): Promise<void> {
+    if (this.slotsInUse < this.options.maxInFlight) {
+      this.slotsInUse++;
+      return Promise.resolve();
+    }
+    return new Promise<void>((resolve) => this.waiting.push(resolve));
+  }
+
+  private releaseSlot() {
+    const next = this.waiting.shift();
+    if (next) {
+      next();
+    } else {
+      this.slotsInUse--;
+    }
+  }
+
+  private async prepare(job: Job): Promise<TransactionRequest | null> {
+    try {
+      const { contract, wallet } = this.context;
+      const request: TransactionRequest = await contract.getFunction(job.method).populateTransaction(...job.args);
+      request.gasLimit = job.options.gasLimit ?? (await wallet.estimateGas(request));
+      return request;
+    } catch (error) {
+      this.preparing--;
+      this.finish(job, { status: 'failed', error: toError(error) });
+      return null;
+    }
+  }
+
+  private async fees(): Promise<TransactionRequest> {
+    const now = Date.now();
+    if (!this.feeData || now - this.feeData.fetchedAt > this.options.feeRefreshMs) {
+      const value = this.context.provider.getFeeData();
+      this.feeData = { value, fetchedAt: now };
+      value.catch(() => {
+        this.feeData = null;
+      });
+    }
+    const data = await this.feeData.value;
+    if (data.maxFeePerGas != null && data.maxPriorityFeePerGas != null) {
+      return { type: 2, maxFeePerGas: data.maxFeePerGas, maxPriorityFeePerGas: data.maxPriorityFeePerGas };
+    }
+    return { type: 0, gasPrice: data.gasPrice };
+  }
+
+  private async takeNonce(): Promise<number> {
+    this.releasedNonces.sort((a, b) => a - b);
+    const reused = this.releasedNonces.shift();
+    if (reused !== undefined) return reused;
+    if (this.nextNonce === null) {
+      this.nextNonce = await this.context.provider.getTransactionCount(this.context.account, 'pending');
+    }
+    // After a resync the node's pending nonce can be one still in flight here,
+    // if the node lost that transaction; it keeps its nonce and is resent by
+    // the poll.
+    while (this.tracked.has(this.nextNonce)) this.nextNonce++;
+    return this.nextNonce++;
+  }
+
+  private async resyncNonce() {
+    this.counters.nonceResyncs++;
+    this.releasedNonces.length = 0;
+    this.nextNonce = await this.context.provider.getTransactionCount(this.context.account, 'pending');
+  }
+
+  private async broadcast(job: Job | null, base: TransactionRequest) {
+    if (job) this.preparing--;
+    for (let attempt = 0; ; attempt++) {
+      let nonce: number | null = null;
+      try {
+        nonce = await this.takeNonce();
+        const request: TransactionRequest = {
+          ...base,
+          ...(await this.fees()),
+          nonce,
+          chainId: this.context.chainId,
+        };
+        const response = await this.context.wallet.sendTransaction(request);
+        this.track({ job, nonce, request, hashes: [response.hash], sentAt: Date.now(), resubmits: 0 });
+        return;
+      } catch (error) {
+        if (isNonceError(error) && attempt === 0) {
+          await this.resyncNonce();
+          continue;
+        }
+        // The node refused it, so the nonce is still free for the next write.
+        if (nonce !== null) this.releasedNonces.push(nonce);
+        if (job) this.finish(job, { status: 'failed', error: toError(error), nonce });
+        return;
+      }
+    }
+  }
+
+  private track(entry: Tracked) {
+    // The node took a second transaction under this nonce, so the first can
+    // no longer be mined.
+    const previous = this.tracked.get(entry.nonce);
+    if (previous) this.settle(previous, { status: 'replaced' });
+    this.tracked.set(entry.nonce, entry);
+    this.counters.peakInFlight = Math.max(this.counters.peakInFlight, this.tracked.size);
+    this.schedulePoll();
+  }
+
+  private schedulePoll() {
+    if (this.pollTimer || this.polling) return;
+    this.pollTimer = setTimeout(() => {
+      this.pollTimer = null;
+      void this.poll();
+    }, this.options.pollIntervalMs);
+  }
+
+  private async poll() {
+    this.polling = true;
+    try {
+      const { provider, account } = this.context;
+      const entries = [...this.tracked.values()];
+      const receipts = await Promise.all(
+        entries.map((entry) =>
+          Promise.all(entry.hashes.map((hash) => provider.getTransactionReceipt(hash).catch(() => null)))
+        )
+      );
+
+      const stale: Tracked[] = [];
+      const now = Date.now();
+      entries.forEach((entry, index) => {
+        const receipt = receipts[index].find((r) => r !== null) ?? null;
+        if (receipt) {
+          this.settle(entry, { status: receipt.status === 1 ? 'confirmed' : 'reverted', receipt, txHash: receipt.hash });
+        } else if (now - entry.sentAt > this.options.receiptTimeoutMs) {
+          stale.push(entry);
+        }
+      });
+
+      if (stale.length > 0) {
+        const minedNonce = await provider.getTransactionCount(account, 'latest');
+        for (const entry of stale) {
+          if (entry.nonce < minedNonce) {
+            // Mined since the receipt poll, or taken by another transaction.
+            const late = await Promise.all(entry.hashes.map((hash) => provider.getTransactionReceipt(hash).catch(() => null)));
+            const receipt = late.find((r) => r !== null) ?? null;
+            if (receipt) {
+              this.settle(entry, { status: receipt.status === 1 ? 'confirmed' : 'reverted', receipt, txHash: receipt.hash });
+            } else {
+              this.settle(entry, { status: 'replaced' });
+            }
+          } else if (entry.resubmits < this.options.maxResubmits) {
+            await this.resubmit(entry);
+          } else {
+            await this.dropIfUnknown(entry);
+          }
+        }
+      }
+
+      await this.fillNonceGaps();
+    } finally {
+      this.polling = false;
+      if (this.tracked.size > 0) this.schedulePoll();
+    }
+  }
+
+  private async resubmit(entry: Tracked) {
+    const request: TransactionRequest = { ...entry.request };
+    if (request.maxFeePerGas != null && request.maxPriorityFeePerGas != null) {
+      request.maxFeePerGas = (BigInt(request.maxFeePerGas) * FEE_BUMP_PERCENT) / BigInt(100);
+      request.maxPriorityFeePerGas = (BigInt(request.maxPriorityFeePerGas) * FEE_BUMP_PERCENT) / BigInt(100);
+    } else if (request.gasPrice != null) {
+      request.gasPrice = (BigInt(request.gasPrice) * FEE_BUMP_PERCENT) / BigInt(100);
+    }
+
+    entry.resubmits++;
+    entry.sentAt = Date.now();
+    this.counters.resubmits++;
+    try {
+      const response = await this.context.wallet.sendTransaction(request);
+      entry.request = request;
+      entry.hashes.push(response.hash);
+    } catch (error) {
+      // "nonce too low" here means one of our earlier hashes (or another
+      // sender) took the nonce; the next poll finds out which.
+      if (!isNonceError(error) && entry.resubmits >= this.options.maxResubmits) {
+        await this.dropIfUnknown(entry, toError(error));
+      }
+    }
+  }
+
+  // Out of resubmits. If the node still holds one of the hashes it may yet be
+  // mined, and reusing the nonce would replace it, so keep waiting for it.
+  private async dropIfUnknown(entry: Tracked, error?: Error) {
+    const known = await Promise.all(
+      entry.hashes.map((hash) => this.context.provider.getTransaction(hash).catch(() => undefined))
+    );
+    // undefined: the lookup failed, so nothing is known either way yet.
+    if (known.some((tx) => tx !== null)) {
+      entry.sentAt = Date.now();
+      return;
+    }
+    this.releasedNonces.push(entry.nonce);
+    this.settle(entry, { status: 'dropped', error });
+  }
+
+  // A nonce freed by a refused or dropped write blocks every later one in
+  // flight. Writes holding a slot take the lowest freed nonces next; any left
+  // below the highest nonce in flight get a zero-value self-transfer.
+  private async fillNonceGaps() {
+    if (this.releasedNonces.length === 0) return;
+    const highest = Math.max(-1, ...this.tracked.keys());
+    const gaps = this.releasedNonces.filter((nonce) => nonce < highest).length - this.preparing;
+
+    // takeNonce hands out the lowest released nonce first.
+    for (let i = 0; i < gaps; i++) {
+      this.counters.gapFills++;
+      await this.broadcast(null, { to: this.context.account, value: BigInt(0), gasLimit: BigInt(21000) });
+    }
+  }
+
+  private settle(
+    entry: Tracked,
+    result: { status: WriteStatus; receipt?: TransactionReceipt | null; txHash?: string; error?: Error }
+  ) {
+    this.tracked.delete(entry.nonce);
+    if (!entry.job) {
+      this.checkIdle();
+      return;
+    }
+    this.finish(entry.job, {
+      ...result,
+      nonce: entry.nonce,
+      txHash: result.txHash ?? entry.hashes[entry.hashes.length - 1],
+      resubmits: entry.resubmits,
+    });
+  }
+
+  private finish(
+    job: Job,
+    result: {
+      status: WriteStatus;
+      nonce?: number | null;
+      txHash?: string | null;
+      receipt?: TransactionReceipt | null;
+      error?: Error | null;
+      resubmits?: number;
+    }
+  ) {
+    const outcome: WriteOutcome = {
+      id: job.id,
+      label: job.options.label,
+      method: job.method,
+      status: result.status,
+      nonce: result.nonce ?? null,
+      txHash: result.txHash ?? null,
+      receipt: result.receipt ?? null,
+      error:
+        result.error ??
+        (result.status === 'confirmed' ? null : new Error(`Transaction ${result.status}${result.txHash ? ` (${result.txHash})` : ''}.`)),
+      resubmits: result.resubmits ?? 0,
+      latencyMs: Date.now() - job.enqueuedAt,
+    };
+    this.counters[result.status]++;
+    this.queued--;
+    this.releaseSlot();
+    job.resolve(outcome);
+    this.options.onOutcome?.(outcome);
+    this.checkIdle();
+  }
+
+  private checkIdle() {
+    if (this.queued > 0 || this.tracked.size > 0) return;
+    const waiters = this.idleWaiters;
+    this.idleWaiters = [];
+    waiters.forEach((resolve) => resolve());
+  }
+}
@@ -2,8 +2,10 @@
 
 import { Contract } from 'ethers';
 import { isAddress } from 'ethers';
-import type { JsonRpcProvider, Wallet } from 'ethers';
 import { restoreManualWalletSession } from './manual-wallet';
+import { observeChainproofWriteBlock } from './chainproof-read';
+import { ChainproofWriteSession } from './chainproof-write-session';
+import type { ChainproofWriteContext, WriteSessionOptions } from './chainproof-write-session';
 
 type RegistryEntry = {
   chainId: number;
@@ -58,13 +60,23 @@ export type ReceiveTransferredBatchResult = {
   batchId: number;
 };
 
-type ChainproofWriteContext = {
-  provider: JsonRpcProvider;
-  wallet: Wallet;
-  contract: Contract;
-  chainId: number;
-  contractAddress: string;
-  account: string;
+export type ReceiveTransferredBatchesProgress = {
+  done: number;
+  total: number;
+  lookup: string;
+  result: ReceiveTransferredBatchResult | null;
+  error: Error | null;
+};
+
+export type ReceiveTransferredBatchesOptions = {
+  maxInFlight?: number;
+  onProgress?: (progress: ReceiveTransferredBatchesProgress) => void;
+};
+
+export type ReceiveTransferredBatchesResult = {
+  received: ReceiveTransferredBatchResult[];
+  failed: Array<{ lookup: string; error: Error }>;
+  elapsedMs: number;
 };
 
 const CHAINPROOF_WRITE_ABI = [
@@ -201,6 +213,13 @@ async function createChainproofWriteContext(
   return { provider, wallet, contract, chainId, contractAddress, account };
 }
 
+// Reads after a write must not be served from before its block.
+async function observeReceipt(receipt: { blockNumber?: number } | null | undefined) {
+  if (typeof receipt?.blockNumber === 'number') {
+    await observeChainproofWriteBlock(receipt.blockNumber);
+  }
+}
+
 function getHarvestedBatchId(contract: Contract, receipt: { logs?: Array<{ data: string; topics: string[] }> } | null) {
   const logs = receipt?.logs || [];
   for (const log of logs) {
@@ -242,6 +261,7 @@ export async function harvestProducerBatch(input: HarvestProducerBatchInput): Pr
 
     const tx = await context.contract.harvestBatch(origin, ipfsHash, BigInt(quantity), trackingCode);
     const receipt = await tx.wait();
+    await observeReceipt(receipt);
     const newBatchId = getHarvestedBatchId(context.contract, receipt);
 
     return {
@@ -269,7 +289,7 @@ export async function initiateBatchTransfer(
     const context = await createChainproofWriteContext();
     const batchId = await resolveBatchIdFromLookup(context, input.lookup);
     const tx = await context.contract.initiateTransfer(BigInt(batchId), recipient);
-    await tx.wait();
+    await observeReceipt(await tx.wait());
 
     return {
       chainId: context.chainId,
@@ -291,7 +311,7 @@ export async function receiveTransferredBatch(
     const context = await createChainproofWriteContext();
     const batchId = await resolveBatchIdFromLookup(context, input.lookup);
     const tx = await context.contract.receiveBatch(BigInt(batchId));
-    await tx.wait();
+    await observeReceipt(await tx.wait());
 
     return {
       chainId: context.chainId,
@@ -304,3 +324,78 @@ export async function receiveTransferredBatch(
     throw mapWriteError(error);
   }
 }
+
+// One context and one nonce sequence for many writes; see ChainproofWriteSession.
+export async function openChainproofWriteSession(options?: WriteSessionOptions): Promise<ChainproofWriteSession> {
+  const context = await createChainproofWriteContext();
+  return new ChainproofWriteSession(context, options);
+}
+
+export async function receiveTransferredBatches(
+  lookups: string[],
+  options: ReceiveTransferredBatchesOptions = {}
+): Promise<ReceiveTransferredBatchesResult> {
+  let session: ChainproofWriteSession;
+  try {
+    session = await openChainproofWriteSession({ maxInFlight: options.maxInFlight });
+  } catch (error) {
+    throw mapWriteError(error);
+  }
+
+  try {
+    return await receiveTransferredBatchesInSession(session, lookups, options.onProgress);
+  } finally {
+    session.close();
+  }
+}
+
+// The body of receiveTransferredBatches, on a session the caller owns.
+export async function receiveTransferredBatchesInSession(
+  session: ChainproofWriteSession,
+  lookups: string[],
+  onProgress?: ReceiveTransferredBatchesOptions['onProgress']
+): Promise<ReceiveTransferredBatchesResult> {
+  const started = Date.now();
+  const received: ReceiveTransferredBatchResult[] = [];
+  const failed: Array<{ lookup: string; error: Error }> = [];
+  let done = 0;
+
+  const report = (lookup: string, result: ReceiveTransferredBatchResult | null, error: Error | null) => {
+    done++;
+    if (result) {
+      received.push(result);
+    } else if (error) {
+      failed.push({ lookup, error });
+    }
+    onProgress?.({ done, total: lookups.length, lookup, result, error });
+  };
+
+  const { context } = session;
+  await Promise.all(
+    lookups.map(async (lookup) => {
+      try {
+        const batchId = await resolveBatchIdFromLookup(context, lookup);
+        const outcome = await session.submit('receiveBatch', [BigInt(batchId)], { label: lookup });
+        if (outcome.status !== 'confirmed') {
+          throw outcome.error || new Error('Receive transaction failed.');
+        }
+        await observeReceipt(outcome.receipt);
+        report(
+          lookup,
+          {
+            chainId: context.chainId,
+            contractAddress: context.contractAddress,
+            txHash: String(outcome.txHash),
+            account: context.account,
+            batchId,
+          },
+          null
+        );
+      } catch (error) {
+        report(lookup, null, mapWriteError(error));
+      }
+    })
+  );
+
+  return { received, failed, elapsedMs: Date.now() - started };
+}
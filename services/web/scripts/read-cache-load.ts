@@ -0,0 +1,143 @@
+// Load test for the block-aware ChainProof read cache.
+//
+// Start a local node and deploy first (`npx hardhat node` and
+// `npx hardhat run scripts/deploy.js --network localhost` in services/smart-contracts),
+// then run `npm run loadtest:read` from services/web.
+//
+// Environment:
+//   NEXT_PUBLIC_CHAINPROOF_RPC_URL  RPC endpoint (default http://127.0.0.1:8545)
+//   LOAD_CLIENTS                    concurrent simulated dashboards (default 50)
+//   LOAD_ROUNDS                     page loads per dashboard (default 20)
+//   LOAD_MINE_INTERVAL_MS           mine an empty block this often, 0 to disable (default 1000)
+import path from 'node:path';
+import { readFileSync } from 'node:fs';
+import { performance } from 'node:perf_hooks';
+import { Contract, JsonRpcProvider } from 'ethers';
+import type { JsonRpcPayload, JsonRpcResult } from 'ethers';
+import { CHAINPROOF_READ_ABI } from '../lib/chainproof-read';
+import { ChainproofReadCache } from '../lib/chainproof-read-cache';
+
+type Reader = {
+  call: (method: string, ...args: unknown[]) => Promise<unknown>;
+  queryEvents: (eventName: string, ...args: unknown[]) => Promise<unknown>;
+};
+
+class CountingProvider extends JsonRpcProvider {
+  requests = 0;
+
+  async _send(payload: JsonRpcPayload | Array<JsonRpcPayload>): Promise<Array<JsonRpcResult>> {
+    this.requests += Array.isArray(payload) ? payload.length : 1;
+    return super._send(payload);
+  }
+}
+
+const rpcUrl = process.env.NEXT_PUBLIC_CHAINPROOF_RPC_URL || 'http://127.0.0.1:8545';
+const contractKey = process.env.NEXT_PUBLIC_CHAINPROOF_CONTRACT_KEY || 'chainproof';
+const clients = Number(process.env.LOAD_CLIENTS || '50');
+const rounds = Number(process.env.LOAD_ROUNDS || '20');
+const mineIntervalMs = Number(process.env.LOAD_MINE_INTERVAL_MS || '1000');
+
+function loadContractAddress(chainId: number) {
+  const registryPath = path.resolve(process.cwd(), '..', 'smart-contracts', 'config', 'contracts.json');
+  const registry = JSON.parse(readFileSync(registryPath, 'utf-8'));
+  const address = registry?.[contractKey]?.[String(chainId)]?.address;
+  if (!address) {
+    throw new Error(`No contract registry entry found for key "${contractKey}" on chain ${chainId}.`);
+  }
+  return String(address);
+}
+
+function percentile(sorted: number[], p: number) {
+  if (sorted.length === 0) return 0;
+  const index = Math.min(sorted.length - 1, Math.floor((p / 100) * sorted.length));
+  return sorted[index];
+}
+
+async function dashboardPageLoad(reader: Reader, batchCount: number, client: number, round: number) {
+  await Promise.all([reader.call('owner'), reader.call('batchCount')]);
+  if (batchCount === 0) return;
+
+  const batchId = ((client + round) % Math.min(batchCount, 10)) + 1;
+  await Promise.all([
+    reader.call('batches', batchId),
+    reader.call('getParentBatches', batchId),
+    reader.call('getChildBatches', batchId),
+    reader.queryEvents('BatchHarvested', batchId),
+    reader.queryEvents('BatchTransferInitiated', batchId),
+    reader.queryEvents('BatchReceived', batchId),
+  ]);
+}
+
+async function runScenario(name: string, provider: CountingProvider, reader: Reader, batchCount: number) {
+  const latencies: number[] = [];
+  const startRequests = provider.requests;
+  const miner =
+    mineIntervalMs > 0 ? setInterval(() => void provider.send('evm_mine', []).catch(() => undefined), mineIntervalMs) : null;
+
+  const started = performance.now();
+  await Promise.all(
+    Array.from({ length: clients }, async (_, client) => {
+      for (let round = 0; round < rounds; round++) {
+        const t0 = performance.now();
+        await dashboardPageLoad(reader, batchCount, client, round);
+        latencies.push(performance.now() - t0);
+      }
+    })
+  );
+  const elapsedMs = performance.now() - started;
+  if (miner) clearInterval(miner);
+
+  latencies.sort((a, b) => a - b);
+  return {
+    scenario: name,
+    pageLoads: latencies.length,
+    rpcRequests: provider.requests - startRequests,
+    elapsedMs: Math.round(elapsedMs),
+    pageLoadsPerSecond: Number(((latencies.length / elapsedMs) * 1000).toFixed(1)),
+    latencyMs: {
+      p50: Number(percentile(latencies, 50).toFixed(2)),
+      p95: Number(percentile(latencies, 95).toFixed(2)),
+      p99: Number(percentile(latencies, 99).toFixed(2)),
+    },
+  };
+}
+
+async function main() {
+  const provider = new CountingProvider(rpcUrl);
+  const chainId = Number((await provider.getNetwork()).chainId);
+  const contract = new Contract(loadContractAddress(chainId), CHAINPROOF_READ_ABI, provider);
+  const batchCount = Number(await contract.batchCount());
+
+  const direct: Reader = {
+    call: (method, ...args) => contract.getFunction(method)(...args),
+    queryEvents: (eventName, ...args) => contract.queryFilter(contract.filters[eventName](...args)),
+  };
+  const uncached = await runScenario('uncached', provider, direct, batchCount);
+
+  const cache = new ChainproofReadCache(provider, contract);
+  const cached = await runScenario('cached', provider, cache, batchCount);
+  const stats = cache.stats();
+  await cache.dispose();
+  provider.destroy();
+
+  console.log(
+    JSON.stringify(
+      {
+        rpcUrl,
+        chainId,
+        batchCount,
+        clients,
+        rounds,
+        mineIntervalMs,
+        results: [uncached, { ...cached, cache: stats }],
+      },
+      null,
+      2
+    )
+  );
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exitCode = 1;
+});
@@ -0,0 +1,252 @@
+// Throughput benchmark for pipelined ChainProof writes.
+//
+// Start a local node and deploy first (`npx hardhat node` and
+// `npx hardhat run scripts/deploy.js --network localhost` in services/smart-contracts),
+// then run `npm run bench:write` from services/web.
+//
+// A producer harvests pallets and transfers them to a warehouse, which then
+// receives them once with the old send-and-wait loop and once through
+// ChainproofWriteSession. Results are printed as JSON.
+//
+// Environment:
+//   NEXT_PUBLIC_CHAINPROOF_RPC_URL  RPC endpoint (default http://127.0.0.1:8545)
+//   BENCH_PALLETS                   pallets received per scenario (default 50)
+//   BENCH_MAX_IN_FLIGHT             session in-flight limit (default 16)
+//   BENCH_BLOCK_INTERVAL_MS         interval mining period, 0 keeps automine (default 1000)
+//   BENCH_DROP_EVERY                drop every Nth pending session transaction from the
+//                                   node's mempool to exercise resubmission, 0 to disable (default 0)
+//   BENCH_PRODUCER_KEY              producer private key (default Hardhat account #1)
+//   BENCH_WAREHOUSE_KEY             warehouse private key (default Hardhat account #3)
+import path from 'node:path';
+import { readFileSync } from 'node:fs';
+import { performance } from 'node:perf_hooks';
+import { Contract, JsonRpcProvider, Wallet } from 'ethers';
+import { ChainproofWriteSession } from '../lib/chainproof-write-session';
+import type { ChainproofWriteContext, WriteOutcome } from '../lib/chainproof-write-session';
+
+const BENCH_ABI = [
+  'function roles(address) view returns (uint8)',
+  'function assignMyRole(uint8 role)',
+  'function harvestBatch(string origin, string ipfsHash, uint256 quantity, string trackingCode) returns (uint256 newBatchId)',
+  'function initiateTransfer(uint256 batchId, address to)',
+  'function receiveBatch(uint256 batchId)',
+  'event BatchHarvested(uint256 indexed id, address indexed creator, uint256 quantity, string trackingCode, uint256 timestamp)',
+] as const;
+
+const PRODUCER_ROLE = 1;
+const WAREHOUSE_ROLE = 3;
+
+const rpcUrl = process.env.NEXT_PUBLIC_CHAINPROOF_RPC_URL || 'http://127.0.0.1:8545';
+const contractKey = process.env.NEXT_PUBLIC_CHAINPROOF_CONTRACT_KEY || 'chainproof';
+const pallets = Number(process.env.BENCH_PALLETS || '50');
+const maxInFlight = Number(process.env.BENCH_MAX_IN_FLIGHT || '16');
+const blockIntervalMs = Number(process.env.BENCH_BLOCK_INTERVAL_MS || '1000');
+const dropEvery = Number(process.env.BENCH_DROP_EVERY || '0');
+const producerKey =
+  process.env.BENCH_PRODUCER_KEY || '0x59c6995e998f97a5a0044966f0945389dc9e86dae88c7a8412f4603b6b78690d';
+const warehouseKey =
+  process.env.BENCH_WAREHOUSE_KEY || '0x7c852118294e51e653712a81e05800f419141751be58f605c371e15141b007a6';
+
+function loadContractAddress(chainId: number) {
+  const registryPath = path.resolve(process.cwd(), '..', 'smart-contracts', 'config', 'contracts.json');
+  const registry = JSON.parse(readFileSync(registryPath, 'utf-8'));
+  const address = registry?.[contractKey]?.[String(chainId)]?.address;
+  if (!address) {
+    throw new Error(`No contract registry entry found for key "${contractKey}" on chain ${chainId}.`);
+  }
+  return String(address);
+}
+
+function percentile(sorted: number[], p: number) {
+  if (sorted.length === 0) return 0;
+  const index = Math.min(sorted.length - 1, Math.floor((p / 100) * sorted.length));
+  return sorted[index];
+}
+
+async function makeContext(provider: JsonRpcProvider, key: string, chainId: number, address: string) {
+  // A plain Wallet; ethers' NonceManager would hide exactly what is measured here.
+  const wallet = new Wallet(key, provider);
+  const contract = new Contract(address, BENCH_ABI, wallet);
+  const context: ChainproofWriteContext = {
+    provider,
+    wallet,
+    contract,
+    chainId,
+    contractAddress: address,
+    account: await wallet.getAddress(),
+  };
+  return context;
+}
+
+async function ensureRole(context: ChainproofWriteContext, role: number) {
+  if (Number(await context.contract.roles(context.account)) === role) return;
+  const tx = await context.contract.assignMyRole(role);
+  await tx.wait();
+}
+
+function summarize(name: string, latencies: number[], elapsedMs: number, extra: Record<string, unknown> = {}) {
+  latencies.sort((a, b) => a - b);
+  return {
+    scenario: name,
+    transactions: latencies.length,
+    elapsedMs: Math.round(elapsedMs),
+    txPerSecond: Number(((latencies.length / elapsedMs) * 1000).toFixed(2)),
+    latencyMs: {
+      p50: Math.round(percentile(latencies, 50)),
+      p95: Math.round(percentile(latencies, 95)),
+      p99: Math.round(percentile(latencies, 99)),
+    },
+    ...extra,
+  };
+}
+
+// Removes every Nth new transaction from the account's pending pool before it
+// is mined, the way a congested public mempool might evict it.
+function startDropper(provider: JsonRpcProvider, account: string) {
+  if (dropEvery <= 0 || blockIntervalMs <= 0) return { stop: () => 0 };
+  const seen = new Set<string>();
+  let dropped = 0;
+  const timer = setInterval(async () => {
+    try {
+      const block = await provider.send('eth_getBlockByNumber', ['pending', true]);
+      for (const tx of block?.transactions || []) {
+        if (seen.has(tx.hash) || String(tx.from).toLowerCase() !== account.toLowerCase()) continue;
+        seen.add(tx.hash);
+        if (seen.size % dropEvery === 0) {
+          await provider.send('hardhat_dropTransaction', [tx.hash]);
+          dropped++;
+        }
+      }
+    } catch {
+      // Node without the hardhat_* methods; leave the pool alone.
+    }
+  }, Math.max(50, Math.floor(blockIntervalMs / 4)));
+  return {
+    stop: () => {
+      clearInterval(timer);
+      return dropped;
+    },
+  };
+}
+
+function sessionFor(context: ChainproofWriteContext) {
+  return new ChainproofWriteSession(context, {
+    maxInFlight,
+    pollIntervalMs: Math.max(100, Math.floor((blockIntervalMs || 400) / 2)),
+    // Short enough that a dropped transaction is noticed within the run.
+    receiptTimeoutMs: Math.max(2000, (blockIntervalMs || 1000) * 3),
+  });
+}
+
+function harvestedId(context: ChainproofWriteContext, outcome: WriteOutcome) {
+  for (const log of outcome.receipt?.logs || []) {
+    const parsed = context.contract.interface.parseLog(log);
+    if (parsed?.name === 'BatchHarvested') return Number(parsed.args.id);
+  }
+  throw new Error(`No BatchHarvested event in ${outcome.txHash}.`);
+}
+
+async function runSession(
+  name: string,
+  context: ChainproofWriteContext,
+  calls: Array<{ method: string; args: unknown[] }>
+) {
+  const session = sessionFor(context);
+  const dropper = startDropper(context.provider, context.account);
+  const started = performance.now();
+  const outcomes = await Promise.all(calls.map((call) => session.submit(call.method, call.args)));
+  const elapsedMs = performance.now() - started;
+  const droppedByNode = dropper.stop();
+  const stats = session.stats();
+  session.close();
+
+  const failed = outcomes.filter((outcome) => outcome.status !== 'confirmed');
+  if (failed.length > 0) {
+    throw new Error(`${name}: ${failed.length} writes did not confirm (${failed[0].status}: ${failed[0].error?.message}).`);
+  }
+  return {
+    outcomes,
+    result: summarize(
+      name,
+      outcomes.map((outcome) => outcome.latencyMs),
+      elapsedMs,
+      { droppedByNode, session: stats }
+    ),
+  };
+}
+
+async function runSequential(name: string, context: ChainproofWriteContext, calls: Array<{ method: string; args: unknown[] }>) {
+  const latencies: number[] = [];
+  const started = performance.now();
+  for (const call of calls) {
+    const t0 = performance.now();
+    const tx = await context.contract.getFunction(call.method)(...call.args);
+    await tx.wait();
+    latencies.push(performance.now() - t0);
+  }
+  return summarize(name, latencies, performance.now() - started);
+}
+
+async function main() {
+  const provider = new JsonRpcProvider(rpcUrl);
+  const chainId = Number((await provider.getNetwork()).chainId);
+  const address = loadContractAddress(chainId);
+  const producer = await makeContext(provider, producerKey, chainId, address);
+  const warehouse = await makeContext(provider, warehouseKey, chainId, address);
+
+  await ensureRole(producer, PRODUCER_ROLE);
+  await ensureRole(warehouse, WAREHOUSE_ROLE);
+
+  if (blockIntervalMs > 0) {
+    await provider.send('evm_setAutomine', [false]);
+    await provider.send('evm_setIntervalMining', [blockIntervalMs]);
+  }
+
+  try {
+    const runTag = Date.now().toString(36);
+    const harvests = Array.from({ length: pallets * 2 }, (_, i) => ({
+      method: 'harvestBatch',
+      args: ['Bench Farm', `temp://bench/${runTag}/${i}`, BigInt(100), `BENCH-${runTag}-${i}`],
+    }));
+    const harvested = await runSession('producer harvest (session)', producer, harvests);
+    const batchIds = harvested.outcomes.map((outcome) => harvestedId(producer, outcome));
+
+    const transfers = batchIds.map((batchId) => ({
+      method: 'initiateTransfer',
+      args: [BigInt(batchId), warehouse.account],
+    }));
+    const transferred = await runSession('producer transfer (session)', producer, transfers);
+
+    const receives = batchIds.map((batchId) => ({ method: 'receiveBatch', args: [BigInt(batchId)] }));
+    const sequential = await runSequential('warehouse receive (send and wait)', warehouse, receives.slice(0, pallets));
+    const pipelined = await runSession('warehouse receive (session)', warehouse, receives.slice(pallets));
+
+    console.log(
+      JSON.stringify(
+        {
+          rpcUrl,
+          chainId,
+          pallets,
+          maxInFlight,
+          blockIntervalMs,
+          dropEvery,
+          results: [harvested.result, transferred.result, sequential, pipelined.result],
+          receiveSpeedup: Number((sequential.elapsedMs / pipelined.result.elapsedMs).toFixed(2)),
+        },
+        null,
+        2
+      )
+    );
+  } finally {
+    if (blockIntervalMs > 0) {
+      await provider.send('evm_setIntervalMining', [0]);
+      await provider.send('evm_setAutomine', [true]);
+    }
+    provider.destroy();
+  }
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exitCode = 1;
+});